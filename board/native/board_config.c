@@ -0,0 +1,40 @@
+/**
+ * Native node configuration storage
+ *
+ * There is no flashrom on the host, the configuration lives in RAM for the
+ * lifetime of the process.
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ * @}
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <config.h>
+
+char configmem[sizeof(configmem_t)];
+
+void config_load(void) {
+    configmem_t *mem = (configmem_t*) configmem;
+
+    if (mem->magic_key == CONFIG_KEY) {
+        memcpy(&sysconfig, &mem->config, sizeof(sysconfig));
+    }
+    else {
+        config_save();
+    }
+}
+
+uint8_t config_save(void) {
+    configmem_t mem = { CONFIG_KEY, sysconfig };
+    memcpy(configmem, &mem, sizeof(mem));
+    return 1;
+}
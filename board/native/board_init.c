@@ -0,0 +1,39 @@
+/**
+ * Native board initialization
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ * @}
+ */
+
+#include <stdio.h>
+
+#include <board.h>
+#include <cpu.h>
+#ifdef MODULE_BOARD_CC110X
+#include <cc110x_emu.h>
+#endif
+
+volatile int native_led_red = 0;
+volatile int native_led_green = 0;
+
+void board_init(void) {
+    /* behave like a serial line: flush every line, even into pipes */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    LED_RED_OFF;
+    LED_GREEN_OFF;
+
+    native_uart0_init();
+
+#ifdef MODULE_BOARD_CC110X
+    cc110x_emu_clock_init();
+#endif
+}
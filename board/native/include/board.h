@@ -0,0 +1,37 @@
+/**
+ * Native board definitions
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ */
+
+#ifndef __BOARD_H
+#define __BOARD_H
+
+#include <bitarithm.h>
+
+/* there are no LEDs on a host, their state is kept for inspection only */
+extern volatile int native_led_red;
+extern volatile int native_led_green;
+
+#define LED_GREEN_OFF (native_led_green = 0)
+#define LED_GREEN_ON (native_led_green = 1)
+#define LED_GREEN_TOGGLE (native_led_green ^= 1)
+#define LED_RED_OFF (native_led_red = 0)
+#define LED_RED_ON (native_led_red = 1)
+#define LED_RED_TOGGLE (native_led_red ^= 1)
+
+/**
+ * @brief   Connect stdin to uart0 (SIGIO driven).
+ */
+void native_uart0_init(void);
+
+/** @} */
+#endif /* __BOARD_H */
@@ -0,0 +1,150 @@
+/**
+ * Emulated CC1100 for native boards
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @brief   Register level CC1100 model behind the board_cc110x interface
+ *
+ * The emulator implements cc110x_txrx(), the chip select and the GDO pins,
+ * so both cc110x drivers run unmodified on top of it. It decodes the SPI
+ * header bytes, keeps the configuration registers, PATABLE and both
+ * 64 byte FIFOs and runs the radio state machine (IDLE, RX, TX, FSTXON,
+ * WOR, SLEEP and the FIFO error states) including calibration and
+ * settling delays.
+ *
+ * Timing follows the configuration: the data rate comes from MDMCFG4/3,
+ * preamble and sync word length from MDMCFG1/2, CRC and length handling
+ * from PKTCTRL0/1, the states after RX and TX from MCSM1 and the wake on
+ * radio period from WOREVT1/0, WORCTRL and MCSM2. GDO0 and GDO2 support
+ * the sync word/end of packet (0x06), carrier sense (0x0E) and CCA (0x09)
+ * functions. As on the MSB-A2 the GDO2 interrupt fires on the falling and
+ * the GDO0 interrupt on the rising edge; they are delivered as
+ * NATIVE_IRQ_GPIO. The board runs the kernel's hwtimers on the emulator's
+ * clock, see cc110x_emu_clock_init().
+ *
+ * The air is the process itself: frames sent by the driver go to the hook
+ * set with cc110x_emu_set_tx_hook(), frames from other nodes are put on the
+ * air with cc110x_emu_receive(), and cc110x_emu_set_busy() occupies the
+ * channel without a frame. Overlapping incoming frames destroy each other
+ * and nothing is received while sending.
+ *
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ */
+
+#ifndef CC110X_EMU_H_
+#define CC110X_EMU_H_
+
+#include <stdint.h>
+
+#define CC110X_EMU_FIFO_SIZE        (64)
+#define CC110X_EMU_AIR_QUEUE_SIZE   (8)     ///< frames of other nodes to start later
+#define CC110X_EMU_NOISE_DBM        (-100)  ///< RSSI of a free channel
+
+/* state transitions, datasheet values for a 26 MHz crystal */
+#define CC110X_EMU_CALIBRATE_US     (720)   ///< IDLE to RX or TX with FS_AUTOCAL
+#define CC110X_EMU_SETTLE_US        (90)    ///< IDLE to RX or TX without calibration
+#define CC110X_EMU_TURNAROUND_US    (22)    ///< RX to TX and TX to RX
+
+/* what the MCU's accesses cost on the emulator's clock */
+#define CC110X_EMU_SPI_BYTE_US      (2)     ///< a byte over SPI at 4 MHz
+#define CC110X_EMU_PIN_READ_US      (1)     ///< reading a GDO pin
+#define CC110X_EMU_TIMER_READ_US    (1)     ///< reading the hwtimer counter
+
+/* host time between looks whether the CPU idles while an event is ahead */
+#define CC110X_EMU_IDLE_CHECK_US    (20)
+
+typedef struct {
+    uint32_t spi_bytes;         ///< bytes clocked over SPI
+    uint32_t strobes;
+    uint32_t frames_out;        ///< frames sent by the driver
+    uint32_t frames_in;         ///< frames put on the air for us
+    uint32_t frames_received;   ///< frames that ended up in the RX FIFO
+    uint32_t frames_missed;     ///< radio not listening, sending or asleep
+    uint32_t frames_filtered;   ///< address or length check failed
+    uint32_t frames_collided;   ///< destroyed by an overlapping frame
+    uint32_t rx_overflows;
+    uint32_t tx_underflows;
+    uint32_t air_time_out;      ///< us spent sending
+} cc110x_emu_statistic_t;
+
+extern cc110x_emu_statistic_t cc110x_emu_statistic;
+
+/**
+ * @brief   Called when a frame sent by the driver has left the antenna
+ *
+ * Runs with interrupts disabled, from interrupt or thread context, and
+ * must not call back into the emulator.
+ *
+ * @param frame     length byte followed by the payload (address first)
+ * @param end       emulator time (us) of the end of the frame
+ */
+typedef void (*cc110x_emu_tx_hook_t)(const uint8_t *frame, uint32_t end);
+
+void cc110x_emu_set_tx_hook(cc110x_emu_tx_hook_t hook);
+
+/**
+ * @brief   Put a frame from another node on the air, starting now
+ *
+ * @param frame     length byte followed by the payload (address first)
+ * @param rssi      received signal strength in dBm
+ * @param lqi       link quality, 0..127
+ * @param crc_ok    0 to make the frame fail its CRC check
+ *
+ * @return  emulator time (us) at which the frame ends
+ */
+uint32_t cc110x_emu_receive(const uint8_t *frame, int rssi, uint8_t lqi, uint8_t crc_ok);
+
+/**
+ * @brief   Put a frame from another node on the air at a given time
+ *
+ * Like cc110x_emu_receive(), but the frame starts at emulator time
+ * <em>start</em>, right away if that has passed. A frame may start when
+ * the one before ends, without colliding.
+ *
+ * @return  emulator time (us) at which the frame ends, 0 if
+ *          CC110X_EMU_AIR_QUEUE_SIZE frames are waiting already
+ */
+uint32_t cc110x_emu_receive_at(uint32_t start, const uint8_t *frame, int rssi, uint8_t lqi,
+                               uint8_t crc_ok);
+
+/**
+ * @brief   Occupy the channel for duration us, starting now
+ *
+ * @param rssi  signal strength seen by carrier sense and RSSI
+ */
+void cc110x_emu_set_busy(uint32_t duration, int rssi);
+
+/**
+ * @return  time in us a frame of the given length byte spends on air,
+ *          preamble and sync word included
+ */
+uint32_t cc110x_emu_air_time(uint8_t length);
+
+/**
+ * @return  the emulator's clock in us
+ *
+ * The clock is virtual: it runs with the SPI bytes, pin and timer reads
+ * of the MCU and skips to the next event on air or the next hwtimer while
+ * the CPU idles, so it does not depend on the host. A thread that polls
+ * for an interrupt has to read a pin or the hwtimer in its loop, a loop
+ * on a flag alone does not move the clock.
+ */
+uint32_t cc110x_emu_now(void);
+
+/**
+ * @brief   Run the hwtimers, and vtimer on top of them, on the emulator's
+ *          clock
+ *
+ * Called from board_init(), so the drivers' waits and timeouts keep to
+ * the same time as the radio.
+ */
+void cc110x_emu_clock_init(void);
+
+/** @} */
+#endif /* CC110X_EMU_H_ */
@@ -0,0 +1,1099 @@
+/**
+ * Emulated CC1100 for native boards
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ * @}
+ */
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <cpu.h>
+#include <hwtimer_cpu.h>
+#include <irq.h>
+#include <kernel.h>
+#include <sched.h>
+
+#include <cc110x_ng.h>
+#include <cc110x-arch.h>
+#include <cc110x-internal.h>
+#include <cc110x_spi.h>
+
+#include "cc110x_emu.h"
+
+//#define ENABLE_DEBUG
+#include <debug.h>
+
+#define XOSC_HZ             (26000000ULL)
+#define CONF_REGISTERS      (CC1100_TEST0 + 1)
+
+/* a at or after b, for the wrapping microsecond clock */
+#define AFTER(a, b)         ((int32_t) ((a) - (b)) >= 0)
+
+/* radio states, the SPI status byte reports the first six */
+enum {
+    EMU_IDLE = 0,
+    EMU_RX = 1,
+    EMU_TX = 2,
+    EMU_FSTXON = 3,
+    EMU_RXFIFO_OVERFLOW = 6,
+    EMU_TXFIFO_UNDERFLOW = 7,
+    EMU_SLEEP,
+    EMU_WOR
+};
+
+/* GDOx_CFG values the model knows */
+#define GDO_SYNC_WORD       (0x06)
+#define GDO_CCA             (0x09)
+#define GDO_CARRIER_SENSE   (0x0E)
+#define GDO_INVERT          (0x40)
+
+cc110x_emu_statistic_t cc110x_emu_statistic;
+
+static uint8_t ready;
+static timer_t irq_timer;               ///< host time, looks whether the CPU idles
+static uint32_t emu_time;               ///< the virtual clock, us
+
+static uint8_t regs[CONF_REGISTERS];
+static uint8_t patable[8];
+static uint8_t patable_index;
+
+static uint8_t state = EMU_SLEEP;
+static uint32_t state_ready;            ///< end of calibration or settling
+static uint32_t wor_start;
+static uint8_t power_down;              ///< SPWD takes effect on CS high
+
+static uint8_t tx_fifo[CC110X_EMU_FIFO_SIZE];
+static uint8_t tx_fifo_len;
+static uint8_t rx_fifo[CC110X_EMU_FIFO_SIZE];
+static uint8_t rx_fifo_start;
+static uint8_t rx_fifo_end;
+
+/* the frame we are sending */
+static struct {
+    uint8_t active;
+    uint8_t complete;                   ///< all bytes were in the TX FIFO
+    uint8_t synced;
+    uint32_t sync;
+    uint32_t end;
+    uint8_t frame[CC110X_EMU_FIFO_SIZE];
+} own;
+
+/* the frame on the air for us */
+static struct {
+    uint8_t active;
+    uint8_t synced;
+    uint8_t heard;                      ///< the receiver got the sync word
+    uint8_t lost;                       ///< ... but stopped listening or collided
+    uint32_t start;
+    uint32_t sync;
+    uint32_t end;
+    int rssi;
+    uint8_t lqi;
+    uint8_t crc_ok;
+    uint8_t frame[CC110X_EMU_FIFO_SIZE];
+} in;
+
+static struct {
+    uint8_t active;
+    uint32_t end;
+    int rssi;
+} busy;
+
+/* frames of other nodes starting later, in the order of their start */
+static struct {
+    uint32_t start;
+    int rssi;
+    uint8_t lqi;
+    uint8_t crc_ok;
+    uint8_t frame[CC110X_EMU_FIFO_SIZE];
+} air_queue[CC110X_EMU_AIR_QUEUE_SIZE];
+static uint8_t air_queued;
+
+/* the hwtimers' next compare match */
+static struct {
+    uint8_t active;
+    uint8_t pending;                    ///< due, called from the next interrupt
+    uint32_t at;
+    void (*handler)(void);
+} emu_alarm;
+
+static uint8_t last_lqi;
+
+/* SPI transfer in progress */
+static uint8_t spi_header;              ///< next byte is a header byte
+static uint8_t spi_addr;
+static uint8_t spi_read;
+static uint8_t spi_burst;
+
+static uint8_t gdo0_irq_enabled;
+static uint8_t gdo2_irq_enabled;
+static uint8_t gdo0_level;
+static uint8_t gdo2_level;
+static uint8_t gdo0_pending;
+static uint8_t gdo2_pending;
+
+static cc110x_emu_tx_hook_t tx_hook;
+
+static void emu_init(void);
+static void advance(uint32_t now);
+static void update_pins(uint32_t t);
+static void rearm(void);
+
+/*---------------------------------------------------------------------------*/
+//                              Timing
+/*---------------------------------------------------------------------------*/
+
+/*
+ * The emulator keeps its own clock, so runs do not depend on the host's
+ * load. It advances by the time of each SPI byte, pin and timer read, and
+ * jumps to the next event while the CPU idles.
+ */
+uint32_t cc110x_emu_now(void) {
+    return emu_time;
+}
+
+/* the MCU accessed the emulator, called with interrupts disabled */
+static uint32_t spend(uint32_t us) {
+    emu_init();
+    emu_time += us;
+    return emu_time;
+}
+
+/* time n bytes take on air at the configured data rate */
+static uint32_t bytes_us(uint32_t n) {
+    uint8_t e = regs[CC1100_MDMCFG4] & 0x0F;
+    uint64_t m = 256 + regs[CC1100_MDMCFG3];
+
+    /* baud = (256 + DRATE_M) * 2^DRATE_E * f_xosc / 2^28 */
+    uint64_t baud_scaled = (m << e) * XOSC_HZ;
+    return (uint32_t) (((uint64_t) n * 8 * 1000000 * (1ULL << 28) + baud_scaled - 1) / baud_scaled);
+}
+
+static uint32_t preamble_bytes(void) {
+    static const uint8_t preamble[] = { 2, 3, 4, 6, 8, 12, 16, 24 };
+    uint8_t sync_mode = regs[CC1100_MDMCFG2] & 0x07;
+    uint32_t sync;
+
+    if ((sync_mode == 0) || (sync_mode == 4)) {
+        sync = 0;
+    }
+    else if ((sync_mode == 3) || (sync_mode == 7)) {
+        sync = 4;
+    }
+    else {
+        sync = 2;
+    }
+    return preamble[(regs[CC1100_MDMCFG1] >> 4) & 0x07] + sync;
+}
+
+/* length byte, payload and CRC */
+static uint32_t packet_bytes(uint8_t length) {
+    return 1 + length + ((regs[CC1100_PKTCTRL0] & 0x04) ? 2 : 0);
+}
+
+uint32_t cc110x_emu_air_time(uint8_t length) {
+    return bytes_us(preamble_bytes()) + bytes_us(packet_bytes(length));
+}
+
+static uint32_t wor_period_us(void) {
+    uint32_t event0 = ((uint32_t) regs[CC1100_WOREVT1] << 8) | regs[CC1100_WOREVT0];
+    uint8_t res = regs[CC1100_WORCTRL] & 0x03;
+
+    /* t_event0 = 750 / f_xosc * EVENT0 * 2^(5 * WOR_RES) */
+    return (uint32_t) (((uint64_t) event0 * 750 * 1000000 << (5 * res)) / XOSC_HZ);
+}
+
+/* whether wake on radio has the receiver on at time t */
+static uint8_t wor_listening(uint32_t t) {
+    uint8_t rx_time = regs[CC1100_MCSM2] & 0x07;
+    uint32_t period = wor_period_us();
+
+    if ((rx_time == 7) || (period == 0)) {
+        return 1;
+    }
+    /* RX timeout, 3.6058 % of the period for RX_TIME 0, halved per step */
+    uint32_t on = (uint32_t) ((uint64_t) period * 36058 / 1000000) >> rx_time;
+    return ((t - wor_start) % period) < on;
+}
+
+/*---------------------------------------------------------------------------*/
+//                              Radio
+/*---------------------------------------------------------------------------*/
+
+static uint8_t carrier(uint32_t t) {
+    return (busy.active && !AFTER(t, busy.end)) ||
+           (in.active && AFTER(t, in.start) && !AFTER(t, in.end));
+}
+
+static int rssi_dbm(uint32_t t) {
+    if (in.active && AFTER(t, in.start) && !AFTER(t, in.end)) {
+        return in.rssi;
+    }
+    if (busy.active && !AFTER(t, busy.end)) {
+        return busy.rssi;
+    }
+    return CC110X_EMU_NOISE_DBM;
+}
+
+/* RSSI_dBm = RSSI_dec / 2 - RSSI_offset, the offset is 74 dB */
+static uint8_t rssi_raw(int dbm) {
+    int raw = (dbm + 74) * 2;
+    if (raw < -128) raw = -128;
+    if (raw > 127) raw = 127;
+    return (uint8_t) raw;
+}
+
+static uint8_t rx_fifo_bytes(void) {
+    return rx_fifo_end - rx_fifo_start;
+}
+
+static void set_state(uint8_t new, uint32_t now) {
+    if (new == state) {
+        /* SRX in RX and STX in TX change nothing */
+        return;
+    }
+    if ((state == EMU_RX) && (new != EMU_RX) && in.active && in.heard) {
+        in.lost = 1;
+    }
+    if (own.active && (new != EMU_TX)) {
+        /* aborted by a strobe */
+        own.active = 0;
+    }
+
+    if ((new == EMU_RX) || (new == EMU_TX)) {
+        if ((state == EMU_RX) || (state == EMU_TX) || (state == EMU_FSTXON)) {
+            state_ready = now + CC110X_EMU_TURNAROUND_US;
+        }
+        else if (((regs[CC1100_MCSM0] >> 4) & 0x03) == 1) {
+            state_ready = now + CC110X_EMU_CALIBRATE_US;
+        }
+        else {
+            state_ready = now + CC110X_EMU_SETTLE_US;
+        }
+    }
+    state = new;
+}
+
+/* puts the TX FIFO on air once the transmitter is ready */
+static void start_tx(uint32_t now) {
+    set_state(EMU_TX, now);
+    if (tx_fifo_len == 0) {
+        /* sends preamble until the FIFO is filled, which never ends here */
+        return;
+    }
+
+    own.active = 1;
+    own.synced = 0;
+    own.complete = (tx_fifo[0] + 1 <= tx_fifo_len);
+    own.sync = state_ready + bytes_us(preamble_bytes());
+    if (AFTER(now, own.sync)) {
+        /* the preamble has been going on since the FIFO ran empty */
+        own.sync = now;
+    }
+    own.end = own.sync + bytes_us(packet_bytes(tx_fifo[0]));
+    memcpy(own.frame, tx_fifo, tx_fifo_len);
+    tx_fifo_len = 0;
+}
+
+static void off_mode(uint8_t mode, uint32_t now) {
+    switch (mode) {
+        case 1:
+            set_state(EMU_FSTXON, now);
+            break;
+        case 2:
+            start_tx(now);
+            break;
+        case 3:
+            set_state(EMU_RX, now);
+            break;
+        default:
+            set_state(EMU_IDLE, now);
+            break;
+    }
+}
+
+static void tx_end(uint32_t t) {
+    own.active = 0;
+
+    if (!own.complete) {
+        cc110x_emu_statistic.tx_underflows++;
+        set_state(EMU_TXFIFO_UNDERFLOW, t);
+        return;
+    }
+
+    cc110x_emu_statistic.frames_out++;
+    cc110x_emu_statistic.air_time_out += cc110x_emu_air_time(own.frame[0]);
+    DEBUG("cc110x_emu: sent %u bytes to %u\n", own.frame[0], own.frame[1]);
+    if (tx_hook != NULL) {
+        tx_hook(own.frame, t);
+    }
+
+    /* TXOFF_MODE, staying in TX sends preamble from now on */
+    state_ready = t;
+    off_mode(regs[CC1100_MCSM1] & 0x03, t);
+}
+
+static uint8_t address_ok(uint8_t addr) {
+    switch (regs[CC1100_PKTCTRL1] & 0x03) {
+        case 0:
+            return 1;
+        case 1:
+            return addr == regs[CC1100_ADDR];
+        case 2:
+            return (addr == regs[CC1100_ADDR]) || (addr == 0x00);
+        default:
+            return (addr == regs[CC1100_ADDR]) || (addr == 0x00) || (addr == 0xFF);
+    }
+}
+
+static void rx_sync(uint32_t t) {
+    uint32_t sync_start = t - bytes_us(2);
+
+    in.synced = 1;
+    if ((state == EMU_RX) && AFTER(sync_start, state_ready)) {
+        in.heard = 1;
+    }
+    else if ((state == EMU_WOR) && wor_listening(sync_start)) {
+        /* the poll caught the packet, the receiver stays on for it */
+        in.heard = 1;
+        state = EMU_RX;
+        state_ready = sync_start;
+    }
+}
+
+static void rx_end(uint32_t t) {
+    uint8_t length = in.frame[0];
+    uint8_t status = (regs[CC1100_PKTCTRL1] & 0x04) ? 2 : 0;
+
+    in.active = 0;
+    if (!in.heard) {
+        cc110x_emu_statistic.frames_missed++;
+        return;
+    }
+    if (in.lost) {
+        if (state == EMU_RX) {
+            cc110x_emu_statistic.frames_collided++;
+        }
+        else {
+            cc110x_emu_statistic.frames_missed++;
+        }
+        return;
+    }
+    if ((length > regs[CC1100_PKTLEN]) || !address_ok(in.frame[1]) ||
+        (!in.crc_ok && (regs[CC1100_PKTCTRL1] & 0x08))) {
+        /* discarded, the receiver restarts */
+        cc110x_emu_statistic.frames_filtered++;
+        return;
+    }
+
+    if (rx_fifo_start == rx_fifo_end) {
+        rx_fifo_start = rx_fifo_end = 0;
+    }
+    if (rx_fifo_start > 0) {
+        memmove(rx_fifo, rx_fifo + rx_fifo_start, rx_fifo_bytes());
+        rx_fifo_end -= rx_fifo_start;
+        rx_fifo_start = 0;
+    }
+    if (rx_fifo_end + 1 + length + status > CC110X_EMU_FIFO_SIZE) {
+        cc110x_emu_statistic.rx_overflows++;
+        set_state(EMU_RXFIFO_OVERFLOW, t);
+        return;
+    }
+
+    memcpy(rx_fifo + rx_fifo_end, in.frame, 1 + length);
+    rx_fifo_end += 1 + length;
+    last_lqi = (in.crc_ok ? CRC_OK : 0) | (in.lqi & LQI_EST);
+    if (status) {
+        rx_fifo[rx_fifo_end++] = rssi_raw(in.rssi);
+        rx_fifo[rx_fifo_end++] = last_lqi;
+    }
+    cc110x_emu_statistic.frames_received++;
+
+    /* RXOFF_MODE */
+    off_mode((regs[CC1100_MCSM1] >> 2) & 0x03, t);
+}
+
+/* a frame of another node starts at t, returns when it ends */
+static uint32_t put_on_air(const uint8_t *frame, int rssi, uint8_t lqi, uint8_t crc_ok,
+                           uint32_t t) {
+    uint8_t length = (frame[0] < CC110X_EMU_FIFO_SIZE) ? frame[0] : CC110X_EMU_FIFO_SIZE - 1;
+    uint32_t end = t + cc110x_emu_air_time(length);
+
+    cc110x_emu_statistic.frames_in++;
+
+    if (in.active) {
+        /* both frames are lost, the channel stays busy until the later ends */
+        in.lost = 1;
+        cc110x_emu_statistic.frames_in--;
+        cc110x_emu_statistic.frames_collided++;
+        if (!busy.active || AFTER(end, busy.end)) {
+            busy.end = end;
+        }
+        busy.active = 1;
+        busy.rssi = rssi;
+    }
+    else {
+        memset(&in, 0, sizeof(in));
+        memcpy(in.frame, frame, 1 + length);
+        in.frame[0] = length;
+        in.active = 1;
+        in.start = t;
+        in.sync = t + bytes_us(preamble_bytes());
+        in.end = end;
+        in.rssi = rssi;
+        in.lqi = lqi;
+        in.crc_ok = crc_ok;
+    }
+    return end;
+}
+
+/*
+ * Processes everything that happened on air up to now in time order and
+ * updates the GDO pins at each step, so no edge is skipped.
+ */
+static void advance(uint32_t now) {
+    while (1) {
+        uint32_t t = now;
+        uint8_t which = 0;
+
+#define EARLIER(cond, time, id) \
+        if ((cond) && AFTER(now, time) && ((which == 0) || !AFTER(time, t))) { t = (time); which = (id); }
+
+        EARLIER(own.active && !own.synced, own.sync, 1);
+        EARLIER(own.active, own.end, 2);
+        EARLIER(in.active && !in.synced, in.sync, 3);
+        EARLIER(in.active, in.end, 4);
+        EARLIER(busy.active, busy.end, 5);
+        EARLIER(emu_alarm.active, emu_alarm.at, 7);
+        /* ties go to the earlier line, a frame ending makes room for the next */
+        EARLIER(air_queued, air_queue[0].start, 6);
+#undef EARLIER
+
+        switch (which) {
+            case 1:
+                own.synced = 1;
+                break;
+            case 2:
+                tx_end(t);
+                break;
+            case 3:
+                rx_sync(t);
+                break;
+            case 4:
+                rx_end(t);
+                break;
+            case 5:
+                busy.active = 0;
+                break;
+            case 6:
+                put_on_air(air_queue[0].frame, air_queue[0].rssi, air_queue[0].lqi,
+                           air_queue[0].crc_ok, t);
+                air_queued--;
+                memmove(air_queue, air_queue + 1, air_queued * sizeof(air_queue[0]));
+                break;
+            case 7:
+                emu_alarm.active = 0;
+                emu_alarm.pending = 1;
+                break;
+            default:
+                update_pins(now);
+                return;
+        }
+        update_pins(t);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+//                              GDO pins
+/*---------------------------------------------------------------------------*/
+
+static uint8_t gdo_level(uint8_t cfg, uint32_t t) {
+    uint8_t level;
+
+    switch (cfg & 0x3F) {
+        case GDO_SYNC_WORD:
+            level = (own.active && own.synced) ||
+                    (in.active && in.synced && in.heard && !in.lost);
+            break;
+        case GDO_CARRIER_SENSE:
+            level = (state == EMU_RX) && carrier(t);
+            break;
+        case GDO_CCA:
+            level = (state == EMU_RX) && !carrier(t);
+            break;
+        default:
+            /* CHIP_RDYn, high impedance and clock outputs read low */
+            level = 0;
+            break;
+    }
+    return (cfg & GDO_INVERT) ? !level : level;
+}
+
+/* latches the edges the board's GPIO interrupts trigger on */
+static void update_pins(uint32_t t) {
+    uint8_t gdo0 = gdo_level(regs[CC1100_IOCFG0], t);
+    uint8_t gdo2 = gdo_level(regs[CC1100_IOCFG2], t);
+
+    if (gdo0 && !gdo0_level && gdo0_irq_enabled) {
+        gdo0_pending = 1;
+    }
+    if (!gdo2 && gdo2_level && gdo2_irq_enabled) {
+        gdo2_pending = 1;
+    }
+    gdo0_level = gdo0;
+    gdo2_level = gdo2;
+}
+
+/* the earliest event on air, 0 if there is none */
+static uint8_t next_event(uint32_t *t) {
+    uint8_t found = 0;
+
+#define CANDIDATE(cond, time) \
+    if ((cond) && (!found || AFTER(*t, time))) { *t = (time); found = 1; }
+
+    CANDIDATE(air_queued, air_queue[0].start);
+    CANDIDATE(own.active && !own.synced, own.sync);
+    CANDIDATE(own.active, own.end);
+    CANDIDATE(in.active && !in.synced, in.sync);
+    CANDIDATE(in.active, in.end);
+    CANDIDATE(busy.active, busy.end);
+    CANDIDATE(emu_alarm.active, emu_alarm.at);
+#undef CANDIDATE
+
+    return found;
+}
+
+/* nothing but the idle thread runs, so no one touches the radio */
+static uint8_t cpu_idle(void) {
+    return (active_thread->priority == PRIORITY_IDLE) && !sched_context_switch_request;
+}
+
+/* NATIVE_IRQ_GPIO handler, runs as interrupt */
+static void emu_isr(void) {
+    uint32_t t;
+
+    if (!gdo0_pending && !gdo2_pending && !emu_alarm.pending && cpu_idle() &&
+        next_event(&t) && AFTER(t, emu_time)) {
+        emu_time = t;
+    }
+    advance(emu_time);
+    if (gdo0_pending) {
+        gdo0_pending = 0;
+        if (gdo0_irq_enabled) {
+            cc110x_gdo0_irq();
+        }
+    }
+    if (gdo2_pending) {
+        gdo2_pending = 0;
+        if (gdo2_irq_enabled) {
+            cc110x_gdo2_irq();
+        }
+    }
+    if (emu_alarm.pending) {
+        emu_alarm.pending = 0;
+        emu_alarm.handler();
+    }
+    rearm();
+}
+
+/*
+ * Raises a pending interrupt, which fires as soon as interrupts are
+ * enabled, at the same point of every run. Otherwise arms the host timer
+ * to look again whether the CPU idles while something is ahead.
+ */
+static void rearm(void) {
+    struct itimerspec its;
+    uint32_t t;
+
+    if (gdo0_pending || gdo2_pending || emu_alarm.pending) {
+        raise(NATIVE_IRQ_GPIO);
+        return;
+    }
+    memset(&its, 0, sizeof(its));
+    if (next_event(&t)) {
+        its.it_value.tv_nsec = CC110X_EMU_IDLE_CHECK_US * 1000;
+    }
+    timer_settime(irq_timer, 0, &its, NULL);
+}
+
+/*---------------------------------------------------------------------------*/
+//                              SPI
+/*---------------------------------------------------------------------------*/
+
+static uint8_t chip_status(uint8_t read) {
+    uint8_t st = (state <= EMU_TXFIFO_UNDERFLOW) ? state : EMU_IDLE;
+    uint8_t bytes = read ? rx_fifo_bytes() : CC110X_EMU_FIFO_SIZE - tx_fifo_len;
+
+    return (st << 4) | ((bytes > 15) ? 15 : bytes);
+}
+
+static void reset(uint32_t now) {
+    static const uint8_t defaults[CONF_REGISTERS] = {
+        0x29, 0x2E, 0x3F, 0x07, 0xD3, 0x91, 0xFF, 0x04, 0x45, 0x00, 0x00, 0x0F,
+        0x00, 0x1E, 0xC4, 0xEC, 0x8C, 0x22, 0x02, 0x22, 0xF8, 0x47, 0x07, 0x30,
+        0x04, 0x36, 0x6C, 0x03, 0x40, 0x91, 0x87, 0x6B, 0xF8, 0x56, 0x10, 0xA9,
+        0x0A, 0x20, 0x0D, 0x41, 0x00, 0x59, 0x7F, 0x3F, 0x88, 0x31, 0x0B
+    };
+
+    memcpy(regs, defaults, sizeof(regs));
+    memset(patable, 0, sizeof(patable));
+    patable[0] = 0xC6;
+    tx_fifo_len = 0;
+    rx_fifo_start = rx_fifo_end = 0;
+    own.active = 0;
+    set_state(EMU_IDLE, now);
+    update_pins(now);
+}
+
+static void strobe(uint8_t cmd, uint32_t now) {
+    cc110x_emu_statistic.strobes++;
+
+    switch (cmd) {
+        case CC1100_SRES:
+            reset(now);
+            break;
+        case CC1100_SFSTXON:
+            set_state(EMU_FSTXON, now);
+            break;
+        case CC1100_SXOFF:
+        case CC1100_SPWD:
+            /* both take effect when CS goes high */
+            power_down = 1;
+            break;
+        case CC1100_SRX:
+            if ((state != EMU_RXFIFO_OVERFLOW) && (state != EMU_TXFIFO_UNDERFLOW)) {
+                set_state(EMU_RX, now);
+            }
+            break;
+        case CC1100_STX:
+            /* CCA_MODE other than 0 only sends on a clear channel */
+            if ((state == EMU_RX) && (regs[CC1100_MCSM1] & 0x30) && carrier(now)) {
+                break;
+            }
+            if ((state != EMU_RXFIFO_OVERFLOW) && (state != EMU_TXFIFO_UNDERFLOW) &&
+                !own.active) {
+                start_tx(now);
+            }
+            break;
+        case CC1100_SIDLE:
+            set_state(EMU_IDLE, now);
+            break;
+        case CC1100_SWOR:
+            set_state(EMU_WOR, now);
+            wor_start = now;
+            break;
+        case CC1100_SFRX:
+            if ((state == EMU_IDLE) || (state == EMU_RXFIFO_OVERFLOW)) {
+                rx_fifo_start = rx_fifo_end = 0;
+                state = EMU_IDLE;
+            }
+            break;
+        case CC1100_SFTX:
+            if ((state == EMU_IDLE) || (state == EMU_TXFIFO_UNDERFLOW)) {
+                tx_fifo_len = 0;
+                state = EMU_IDLE;
+            }
+            break;
+        case CC1100_SWORRST:
+            wor_start = now;
+            break;
+        default:
+            /* SCAL, SAFC and SNOP change nothing here */
+            break;
+    }
+}
+
+static uint8_t marc_state(uint32_t now) {
+    switch (state) {
+        case EMU_SLEEP:
+            return 0;
+        case EMU_RX:
+            return 13;
+        case EMU_TX:
+            return 19;
+        case EMU_FSTXON:
+            return 18;
+        case EMU_RXFIFO_OVERFLOW:
+            return 17;
+        case EMU_TXFIFO_UNDERFLOW:
+            return 22;
+        case EMU_WOR:
+            return wor_listening(now) ? 13 : 0;
+        default:
+            return 1;
+    }
+}
+
+static uint8_t read_status(uint8_t addr, uint32_t now) {
+    switch (addr) {
+        case CC1100_PARTNUM:
+            return 0x00;
+        case CC1100_VERSION:
+            return 0x03;
+        case CC1100_LQI:
+            return last_lqi;
+        case CC1100_RSSI:
+            return rssi_raw(rssi_dbm(now));
+        case CC1100_MARCSTATE:
+            return marc_state(now);
+        case CC1100_WORTIME1:
+        case CC1100_WORTIME0: {
+            uint32_t ticks = (uint32_t) ((uint64_t) (now - wor_start) * XOSC_HZ / 750 / 1000000);
+            return (addr == CC1100_WORTIME1) ? (ticks >> 8) : ticks;
+        }
+        case CC1100_PKTSTATUS:
+            return ((state == EMU_RX) && carrier(now) ? CS : 0) |
+                   ((state == EMU_RX) && !carrier(now) ? CCA : 0) |
+                   (in.active && in.synced && in.heard ? SFD : 0) |
+                   (gdo2_level ? GDO2 : 0) | (gdo0_level ? GDO0 : 0);
+        case CC1100_TXBYTES:
+            return ((state == EMU_TXFIFO_UNDERFLOW) ? TXFIFO_UNDERFLOW : 0) | tx_fifo_len;
+        case CC1100_RXBYTES:
+            return ((state == EMU_RXFIFO_OVERFLOW) ? 0x80 : 0) | rx_fifo_bytes();
+        default:
+            return 0;
+    }
+}
+
+static uint8_t read_byte(uint8_t addr) {
+    if (addr == CC1100_RXFIFO) {
+        if (rx_fifo_start == rx_fifo_end) {
+            return 0;
+        }
+        return rx_fifo[rx_fifo_start++];
+    }
+    if (addr == CC1100_PATABLE) {
+        uint8_t value = patable[patable_index];
+        patable_index = (patable_index + 1) % sizeof(patable);
+        return value;
+    }
+    if (addr < CONF_REGISTERS) {
+        return regs[addr];
+    }
+    return 0;
+}
+
+static void write_byte(uint8_t addr, uint8_t value) {
+    if (addr == CC1100_TXFIFO) {
+        if (tx_fifo_len < CC110X_EMU_FIFO_SIZE) {
+            tx_fifo[tx_fifo_len++] = value;
+        }
+        return;
+    }
+    if (addr == CC1100_PATABLE) {
+        patable[patable_index] = value;
+        patable_index = (patable_index + 1) % sizeof(patable);
+        return;
+    }
+    if (addr < CONF_REGISTERS) {
+        regs[addr] = value;
+    }
+}
+
+uint8_t cc110x_txrx(uint8_t c) {
+    unsigned state_irq = disableIRQ();
+    uint32_t now = spend(CC110X_EMU_SPI_BYTE_US);
+    uint8_t result;
+
+    advance(now);
+    cc110x_emu_statistic.spi_bytes++;
+
+    if (spi_header) {
+        uint8_t addr = c & 0x3F;
+
+        spi_read = (c & CC1100_READ_SINGLE) != 0;
+        spi_burst = (c & CC1100_WRITE_BURST) != 0;
+        result = chip_status(spi_read);
+
+        if ((addr >= CC1100_SRES) && (addr <= CC1100_SNOP) && !(spi_read && spi_burst)) {
+            strobe(addr, now);
+        }
+        else if ((addr >= CC1100_PARTNUM) && (addr <= CC1100_RXBYTES)) {
+            /* status registers are read with the burst bit, one at a time */
+            spi_addr = addr | 0x80;
+            spi_header = 0;
+        }
+        else {
+            spi_addr = addr;
+            spi_header = 0;
+        }
+    }
+    else {
+        if (spi_addr & 0x80) {
+            result = read_status(spi_addr & 0x3F, now);
+            spi_header = 1;
+        }
+        else if (spi_read) {
+            result = read_byte(spi_addr);
+        }
+        else {
+            result = chip_status(0);
+            write_byte(spi_addr, c);
+        }
+
+        if (!(spi_addr & 0x80)) {
+            if (!spi_burst) {
+                spi_header = 1;
+            }
+            else if ((spi_addr != CC1100_TXFIFO) && (spi_addr != CC1100_PATABLE)) {
+                spi_addr++;
+            }
+        }
+    }
+
+    update_pins(now);
+    rearm();
+    restoreIRQ(state_irq);
+    return result;
+}
+
+void cc110x_spi_init(void) {
+    unsigned state_irq = disableIRQ();
+    emu_init();
+    restoreIRQ(state_irq);
+}
+
+void cc110x_spi_cs(void) {
+    unsigned state_irq = disableIRQ();
+    uint32_t now = cc110x_emu_now();
+
+    emu_init();
+    advance(now);
+    if (state == EMU_SLEEP) {
+        /* CS low wakes the chip up */
+        set_state(EMU_IDLE, now);
+    }
+    restoreIRQ(state_irq);
+}
+
+void cc110x_spi_select(void) {
+    cc110x_spi_cs();
+    spi_header = 1;
+}
+
+void cc110x_spi_unselect(void) {
+    unsigned state_irq = disableIRQ();
+    uint32_t now = cc110x_emu_now();
+
+    emu_init();
+    advance(now);
+    spi_header = 1;
+    patable_index = 0;
+    if ((state == EMU_TX) && !own.active && tx_fifo_len) {
+        /* refilled while sending preamble */
+        start_tx(now);
+    }
+    if (power_down) {
+        power_down = 0;
+        set_state(EMU_SLEEP, now);
+    }
+    update_pins(now);
+    rearm();
+    restoreIRQ(state_irq);
+}
+
+/*---------------------------------------------------------------------------*/
+//                              Board interface
+/*---------------------------------------------------------------------------*/
+
+static int read_gdo(uint8_t reg) {
+    unsigned state_irq = disableIRQ();
+    uint32_t now = spend(CC110X_EMU_PIN_READ_US);
+
+    advance(now);
+    rearm();
+    int level = gdo_level(regs[reg], now);
+    restoreIRQ(state_irq);
+    return level;
+}
+
+int cc110x_get_gdo0(void) {
+    return read_gdo(CC1100_IOCFG0);
+}
+
+int cc110x_get_gdo1(void) {
+    /* SO goes low as soon as the crystal runs */
+    return 0;
+}
+
+int cc110x_get_gdo2(void) {
+    return read_gdo(CC1100_IOCFG2);
+}
+
+void cc110x_gdo0_enable(void) {
+    gdo0_pending = 0;
+    gdo0_irq_enabled = 1;
+}
+
+void cc110x_gdo0_disable(void) {
+    gdo0_irq_enabled = 0;
+    gdo0_pending = 0;
+}
+
+void cc110x_gdo2_enable(void) {
+    gdo2_pending = 0;
+    gdo2_irq_enabled = 1;
+}
+
+void cc110x_gdo2_disable(void) {
+    gdo2_irq_enabled = 0;
+    gdo2_pending = 0;
+}
+
+void cc110x_init_interrupts(void) {
+    unsigned state_irq = disableIRQ();
+    emu_init();
+    cc110x_gdo2_enable();
+    restoreIRQ(state_irq);
+}
+
+void cc110x_before_send(void) {
+    // Disable GDO2 interrupt before sending packet
+    cc110x_gdo2_disable();
+}
+
+void cc110x_after_send(void) {
+    // Enable GDO2 interrupt after sending packet
+    cc110x_gdo2_enable();
+}
+
+/*---------------------------------------------------------------------------*/
+//                              Air
+/*---------------------------------------------------------------------------*/
+
+void cc110x_emu_set_tx_hook(cc110x_emu_tx_hook_t hook) {
+    tx_hook = hook;
+}
+
+uint32_t cc110x_emu_receive(const uint8_t *frame, int rssi, uint8_t lqi, uint8_t crc_ok) {
+    unsigned state_irq = disableIRQ();
+    uint32_t now = cc110x_emu_now();
+    uint32_t end;
+
+    emu_init();
+    advance(now);
+    end = put_on_air(frame, rssi, lqi, crc_ok, now);
+    update_pins(now);
+    rearm();
+    restoreIRQ(state_irq);
+    return end;
+}
+
+uint32_t cc110x_emu_receive_at(uint32_t start, const uint8_t *frame, int rssi, uint8_t lqi,
+                               uint8_t crc_ok) {
+    unsigned state_irq = disableIRQ();
+    uint32_t now = cc110x_emu_now();
+    uint8_t length = (frame[0] < CC110X_EMU_FIFO_SIZE) ? frame[0] : CC110X_EMU_FIFO_SIZE - 1;
+    uint8_t i;
+
+    if (air_queued == CC110X_EMU_AIR_QUEUE_SIZE) {
+        restoreIRQ(state_irq);
+        return 0;
+    }
+
+    emu_init();
+    advance(now);
+    if (AFTER(now, start)) {
+        start = now;
+    }
+    for (i = air_queued; (i > 0) && AFTER(air_queue[i - 1].start, start + 1); i--) {
+        air_queue[i] = air_queue[i - 1];
+    }
+    air_queue[i].start = start;
+    air_queue[i].rssi = rssi;
+    air_queue[i].lqi = lqi;
+    air_queue[i].crc_ok = crc_ok;
+    memcpy(air_queue[i].frame, frame, 1 + length);
+    air_queue[i].frame[0] = length;
+    air_queued++;
+
+    /* a frame starting now goes on air right away */
+    advance(now);
+    update_pins(now);
+    rearm();
+    restoreIRQ(state_irq);
+    return start + cc110x_emu_air_time(length);
+}
+
+void cc110x_emu_set_busy(uint32_t duration, int rssi) {
+    unsigned state_irq = disableIRQ();
+    uint32_t now = cc110x_emu_now();
+
+    emu_init();
+    advance(now);
+    busy.active = 1;
+    busy.end = now + duration;
+    busy.rssi = rssi;
+    update_pins(now);
+    rearm();
+    restoreIRQ(state_irq);
+}
+
+/*---------------------------------------------------------------------------*/
+//                              Timer
+/*---------------------------------------------------------------------------*/
+
+/* the hwtimers' counter */
+static uint32_t timer_now(void) {
+    unsigned state_irq = disableIRQ();
+    uint32_t now = spend(CC110X_EMU_TIMER_READ_US);
+
+    advance(now);
+    rearm();
+    restoreIRQ(state_irq);
+    return now;
+}
+
+/* the hwtimers' compare match, the handler runs from emu_isr() */
+static void set_alarm(uint32_t at, void (*handler)(void)) {
+    unsigned state_irq = disableIRQ();
+    uint32_t now = cc110x_emu_now();
+
+    emu_init();
+    advance(now);
+    emu_alarm.active = (handler != NULL);
+    emu_alarm.pending = 0;
+    emu_alarm.at = at;
+    emu_alarm.handler = handler;
+    advance(now);
+    rearm();
+    restoreIRQ(state_irq);
+}
+
+void cc110x_emu_clock_init(void) {
+    native_hwtimer_set_clock(timer_now, set_alarm);
+}
+
+/* called with interrupts disabled */
+static void emu_init(void) {
+    struct sigevent sev;
+
+    if (ready) {
+        return;
+    }
+    ready = 1;
+
+    memset(&cc110x_emu_statistic, 0, sizeof(cc110x_emu_statistic));
+    spi_header = 1;
+    reset(0);
+
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_SIGNAL;
+    sev.sigev_signo = NATIVE_IRQ_GPIO;
+    if (timer_create(CLOCK_MONOTONIC, &sev, &irq_timer) != 0) {
+        puts("cc110x_emu: timer_create() failed");
+    }
+    native_register_irq(NATIVE_IRQ_GPIO, emu_isr);
+}
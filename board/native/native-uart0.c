@@ -0,0 +1,80 @@
+/**
+ * Native uart0: stdin/stdout of the process
+ *
+ * Input is delivered by SIGIO, which is treated as the uart0 receive
+ * interrupt. Output goes straight to stdout.
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ * @}
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <board.h>
+#include <cpu.h>
+#include <kernel.h>
+#include <board_uart0.h>
+
+#define NATIVE_UART0_CHUNK  (32)
+
+#ifdef MODULE_UART0
+static void native_uart0_stop(void) {
+    int flags = fcntl(STDIN_FILENO, F_GETFL);
+    fcntl(STDIN_FILENO, F_SETFL, flags & ~O_ASYNC);
+}
+
+/* SIGIO handler, runs as interrupt */
+static void native_uart0_isr(void) {
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    char buf[NATIVE_UART0_CHUNK];
+    int received = 0;
+
+    if (!uart0_handler_pid) {
+        /* leave the input to the kernel until somebody listens */
+        return;
+    }
+
+    /* stdin stays blocking as it usually shares its file description with
+     * stdout, so only read what poll() reports */
+    while ((poll(&pfd, 1, 0) == 1) && (pfd.revents & (POLLIN | POLLHUP))) {
+        ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+        if (n <= 0) {
+            /* end of input, no more interrupts */
+            native_uart0_stop();
+            break;
+        }
+        uart0_handle_incoming_buf(buf, n);
+        received = 1;
+    }
+
+    if (received) {
+        uart0_notify_thread();
+    }
+}
+#endif
+
+void native_uart0_init(void) {
+#ifdef MODULE_UART0
+    native_register_irq(NATIVE_IRQ_IO, native_uart0_isr);
+
+    fcntl(STDIN_FILENO, F_SETOWN, getpid());
+    int flags = fcntl(STDIN_FILENO, F_GETFL);
+    fcntl(STDIN_FILENO, F_SETFL, flags | O_ASYNC);
+#endif
+}
+
+int fw_puts(char *astring, int length) {
+    return fwrite(astring, 1, length, stdout);
+}
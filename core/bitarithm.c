@@ -14,6 +14,8 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
+#include "bitarithm.h"
 
 unsigned
 number_of_highest_bit(unsigned v)
@@ -37,17 +39,29 @@ number_of_highest_bit(unsigned v)
     return r;
 }
 /*---------------------------------------------------------------------------*/
+#if ARCH_32_BIT
+static const unsigned char debruijn_position[32] = {
+     0,  1, 28,  2, 29, 14, 24,  3, 30, 22, 20, 15, 25, 17,  4,  8,
+    31, 27, 13, 23, 21, 19, 16,  7, 26, 12, 18,  6, 11,  5, 10,  9
+};
+#endif
+
 unsigned
 number_of_lowest_bit(register unsigned v)
 {
+#if ARCH_32_BIT
+    /* isolate the lowest bit, a de Bruijn sequence maps it to a unique index */
+    return debruijn_position[((uint32_t)((v & -v) * 0x077CB531U)) >> 27];
+#else
     register unsigned r = 0;
 
-    while( (v & 0x01) == 0 ) {
-        v >>= 1;
-        r++;
-    };
+    if ((v & 0xFF) == 0) { v >>= 8; r  = 8; }
+    if ((v & 0x0F) == 0) { v >>= 4; r += 4; }
+    if ((v & 0x03) == 0) { v >>= 2; r += 2; }
+    r += (~v & 0x01);
 
     return r;
+#endif
 }
 /*---------------------------------------------------------------------------*/
 unsigned
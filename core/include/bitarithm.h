@@ -78,12 +78,37 @@ unsigned number_of_highest_bit(unsigned v);
 /**
  * @brief	Returns the number of the lowest '1' bit in a value
  * @param[in]	v	Input value
- * @return			Bit Number
+ * @return			Bit Number, undefined for v == 0
  *
- * Source: http://graphics.stanford.edu/~seander/bithacks.html#IntegerLogObvious
+ * Source: http://graphics.stanford.edu/~seander/bithacks.html#ZerosOnRightMultLookup
  */
 unsigned number_of_lowest_bit(register unsigned v);
 
+/**
+ * @brief	Returns the number of the lowest '1' bit in a value, inlined
+ *
+ * Uses the count leading zeros instruction where the core has one and
+ * falls back to number_of_lowest_bit() otherwise. The result for v == 0 is
+ * undefined.
+ *
+ * @param[in]	v	Input value
+ * @return			Bit Number
+ */
+#if defined(__ARM_FEATURE_CLZ) || defined(__ARM_ARCH_5T__) || defined(__ARM_ARCH_5TE__) || \
+    defined(__ARM_ARCH_6__) || defined(__ARM_ARCH_7A__)
+static inline unsigned bitarithm_lsb(unsigned v)
+{
+    return 31 - __builtin_clz(v & -v);
+}
+#elif defined(__i386__) || defined(__x86_64__)
+static inline unsigned bitarithm_lsb(unsigned v)
+{
+    return __builtin_ctz(v);
+}
+#else
+#define bitarithm_lsb(v)    number_of_lowest_bit(v)
+#endif
+
 /**
  * @brief	Returns the number of bits set in a value
  * @param[in]	v	Input value
@@ -1,4 +1,12 @@
 /**
+ * Mutexes use priority inheritance: while a thread waits for a mutex, the
+ * owner runs with at least the waiter's priority, also across chains of
+ * owners blocked on other mutexes. The owner drops back to its own priority
+ * (or to the highest priority still waiting on a mutex it keeps) when it
+ * unlocks.
+ *
+ * A mutex filled with zeros is a valid, unlocked mutex.
+ *
  * @defgroup mutex Mutexes / Synchronization
  * @ingroup kernel
  * @{
@@ -16,13 +24,35 @@
 #include "queue.h"
 #include "tcb.h"
 
+#if MUTEXSTATISTICS
+/**
+ * @brief Lock statistics of a mutex, times are in hwtimer ticks.
+ */
+typedef struct mutex_stat_t {
+    const char *name;           ///< set by mutex_stat_register()
+    unsigned int locks;         ///< number of times the mutex was acquired
+    unsigned int contended;     ///< acquisitions that had to wait
+    unsigned int wait_total;    ///< summed time spent waiting
+    unsigned int wait_max;      ///< longest wait
+    unsigned int hold_total;    ///< summed time the mutex was held
+    unsigned int hold_max;      ///< longest hold
+    unsigned int locked_at;     // @internal
+} mutex_stat_t;
+#endif
+
 /**
  * @brief Mutex structure. Should never be modified by the user.
  */
 typedef struct mutex_t {
     /* fields are managed by mutex functions, don't touch */
-    unsigned int val;       // @internal
-    queue_node_t queue;     // @internal
+    unsigned int val;           // @internal
+    queue_node_t queue;         // @internal
+    struct tcb_t *owner;        // @internal
+    struct mutex_t *next_held;  // @internal, list of mutexes held by owner
+    unsigned int count;         // @internal, recursion depth
+#if MUTEXSTATISTICS
+    mutex_stat_t stat;          // @internal
+#endif
 } mutex_t;
 
 /**
@@ -62,6 +92,43 @@ int mutex_lock(struct mutex_t* mutex);
  */
 void mutex_unlock(struct mutex_t* mutex, int yield);
 
+/**
+ * @brief Gets a mutex, blocking. May be called again by the owner.
+ *
+ * The mutex is released after as many calls to mutex_unlock_recursive().
+ * Don't mix with mutex_lock() on the same mutex.
+ *
+ * @param mutex Mutex-Object to lock. Has to be initialized first.
+ *
+ * @return 1 getting the mutex was successful
+ */
+int mutex_lock_recursive(struct mutex_t* mutex);
+
+/**
+ * @brief Undoes one mutex_lock_recursive(), unlocks with the last one.
+ *
+ * @param mutex Mutex-Object to unlock.
+ * @param yield see mutex_unlock()
+ */
+void mutex_unlock_recursive(struct mutex_t* mutex, int yield);
+
+#if MUTEXSTATISTICS
+/**
+ * @brief Adds a mutex to the ones printed by mutex_print_stats().
+ *
+ * @param mutex Mutex-Object, statistics are kept for every mutex
+ * @param name  name shown in the output
+ */
+void mutex_stat_register(struct mutex_t* mutex, const char *name);
+
+/**
+ * @brief Prints lock, wait and hold statistics of the registered mutexes.
+ */
+void mutex_print_stats(void);
+#else
+#define mutex_stat_register(mutex, name)
+#endif
+
 #define MUTEX_YIELD 1
 #define MUTEX_INISR 2
 
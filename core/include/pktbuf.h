@@ -0,0 +1,106 @@
+/**
+ * Reference counted packet buffers
+ *
+ * A fixed pool of frame sized buffers that can be handed from thread to
+ * thread (or from an interrupt to a thread) by pointer. Every holder of a
+ * buffer owns one reference; the buffer returns to the pool when the last
+ * reference is dropped. This allows a received frame to travel up the
+ * network stack without being copied into each layer's static buffer.
+ *
+ * @defgroup pktbuf Packet buffers
+ * @ingroup kernel
+ * @{
+ */
+
+/**
+ * @file
+ * @author      Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ */
+
+#ifndef __PKTBUF_H
+#define __PKTBUF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <cpu-conf.h>
+#include "msg.h"
+
+/** Number of buffers in the pool */
+#ifndef PKTBUF_COUNT
+#define PKTBUF_COUNT    (8)
+#endif
+
+/** Size of a buffer, enough for one radio frame */
+#ifndef PKTBUF_SIZE
+#define PKTBUF_SIZE     (64)
+#endif
+
+/**
+ * @brief Packet buffer. Only length and data may be used directly.
+ */
+typedef struct pktbuf_t {
+    uint16_t length;                ///< number of valid bytes in data
+    uint8_t refcount;               // @internal
+    uint8_t reserved;               // @internal, keeps data aligned
+    uint8_t data[PKTBUF_SIZE];      ///< buffer contents
+} pktbuf_t;
+
+/**
+ * @brief Pool usage counters
+ */
+typedef struct pktbuf_statistic_t {
+    unsigned int allocated;         ///< successful pktbuf_alloc() calls
+    unsigned int exhausted;         ///< pktbuf_alloc() calls with no buffer left
+    unsigned int in_use;            ///< buffers currently referenced
+    unsigned int max_in_use;        ///< high water mark of in_use
+} pktbuf_statistic_t;
+
+extern pktbuf_statistic_t pktbuf_statistic;
+
+/**
+ * @brief Takes a buffer from the pool. May be called from interrupts.
+ *
+ * @return buffer with one reference and length 0, NULL if the pool is empty
+ */
+pktbuf_t *pktbuf_alloc(void);
+
+/**
+ * @brief Adds a reference to a buffer.
+ */
+void pktbuf_hold(pktbuf_t *pkt);
+
+/**
+ * @brief Drops a reference, the buffer is returned to the pool with the last one.
+ */
+void pktbuf_release(pktbuf_t *pkt);
+
+/**
+ * @brief Finds the buffer containing a pointer.
+ *
+ * Lets a layer that only got a pointer into a frame take its own
+ * reference instead of copying the data.
+ *
+ * @param ptr any pointer
+ *
+ * @return the referenced buffer ptr points into, NULL if it is not a pool buffer
+ */
+pktbuf_t *pktbuf_get(const void *ptr);
+
+/**
+ * @brief Hands a buffer to another thread.
+ *
+ * The caller's reference is transferred to the receiver, which gets the
+ * buffer in m->content.ptr and has to release it. If the message cannot be
+ * delivered, the reference is dropped. May be called from interrupts.
+ *
+ * @param m pointer to message structure, type has to be set
+ * @param pkt buffer to hand over
+ * @param target_pid PID of target thread
+ * @param block see msg_send()
+ *
+ * @return see msg_send()
+ */
+int pktbuf_send(msg_t *m, pktbuf_t *pkt, unsigned int target_pid, bool block);
+
+/** @} */
+#endif /* __PKTBUF_H */
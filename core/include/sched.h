@@ -27,6 +27,12 @@ void sched_run();
 void sched_set_status(tcb_t *process, unsigned int status);
 void sched_switch(uint16_t current_prio, uint16_t other_prio, int in_isr);
 
+/**
+ * @brief Changes a thread's priority, moving it to the new runqueue.
+ *        Interrupts have to be disabled.
+ */
+void sched_set_priority(tcb_t *process, uint16_t priority);
+
 extern volatile unsigned int sched_context_switch_request;
 
 extern volatile tcb_t *sched_threads[MAXTHREADS];
@@ -45,6 +51,22 @@ extern volatile int thread_pid;
     }schedstat;
 
     extern schedstat pidlist[MAXTHREADS];
+
+    /**
+     * Context switch latency: time from the switch request (or entering
+     * the scheduler) until the next thread is selected. Bucket 0 counts
+     * zero latencies, bucket i latencies below 2^i hwtimer ticks.
+     */
+    #define SCHED_LATENCY_BUCKETS   (16)
+
+    typedef struct schedstat_latency {
+        unsigned int histogram[SCHED_LATENCY_BUCKETS];
+        unsigned int max;
+    }schedstat_latency;
+
+    extern schedstat_latency sched_latency;
+
+    void sched_print_latency(void);
 #endif
 
 /** @} */
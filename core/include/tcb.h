@@ -35,12 +35,16 @@
 #define STATUS_REPLY_BLOCKED 	(0x0100)
 #define STATUS_TIMER_WAITING	(0x0200)
 
+struct mutex_t;
+
 typedef struct tcb_t {
     char* sp;
     uint16_t status;
 
     uint16_t pid;
     uint16_t priority;
+    uint16_t base_priority;             ///< priority without inheritance
+    struct mutex_t *mutexes_held;       ///< mutexes owned by this thread
 
     clist_node_t rq_entry;
 
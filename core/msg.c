@@ -127,7 +127,11 @@ int msg_send_receive(msg_t *m, msg_t *reply, unsigned int target_pid) {
     tcb_t *me = (tcb_t*) sched_threads[thread_pid];
     sched_set_status(me,  STATUS_REPLY_BLOCKED);
     me->wait_data = (void*) reply;
-    msg_send(m, target_pid, true);
+
+    /* reply doubles as the message sent, msg_send() points wait_data at it
+     * while we wait for the target to receive */
+    *reply = *m;
+    msg_send(reply, target_pid, true);
 
     /* msg_send blocks until reply received */
     
@@ -215,9 +219,11 @@ int msg_receive(msg_t* m) {
         msg_t* sender_msg = (msg_t*)sender->wait_data;
         *m = *sender_msg;
 
-        /* remove sender from queue */
-        sender->wait_data = NULL;
-        sched_set_status(sender,  STATUS_PENDING);
+        /* remove sender from queue, unless it waits for our reply */
+        if (sender->status != STATUS_REPLY_BLOCKED) {
+            sender->wait_data = NULL;
+            sched_set_status(sender,  STATUS_PENDING);
+        }
 
         eINT();
         return 1;
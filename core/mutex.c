@@ -25,6 +25,16 @@
 //#define ENABLE_DEBUG
 #include <debug.h>
 
+#if MUTEXSTATISTICS
+extern unsigned long hwtimer_now(void);
+
+#ifndef MUTEX_STAT_MAX
+#define MUTEX_STAT_MAX  (16)
+#endif
+
+static struct mutex_t *mutex_stat_list[MUTEX_STAT_MAX];
+#endif
+
 int mutex_init(struct mutex_t* mutex) {
     mutex->val = 0;
 
@@ -32,12 +42,107 @@ int mutex_init(struct mutex_t* mutex) {
     mutex->queue.data = 0;
     mutex->queue.next = NULL;
 
+    mutex->owner = NULL;
+    mutex->next_held = NULL;
+    mutex->count = 0;
+
     return 1;
 }
 
+/* records the new owner, interrupts have to be disabled */
+static void mutex_acquired(struct mutex_t *mutex, tcb_t *owner) {
+    mutex->owner = owner;
+    mutex->next_held = owner->mutexes_held;
+    owner->mutexes_held = mutex;
+#if MUTEXSTATISTICS
+    mutex->stat.locks++;
+    mutex->stat.locked_at = hwtimer_now();
+#endif
+}
+
+/* removes mutex from its owner's list of held mutexes and drops the
+ * owner's priority to what it still inherits, interrupts have to be disabled */
+static void mutex_released(struct mutex_t *mutex) {
+    tcb_t *owner = mutex->owner;
+    struct mutex_t **m;
+    uint16_t priority;
+
+#if MUTEXSTATISTICS
+    unsigned int held = hwtimer_now() - mutex->stat.locked_at;
+    mutex->stat.hold_total += held;
+    if (held > mutex->stat.hold_max) {
+        mutex->stat.hold_max = held;
+    }
+#endif
+
+    mutex->owner = NULL;
+    if (owner == NULL) {
+        return;
+    }
+
+    for (m = &owner->mutexes_held; *m != NULL; m = &((*m)->next_held)) {
+        if (*m == mutex) {
+            *m = mutex->next_held;
+            break;
+        }
+    }
+    mutex->next_held = NULL;
+
+    priority = owner->base_priority;
+    for (mutex = owner->mutexes_held; mutex != NULL; mutex = mutex->next_held) {
+        /* waiters are sorted by priority */
+        if (mutex->queue.next && (mutex->queue.next->priority < priority)) {
+            priority = mutex->queue.next->priority;
+        }
+    }
+    sched_set_priority(owner, priority);
+}
+
+/* lets the owner of mutex (and the owners of mutexes it waits for) run
+ * with at least priority, interrupts have to be disabled */
+static void mutex_inherit(struct mutex_t *mutex, uint16_t priority) {
+    tcb_t *owner;
+    queue_node_t *n;
+    int depth;
+
+    for (depth = 0; depth < MAXTHREADS; depth++) {
+        owner = mutex->owner;
+        if ((owner == NULL) || (owner->priority <= priority)) {
+            return;
+        }
+
+        DEBUG("%s: inherits priority %u\n", owner->name, priority);
+        sched_set_priority(owner, priority);
+
+        if (owner->status != STATUS_MUTEX_BLOCKED) {
+            return;
+        }
+
+        /* owner waits for another mutex, requeue it there with the new priority */
+        mutex = (struct mutex_t*) owner->wait_data;
+        for (n = mutex->queue.next; n != NULL; n = n->next) {
+            if (n->data == (unsigned int) owner) {
+                queue_remove(&(mutex->queue), n);
+                n->priority = priority;
+                queue_priority_add(&(mutex->queue), n);
+                break;
+            }
+        }
+    }
+}
+
 int mutex_trylock(struct mutex_t* mutex) {
     DEBUG("%s: trylocking to get mutex. val: %u\n", active_thread->name, mutex->val);
-    return (atomic_set_return(&mutex->val, thread_pid ) == 0);
+    int irqstate = disableIRQ();
+    int locked = (mutex->val == 0);
+
+    if (locked) {
+        mutex->val = 1;
+        mutex_acquired(mutex, (tcb_t*) active_thread);
+    }
+
+    restoreIRQ(irqstate);
+    return locked;
 }
 
 int prio() {
@@ -47,7 +152,7 @@ int prio() {
 int mutex_lock(struct mutex_t* mutex) {
     DEBUG("%s: trying to get mutex. val: %u\n", active_thread->name, mutex->val);
 
-    if (atomic_set_return(&mutex->val,1) != 0) {
+    if (! mutex_trylock(mutex)) {
         // mutex was locked.
         mutex_wait(mutex);
     }
@@ -59,13 +164,19 @@ void mutex_wait(struct mutex_t *mutex) {
     DEBUG("%s: Mutex in use. %u\n", active_thread->name, mutex->val);
     if (mutex->val == 0) {
         // somebody released the mutex. return.
-        mutex->val = thread_pid;
+        mutex->val = 1;
+        mutex_acquired(mutex, (tcb_t*) active_thread);
         DEBUG("%s: mutex_wait early out. %u\n", active_thread->name, mutex->val);
         restoreIRQ(irqstate);
         return;
     }
 
+#if MUTEXSTATISTICS
+    unsigned int wait_start = hwtimer_now();
+#endif
+
     sched_set_status((tcb_t*)active_thread, STATUS_MUTEX_BLOCKED);
+    active_thread->wait_data = (void*) mutex;
 
     queue_node_t n;
     n.priority = (unsigned int) active_thread->priority;
@@ -76,11 +187,21 @@ void mutex_wait(struct mutex_t *mutex) {
 
     queue_priority_add(&(mutex->queue), &n);
 
+    mutex_inherit(mutex, active_thread->priority);
+
     restoreIRQ(irqstate);
 
     thread_yield();
 
     /* we were woken up by scheduler. waker removed us from queue. we have the mutex now. */
+#if MUTEXSTATISTICS
+    unsigned int waited = hwtimer_now() - wait_start;
+    mutex->stat.contended++;
+    mutex->stat.wait_total += waited;
+    if (waited > mutex->stat.wait_max) {
+        mutex->stat.wait_max = waited;
+    }
+#endif
 }
 
 void mutex_unlock(struct mutex_t* mutex, int yield) {
@@ -88,13 +209,18 @@ void mutex_unlock(struct mutex_t* mutex, int yield) {
     int irqstate = disableIRQ();
   
     if (mutex->val != 0) {
+        mutex_released(mutex);
+
         if (mutex->queue.next) {
             queue_node_t *next = queue_remove_head(&(mutex->queue));
             tcb_t* process = (tcb_t*)next->data;
             DEBUG("%s: waking up waiter %s.\n", process->name);
+            process->wait_data = NULL;
+            mutex_acquired(mutex, process);
             sched_set_status(process, STATUS_PENDING);
 
-            sched_switch(active_thread->priority, process->priority, inISR());
+            /* switch if the waiter has at least our (possibly lowered) priority */
+            sched_switch(process->priority, active_thread->priority, inISR());
         } else {
             mutex->val = 0;
         }
@@ -103,3 +229,62 @@ void mutex_unlock(struct mutex_t* mutex, int yield) {
     restoreIRQ(irqstate);
 }
 
+int mutex_lock_recursive(struct mutex_t* mutex) {
+    if (mutex->owner == active_thread) {
+        mutex->count++;
+        return 1;
+    }
+
+    mutex_lock(mutex);
+    mutex->count = 1;
+    return 1;
+}
+
+void mutex_unlock_recursive(struct mutex_t* mutex, int yield) {
+    if (mutex->count > 1) {
+        mutex->count--;
+        return;
+    }
+
+    mutex->count = 0;
+    mutex_unlock(mutex, yield);
+}
+
+#if MUTEXSTATISTICS
+void mutex_stat_register(struct mutex_t* mutex, const char *name) {
+    int i, free_slot = -1;
+
+    mutex->stat.name = name;
+    for (i = 0; i < MUTEX_STAT_MAX; i++) {
+        if (mutex_stat_list[i] == mutex) {
+            return;
+        }
+        if ((mutex_stat_list[i] == NULL) && (free_slot < 0)) {
+            free_slot = i;
+        }
+    }
+    if (free_slot >= 0) {
+        mutex_stat_list[free_slot] = mutex;
+    }
+}
+
+void mutex_print_stats(void) {
+    int i;
+    mutex_stat_t *s;
+
+    printf("%-16s %-10s %8s %9s %10s %8s %10s %8s\n", "mutex", "owner", "locks", "contended",
+           "wait avg", "max", "hold avg", "max");
+    for (i = 0; i < MUTEX_STAT_MAX; i++) {
+        if (mutex_stat_list[i] == NULL) {
+            continue;
+        }
+        s = &mutex_stat_list[i]->stat;
+        printf("%-16s %-10s %8u %9u %10u %8u %10u %8u\n",
+               (s->name != NULL) ? s->name : "?",
+               (mutex_stat_list[i]->owner != NULL) ? mutex_stat_list[i]->owner->name : "-",
+               s->locks, s->contended,
+               s->contended ? s->wait_total / s->contended : 0, s->wait_max,
+               s->locks ? s->hold_total / s->locks : 0, s->hold_max);
+    }
+}
+#endif
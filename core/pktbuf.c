@@ -0,0 +1,88 @@
+/**
+ * Reference counted packet buffers
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup pktbuf
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ * @}
+ */
+
+#include <stddef.h>
+#include "pktbuf.h"
+#include "irq.h"
+
+static pktbuf_t pktbuf_pool[PKTBUF_COUNT];
+
+pktbuf_statistic_t pktbuf_statistic;
+
+pktbuf_t *pktbuf_alloc(void) {
+    pktbuf_t *pkt = NULL;
+    int i;
+    unsigned state = disableIRQ();
+
+    for (i = 0; i < PKTBUF_COUNT; i++) {
+        if (pktbuf_pool[i].refcount == 0) {
+            pkt = &pktbuf_pool[i];
+            pkt->refcount = 1;
+            pkt->length = 0;
+            pktbuf_statistic.allocated++;
+            if (++pktbuf_statistic.in_use > pktbuf_statistic.max_in_use) {
+                pktbuf_statistic.max_in_use = pktbuf_statistic.in_use;
+            }
+            break;
+        }
+    }
+    if (pkt == NULL) {
+        pktbuf_statistic.exhausted++;
+    }
+
+    restoreIRQ(state);
+    return pkt;
+}
+
+void pktbuf_hold(pktbuf_t *pkt) {
+    unsigned state = disableIRQ();
+    pkt->refcount++;
+    restoreIRQ(state);
+}
+
+void pktbuf_release(pktbuf_t *pkt) {
+    unsigned state = disableIRQ();
+    if (pkt->refcount && (--pkt->refcount == 0)) {
+        pktbuf_statistic.in_use--;
+    }
+    restoreIRQ(state);
+}
+
+pktbuf_t *pktbuf_get(const void *ptr) {
+    const uint8_t *p = ptr;
+    const uint8_t *pool = (const uint8_t*) pktbuf_pool;
+    pktbuf_t *pkt;
+
+    if ((p < pool) || (p >= pool + sizeof(pktbuf_pool))) {
+        return NULL;
+    }
+
+    pkt = &pktbuf_pool[(p - pool) / sizeof(pktbuf_t)];
+    if (pkt->refcount == 0) {
+        return NULL;
+    }
+    return pkt;
+}
+
+int pktbuf_send(msg_t *m, pktbuf_t *pkt, unsigned int target_pid, bool block) {
+    int res;
+
+    m->content.ptr = (char*) pkt;
+    res = msg_send(m, target_pid, block);
+    if (res != 1) {
+        pktbuf_release(pkt);
+    }
+    return res;
+}
@@ -40,8 +40,12 @@ void sched_register_cb(void (*callback)(uint32_t, uint32_t));
 
 
 #if SCHEDSTATISTICS
+    extern unsigned long hwtimer_now(void);
+    static void sched_record_latency(unsigned int latency);
     static void (*sched_cb)(uint32_t timestamp, uint32_t value) = NULL;
     schedstat pidlist[MAXTHREADS];
+    schedstat_latency sched_latency;
+    static unsigned int sched_switch_requested = 0;
 #endif
 
 void sched_init() {
@@ -55,6 +59,12 @@ void sched_init() {
         pidlist[i].schedules = 0;
 #endif
     }
+#if SCHEDSTATISTICS
+    for (i = 0; i < SCHED_LATENCY_BUCKETS; i++) {
+        sched_latency.histogram[i] = 0;
+    }
+    sched_latency.max = 0;
+#endif
 
     active_thread = NULL;
     thread_pid = -1;
@@ -84,7 +94,6 @@ void sched_run() {
     }
 
 #if SCHEDSTATISTICS
-    extern unsigned long hwtimer_now(void);
     unsigned int time = hwtimer_now();
     if (my_active_thread && (pidlist[my_active_thread->pid].laststart)) {
         pidlist[my_active_thread->pid].runtime += time - pidlist[my_active_thread->pid].laststart;
@@ -99,27 +108,20 @@ void sched_run() {
         DEBUG("scheduler: new task created.\n");
     }
 
-    my_active_thread = NULL;
-    while(! my_active_thread) {
-
-        //        for (int i = 0; i < SCHED_PRIO_LEVELS; i++) { /* TODO: introduce bitfield cache */
-        //            if (runqueues[i]) {
-        int nextrq = number_of_lowest_bit(runqueue_bitcache);
-        clist_node_t next = *(runqueues[nextrq]);
-        DEBUG("scheduler: first in queue: %s\n", ((tcb_t*)next.data)->name);
-        clist_advance(&(runqueues[nextrq]));
-        my_active_thread = (tcb_t*)next.data;
-        thread_pid = (volatile int) my_active_thread->pid;
+    /* highest priority with a runnable thread, the queue head is the next
+     * thread, advancing the circular queue moves it to the tail */
+    int nextrq = bitarithm_lsb(runqueue_bitcache);
+    clist_node_t *next = runqueues[nextrq];
+    DEBUG("scheduler: first in queue: %s\n", ((tcb_t*)next->data)->name);
+    clist_advance(&(runqueues[nextrq]));
+    my_active_thread = (tcb_t*)next->data;
+    thread_pid = (volatile int) my_active_thread->pid;
 #if SCHEDSTATISTICS
-        pidlist[my_active_thread->pid].laststart = time;
-        pidlist[my_active_thread->pid].schedules ++;
+    pidlist[my_active_thread->pid].laststart = time;
+    pidlist[my_active_thread->pid].schedules ++;
 #endif
-        //                break;
-        //            }
-        //        }
-        if (active_thread->pid != last_pid) {
-            last_pid = active_thread->pid;
-        }
+    if (active_thread && (active_thread->pid != last_pid)) {
+        last_pid = active_thread->pid;
     }
 
     DEBUG("scheduler: next task: %s\n", my_active_thread->name);
@@ -135,6 +137,11 @@ void sched_run() {
 
     active_thread = (volatile tcb_t*) my_active_thread;
 
+#if SCHEDSTATISTICS
+    sched_record_latency(hwtimer_now() - (sched_switch_requested ? sched_switch_requested : time));
+    sched_switch_requested = 0;
+#endif
+
     DEBUG("scheduler: done.\n");
 }
 
@@ -142,6 +149,30 @@ void sched_run() {
 void sched_register_cb(void (*callback)(uint32_t, uint32_t)) {
     sched_cb = callback;    
 }
+
+static void sched_record_latency(unsigned int latency) {
+    unsigned int bucket = 0;
+    if (latency) {
+        bucket = number_of_highest_bit(latency) + 1;
+        if (bucket >= SCHED_LATENCY_BUCKETS) {
+            bucket = SCHED_LATENCY_BUCKETS - 1;
+        }
+    }
+    sched_latency.histogram[bucket]++;
+    if (latency > sched_latency.max) {
+        sched_latency.max = latency;
+    }
+}
+
+void sched_print_latency(void) {
+    int i;
+    printf("context switch latency (hwtimer ticks), max %u\n", sched_latency.max);
+    for (i = 0; i < SCHED_LATENCY_BUCKETS; i++) {
+        if (sched_latency.histogram[i]) {
+            printf("\t< %6u: %u\n", 1 << i, sched_latency.histogram[i]);
+        }
+    }
+}
 #endif
 
 void sched_set_status(tcb_t *process, unsigned int status) {
@@ -163,9 +194,29 @@ void sched_set_status(tcb_t *process, unsigned int status) {
     process->status = status;
 }
 
+void sched_set_priority(tcb_t *process, uint16_t priority) {
+    if (process->priority == priority) {
+        return;
+    }
+    if (process->status & STATUS_ON_RUNQUEUE) {
+        clist_remove(&runqueues[process->priority], &(process->rq_entry));
+        if (! runqueues[process->priority] ) {
+            runqueue_bitcache &= ~(1 << process->priority);
+        }
+        clist_add(&runqueues[priority], &(process->rq_entry));
+        runqueue_bitcache |= 1 << priority;
+    }
+    process->priority = priority;
+}
+
 void sched_switch(uint16_t current_prio, uint16_t other_prio, int in_isr) {
     DEBUG("%s: %i %i %i\n", active_thread->name, (int)current_prio, (int)other_prio, in_isr);
     if (current_prio <= other_prio) {
+#if SCHEDSTATISTICS
+        if (!sched_switch_requested) {
+            sched_switch_requested = hwtimer_now();
+        }
+#endif
         if (in_isr) {
             sched_context_switch_request = 1;
         } else {
@@ -148,6 +148,8 @@ int thread_create(char *stack, int stacksize, char priority, int flags, void (*f
     cb->stack_size = total_stacksize;
 
     cb->priority = priority;
+    cb->base_priority = priority;
+    cb->mutexes_held = NULL;
     cb->status = 0;
 
     cb->rq_entry.data = (unsigned int) cb;
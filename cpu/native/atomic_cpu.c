@@ -0,0 +1,25 @@
+/**
+ * Native atomic operations
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ * @}
+ */
+
+#include <atomic.h>
+#include <irq.h>
+
+unsigned int atomic_set_return(unsigned int* val, unsigned int set) {
+    unsigned state = disableIRQ();
+    unsigned int old_val = *val;
+    *val = set;
+    restoreIRQ(state);
+    return old_val;
+}
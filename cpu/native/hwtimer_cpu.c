@@ -0,0 +1,171 @@
+/**
+ * Native kernel timer CPU dependent functions implementation
+ *
+ * All ARCH_MAXTIMERS compare channels are multiplexed onto one
+ * ITIMER_REAL, which always expires with the earliest armed channel.
+ * The free running counter is CLOCK_MONOTONIC in microseconds, unless a
+ * board hands in a clock of its own with native_hwtimer_set_clock().
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ * @}
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "cpu.h"
+#include "hwtimer_cpu.h"
+#include "hwtimer_arch.h"
+#include "irq.h"
+
+typedef struct native_timer_t {
+    int armed;
+    uint32_t target;
+} native_timer_t;
+
+/// High level interrupt handler
+static void (*int_handler)(int);
+
+static native_timer_t native_timers[ARCH_MAXTIMERS];
+static struct timespec native_time_base;
+
+static volatile int native_timer_irq_enabled = 1;
+static volatile int native_timer_irq_pending = 0;
+
+/* set by native_hwtimer_set_clock(), the host's clock otherwise */
+static uint32_t (*clock_now)(void);
+static void (*clock_set_alarm)(uint32_t at, void (*handler)(void));
+
+static void timer_irq(void);
+
+/* targets up to a second behind the counter are overdue, everything else
+ * lies ahead, up to a full counter wrap like a compare register */
+#define NATIVE_TIMER_OVERDUE(target, now)   ((uint32_t) ((now) - (target)) <= HWTIMER_SEC)
+
+static void native_timer_rearm(void) {
+    struct itimerval itv;
+    uint32_t now = hwtimer_arch_now();
+    uint32_t next = 0;
+    int armed = 0;
+
+    for (int i = 0; i < ARCH_MAXTIMERS; i++) {
+        if (native_timers[i].armed) {
+            uint32_t remaining = NATIVE_TIMER_OVERDUE(native_timers[i].target, now) ?
+                                 1 : native_timers[i].target - now;
+            if (!armed || (remaining < next)) {
+                next = remaining;
+            }
+            armed = 1;
+        }
+    }
+
+    if (clock_set_alarm != NULL) {
+        /* the clock looks half its range ahead, a timer further out gets an
+         * early interrupt, which finds nothing due and rearms */
+        if (next > INT32_MAX) {
+            next = INT32_MAX;
+        }
+        clock_set_alarm(now + next, armed ? timer_irq : NULL);
+        return;
+    }
+
+    memset(&itv, 0, sizeof(itv));
+    if (armed) {
+        itv.it_value.tv_sec = next / HWTIMER_SEC;
+        itv.it_value.tv_usec = next % HWTIMER_SEC;
+    }
+    setitimer(ITIMER_REAL, &itv, NULL);
+}
+
+static void timer_irq(void) {
+    if (!native_timer_irq_enabled) {
+        native_timer_irq_pending = 1;
+        return;
+    }
+
+    uint32_t now = hwtimer_arch_now();
+    for (int i = 0; i < ARCH_MAXTIMERS; i++) {
+        if (native_timers[i].armed && NATIVE_TIMER_OVERDUE(native_timers[i].target, now)) {
+            native_timers[i].armed = 0;
+            int_handler(i);
+        }
+    }
+
+    native_timer_rearm();
+}
+
+void hwtimer_arch_init(void (*handler)(int), uint32_t fcpu) {
+    (void) fcpu;
+
+    int_handler = handler;
+    clock_gettime(CLOCK_MONOTONIC, &native_time_base);
+    memset(native_timers, 0, sizeof(native_timers));
+
+    native_register_irq(NATIVE_IRQ_TIMER, timer_irq);
+}
+/*---------------------------------------------------------------------------*/
+void hwtimer_arch_enable_interrupt(void) {
+    native_timer_irq_enabled = 1;
+    if (native_timer_irq_pending) {
+        native_timer_irq_pending = 0;
+        unsigned state = disableIRQ();
+        native_timer_rearm();
+        restoreIRQ(state);
+    }
+}
+/*---------------------------------------------------------------------------*/
+void hwtimer_arch_disable_interrupt(void) {
+    native_timer_irq_enabled = 0;
+}
+/*---------------------------------------------------------------------------*/
+void hwtimer_arch_set(unsigned long offset, short timer) {
+    unsigned state = disableIRQ();
+    hwtimer_arch_set_absolute(hwtimer_arch_now() + offset, timer);
+    restoreIRQ(state);
+}
+
+void hwtimer_arch_set_absolute(unsigned long value, short timer) {
+    unsigned state = disableIRQ();
+    native_timers[timer].target = (uint32_t) value;
+    native_timers[timer].armed = 1;
+    native_timer_rearm();
+    restoreIRQ(state);
+}
+/*---------------------------------------------------------------------------*/
+void hwtimer_arch_unset(short timer) {
+    unsigned state = disableIRQ();
+    native_timers[timer].armed = 0;
+    native_timer_rearm();
+    restoreIRQ(state);
+}
+/*---------------------------------------------------------------------------*/
+unsigned long hwtimer_arch_now(void) {
+    struct timespec now;
+
+    if (clock_now != NULL) {
+        return clock_now();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    uint64_t us = (uint64_t)(now.tv_sec - native_time_base.tv_sec) * HWTIMER_SEC;
+    us += (now.tv_nsec - native_time_base.tv_nsec) / 1000;
+
+    /* wraps like a 32 bit hardware counter */
+    return (uint32_t) us;
+}
+/*---------------------------------------------------------------------------*/
+void native_hwtimer_set_clock(uint32_t (*now)(void),
+                              void (*set_alarm)(uint32_t at, void (*handler)(void))) {
+    clock_now = now;
+    clock_set_alarm = set_alarm;
+}
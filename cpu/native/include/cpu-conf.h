@@ -0,0 +1,48 @@
+/**
+ * Native CPU configuration
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ */
+
+#ifndef CPUCONF_H_
+#define CPUCONF_H_
+
+#define FEUERWARE_CONF_CPU_NAME			"native"
+
+/**
+ * @name Kernel configuration
+ *
+ * The stacks handed to thread_create() are only used for the tcb and the
+ * stack test pattern. Every thread executes on a private host stack of
+ * NATIVE_THREAD_STACKSIZE bytes, as glibc's stdio needs far more stack than
+ * the embedded targets provide.
+ * @{
+ */
+#ifndef KERNEL_CONF_STACKSIZE_DEFAULT
+#define KERNEL_CONF_STACKSIZE_DEFAULT	4096
+#endif
+
+#define KERNEL_CONF_STACKSIZE_IDLE		512
+
+#ifndef NATIVE_THREAD_STACKSIZE
+#define NATIVE_THREAD_STACKSIZE			(64 * 1024)
+#endif
+/** @} */
+
+#define TRANSCEIVER_DEFAULT TRANSCEIVER_NATIVE
+#define TRANSCEIVER_BUFFER_SIZE (10)
+#define RX_BUF_SIZE  (10)
+
+/* nativenet receives the whole frame including its header into a pktbuf */
+#define PKTBUF_SIZE  (128)
+
+/** @} */
+#endif /* CPUCONF_H_ */
@@ -0,0 +1,85 @@
+/**
+ * Native CPU declarations
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ */
+
+#ifndef _CPU_H
+#define _CPU_H
+
+/**
+ * @defgroup    native      Native (POSIX host process)
+ * @ingroup     cpu
+ *
+ * Runs the kernel as a single Linux process. Threads are ucontexts,
+ * interrupts are signals and disableIRQ() masks those signals.
+ * @{
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <signal.h>
+
+#include <cpu-conf.h>
+
+#define WORDSIZE 32
+
+/* the kernel timer counts microseconds, the "core clock" is irrelevant */
+#define F_CPU 1000000
+
+/**
+ * @brief   Signals that are treated as interrupt sources
+ *
+ * SIGALRM drives the kernel timers, SIGIO the character devices (uart0),
+ * SIGUSR1 is free for peripherals such as a virtual radio. SIGUSR2 stands
+ * for the GPIO interrupts of emulated board peripherals.
+ */
+#define NATIVE_IRQ_TIMER    SIGALRM
+#define NATIVE_IRQ_IO       SIGIO
+#define NATIVE_IRQ_USR      SIGUSR1
+#define NATIVE_IRQ_GPIO     SIGUSR2
+
+void dINT(void);
+void eINT(void);
+
+void thread_yield(void);
+int inISR(void);
+
+/**
+ * @brief   Install handler as interrupt service routine for signal sig.
+ *
+ * The handler runs with all interrupts masked and inISR() returning true,
+ * a context switch requested by it is performed on return.
+ *
+ * @return  0 on success, -1 if sig is not an interrupt source
+ */
+int native_register_irq(int sig, void (*handler)(void));
+
+/**
+ * @brief   Remove the interrupt service routine for signal sig.
+ */
+int native_unregister_irq(int sig);
+
+/**
+ * @brief   Mark the beginning/end of a non-reentrant host library call
+ *
+ * Context switches requested by interrupts while a thread is inside the
+ * host C library (malloc, stdio) are deferred until the call returns.
+ */
+void _native_syscall_enter(void);
+void _native_syscall_leave(void);
+
+extern volatile int _native_in_isr;
+extern volatile int _native_in_syscall;
+
+/** @} */
+/** @} */
+#endif /* _CPU_H */
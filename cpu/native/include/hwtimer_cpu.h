@@ -0,0 +1,44 @@
+/**
+ * Native kernel timer configuration
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ */
+
+#ifndef HWTIMER_CPU_H_
+#define HWTIMER_CPU_H_
+
+#include <stdint.h>
+
+#define ARCH_MAXTIMERS 4
+#define HWTIMER_SPEED 1000000
+#define HWTIMER_MAXTICKS (0xFFFFFFFF)
+
+#define HWTIMER_MSEC  (HWTIMER_SPEED/1000)
+#define HWTIMER_SEC   (HWTIMER_SPEED)
+
+/**
+ * @brief   Run the hwtimers on a clock other than the host's
+ *
+ * For peripheral models with a virtual clock, so the drivers' waits keep
+ * to the same time as the model. Call it from board_init(), before any
+ * timer is set.
+ *
+ * @param now       reads the clock in us; repeated reads must advance it,
+ *                  or a busy wait on the timer never ends
+ * @param set_alarm calls handler as interrupt once the clock reaches at,
+ *                  which lies at most INT32_MAX us ahead, replacing the
+ *                  alarm set before; a handler of NULL removes it
+ */
+void native_hwtimer_set_clock(uint32_t (*now)(void),
+                              void (*set_alarm)(uint32_t at, void (*handler)(void)));
+
+/** @} */
+#endif /* HWTIMER_CPU_H_ */
@@ -0,0 +1,32 @@
+/**
+ * Native CPU internal functions
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @internal
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ */
+
+#ifndef NATIVE_INTERNAL_H_
+#define NATIVE_INTERNAL_H_
+
+#include <signal.h>
+
+/**
+ * @brief   Set up the signal set used by disableIRQ()/enableIRQ().
+ */
+void native_irq_init(void);
+
+/**
+ * @brief   Remove all interrupt signals from set.
+ */
+void native_irq_unmask(sigset_t *set);
+
+/** @} */
+#endif /* NATIVE_INTERNAL_H_ */
@@ -0,0 +1,67 @@
+/**
+ * Virtual radio for native nodes
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @brief   Transceiver driver exchanging frames through tools/nativenet_hub
+ *
+ * Frames are sent as datagrams over a Unix domain socket to the hub, which
+ * forwards them to all nodes linked to the sender according to its
+ * topology, applying loss and latency. Reception is signalled by
+ * NATIVE_IRQ_USR, the driver's "radio interrupt", which receives each frame
+ * straight into a pktbuf and hands it to the transceiver thread with an
+ * RCV_PKT_NATIVE message. The pktbuf holds the complete nativenet_frame_t.
+ *
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ */
+
+#ifndef NATIVENET_H_
+#define NATIVENET_H_
+
+#include <stdint.h>
+#include <radio/types.h>
+
+#include "nativenet_proto.h"
+
+#define NATIVENET_MIN_CHANNR    (0)
+#define NATIVENET_MAX_CHANNR    (24)
+
+typedef struct {
+    uint32_t packets_in;            ///< frames received from the hub
+    uint32_t packets_in_dropped;    ///< frames not addressed to us
+    uint32_t packets_in_nobuf;      ///< frames lost for lack of a pktbuf
+    uint32_t packets_out;           ///< frames handed to the hub
+    uint32_t packets_out_failed;    ///< frames the hub did not accept
+} nativenet_statistic_t;
+
+extern nativenet_statistic_t nativenet_statistic;
+
+/**
+ * @brief   Connect to the hub and start receiving
+ *
+ * @param tpid  pid of the transceiver thread, gets received frames with
+ *              RCV_PKT_NATIVE and owns the pktbuf in content.ptr
+ */
+void nativenet_init(int tpid);
+
+/**
+ * @return 1 if the frame was handed to the hub, 0 otherwise
+ */
+uint8_t nativenet_send(radio_packet_t *packet);
+
+int16_t nativenet_set_channel(uint8_t channel);
+int16_t nativenet_get_channel(void);
+radio_address_t nativenet_set_address(radio_address_t address);
+radio_address_t nativenet_get_address(void);
+void nativenet_set_monitor(uint8_t mode);
+void nativenet_switch_to_rx(void);
+void nativenet_powerdown(void);
+
+/** @} */
+#endif /* NATIVENET_H_ */
@@ -0,0 +1,58 @@
+/**
+ * Wire format between native nodes and the nativenet hub
+ *
+ * Shared by cpu/native/nativenet.c and tools/nativenet_hub.
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ */
+
+#ifndef NATIVENET_PROTO_H_
+#define NATIVENET_PROTO_H_
+
+#include <stdint.h>
+
+/**
+ * Default hub socket, overridden by the NATIVENET_HUB environment variable
+ * (nodes) or the -s option (hub).
+ */
+#define NATIVENET_HUB_PATH          "/tmp/nativenet.sock"
+
+/** Maximum payload of a frame, same as CC1100_MAX_DATA_LENGTH by default */
+#ifndef NATIVENET_MAX_DATA_LENGTH
+#define NATIVENET_MAX_DATA_LENGTH   (58)
+#endif
+
+#define NATIVENET_BROADCAST_ADDRESS (0x00)
+
+/**
+ * @brief   Frame types
+ */
+enum nativenet_frame_type {
+    NATIVENET_HELLO = 1,    ///< node -> hub: address/channel changed
+    NATIVENET_DATA  = 2,    ///< radio frame, node -> hub -> nodes
+    NATIVENET_BYE   = 3     ///< node -> hub: radio powered down
+};
+
+typedef struct __attribute__ ((packed)) {
+    uint8_t type;           ///< one of nativenet_frame_type
+    uint8_t channel;        ///< radio channel of the sender
+    uint16_t src;           ///< radio source address
+    uint16_t dst;           ///< radio destination address
+    uint8_t rssi;           ///< filled in by the hub
+    uint8_t lqi;            ///< filled in by the hub
+    uint8_t length;         ///< length of data
+    uint8_t data[NATIVENET_MAX_DATA_LENGTH];
+} nativenet_frame_t;
+
+#define NATIVENET_FRAME_HEADER_LENGTH   (sizeof(nativenet_frame_t) - NATIVENET_MAX_DATA_LENGTH)
+
+/** @} */
+#endif /* NATIVENET_PROTO_H_ */
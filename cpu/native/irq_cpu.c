@@ -0,0 +1,167 @@
+/**
+ * Native interrupt emulation on top of POSIX signals
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ * @}
+ */
+
+#include <signal.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "cpu.h"
+#include "irq.h"
+#include "sched.h"
+#include "native_internal.h"
+
+#define NATIVE_MAX_SIGNALS  (64)
+
+volatile int _native_in_isr = 0;
+volatile int _native_in_syscall = 0;
+
+static void (*native_irq_handlers[NATIVE_MAX_SIGNALS])(void);
+
+/* the set of signals blocked while "interrupts are disabled" */
+static sigset_t native_irq_set;
+
+static int native_is_irq(int sig) {
+    return (sig == NATIVE_IRQ_TIMER) || (sig == NATIVE_IRQ_IO) || (sig == NATIVE_IRQ_USR) ||
+           (sig == NATIVE_IRQ_GPIO);
+}
+
+static void native_context_switch_isr(void) {
+    ucontext_t *old = (ucontext_t *) active_thread->sp;
+
+    sched_run();
+
+    ucontext_t *new = (ucontext_t *) active_thread->sp;
+    if (new != old) {
+        /* we are resumed here later and return through the signal frame */
+        swapcontext(old, new);
+    }
+}
+
+static void native_isr_entry(int sig, siginfo_t *info, void *context) {
+    (void) info;
+    (void) context;
+
+    _native_in_isr = 1;
+    if (native_irq_handlers[sig] != NULL) {
+        native_irq_handlers[sig]();
+    }
+    _native_in_isr = 0;
+
+    /* a thread interrupted inside the host libc must not be switched
+     * away from, the switch is done in _native_syscall_leave() */
+    if (sched_context_switch_request && !_native_in_syscall && active_thread != NULL) {
+        native_context_switch_isr();
+    }
+}
+
+int native_register_irq(int sig, void (*handler)(void)) {
+    struct sigaction sa;
+
+    if (!native_is_irq(sig)) {
+        return -1;
+    }
+
+    unsigned state = disableIRQ();
+    native_irq_handlers[sig] = handler;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = native_isr_entry;
+    sa.sa_mask = native_irq_set;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigaction(sig, &sa, NULL);
+    restoreIRQ(state);
+
+    return 0;
+}
+
+int native_unregister_irq(int sig) {
+    if (!native_is_irq(sig)) {
+        return -1;
+    }
+
+    unsigned state = disableIRQ();
+    signal(sig, SIG_IGN);
+    native_irq_handlers[sig] = NULL;
+    restoreIRQ(state);
+
+    return 0;
+}
+
+void native_irq_init(void) {
+    sigemptyset(&native_irq_set);
+    sigaddset(&native_irq_set, NATIVE_IRQ_TIMER);
+    sigaddset(&native_irq_set, NATIVE_IRQ_IO);
+    sigaddset(&native_irq_set, NATIVE_IRQ_USR);
+    sigaddset(&native_irq_set, NATIVE_IRQ_GPIO);
+}
+
+void native_irq_unmask(sigset_t *set) {
+    sigdelset(set, NATIVE_IRQ_TIMER);
+    sigdelset(set, NATIVE_IRQ_IO);
+    sigdelset(set, NATIVE_IRQ_USR);
+    sigdelset(set, NATIVE_IRQ_GPIO);
+}
+
+/*---------------------------------------------------------------------------*/
+unsigned disableIRQ(void) {
+    sigset_t old;
+    sigprocmask(SIG_BLOCK, &native_irq_set, &old);
+    return !sigismember(&old, NATIVE_IRQ_TIMER);
+}
+
+unsigned enableIRQ(void) {
+    sigset_t old;
+    sigprocmask(SIG_UNBLOCK, &native_irq_set, &old);
+    return !sigismember(&old, NATIVE_IRQ_TIMER);
+}
+
+void restoreIRQ(unsigned state) {
+    if (state) {
+        enableIRQ();
+    }
+    else {
+        disableIRQ();
+    }
+}
+
+void dINT(void) {
+    disableIRQ();
+}
+
+void eINT(void) {
+    enableIRQ();
+}
+
+int inISR(void) {
+    return _native_in_isr;
+}
+
+/*---------------------------------------------------------------------------*/
+void _native_syscall_enter(void) {
+    _native_in_syscall++;
+}
+
+void _native_syscall_leave(void) {
+    _native_in_syscall--;
+
+    if ((_native_in_syscall == 0) && sched_context_switch_request && !_native_in_isr) {
+        unsigned state = disableIRQ();
+        if (state && sched_context_switch_request) {
+            /* the interrupt that requested the switch has already returned */
+            thread_yield();
+        }
+        restoreIRQ(state);
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ * Native power management: the idle thread sleeps until the next signal
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ * @}
+ */
+
+#include <unistd.h>
+
+#include "lpm.h"
+
+static enum lpm_mode native_lpm;
+
+void lpm_init(void) {
+    native_lpm = LPM_ON;
+}
+
+enum lpm_mode lpm_set(enum lpm_mode target) {
+    enum lpm_mode last_lpm = native_lpm;
+
+    native_lpm = target;
+
+    switch (target) {
+        case LPM_ON:
+            break;
+        case LPM_IDLE:
+        case LPM_SLEEP:
+        case LPM_POWERDOWN:
+            /* any interrupt wakes us up, just like on hardware */
+            pause();
+            native_lpm = LPM_ON;
+            break;
+        case LPM_OFF:
+        default:
+            _exit(0);
+    }
+
+    return last_lpm;
+}
+
+void lpm_awake(void) {
+    native_lpm = LPM_ON;
+}
+
+void lpm_begin_awake(void) {
+    native_lpm = LPM_ON;
+}
+
+void lpm_end_awake(void) {
+    native_lpm = LPM_ON;
+}
+
+enum lpm_mode lpm_get(void) {
+    return native_lpm;
+}
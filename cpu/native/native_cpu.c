@@ -0,0 +1,148 @@
+/**
+ * Native CPU: context switching on top of ucontext
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ * @}
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+
+#include "cpu.h"
+#include "irq.h"
+#include "kernel.h"
+#include "kernel_intern.h"
+#include "sched.h"
+#include "native_internal.h"
+
+#define NATIVE_MAX_STACKS       (2 * MAXTHREADS)
+#define NATIVE_EXIT_STACKSIZE   (8 * 1024)
+
+/**
+ * Host stacks are assigned by the stack_start passed to thread_stack_init().
+ * A thread created on the stack of a finished thread reuses its host stack.
+ */
+typedef struct native_stack_t {
+    void *stack_start;
+    char *host_stack;
+} native_stack_t;
+
+static native_stack_t native_stacks[NATIVE_MAX_STACKS];
+
+/* sched_task_exit() runs here when a thread function returns */
+static ucontext_t native_exit_context;
+static char native_exit_stack[NATIVE_EXIT_STACKSIZE];
+
+extern void board_init(void);
+extern void cpu_switch_context_exit(void);
+
+static char *native_host_stack(void *stack_start) {
+    native_stack_t *free_slot = NULL;
+
+    for (int i = 0; i < NATIVE_MAX_STACKS; i++) {
+        if (native_stacks[i].stack_start == stack_start) {
+            return native_stacks[i].host_stack;
+        }
+        if ((free_slot == NULL) && (native_stacks[i].stack_start == NULL)) {
+            free_slot = &native_stacks[i];
+        }
+    }
+
+    if (free_slot == NULL) {
+        puts("native: too many thread stacks.");
+        exit(EXIT_FAILURE);
+    }
+
+    free_slot->host_stack = malloc(NATIVE_THREAD_STACKSIZE);
+    if (free_slot->host_stack == NULL) {
+        puts("native: out of memory for thread stack.");
+        exit(EXIT_FAILURE);
+    }
+    free_slot->stack_start = stack_start;
+
+    return free_slot->host_stack;
+}
+
+//----------------------------------------------------------------------------
+// Processor specific routine - here for native
+// sp of a thread is a pointer to its ucontext_t
+//----------------------------------------------------------------------------
+char *thread_stack_init(void *task_func, void *stack_start)
+{
+    char *host_stack = native_host_stack(stack_start);
+    ucontext_t *ctx = (ucontext_t *) host_stack;
+    /* keep the ucontext out of the way of the stack */
+    size_t offset = (sizeof(ucontext_t) + 15) & ~15;
+
+    getcontext(ctx);
+    ctx->uc_stack.ss_sp = host_stack + offset;
+    ctx->uc_stack.ss_size = NATIVE_THREAD_STACKSIZE - offset;
+    ctx->uc_stack.ss_flags = 0;
+    ctx->uc_link = &native_exit_context;
+
+    /* threads start with interrupts enabled */
+    native_irq_unmask(&ctx->uc_sigmask);
+
+    makecontext(ctx, (void (*)(void)) task_func, 0);
+
+    return (char *) ctx;
+}
+
+void thread_print_stack(void) {
+    ucontext_t *ctx = (ucontext_t *) active_thread->sp;
+    printf("task: %s host stack: %p size: %u\n", active_thread->name,
+           ctx->uc_stack.ss_sp, (unsigned int) ctx->uc_stack.ss_size);
+}
+
+void thread_yield(void) {
+    ucontext_t *old = (ucontext_t *) active_thread->sp;
+    unsigned state = disableIRQ();
+
+    sched_run();
+
+    ucontext_t *new = (ucontext_t *) active_thread->sp;
+    if (new != old) {
+        swapcontext(old, new);
+    }
+
+    restoreIRQ(state);
+}
+
+void cpu_switch_context_exit(void) {
+    sched_run();
+    setcontext((ucontext_t *) active_thread->sp);
+    puts("native: setcontext() failed.");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief   Process entry point
+ *
+ * The project's main() becomes the main thread, so the kernel is
+ * started from a constructor and never returns to the C runtime.
+ */
+__attribute__((constructor)) static void native_startup(void) {
+    native_irq_init();
+    dINT();
+
+    getcontext(&native_exit_context);
+    native_exit_context.uc_stack.ss_sp = native_exit_stack;
+    native_exit_context.uc_stack.ss_size = sizeof(native_exit_stack);
+    native_exit_context.uc_stack.ss_flags = 0;
+    native_exit_context.uc_link = NULL;
+    makecontext(&native_exit_context, sched_task_exit, 0);
+
+    board_init();
+    puts("native: hardware initialization complete.");
+
+    kernel_init();
+}
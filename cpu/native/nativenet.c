@@ -0,0 +1,246 @@
+/**
+ * Virtual radio for native nodes
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ * @}
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "cpu-conf.h"
+#include "irq.h"
+#include "msg.h"
+#include "pktbuf.h"
+#include "transceiver.h"
+#include "nativenet.h"
+
+//#define ENABLE_DEBUG
+#include <debug.h>
+
+nativenet_statistic_t nativenet_statistic;
+
+static int nativenet_sock = -1;
+static int nativenet_transceiver_pid;
+static struct sockaddr_un nativenet_hub;
+static struct sockaddr_un nativenet_local;
+
+static radio_address_t nativenet_address;
+static uint8_t nativenet_channel;
+static uint8_t nativenet_monitor;
+static uint8_t nativenet_on;
+
+static int nativenet_to_hub(nativenet_frame_t *frame) {
+    size_t len = NATIVENET_FRAME_HEADER_LENGTH + frame->length;
+
+    if (sendto(nativenet_sock, frame, len, 0, (struct sockaddr *) &nativenet_hub,
+               sizeof(nativenet_hub)) != (ssize_t) len) {
+        DEBUG("nativenet: sendto hub failed: %s\n", strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+static void nativenet_hello(uint8_t type) {
+    nativenet_frame_t frame;
+
+    memset(&frame, 0, NATIVENET_FRAME_HEADER_LENGTH);
+    frame.type = type;
+    frame.channel = nativenet_channel;
+    frame.src = nativenet_address;
+    frame.length = 0;
+
+    nativenet_to_hub(&frame);
+}
+
+/* checks if a received frame is meant for us */
+static int nativenet_accept(nativenet_frame_t *frame, ssize_t n) {
+    if ((n < (ssize_t) NATIVENET_FRAME_HEADER_LENGTH) || (frame->type != NATIVENET_DATA)) {
+        return 0;
+    }
+    nativenet_statistic.packets_in++;
+
+    if (!nativenet_on || (frame->channel != nativenet_channel) ||
+        (!nativenet_monitor && (frame->dst != nativenet_address) &&
+         (frame->dst != NATIVENET_BROADCAST_ADDRESS))) {
+        nativenet_statistic.packets_in_dropped++;
+        return 0;
+    }
+
+    if (frame->length > n - NATIVENET_FRAME_HEADER_LENGTH) {
+        frame->length = n - NATIVENET_FRAME_HEADER_LENGTH;
+    }
+    return 1;
+}
+
+/* NATIVE_IRQ_USR handler, runs as interrupt */
+static void nativenet_rx_handler(void) {
+    nativenet_frame_t discard;
+    nativenet_frame_t *frame;
+    pktbuf_t *pkt;
+    ssize_t n;
+    msg_t m;
+
+    while (1) {
+        /* receive straight into a pktbuf, the transceiver thread takes it over */
+        pkt = pktbuf_alloc();
+        frame = (pkt != NULL) ? (nativenet_frame_t*) pkt->data : &discard;
+
+        n = recv(nativenet_sock, frame, sizeof(nativenet_frame_t), 0);
+        if (n <= 0) {
+            break;
+        }
+
+        if (!nativenet_accept(frame, n)) {
+            if (pkt != NULL) {
+                pktbuf_release(pkt);
+            }
+        }
+        else if ((pkt == NULL) || !nativenet_transceiver_pid) {
+            nativenet_statistic.packets_in_nobuf++;
+            if (pkt != NULL) {
+                pktbuf_release(pkt);
+            }
+        }
+        else {
+            pkt->length = n;
+            m.type = (uint16_t) RCV_PKT_NATIVE;
+            if (pktbuf_send(&m, pkt, nativenet_transceiver_pid, false) != 1) {
+                nativenet_statistic.packets_in_nobuf++;
+            }
+        }
+    }
+
+    if (pkt != NULL) {
+        pktbuf_release(pkt);
+    }
+}
+
+static void nativenet_cleanup(void) {
+    unlink(nativenet_local.sun_path);
+}
+
+void nativenet_init(int tpid) {
+    const char *hub = getenv("NATIVENET_HUB");
+
+    nativenet_transceiver_pid = tpid;
+    memset(&nativenet_statistic, 0, sizeof(nativenet_statistic));
+
+    memset(&nativenet_hub, 0, sizeof(nativenet_hub));
+    nativenet_hub.sun_family = AF_UNIX;
+    strncpy(nativenet_hub.sun_path, (hub != NULL) ? hub : NATIVENET_HUB_PATH,
+            sizeof(nativenet_hub.sun_path) - 1);
+
+    memset(&nativenet_local, 0, sizeof(nativenet_local));
+    nativenet_local.sun_family = AF_UNIX;
+    snprintf(nativenet_local.sun_path, sizeof(nativenet_local.sun_path),
+             "/tmp/nativenet-%d.sock", (int) getpid());
+
+    nativenet_sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (nativenet_sock < 0) {
+        puts("nativenet: socket() failed");
+        return;
+    }
+
+    unlink(nativenet_local.sun_path);
+    if (bind(nativenet_sock, (struct sockaddr *) &nativenet_local, sizeof(nativenet_local)) < 0) {
+        printf("nativenet: cannot bind %s\n", nativenet_local.sun_path);
+        close(nativenet_sock);
+        nativenet_sock = -1;
+        return;
+    }
+    atexit(nativenet_cleanup);
+
+    native_register_irq(NATIVE_IRQ_USR, nativenet_rx_handler);
+
+    /* deliver NATIVE_IRQ_USR instead of SIGIO, which belongs to uart0 */
+    fcntl(nativenet_sock, F_SETOWN, getpid());
+    fcntl(nativenet_sock, F_SETSIG, NATIVE_IRQ_USR);
+    fcntl(nativenet_sock, F_SETFL, fcntl(nativenet_sock, F_GETFL) | O_ASYNC | O_NONBLOCK);
+
+    nativenet_on = 1;
+    nativenet_hello(NATIVENET_HELLO);
+
+    printf("nativenet: %s -> hub %s\n", nativenet_local.sun_path, nativenet_hub.sun_path);
+}
+
+uint8_t nativenet_send(radio_packet_t *packet) {
+    nativenet_frame_t frame;
+
+    if ((nativenet_sock < 0) || (packet->length > NATIVENET_MAX_DATA_LENGTH)) {
+        nativenet_statistic.packets_out_failed++;
+        return 0;
+    }
+
+    frame.type = NATIVENET_DATA;
+    frame.channel = nativenet_channel;
+    frame.src = nativenet_address;
+    frame.dst = packet->dst;
+    frame.rssi = 0;
+    frame.lqi = 0;
+    frame.length = packet->length;
+    memcpy(frame.data, packet->data, packet->length);
+
+    if (!nativenet_to_hub(&frame)) {
+        nativenet_statistic.packets_out_failed++;
+        return 0;
+    }
+
+    nativenet_statistic.packets_out++;
+    return 1;
+}
+
+int16_t nativenet_set_channel(uint8_t channel) {
+    if (channel > NATIVENET_MAX_CHANNR) {
+        return -1;
+    }
+    nativenet_channel = channel;
+    nativenet_hello(NATIVENET_HELLO);
+    return nativenet_channel;
+}
+
+int16_t nativenet_get_channel(void) {
+    return nativenet_channel;
+}
+
+radio_address_t nativenet_set_address(radio_address_t address) {
+    nativenet_address = address;
+    nativenet_hello(NATIVENET_HELLO);
+    return nativenet_address;
+}
+
+radio_address_t nativenet_get_address(void) {
+    return nativenet_address;
+}
+
+void nativenet_set_monitor(uint8_t mode) {
+    nativenet_monitor = mode;
+}
+
+void nativenet_switch_to_rx(void) {
+    if (!nativenet_on) {
+        nativenet_on = 1;
+        nativenet_hello(NATIVENET_HELLO);
+    }
+}
+
+void nativenet_powerdown(void) {
+    nativenet_on = 0;
+    nativenet_hello(NATIVENET_BYE);
+}
@@ -0,0 +1,92 @@
+/**
+ * Native host C library wrappers
+ *
+ * malloc() and stdio take non-recursive locks in glibc. A thread switched
+ * away from inside one of them by an interrupt would deadlock the next
+ * thread calling it, so these calls are bracketed by
+ * _native_syscall_enter()/_native_syscall_leave(). The wrappers are bound
+ * by the linker (-Wl,--wrap, see Jamrules.native).
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @ingroup native
+ * @{
+ * @file
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ * @}
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+int __real_vprintf(const char *format, va_list ap);
+int __real_puts(const char *s);
+int __real_putchar(int c);
+
+void *__wrap_malloc(size_t size) {
+    _native_syscall_enter();
+    void *r = __real_malloc(size);
+    _native_syscall_leave();
+    return r;
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    _native_syscall_enter();
+    void *r = __real_calloc(nmemb, size);
+    _native_syscall_leave();
+    return r;
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    _native_syscall_enter();
+    void *r = __real_realloc(ptr, size);
+    _native_syscall_leave();
+    return r;
+}
+
+void __wrap_free(void *ptr) {
+    _native_syscall_enter();
+    __real_free(ptr);
+    _native_syscall_leave();
+}
+
+int __wrap_vprintf(const char *format, va_list ap) {
+    _native_syscall_enter();
+    int r = __real_vprintf(format, ap);
+    _native_syscall_leave();
+    return r;
+}
+
+int __wrap_printf(const char *format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    _native_syscall_enter();
+    int r = __real_vprintf(format, ap);
+    _native_syscall_leave();
+    va_end(ap);
+    return r;
+}
+
+int __wrap_puts(const char *s) {
+    _native_syscall_enter();
+    int r = __real_puts(s);
+    _native_syscall_leave();
+    return r;
+}
+
+int __wrap_putchar(int c) {
+    _native_syscall_enter();
+    int r = __real_putchar(c);
+    _native_syscall_leave();
+    return r;
+}
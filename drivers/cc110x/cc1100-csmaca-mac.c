@@ -47,6 +47,7 @@ and the mailinglist (subscription via web site)
 #include <protocol-multiplex.h>
 
 #include "hwtimer.h"
+#include <irq.h>
 #include <vtimer.h>
 
 /*---------------------------------------------------------------------------*/
@@ -71,6 +72,17 @@ static void cs_timeout_cb(void* ptr)
 	cs_timeout_flag = 1;
 }
 
+/*---------------------------------------------------------------------------*/
+static void cs_timer_remove(void)
+{
+	int irq_state = disableIRQ();
+	if (!cs_timeout_flag)						// A timer that fired is gone already
+	{
+		hwtimer_remove(cs_hwtimer_id);
+	}
+	restoreIRQ(irq_state);
+}
+
 /*---------------------------------------------------------------------------*/
 int cc1100_send_csmaca(radio_address_t address, protocol_t protocol, int priority, char *payload, int payload_len)
 {
@@ -189,7 +201,7 @@ int cc1100_send_csmaca(radio_address_t address, protocol_t protocol, int priorit
 #endif
 			}
 		}
-		hwtimer_remove(cs_hwtimer_id);			// Remove hwtimer
+		cs_timer_remove();						// Remove hwtimer
 		cc1100_cs_write_cca(1);					// Air is free now
 		cc1100_cs_set_enabled(true);
 		if (cc1100_cs_read()) goto window;		// GDO0 triggers on rising edge, so
@@ -204,9 +216,10 @@ int cc1100_send_csmaca(radio_address_t address, protocol_t protocol, int priorit
 		while (!cs_timeout_flag
 				|| !cc1100_cs_read_cca())		// Wait until timeout is finished
 		{
-			if (cc1100_cs_read_cca() == 0)		// Is the air still free?
+			if (cc1100_cs_read_cca() == 0		// Is the air still free?
+				|| cc1100_cs_read())			// (the pin may not have interrupted yet)
 			{
-				hwtimer_remove(cs_hwtimer_id);
+				cs_timer_remove();
 				goto window;					// No. Go back to new wait period.
 			}
 		}
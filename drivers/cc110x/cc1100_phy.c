@@ -92,7 +92,7 @@ static cc1100_packet_layer0_t tx_buffer;		///< TX buffer (for one packet)
 #define MAX_PACKET_HANDLERS		(5)
 static packet_monitor_t packet_monitor;
 static handler_entry_t handlers[MAX_PACKET_HANDLERS];
-static const pm_table_t handler_table;
+static pm_table_t handler_table;
 static const char *cc1100_event_handler_name = "cc1100_event_handler";
 static mutex_t cc1100_mutex;
 volatile int cc1100_mutex_pid;
@@ -101,7 +101,7 @@ char cc110x_conf[] = {
   0xF8, // MDMCFG0
   0x00, // DEVIATN
   0x07, // MCSM2
-  0x03, // MCSM1
+  0x0F, // MCSM1, stay in RX after a packet, so the next one is not missed
   0x18, // MCSM0
   0x1D, // FOCCFG
   0x1C, // BSCFG
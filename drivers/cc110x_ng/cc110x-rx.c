@@ -21,48 +21,51 @@ radio_address_t ignored_addr[IGN_MAX];
 static uint8_t is_ignored(radio_address_t addr);
 #endif
 
+#define RX_EMPTY        (0)     ///< no complete packet in the RX FIFO
+#define RX_OK           (1)
+#define RX_DROPPED      (2)     ///< CRC failed or invalid length
+
 static uint8_t receive_packet_variable(uint8_t *rxBuffer, uint8_t length);
 static uint8_t receive_packet(uint8_t *rxBuffer, uint8_t length);
 
 rx_buffer_t cc110x_rx_buffer[RX_BUF_SIZE];		    ///< RX buffer
 volatile uint8_t rx_buffer_next;	    ///< Next packet in RX queue
 
+static uint8_t rx_length;               ///< length byte of a packet still arriving, 0 if none
+
 void cc110x_rx_handler(void) {
-    uint8_t res = 0;
+    uint8_t res;
 
-	// Possible packet received, RX -> IDLE (0.1 us)
 	rflags.CAA      = 0;
 	rflags.MAN_WOR  = 0;
-	cc110x_statistic.packets_in++;
 
-	res = receive_packet((uint8_t*)&(cc110x_rx_buffer[rx_buffer_next].packet), sizeof(cc110x_packet_t));
-	if (res) {
+	// The radio stays in RX after a packet (RXOFF_MODE), so an interrupt
+	// served late finds the following packets in the RX FIFO as well
+	while ((res = receive_packet((uint8_t*)&(cc110x_rx_buffer[rx_buffer_next].packet),
+                                 sizeof(cc110x_packet_t))) != RX_EMPTY) {
+		cc110x_statistic.packets_in++;
+
+		if (res == RX_DROPPED) {
+			// No ACK received so TOF is unpredictable
+			rflags.TOF = 0;
+			continue;
+		}
+
         // If we are sending a burst, don't accept packets.
-		// Only ACKs are processed (for stopping the burst).
 		// Same if state machine is in TX lock.
 		if (radio_state == RADIO_SEND_BURST || rflags.TX)
 		{
 			cc110x_statistic.packets_in_while_tx++;
-			return;
+			continue;
 		}
 
         cc110x_rx_buffer[rx_buffer_next].rssi = rflags._RSSI;
         cc110x_rx_buffer[rx_buffer_next].lqi = rflags._LQI;
-		cc110x_strobe(CC1100_SFRX);		// ...for flushing the RX FIFO
-
-		// Valid packet. After a wake-up, the radio should be in IDLE.
-		// So put CC1100 to RX for WOR_TIMEOUT (have to manually put
-		// the radio back to sleep/WOR).
-		//cc110x_spi_write_reg(CC1100_MCSM0, 0x08);	// Turn off FS-Autocal
-		cc110x_write_reg(CC1100_MCSM2, 0x07);	// Configure RX_TIME (until end of packet)
-        cc110x_strobe(CC1100_SRX);
-        hwtimer_wait(IDLE_TO_RX_TIME);
-        radio_state = RADIO_RX;
-        
+
 #ifdef DBG_IGNORE
         if (is_ignored(cc110x_rx_buffer[rx_buffer_next].packet.phy_src)) {
             LED_RED_TOGGLE;
-            return;
+            continue;
         }
 #endif
 
@@ -78,84 +81,75 @@ void cc110x_rx_handler(void) {
         if (++rx_buffer_next == RX_BUF_SIZE) {
             rx_buffer_next = 0;
         }
-        return;
     }
-	else
-	{
-		// No ACK received so TOF is unpredictable
-		rflags.TOF = 0;
-
-		// CRC false or RX buffer full -> clear RX FIFO in both cases
-		cc110x_strobe(CC1100_SIDLE);	// Switch to IDLE (should already be)...
-		cc110x_strobe(CC1100_SFRX);		// ...for flushing the RX FIFO
-
-		// If packet interrupted this nodes send call,
-		// don't change anything after this point.
-		if (radio_state == RADIO_AIR_FREE_WAITING)
-		{
-			cc110x_strobe(CC1100_SRX);
-			hwtimer_wait(IDLE_TO_RX_TIME);
-			return;
-		}
-		// If currently sending, exit here (don't go to RX/WOR)
-		if (radio_state == RADIO_SEND_BURST)
-		{
-			cc110x_statistic.packets_in_while_tx++;
-			return;
-		}
+}
 
-		// No valid packet, so go back to RX/WOR as soon as possible
-		cc110x_switch_to_rx();
-	}
+void cc110x_rx_flush(void) {
+	cc110x_strobe(CC1100_SFRX);
+	rx_length = 0;
 }
 
+/* drops the RX FIFO and keeps receiving */
+static void restart_rx(void) {
+	cc110x_strobe(CC1100_SIDLE);
+	cc110x_rx_flush();
+	cc110x_strobe(CC1100_SRX);
+}
 
 static uint8_t receive_packet_variable(uint8_t *rxBuffer, uint8_t length) {
 	uint8_t status[2];
-	uint8_t packetLength = 0;
+	uint8_t rx_bytes = cc110x_read_status(CC1100_RXBYTES);
+
+	if (rx_bytes & RXFIFO_OVERFLOW) {
+		cc110x_statistic.packets_in_overflow++;
+		restart_rx();
+		return RX_EMPTY;
+	}
+	rx_bytes &= BYTES_IN_RXFIFO;
 
-	/* Any bytes available in RX FIFO? */
-	if ((cc110x_read_status(CC1100_RXBYTES) & BYTES_IN_RXFIFO)) {
+	if (!rx_length) {
+		if (!rx_bytes) {
+			return RX_EMPTY;
+		}
 		// Read length byte (first byte in RX FIFO)
-        cc110x_read_fifo((char*) &packetLength, 1);
-		// Read data from RX FIFO and store in rxBuffer
-        if (packetLength <= length)
-		{
-			// Put length byte at first position in RX Buffer
-			rxBuffer[0] = packetLength;
+        cc110x_read_fifo((char*) &rx_length, 1);
+		rx_bytes--;
+
+		if ((rx_length == 0) || (rx_length >= length)) {
+			// Lost track of the packet boundaries
+			restart_rx();
+			return RX_DROPPED;
+		}
+	}
 
-			// Read the rest of the packet
-			//cc110x_readburst_reg(CC1100_RXFIFO, (char*)rxBuffer+1, packetLength);
-            cc110x_read_fifo((char*) rxBuffer + 1, packetLength);
+	// The rest of the packet is still arriving, its own interrupt follows
+	if (rx_bytes < rx_length + 2) {
+		return RX_EMPTY;
+	}
 
-            // Read the 2 appended status bytes (status[0] = RSSI, status[1] = LQI)
-			cc110x_readburst_reg(CC1100_RXFIFO, (char*)status, 2);
+	// Put length byte at first position in RX Buffer
+	rxBuffer[0] = rx_length;
 
-			// Store RSSI value of packet
-			rflags._RSSI = status[I_RSSI];
+	// Read the rest of the packet
+    cc110x_read_fifo((char*) rxBuffer + 1, rx_length);
+	rx_length = 0;
 
-			// MSB of LQI is the CRC_OK bit
-			rflags.CRC = (status[I_LQI] & CRC_OK) >> 7;
-			if (!rflags.CRC) {
-                cc110x_statistic.packets_in_crc_fail++;
-            }
+    // Read the 2 appended status bytes (status[0] = RSSI, status[1] = LQI)
+	cc110x_readburst_reg(CC1100_RXFIFO, (char*)status, 2);
 
-			// Bit 0-6 of LQI indicates the link quality (LQI)
-			rflags._LQI = status[I_LQI] & LQI_EST;
+	// Store RSSI value of packet
+	rflags._RSSI = status[I_RSSI];
 
-			return rflags.CRC;
-        }
-        /* too many bytes in FIFO */
-		else {
-			// RX FIFO get automatically flushed if return value is false
-            return 0;
-        }
-	}
-    /* no bytes in RX FIFO */
-	else {
-		// RX FIFO get automatically flushed if return value is false
-		return 0;
-	}
+	// MSB of LQI is the CRC_OK bit
+	rflags.CRC = (status[I_LQI] & CRC_OK) >> 7;
+	if (!rflags.CRC) {
+        cc110x_statistic.packets_in_crc_fail++;
+    }
+
+	// Bit 0-6 of LQI indicates the link quality (LQI)
+	rflags._LQI = status[I_LQI] & LQI_EST;
+
+	return rflags.CRC ? RX_OK : RX_DROPPED;
 }
 
 static uint8_t receive_packet(uint8_t *rxBuffer, uint8_t length) {
@@ -165,8 +159,8 @@ static uint8_t receive_packet(uint8_t *rxBuffer, uint8_t length) {
 		return receive_packet_variable(rxBuffer, length);
 	}
 	// Fixed packet length not supported.
-	// RX FIFO get automatically flushed if return value is false
-	return 0;
+	restart_rx();
+	return RX_EMPTY;
 }
 
 #ifdef DBG_IGNORE
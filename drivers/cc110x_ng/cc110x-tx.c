@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 
 #include <cc110x_ng.h>
 #include <cc110x-defaultSettings.h>
@@ -7,72 +8,211 @@
 #include <cc110x_spi.h>
 #include <cc110x-reg.h>
 
+#include <hwtimer.h>
 #include <irq.h>
+#include <msg.h>
+#include <transceiver.h>
 
 #include <board.h>
 
-uint8_t cc110x_send(cc110x_packet_t *packet) {
-	volatile uint32_t abort_count;
-    uint8_t size;
-    /* TODO: burst sending */
-	radio_state = RADIO_SEND_BURST;
-	rflags.LL_ACK = 0;
+/*
+ * Packets wait in tx_queue until the radio is free. cc110x_send() only
+ * copies the packet and, if the radio is idle, writes it to the TX FIFO and
+ * strobes STX. The end of the packet is signalled by the falling edge of
+ * GDO2, whose interrupt completes the transmission, reports it to the
+ * transceiver thread and starts the next queued packet.
+ *
+ * Packets queued back to back go out as a burst: while another packet
+ * waits, TXOFF_MODE keeps the radio in TX after the packet on air, so the
+ * interrupt only refills the (then empty) TX FIFO. Only the first packet
+ * of a burst pays for SIDLE, the FIFO flushes and the calibration, and
+ * after the last one the radio returns to RX without calibrating.
+ */
+static cc110x_packet_t tx_queue[CC1100_TX_QUEUE_SIZE];
+static volatile uint8_t tx_queue_head;          ///< packet on air or next to send
+static volatile uint8_t tx_queue_count;
+static uint8_t tx_burst;                        ///< TXOFF_MODE is TX
+
+static int tx_timer = -1;                       ///< hwtimer guarding the packet on air
+
+static void tx_start(void);
+static void tx_write(void);
+static void tx_done(uint8_t success);
 
+/* copies a packet into the queue, called with interrupts disabled */
+static uint8_t tx_enqueue(cc110x_packet_t *packet) {
     /*
      * Number of bytes to send is:
      * length of phy payload (packet->length)
      * + size of length field (1 byte)
      */
-    size = packet->length + 1;
+    uint8_t size = packet->length + 1;
 
 	// The number of bytes to be transmitted must be smaller
 	// or equal to PACKET_LENGTH (62 bytes). So the receiver
 	// can put the whole packet in its RX-FIFO (with appended
 	// packet status bytes).
-	if (size > PACKET_LENGTH) {
+	if ((size > PACKET_LENGTH) || (tx_queue_count == CC1100_TX_QUEUE_SIZE)) {
         return 0;
     }
 
-    packet->phy_src = cc110x_get_address();
+    cc110x_packet_t *p = &tx_queue[(tx_queue_head + tx_queue_count) % CC1100_TX_QUEUE_SIZE];
+    memcpy(p, packet, size);
+    p->phy_src = cc110x_get_address();
+    tx_queue_count++;
+
+    return 1;
+}
+
+/* keeps the radio in TX after the packet on air while another one waits */
+static void tx_update_burst(void) {
+    unsigned int cpsr = disableIRQ();
+    uint8_t burst = (tx_queue_count > 1);
+
+    if (burst != tx_burst) {
+        tx_burst = burst;
+        cc110x_write_reg(CC1100_MCSM1, (cc110x_conf[CC1100_MCSM1] & ~TXOFF_MODE) |
+                                       (burst ? TXOFF_MODE_TX : (cc110x_conf[CC1100_MCSM1] & TXOFF_MODE)));
+    }
+    restoreIRQ(cpsr);
+}
+
+uint8_t cc110x_send_burst(cc110x_packet_t *packets, uint8_t count) {
+    uint8_t queued = 0;
+
+    unsigned int cpsr = disableIRQ();
+    /* with an empty queue nothing is on air, so no interrupt starts it */
+    uint8_t idle = (tx_queue_count == 0);
+
+    while ((queued < count) && tx_enqueue(&packets[queued])) {
+        queued++;
+    }
+    restoreIRQ(cpsr);
+
+    if (!queued) {
+        return 0;
+    }
+    if (idle) {
+        tx_start();
+    }
+    else {
+        tx_update_burst();
+    }
+
+	return queued;
+}
+
+uint8_t cc110x_send(cc110x_packet_t *packet) {
+    return cc110x_send_burst(packet, 1);
+}
+
+uint8_t cc110x_tx_queue_full(void) {
+    return (tx_queue_count == CC1100_TX_QUEUE_SIZE);
+}
+
+void cc110x_tx_handler(void) {
+    if (!tx_queue_count) {
+        return;
+    }
+    // GDO2 cleared -> end of packet
+    if (tx_timer >= 0) {
+        hwtimer_remove(tx_timer);
+        tx_timer = -1;
+    }
+    tx_done(1);
+}
+
+/* hwtimer callback, the packet did not leave in time */
+static void tx_timeout(void *ptr) {
+    (void) ptr;
 
+    tx_timer = -1;
+    if (radio_state != RADIO_SEND_BURST) {
+        return;
+    }
+    // CC1100 maybe in wrong mode, e.g. sending preambles for always
+    puts("[CC1100 TX] fatal error");
+    cc110x_statistic.raw_packets_out_timeout++;
+    tx_done(0);
+}
+
+/* first packet of a burst, called by cc110x_send_burst() or tx_done() */
+static void tx_start(void) {
 	// Disables RX interrupt etc.
 	cc110x_before_send();
 
+	// From now on GDO2 interrupts belong to the transmission
+	radio_state = RADIO_SEND_BURST;
+	rflags.LL_ACK = 0;
+
 	// But CC1100 in IDLE mode to flush the FIFO
     cc110x_strobe(CC1100_SIDLE);
     // Flush TX FIFO to be sure it is empty
     cc110x_strobe(CC1100_SFTX);
+    // A packet cut short by SIDLE must not stay in the RX FIFO
+    cc110x_rx_flush();
+
+    tx_write();
+
+    // GDO2 now signals the end of our own packet, see cc110x_gdo2_irq()
+    cc110x_after_send();
+}
+
+/* writes the packet at the queue head and sends it */
+static void tx_write(void) {
+    cc110x_packet_t *packet = &tx_queue[tx_queue_head];
+
+    tx_update_burst();
+
 	// Write packet into TX FIFO
-    cc110x_writeburst_reg(CC1100_TXFIFO, (char*) packet, size);
-  	// Switch to TX mode
-    abort_count = 0;
-    unsigned int cpsr = disableIRQ();
-    cc110x_strobe(CC1100_STX);
-    // Wait for GDO2 to be set -> sync word transmitted
-    while (cc110x_get_gdo2() == 0) {
-    	abort_count++;
-    	if (abort_count > CC1100_SYNC_WORD_TX_TIME) {
-    		// Abort waiting. CC1100 maybe in wrong mode
-    		// e.g. sending preambles for always
-    		puts("[CC1100 TX] fatal error\n");
-    		break;
-    	}
+    cc110x_writeburst_reg(CC1100_TXFIFO, (char*) packet, packet->length + 1);
+
+    // Armed before the packet can end, which removes the timer again
+    tx_timer = hwtimer_set(CC1100_TX_TIMEOUT, tx_timeout, NULL);
+    if (tx_timer < 0) {
+        // Without a timer a stuck transmission is never given up
+        rflags.KT_RES_ERR = 1;
     }
-    restoreIRQ(cpsr);
-	// Wait for GDO2 to be cleared -> end of packet
-    while (cc110x_get_gdo2() != 0);
-    //LED_GREEN_TOGGLE;
 
-    // Experimental - TOF Measurement
-    cc110x_after_send();
-    cc110x_statistic.raw_packets_out++;
+  	// Switch to TX mode, no effect if the burst kept the radio in TX
+    cc110x_strobe(CC1100_STX);
+}
 
-	// Store number of transmission retries
+/* called from interrupt context */
+static void tx_done(uint8_t success) {
+    msg_t m;
+
+    if (success) {
+        cc110x_statistic.raw_packets_out++;
+    }
 	rflags.TX = 0;
 
+    if (++tx_queue_head == CC1100_TX_QUEUE_SIZE) {
+        tx_queue_head = 0;
+    }
+    tx_queue_count--;
+
+    /* tell the transceiver thread, it may have senders waiting for room */
+    if (transceiver_pid) {
+        m.type = (uint16_t) SND_PKT_DONE;
+        m.content.value = success;
+        msg_send_int(&m, transceiver_pid);
+    }
+
+    if (tx_queue_count) {
+        // A burst left the radio in TX with an empty FIFO, anything else
+        // (the packet was queued too late or the last one failed) starts over
+        if (success && tx_burst &&
+            ((cc110x_read_status(CC1100_MARCSTATE) & MARC_STATE) == MARC_STATE_TX)) {
+            cc110x_statistic.raw_packets_out_burst++;
+            tx_write();
+        }
+        else {
+            tx_start();
+        }
+        return;
+    }
+
 	// Go to mode after TX (CONST_RX -> RX, WOR -> WOR)
 	cc110x_switch_to_rx();
-
-	return true;
 }
-
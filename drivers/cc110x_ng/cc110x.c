@@ -97,7 +97,13 @@ void cc110x_gdo0_irq(void) {
 }
 
 void cc110x_gdo2_irq(void) {
-	cc110x_rx_handler();
+	// The falling edge ends either our own or a received packet
+	if (radio_state == RADIO_SEND_BURST) {
+		cc110x_tx_handler();
+	}
+	else {
+		cc110x_rx_handler();
+	}
 }
 
 uint8_t cc110x_get_buffer_pos(void) {
@@ -83,11 +83,14 @@ typedef struct cc110x_statistic {
 	uint32_t	packets_in;
 	uint32_t	packets_in_crc_fail;
 	uint32_t	packets_in_while_tx;
+	uint32_t	packets_in_overflow;
 	uint32_t	packets_in_dups;
 	uint32_t	packets_in_up;
 	uint32_t	packets_out;
 	uint32_t	packets_out_broadcast;
 	uint32_t	raw_packets_out;
+	uint32_t	raw_packets_out_timeout;
+	uint32_t	raw_packets_out_burst;
 	uint32_t	acks_send;
 	uint32_t	rx_buffer_max;
 	uint32_t	watch_dog_resets;
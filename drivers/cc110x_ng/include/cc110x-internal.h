@@ -70,6 +70,7 @@ and the mailinglist (subscription via web site)
 #define I_RSSI              (0x00)		///< Index 0 contains RSSI information (from optionally appended packet status bytes).
 #define I_LQI               (0x01)		///< Index 1 contains LQI & CRC_OK information (from optionally appended packet status bytes).
 #define MARC_STATE			(0x1F)		///< Bitmask (=00011111) for reading MARC_STATE in MARCSTATE status register.
+#define MARC_STATE_TX		(0x13)		///< MARC_STATE value while transmitting.
 #define CS					(0x40)		///< Bitmask (=01000000) for reading CS (Carrier Sense) in PKTSTATUS status register.
 #define PQT_REACHED			(0x20)		///< Bitmask (=00100000) for reading PQT_REACHED (Preamble Quality reached) in PKTSTATUS status register.
 #define CCA					(0x10)		///< Bitmask (=00010000) for reading CCA (clear channel assessment) in PKTSTATUS status register.
@@ -79,8 +80,8 @@ and the mailinglist (subscription via web site)
 #define GDO0				(0x01)		///< Bitmask (=00000001) for reading GDO0 (current value on GDO0 pin) in PKTSTATUS status register.
 #define TXFIFO_UNDERFLOW	(0x80)		///< Bitmask (=10000000) for reading TXFIFO_UNDERFLOW in TXBYTES status register.
 #define BYTES_IN_TXFIFO		(0x7F)		///< Bitmask (=01111111) for reading NUM_TXBYTES in TXBYTES status register.
-#define RXFIFO_OVERFLOW		(0xBF)		///< Bitmask (=10000000) for reading RXFIFO_OVERFLOW in RXBYTES status register.
-#define BYTES_IN_RXFIFO     (0xFF)		///< Bitmask (=01111111) for reading NUM_RXBYTES in RXBYTES status register.
+#define RXFIFO_OVERFLOW		(0x80)		///< Bitmask (=10000000) for reading RXFIFO_OVERFLOW in RXBYTES status register.
+#define BYTES_IN_RXFIFO     (0x7F)		///< Bitmask (=01111111) for reading NUM_RXBYTES in RXBYTES status register.
 /** @} */
 
 /**
@@ -88,6 +89,8 @@ and the mailinglist (subscription via web site)
  * @{
  */
 #define PKT_LENGTH_CONFIG	(0x03)		///< Bitmask (=00000011) for reading LENGTH_CONFIG in PKTCTRL0 configuration register.
+#define TXOFF_MODE			(0x03)		///< Bitmask (=00000011) for reading TXOFF_MODE in MCSM1 configuration register.
+#define TXOFF_MODE_TX		(0x02)		///< TXOFF_MODE value to stay in TX (start sending preamble) after a packet.
 /** @} */
 
 /**
@@ -22,8 +22,9 @@
 #define MAX_OUTPUT_POWER		   (11)	///< Maximum output power value
 
 #define PACKET_LENGTH				(0x3E)		///< Packet length = 62 Bytes.
-#define CC1100_SYNC_WORD_TX_TIME   (90000)		// loop count (max. timeout ~ 15 ms) to wait for
-												// sync word to be transmitted (GDO2 from low to high)
+#define CC1100_TX_TIMEOUT	HWTIMER_TICKS(50000)	///< time for a packet to leave before the
+												///< transmission is given up
+#define CC1100_TX_QUEUE_SIZE		(4)		///< Packets queued for sending
 /**
  * @name	Defines used as state values for state machine
  * @{
@@ -98,8 +99,41 @@ void cc110x_init(int transceiver_pid);
 
 void cc110x_rx_handler(void);
 
+/**
+ * @brief	Drop everything in the RX FIFO, the radio must be idle
+ */
+void cc110x_rx_flush(void);
+
+void cc110x_tx_handler(void);
+
+/**
+ * @brief	Queue a packet for sending
+ *
+ * Copies the packet and returns immediately. The transmission completes in
+ * the GDO2 interrupt, which sends SND_PKT_DONE to the transceiver thread
+ * with content.value 1 if the packet was sent and 0 if it timed out.
+ *
+ * @return	1 if the packet was queued, 0 if it is too long or the queue
+ *			is full
+ */
 uint8_t cc110x_send(cc110x_packet_t *pkt);
 
+/**
+ * @brief	Queue several packets to be sent as one burst
+ *
+ * The packets go out back to back without the radio leaving TX, so only
+ * the first one waits for the frequency synthesizer to calibrate. Each
+ * packet is reported with SND_PKT_DONE like one from cc110x_send().
+ *
+ * @return	number of packets queued, from the start of packets
+ */
+uint8_t cc110x_send_burst(cc110x_packet_t *packets, uint8_t count);
+
+/**
+ * @return	1 if cc110x_send() has no room for another packet
+ */
+uint8_t cc110x_tx_queue_full(void);
+
 uint8_t cc110x_get_buffer_pos(void);
 
 void cc110x_setup_rx_mode(void);
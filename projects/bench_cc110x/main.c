@@ -0,0 +1,274 @@
+/*
+ * cc110x_ng benchmark on the emulated CC1100
+ *
+ * Runs the driver on top of the native board's CC1100 emulator. The TX
+ * part keeps the driver's TX queue full with BENCH_FRAMES frames of
+ * BENCH_LENGTH bytes and reports the throughput against what the air time
+ * allows, and how long after the end of each frame the driver reported it
+ * done. The RX part puts BENCH_FRAMES frames on the air one at a time and
+ * reports how long after the end of each frame it reached this thread,
+ * leaving BENCH_GAP_US between frames. Frames for another address and with
+ * a broken CRC must not arrive. Finally BENCH_FRAMES frames arrive in back
+ * to back bursts of BENCH_BURST, the way a peer sends the fragments of a
+ * datagram, and the driver has to catch all of them. Frames are put on
+ * air and timed on the emulator's clock, which the hwtimers run on as
+ * well, so a run does not depend on the host's load.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <hwtimer.h>
+#include <irq.h>
+#include <msg.h>
+#include <thread.h>
+#include <transceiver.h>
+#include <cc110x_ng.h>
+#include <cc110x_emu.h>
+
+#ifndef BENCH_FRAMES
+#define BENCH_FRAMES    (1000)
+#endif
+
+#ifndef BENCH_LENGTH
+#define BENCH_LENGTH    (PACKET_LENGTH - 1)
+#endif
+
+/* time between received frames, more than the receiver's calibration */
+#ifndef BENCH_GAP_US
+#define BENCH_GAP_US    (1000)
+#endif
+
+#ifndef BENCH_BURST
+#define BENCH_BURST     (8)
+#endif
+
+#if BENCH_BURST > CC110X_EMU_AIR_QUEUE_SIZE
+#error "the emulator cannot schedule a burst of BENCH_BURST frames"
+#endif
+
+#define BENCH_ADDRESS   (1)
+#define BENCH_PEER      (2)
+
+#define BENCH_RX_TIMEOUT    (0x7F00)
+
+static msg_t msg_queue[16];
+
+static uint32_t tx_end[CC1100_TX_QUEUE_SIZE];
+static volatile uint8_t tx_ends;
+
+static void record_end(const uint8_t *frame, uint32_t end) {
+    (void) frame;
+    tx_end[tx_ends++ % CC1100_TX_QUEUE_SIZE] = end;
+}
+
+static void print_latency(const char *what, uint32_t total, uint32_t max, int count) {
+    printf("%s: avg %lu us, max %lu us\n", what,
+           (unsigned long) (total / count), (unsigned long) max);
+}
+
+static void bench_tx(void) {
+    cc110x_packet_t p;
+    uint32_t start, duration, late, total = 0, max = 0;
+    uint8_t done_count = 0;
+    int sent = 0, done = 0, failed = 0;
+    msg_t m;
+
+    memset(&p, 0, sizeof(p));
+    p.length = BENCH_LENGTH;
+    p.address = BENCH_PEER;
+    cc110x_emu_set_tx_hook(record_end);
+
+    start = cc110x_emu_now();
+    while (done < BENCH_FRAMES) {
+        if ((sent < BENCH_FRAMES) && !cc110x_tx_queue_full()) {
+            p.flags = sent;
+            cc110x_send(&p);
+            sent++;
+            continue;
+        }
+
+        msg_receive(&m);
+        if (m.type != SND_PKT_DONE) {
+            continue;
+        }
+        if (!m.content.value) {
+            failed++;
+        }
+        else {
+            late = cc110x_emu_now() - tx_end[done_count++ % CC1100_TX_QUEUE_SIZE];
+            total += late;
+            if (late > max) {
+                max = late;
+            }
+        }
+        done++;
+    }
+    duration = cc110x_emu_now() - start;
+    cc110x_emu_set_tx_hook(NULL);
+
+    printf("TX %d frames of %d bytes in %lu ms, %d failed\n", BENCH_FRAMES, BENCH_LENGTH,
+           (unsigned long) (duration / 1000), failed);
+    printf("TX throughput: %lu B/s, air time allows %lu B/s\n",
+           (unsigned long) ((uint64_t) BENCH_FRAMES * BENCH_LENGTH * 1000000 / duration),
+           (unsigned long) ((uint64_t) BENCH_LENGTH * 1000000 / cc110x_emu_air_time(BENCH_LENGTH)));
+    if (done > failed) {
+        print_latency("TX done after end of frame", total, max, done - failed);
+    }
+}
+
+static int rx_round;
+static volatile int rx_timer = -1;
+
+/* hwtimer callback, the frame did not arrive */
+static void rx_timeout(void *ptr) {
+    msg_t m;
+
+    rx_timer = -1;
+    m.type = BENCH_RX_TIMEOUT;
+    m.content.value = rx_round;
+    msg_send_int(&m, (int) ptr);
+}
+
+/* the hwtimers count on the emulator's clock, so at is emulator time */
+static void set_rx_timeout(uint32_t at) {
+    rx_timer = hwtimer_set_absolute(at, rx_timeout, (void*) thread_getpid());
+}
+
+/* unless it fired in the meantime, then its message is ignored */
+static void remove_rx_timeout(void) {
+    unsigned state = disableIRQ();
+    if (rx_timer >= 0) {
+        hwtimer_remove(rx_timer);
+        rx_timer = -1;
+    }
+    restoreIRQ(state);
+}
+
+/* returns 1 and how late the frame arrived, 0 if it did not */
+static int receive_one(uint8_t address, uint8_t crc_ok, uint32_t *late) {
+    uint8_t frame[BENCH_LENGTH + 1];
+    uint32_t end;
+    msg_t m;
+
+    memset(frame, 0x55, sizeof(frame));
+    frame[0] = BENCH_LENGTH;
+    frame[1] = address;
+    frame[2] = BENCH_PEER;
+
+    rx_round++;
+    /* like a peer would, leave the receiver time to recalibrate */
+    end = cc110x_emu_receive_at(cc110x_emu_now() + BENCH_GAP_US, frame, -60, 100, crc_ok);
+    set_rx_timeout(end + cc110x_emu_air_time(BENCH_LENGTH));
+
+    /* a timeout of an earlier frame may still be queued */
+    do {
+        msg_receive(&m);
+    } while ((m.type != RCV_PKT_CC1100) &&
+             ((m.type != BENCH_RX_TIMEOUT) || (m.content.value != rx_round)));
+
+    if (m.type == BENCH_RX_TIMEOUT) {
+        return 0;
+    }
+    *late = cc110x_emu_now() - end;
+    remove_rx_timeout();
+
+    return (cc110x_rx_buffer[m.content.value].packet.phy_src == BENCH_PEER);
+}
+
+static void bench_rx(void) {
+    uint32_t late, total = 0, max = 0;
+    int ok = 0, filtered = 0;
+
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        if (receive_one(BENCH_ADDRESS, 1, &late)) {
+            ok++;
+            total += late;
+            if (late > max) {
+                max = late;
+            }
+        }
+    }
+    filtered += receive_one(BENCH_ADDRESS + 10, 1, &late);
+    filtered += receive_one(BENCH_ADDRESS, 0, &late);
+
+    printf("RX %d of %d frames, %d of 2 bad frames passed\n", ok, BENCH_FRAMES, filtered);
+    if (ok) {
+        print_latency("RX delivered after end of frame", total, max, ok);
+    }
+}
+
+static void bench_rx_burst(void) {
+    uint8_t frame[BENCH_LENGTH + 1];
+    int received = 0, bursts = 0, got;
+    uint32_t end;
+    msg_t m;
+
+    memset(frame, 0x55, sizeof(frame));
+    frame[0] = BENCH_LENGTH;
+    frame[1] = BENCH_ADDRESS;
+    frame[2] = BENCH_PEER;
+
+    for (int i = 0; i < BENCH_FRAMES; i += BENCH_BURST) {
+        rx_round++;
+        bursts++;
+
+        /* each frame starts when the one before ends */
+        end = cc110x_emu_now();
+        for (int j = 0; j < BENCH_BURST; j++) {
+            end = cc110x_emu_receive_at(end, frame, -60, 100, 1);
+        }
+        /* the receiver has until a while after the last frame */
+        set_rx_timeout(end + BENCH_GAP_US);
+
+        /* collect what arrives until the burst is in or the time is up */
+        got = 0;
+        do {
+            msg_receive(&m);
+            if (m.type == RCV_PKT_CC1100) {
+                got++;
+            }
+        } while ((got < BENCH_BURST) &&
+                 ((m.type != BENCH_RX_TIMEOUT) || (m.content.value != rx_round)));
+        remove_rx_timeout();
+        received += got;
+    }
+    printf("RX bursts: %d of %d frames\n", received, bursts * BENCH_BURST);
+}
+
+int main(void)
+{
+    msg_init_queue(msg_queue, sizeof(msg_queue) / sizeof(msg_t));
+
+    cc110x_init(thread_getpid());
+    cc110x_set_address(BENCH_ADDRESS);
+
+    /* the air time follows the configuration the driver wrote */
+    printf("cc110x_ng benchmark, %d frames of %d bytes, %lu us air time each.\n",
+           BENCH_FRAMES, BENCH_LENGTH, (unsigned long) cc110x_emu_air_time(BENCH_LENGTH));
+
+    bench_tx();
+    bench_rx();
+    bench_rx_burst();
+
+    printf("emulator: %lu SPI bytes, %lu strobes, %lu out, %lu in, %lu received, "
+           "%lu missed, %lu filtered, %lu collided, %lu overflows, %lu underflows\n",
+           (unsigned long) cc110x_emu_statistic.spi_bytes,
+           (unsigned long) cc110x_emu_statistic.strobes,
+           (unsigned long) cc110x_emu_statistic.frames_out,
+           (unsigned long) cc110x_emu_statistic.frames_in,
+           (unsigned long) cc110x_emu_statistic.frames_received,
+           (unsigned long) cc110x_emu_statistic.frames_missed,
+           (unsigned long) cc110x_emu_statistic.frames_filtered,
+           (unsigned long) cc110x_emu_statistic.frames_collided,
+           (unsigned long) cc110x_emu_statistic.rx_overflows,
+           (unsigned long) cc110x_emu_statistic.tx_underflows);
+    printf("cc110x: %lu out, %lu in bursts, %lu timeouts, %lu in, %lu CRC failures\n",
+           (unsigned long) cc110x_statistic.raw_packets_out,
+           (unsigned long) cc110x_statistic.raw_packets_out_burst,
+           (unsigned long) cc110x_statistic.raw_packets_out_timeout,
+           (unsigned long) cc110x_statistic.packets_in,
+           (unsigned long) cc110x_statistic.packets_in_crc_fail);
+
+    return 0;
+}
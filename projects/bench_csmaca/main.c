@@ -0,0 +1,103 @@
+/*
+ * CSMA/CA benchmark on the emulated CC1100
+ *
+ * Runs the cc110x driver's CSMA/CA MAC on top of the native board's CC1100
+ * emulator. First BENCH_FRAMES broadcasts go out on a free channel, which
+ * shows the cost of DIFS, backoff and the send path next to the air time.
+ * Then every broadcast waits for a channel kept busy for BENCH_BUSY_US,
+ * which shows how long after the channel became free the frame got out.
+ * The MAC's carrier sense timeouts run on the hwtimers, which count on the
+ * emulator's clock, so a run does not depend on the host's load.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <hwtimer.h>
+#include <radio/types.h>
+#include <cc1100-interface.h>
+#include <cc110x_emu.h>
+
+#ifndef BENCH_FRAMES
+#define BENCH_FRAMES    (200)
+#endif
+
+#ifndef BENCH_PAYLOAD
+#define BENCH_PAYLOAD   (40)
+#endif
+
+#ifndef BENCH_BUSY_US
+#define BENCH_BUSY_US   (5000)
+#endif
+
+#define BENCH_ADDRESS   (1)
+#define BENCH_PROTOCOL  (1)
+
+static volatile uint32_t last_end;
+static volatile uint8_t last_length;
+
+static void record_end(const uint8_t *frame, uint32_t end) {
+    last_length = frame[0];
+    last_end = end;
+}
+
+static uint32_t send_one(int *failed) {
+    char payload[BENCH_PAYLOAD];
+    uint32_t start = cc110x_emu_now();
+
+    memset(payload, 0x55, sizeof(payload));
+    if (cc1100_send_csmaca(CC1100_BROADCAST_ADDRESS, BENCH_PROTOCOL, PRIORITY_DATA,
+                           payload, sizeof(payload)) < 0) {
+        (*failed)++;
+    }
+    return cc110x_emu_now() - start;
+}
+
+int main(void)
+{
+    uint32_t duration, total = 0, max = 0;
+    uint32_t busy_end, delay;
+    int failed = 0;
+
+    cc1100_set_address(BENCH_ADDRESS);
+    cc110x_emu_set_tx_hook(record_end);
+
+    printf("CSMA/CA benchmark, %d broadcasts of %d bytes.\n", BENCH_FRAMES, BENCH_PAYLOAD);
+
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        duration = send_one(&failed);
+        total += duration;
+        if (duration > max) {
+            max = duration;
+        }
+    }
+    printf("free channel: avg %lu us, max %lu us per call, %lu frames on air of %lu us, %d failed\n",
+           (unsigned long) (total / BENCH_FRAMES), (unsigned long) max,
+           (unsigned long) cc110x_emu_statistic.frames_out,
+           (unsigned long) cc110x_emu_air_time(last_length), failed);
+
+    total = max = 0;
+    failed = 0;
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        cc110x_emu_set_busy(BENCH_BUSY_US, -50);
+        busy_end = cc110x_emu_now() + BENCH_BUSY_US;
+        send_one(&failed);
+
+        /* from the channel getting free to the end of our frame */
+        delay = last_end - busy_end - cc110x_emu_air_time(last_length);
+        total += delay;
+        if (delay > max) {
+            max = delay;
+        }
+    }
+    printf("busy channel: frame started avg %lu us, max %lu us after %d us busy, %d failed\n",
+           (unsigned long) (total / BENCH_FRAMES), (unsigned long) max, BENCH_BUSY_US, failed);
+
+    printf("emulator: %lu SPI bytes, %lu strobes, %lu frames out, %lu us on air\n",
+           (unsigned long) cc110x_emu_statistic.spi_bytes,
+           (unsigned long) cc110x_emu_statistic.strobes,
+           (unsigned long) cc110x_emu_statistic.frames_out,
+           (unsigned long) cc110x_emu_statistic.air_time_out);
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * 6LoWPAN IPHC encoding benchmark
+ *
+ * Compresses the headers of small UDP datagrams on a few steady flows, a
+ * link-local one to a neighbor, global ones through contexts and one to a
+ * multicast group, with as many contexts installed as a node keeps. Each
+ * flow is timed with its compiled address fields dropped before every
+ * packet, i.e. compressed from scratch, and with them cached. Every cached
+ * header is checked against the one compressed from scratch, and after a
+ * context change the cached headers have to follow the new context.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <bench.h>
+
+#include "sys/net/destiny/in.h"
+#include "sys/net/sixlowpan/sixlowip.h"
+#include "sys/net/sixlowpan/sixlowpan.h"
+
+#ifndef BENCH_PACKETS
+#define BENCH_PACKETS   (100000UL)
+#endif
+
+#define PAYLOAD_LEN     (8)
+
+static uint8_t comp_buf[MTU + 1];
+static uint16_t comp_len;
+static uint8_t packet[IPV6_HDR_LEN + PAYLOAD_LEN];
+static uint8_t want[IPV6_HDR_LEN + PAYLOAD_LEN];
+static uint16_t want_len;
+
+/* <prefix>::ff:fe00:<host>, the IID of host 02:00:00:ff:fe:00:00:<host> */
+static void host_addr(ipv6_addr_t *addr, uint16_t prefix, uint8_t host) {
+    memset(addr, 0, sizeof(*addr));
+    addr->uint8[0] = prefix >> 8;
+    addr->uint8[1] = prefix & 0xff;
+    addr->uint8[8] = 0x02;
+    addr->uint8[11] = 0xff;
+    addr->uint8[12] = 0xfe;
+    addr->uint8[15] = host;
+}
+
+static void host_laddr(ieee_802154_long_t *laddr, uint8_t host) {
+    ipv6_addr_t addr;
+
+    host_addr(&addr, 0, host);
+    memcpy(laddr, &addr.uint8[8], 8);
+}
+
+static void set_packet(ipv6_addr_t *src, ipv6_addr_t *dst) {
+    ipv6_hdr_t *ipv6 = (ipv6_hdr_t *) packet;
+
+    memset(packet, 0, sizeof(packet));
+    ipv6->version_trafficclass = IPV6_VER;
+    ipv6->nextheader = IPPROTO_UDP;
+    ipv6->hoplimit = MULTIHOP_HOPLIMIT;
+    ipv6->length = PAYLOAD_LEN;
+    memcpy(&ipv6->srcaddr, src, sizeof(*src));
+    memcpy(&ipv6->destaddr, dst, sizeof(*dst));
+    for (int i = 0; i < PAYLOAD_LEN; i++) {
+        packet[IPV6_HDR_LEN + i] = i;
+    }
+}
+
+static void encode(ieee_802154_long_t *dest) {
+    comp_len = lowpan_iphc_encoding(dest, (ipv6_hdr_t *) packet,
+                                    &packet[IPV6_HDR_LEN], comp_buf);
+}
+
+/* the header compressed from scratch */
+static void compress_want(ieee_802154_long_t *dest) {
+    lowpan_iphc_cache_flush();
+    encode(dest);
+    memcpy(want, comp_buf, comp_len);
+    want_len = comp_len;
+}
+
+static void check(void) {
+    bench_check(comp_len == want_len && memcmp(comp_buf, want, want_len) == 0);
+}
+
+static void run(const char *name, ipv6_addr_t *src, ipv6_addr_t *dst,
+                ieee_802154_long_t *dest) {
+    uint32_t start;
+    unsigned long cold, warm;
+
+    set_packet(src, dst);
+    compress_want(dest);
+
+    start = bench_start();
+    for (unsigned long i = 0; i < BENCH_PACKETS; i++) {
+        lowpan_iphc_cache_flush();
+        encode(dest);
+    }
+    cold = bench_ns_per(start, BENCH_PACKETS);
+
+    start = bench_start();
+    for (unsigned long i = 0; i < BENCH_PACKETS; i++) {
+        encode(dest);
+    }
+    warm = bench_ns_per(start, BENCH_PACKETS);
+    check();
+
+    printf("%-10s %2u byte header: %5lu ns/packet compressed, %5lu ns/packet cached, %lu errors\n",
+           name, want_len - PAYLOAD_LEN, cold, warm, bench_errors);
+}
+
+int main(void)
+{
+    ipv6_addr_t src, dst, prefix;
+    ieee_802154_long_t dest;
+    uint8_t flows = LOWPAN_IPHC_CACHE_SIZE + 2;
+
+    printf("IPHC encoding benchmark, %d contexts, %d cached flows.\n",
+           LOWPAN_CONTEXT_MAX - 1, LOWPAN_IPHC_CACHE_SIZE);
+
+    host_laddr(&iface.laddr, 1);
+    lowpan_iphc_cache_flush();
+
+    /* contexts of other prefixes in front of the one in use */
+    for (uint8_t num = 1; num < LOWPAN_CONTEXT_MAX; num++) {
+        host_addr(&prefix, 0x2001 + num, 0);
+        lowpan_context_update(num, &prefix, 64, 1, 60);
+    }
+
+    host_laddr(&dest, 2);
+    host_addr(&src, 0xfe80, 1);
+    host_addr(&dst, 0xfe80, 2);
+    run("link-local", &src, &dst, &dest);
+
+    host_addr(&src, 0x2001 + LOWPAN_CONTEXT_MAX - 1, 1);
+    host_addr(&dst, 0x2001 + LOWPAN_CONTEXT_MAX - 1, 3);
+    run("context", &src, &dst, &dest);
+
+    host_addr(&dst, 0xabcd, 3);
+    run("inline", &src, &dst, &dest);
+
+    memset(&dst, 0, sizeof(dst));
+    dst.uint8[0] = 0xff;
+    dst.uint8[1] = 0x02;
+    dst.uint8[15] = 0x1a;
+    run("multicast", &src, &dst, &dest);
+
+    /* flows taking turns, more than fit, each checked */
+    bench_reset_errors();
+    host_addr(&src, 0xfe80, 1);
+    for (unsigned long i = 0; i < BENCH_PACKETS / 100; i++) {
+        host_addr(&dst, 0xfe80, 2 + i % flows);
+        set_packet(&src, &dst);
+        encode(&dest);
+        memcpy(want, comp_buf, comp_len);
+        want_len = comp_len;
+        lowpan_iphc_cache_flush();
+        encode(&dest);
+        check();
+    }
+    printf("flows      %d taking turns, %lu errors\n", flows, bench_errors);
+
+    /* a context of the destination prefix appearing and going away */
+    bench_reset_errors();
+    host_addr(&src, 0xfe80, 1);
+    host_addr(&dst, 0xabcd, 3);
+    host_addr(&prefix, 0xabcd, 0);
+    set_packet(&src, &dst);
+    encode(&dest);
+    lowpan_context_update(0, &prefix, 64, 1, 60);
+    encode(&dest);
+    bench_check(comp_buf[1] & LOWPAN_IPHC_DAC);
+    compress_want(&dest);
+    encode(&dest);
+    check();
+    lowpan_context_update(0, &prefix, 64, 1, 0);
+    encode(&dest);
+    bench_check(!(comp_buf[1] & LOWPAN_IPHC_DAC));
+    compress_want(&dest);
+    encode(&dest);
+    check();
+    printf("contexts   changed, %lu errors, %lu hits, %lu misses\n", bench_errors,
+           (unsigned long) lowpan_iphc_cache_statistic.hits,
+           (unsigned long) lowpan_iphc_cache_statistic.misses);
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * 6LoWPAN-ND neighbor cache benchmark
+ *
+ * Registers a host per neighbor cache entry the way a border router sees
+ * them, by link-local address and each with an address registration
+ * option, and times nbr_cache_search() by IPv6 address and
+ * nbr_cache_search_eui64() for registered hosts and for addresses with a
+ * registered IID but another prefix, which are not in the cache. Every
+ * lookup is checked against the entry it should yield. Then a full cache
+ * of tentative entries takes as many new registrations again, evicting
+ * the least recently used, and one more registration into a cache full
+ * of registered hosts has to be refused. Last a short registration
+ * lifetime runs out.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vtimer.h>
+#include <bench.h>
+
+#include "sys/net/sixlowpan/sixlownd.h"
+
+#ifndef BENCH_LOOKUPS
+#define BENCH_LOOKUPS   (100000UL)
+#endif
+
+extern uint16_t nbr_count;
+
+/* EUI-64 of a host, 02:00:00:ff:fe:00:<host> */
+static void host_eui64(ieee_802154_long_t *eui64, uint16_t host) {
+    memset(eui64, 0, sizeof(*eui64));
+    eui64->uint8[0] = 0x02;
+    eui64->uint8[3] = 0xff;
+    eui64->uint8[4] = 0xfe;
+    eui64->uint8[6] = host >> 8;
+    eui64->uint8[7] = host & 0xff;
+}
+
+/* fe80::<IID of the host>, the IID is its EUI-64 with the U/L bit flipped */
+static void host_addr(ipv6_addr_t *addr, uint16_t host) {
+    memset(addr, 0, sizeof(*addr));
+    addr->uint8[0] = 0xfe;
+    addr->uint8[1] = 0x80;
+    host_eui64((ieee_802154_long_t *) &addr->uint8[8], host);
+    addr->uint8[8] ^= 0x02;
+}
+
+static void add(uint16_t host, uint8_t type, uint32_t ltime, uint8_t want) {
+    ipv6_addr_t addr;
+    ieee_802154_long_t eui64;
+
+    host_addr(&addr, host);
+    host_eui64(&eui64, host);
+    bench_check(nbr_cache_add(&addr, &eui64, 0, NBR_STATUS_STALE, type,
+                              ltime, NULL) == want);
+}
+
+static void expect(nbr_cache_t *entry, uint16_t host) {
+    ipv6_addr_t want;
+
+    if (host == 0) {
+        bench_check(entry == NULL);
+        return;
+    }
+    host_addr(&want, host);
+    bench_check(entry != NULL && memcmp(&entry->addr, &want, sizeof(want)) == 0);
+}
+
+static void lookup_hosts(unsigned long i) {
+    ipv6_addr_t addr;
+    uint16_t host = 1 + (i * 37) % NBR_CACHE_SIZE;
+
+    host_addr(&addr, host);
+    nbr_cache_lock();
+    expect(nbr_cache_search(&addr), host);
+    nbr_cache_unlock();
+}
+
+static void lookup_misses(unsigned long i) {
+    ipv6_addr_t addr;
+
+    /* same IID, other prefix */
+    host_addr(&addr, 1 + i % NBR_CACHE_SIZE);
+    addr.uint8[0] = 0x20;
+    addr.uint8[1] = 0x01;
+    nbr_cache_lock();
+    expect(nbr_cache_search(&addr), 0);
+    nbr_cache_unlock();
+}
+
+static void lookup_eui64(unsigned long i) {
+    ieee_802154_long_t eui64;
+    uint16_t host = 1 + (i * 37) % NBR_CACHE_SIZE;
+
+    host_eui64(&eui64, host);
+    nbr_cache_lock();
+    expect(nbr_cache_search_eui64(&eui64), host);
+    nbr_cache_unlock();
+}
+
+int main(void)
+{
+    ipv6_addr_t addr;
+    uint32_t start;
+    unsigned long us;
+
+    printf("Neighbor cache benchmark, %d entries.\n", NBR_CACHE_SIZE);
+
+    nbr_cache_init();
+    start = bench_start();
+    for (uint16_t host = 1; host <= NBR_CACHE_SIZE; host++) {
+        add(host, NBR_CACHE_TYPE_REG, 3600, OPT_ARO_STATE_SUCCESS);
+    }
+    us = bench_elapsed_us(start);
+    printf("register  %d hosts in %lu us, %lu errors\n", NBR_CACHE_SIZE, us,
+           bench_errors);
+
+    bench_run("hosts", "lookups", BENCH_LOOKUPS, lookup_hosts);
+    bench_run("misses", "lookups", BENCH_LOOKUPS, lookup_misses);
+    bench_run("eui64", "lookups", BENCH_LOOKUPS, lookup_eui64);
+
+    /* registered hosts are never evicted */
+    bench_reset_errors();
+    add(NBR_CACHE_SIZE + 1, NBR_CACHE_TYPE_REG, 3600, OPT_ARO_STATE_NBR_CACHE_FULL);
+    printf("full      refused %s\n", bench_errors ? "no" : "yes");
+
+    /* tentative entries make room for registrations, oldest first */
+    nbr_cache_init();
+    for (uint16_t host = 1; host <= NBR_CACHE_SIZE; host++) {
+        add(host, NBR_CACHE_TYPE_TEN, NBR_CACHE_LTIME_TEN, OPT_ARO_STATE_SUCCESS);
+    }
+    host_addr(&addr, 1);
+    nbr_cache_lock();
+    nbr_cache_search(&addr);
+    nbr_cache_unlock();
+    start = bench_start();
+    for (uint16_t host = 1; host < NBR_CACHE_SIZE; host++) {
+        add(NBR_CACHE_SIZE + host, NBR_CACHE_TYPE_REG, 3600, OPT_ARO_STATE_SUCCESS);
+    }
+    us = bench_elapsed_us(start);
+    nbr_cache_lock();
+    expect(nbr_cache_search(&addr), 1);
+    host_addr(&addr, 2);
+    expect(nbr_cache_search(&addr), 0);
+    nbr_cache_unlock();
+    printf("evict     %d tentative entries in %lu us, %lu errors, %d left\n",
+           NBR_CACHE_SIZE - 1, us, bench_errors, nbr_count);
+
+    /* a registration running out */
+    nbr_cache_init();
+    add(1, NBR_CACHE_TYPE_REG, 1, OPT_ARO_STATE_SUCCESS);
+    vtimer_usleep(2 * 1000 * 1000);
+    host_addr(&addr, 1);
+    bench_reset_errors();
+    nbr_cache_lock();
+    expect(nbr_cache_search(&addr), 0);
+    nbr_cache_unlock();
+    printf("expire    %lu errors, %d left\n", bench_errors, nbr_count);
+
+    return 0;
+}
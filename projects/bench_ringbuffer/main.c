@@ -0,0 +1,159 @@
+/*
+ * ringbuffer benchmark
+ *
+ * Streams BENCH_BYTES through a BENCH_RING_SIZE byte ring buffer, the way
+ * a uart interrupt and its reader thread would, once byte by byte, once
+ * with bulk copies and once through peek/commit. Checks the data on the
+ * way out and reports bytes per second for each variant. The ring size is
+ * deliberately no power of two and the chunk sizes vary, so every copy
+ * also exercises the wrap around.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <hwtimer.h>
+#include <ringbuffer.h>
+
+#ifndef BENCH_BYTES
+#define BENCH_BYTES     (4UL * 1024 * 1024)
+#endif
+
+#ifndef BENCH_RING_SIZE
+#define BENCH_RING_SIZE (100)
+#endif
+
+/* largest chunk moved at once, like a uart fifo or a read() */
+#define BENCH_CHUNK     (32)
+
+static char ring_buffer[BENCH_RING_SIZE];
+static ringbuffer_t ring;
+
+static unsigned long errors;
+
+static char pattern(unsigned long i) {
+    return (char) (i ^ (i >> 8));
+}
+
+static unsigned int chunk_size(unsigned long i) {
+    return 1 + (i * 7) % BENCH_CHUNK;
+}
+
+static void check(unsigned long i, char c) {
+    if (c != pattern(i)) {
+        errors++;
+    }
+}
+
+static unsigned long bench_bytewise(void) {
+    unsigned long in = 0, out = 0;
+    int c;
+
+    while (out < BENCH_BYTES) {
+        for (unsigned int n = chunk_size(in); n && (in < BENCH_BYTES); n--) {
+            if (!rb_add_element(&ring, pattern(in))) {
+                break;
+            }
+            in++;
+        }
+        while ((c = rb_get_element(&ring)) != -1) {
+            check(out++, (char) c);
+        }
+    }
+    return out;
+}
+
+static unsigned long bench_bulk(void) {
+    char chunk[BENCH_CHUNK];
+    unsigned long in = 0, out = 0;
+    unsigned int n;
+
+    while (out < BENCH_BYTES) {
+        n = chunk_size(in);
+        if (n > BENCH_BYTES - in) {
+            n = BENCH_BYTES - in;
+        }
+        if (n > rb_free(&ring)) {
+            n = rb_free(&ring);
+        }
+        for (unsigned int i = 0; i < n; i++) {
+            chunk[i] = pattern(in + i);
+        }
+        in += rb_add_elements(&ring, chunk, n);
+
+        n = rb_get_elements(&ring, chunk, sizeof(chunk));
+        for (unsigned int i = 0; i < n; i++) {
+            check(out++, chunk[i]);
+        }
+    }
+    return out;
+}
+
+static unsigned long bench_peek(void) {
+    unsigned long in = 0, out = 0;
+    unsigned int n;
+    char *data;
+
+    while (out < BENCH_BYTES) {
+        /* the writer fills what the region allows, the reader parses in place */
+        n = rb_peek_write(&ring, &data);
+        if (n > chunk_size(in)) {
+            n = chunk_size(in);
+        }
+        if (n > BENCH_BYTES - in) {
+            n = BENCH_BYTES - in;
+        }
+        for (unsigned int i = 0; i < n; i++) {
+            data[i] = pattern(in + i);
+        }
+        rb_commit_write(&ring, n);
+        in += n;
+
+        n = rb_peek_read(&ring, &data);
+        for (unsigned int i = 0; i < n; i++) {
+            check(out++, data[i]);
+        }
+        rb_commit_read(&ring, n);
+    }
+    return out;
+}
+
+static void run(const char *name, unsigned long (*bench)(void)) {
+    uint32_t start, duration;
+    unsigned long bytes, us;
+
+    ringbuffer_init(&ring, ring_buffer, sizeof(ring_buffer));
+    errors = 0;
+
+    start = hwtimer_now();
+    bytes = bench();
+    duration = hwtimer_now() - start;
+
+    us = HWTIMER_TICKS_TO_US(duration);
+    if (us == 0) {
+        us = 1;
+    }
+    printf("%-9s %lu bytes in %lu us: %lu bytes/s, %lu errors\n", name, bytes, us,
+           (unsigned long) ((unsigned long long) bytes * 1000000 / us), errors);
+}
+
+int main(void)
+{
+    char chunk[BENCH_RING_SIZE + 10];
+
+    printf("ringbuffer benchmark, %lu bytes through %d bytes.\n",
+           (unsigned long) BENCH_BYTES, BENCH_RING_SIZE);
+
+    run("bytewise", bench_bytewise);
+    run("bulk", bench_bulk);
+    run("peek", bench_peek);
+
+    /* a full ring keeps its oldest bytes and counts the rest */
+    ringbuffer_init(&ring, ring_buffer, sizeof(ring_buffer));
+    memset(chunk, 'x', sizeof(chunk));
+    int queued = rb_add_elements(&ring, chunk, sizeof(chunk));
+    printf("overflow: queued %d, dropped %u\n", queued, ring.overflows);
+
+    puts("done.");
+    return 0;
+}
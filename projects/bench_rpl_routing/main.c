@@ -0,0 +1,144 @@
+/*
+ * RPL routing table benchmark
+ *
+ * Fills the routing table the way a storing mode root sees it, one host
+ * route per node of the DODAG plus a few prefix routes, and times
+ * rpl_get_next_hop() for destinations that have a host route, that only
+ * match a prefix route and that match nothing at all. Every lookup is
+ * checked against the next hop it should yield. Reports lookups per
+ * second for each case, how long adding all routes took and what the
+ * routing table timer costs with and without a route running out.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vtimer.h>
+#include <bench.h>
+
+#include "sys/net/sixlowpan/rpl/rpl.h"
+
+#ifndef BENCH_LOOKUPS
+#define BENCH_LOOKUPS   (100000UL)
+#endif
+
+/* leave room for the prefix routes */
+#define BENCH_HOSTS     (RPL_MAX_ROUTING_ENTRIES - 4)
+
+/* abcd::ff:fe00:<node>, the address of a node with a short MAC address */
+static void host_addr(ipv6_addr_t *addr, uint16_t node) {
+    memset(addr, 0, sizeof(*addr));
+    addr->uint8[0] = 0xab;
+    addr->uint8[1] = 0xcd;
+    addr->uint8[11] = 0xff;
+    addr->uint8[12] = 0xfe;
+    addr->uint8[14] = node >> 8;
+    addr->uint8[15] = node & 0xff;
+}
+
+/* link local address of the child a route goes through */
+static void next_hop_addr(ipv6_addr_t *addr, uint16_t child) {
+    host_addr(addr, child);
+    addr->uint8[0] = 0xfe;
+    addr->uint8[1] = 0x80;
+}
+
+static void expect(ipv6_addr_t *dest, uint16_t child) {
+    ipv6_addr_t want;
+    ipv6_addr_t *next_hop = rpl_get_next_hop(dest);
+
+    if (child == 0) {
+        bench_check(next_hop == NULL);
+        return;
+    }
+    next_hop_addr(&want, child);
+    bench_check(next_hop != NULL && memcmp(next_hop, &want, sizeof(want)) == 0);
+}
+
+static void fill(void) {
+    ipv6_addr_t addr, next_hop;
+
+    rpl_clear_routing_table();
+    /* each of 8 children of the root forwards to a share of the nodes */
+    for (uint16_t node = 1; node <= BENCH_HOSTS; node++) {
+        host_addr(&addr, node);
+        next_hop_addr(&next_hop, 1 + node % 8);
+        rpl_add_routing_entry(&addr, &next_hop, 60);
+    }
+    /* abcd:0:0:1::/64 behind child 9, inside abcd::/32 behind child 10 */
+    memset(&addr, 0, sizeof(addr));
+    addr.uint8[0] = 0xab;
+    addr.uint8[1] = 0xcd;
+    next_hop_addr(&next_hop, 10);
+    rpl_add_routing_prefix(&addr, 32, &next_hop, 60);
+    addr.uint8[7] = 1;
+    next_hop_addr(&next_hop, 9);
+    rpl_add_routing_prefix(&addr, 64, &next_hop, 60);
+}
+
+static void lookup_hosts(unsigned long i) {
+    ipv6_addr_t dest;
+    uint16_t node = 1 + (i * 37) % BENCH_HOSTS;
+
+    host_addr(&dest, node);
+    expect(&dest, 1 + node % 8);
+}
+
+static void lookup_prefixes(unsigned long i) {
+    ipv6_addr_t dest;
+
+    host_addr(&dest, 1000 + i % 1000);
+    dest.uint8[7] = i & 1;
+    expect(&dest, (i & 1) ? 9 : 10);
+}
+
+static void lookup_misses(unsigned long i) {
+    ipv6_addr_t dest;
+
+    host_addr(&dest, 1 + i % BENCH_HOSTS);
+    dest.uint8[0] = 0x20;
+    dest.uint8[1] = 0x01;
+    expect(&dest, 0);
+}
+
+int main(void)
+{
+    ipv6_addr_t addr;
+    uint32_t start;
+    unsigned long us;
+    int left = 0;
+
+    printf("RPL routing table benchmark, %d host routes and 2 prefix routes.\n",
+           BENCH_HOSTS);
+
+    start = bench_start();
+    fill();
+    us = bench_elapsed_us(start);
+    printf("fill      %d routes in %lu us\n", BENCH_HOSTS + 2, us);
+
+    bench_run("hosts", "lookups", BENCH_LOOKUPS, lookup_hosts);
+    bench_run("prefixes", "lookups", BENCH_LOOKUPS, lookup_prefixes);
+    bench_run("misses", "lookups", BENCH_LOOKUPS, lookup_misses);
+
+    /* the routing table timer's check every second, nothing due */
+    start = bench_start();
+    for (unsigned long i = 0; i < BENCH_LOOKUPS; i++) {
+        rpl_expire_routing_entries();
+    }
+    us = bench_elapsed_us(start);
+    printf("check     %lu expiry checks in %lu us\n", BENCH_LOOKUPS, us);
+
+    /* one route running out takes one pass over the table */
+    host_addr(&addr, 0xffff);
+    rpl_add_routing_entry(&addr, &addr, 1);
+    vtimer_usleep(2 * 1000 * 1000);
+    start = bench_start();
+    rpl_expire_routing_entries();
+    us = bench_elapsed_us(start);
+    for (int i = 0; i < RPL_MAX_ROUTING_ENTRIES; i++) {
+        left += rpl_get_routing_table()[i].used;
+    }
+    printf("expire    1 route in %lu us, %d of %d left\n", us, left, BENCH_HOSTS + 2);
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * vtimer benchmark
+ *
+ * Arms BENCH_TIMERS timers with pseudo random intervals, removes every
+ * other one and waits for the rest to fire. Reports how long vtimer_set()
+ * and vtimer_remove() took, an upper bound for the time they run with
+ * interrupts disabled, and how late the timers fired. Build with
+ * VTIMERSTATISTICS=1 to also get the longest vtimer interrupt and the
+ * number of interrupts, and with BENCH_SLACK_US to see how many of them
+ * a slack saves.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <hwtimer.h>
+#include <msg.h>
+#include <thread.h>
+#include <timex.h>
+#include <vtimer.h>
+
+#ifndef BENCH_TIMERS
+#define BENCH_TIMERS    (1000)
+#endif
+
+/* timers expire between BENCH_MIN_US and BENCH_MIN_US + BENCH_SPREAD_US */
+#define BENCH_MIN_US    (100000)
+#define BENCH_SPREAD_US (2000000)
+
+#ifndef BENCH_SLACK_US
+#define BENCH_SLACK_US  (0)
+#endif
+
+static vtimer_t timers[BENCH_TIMERS];
+static msg_t msg_queue[64];
+
+static uint32_t random_state = 1;
+
+static uint32_t bench_random(void) {
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 8;
+}
+
+static void print_duration(const char *what, int count, uint32_t total, uint32_t max) {
+    printf("%s %d timers: avg %lu us, max %lu us\n", what, count,
+           (unsigned long) HWTIMER_TICKS_TO_US(total / count),
+           (unsigned long) HWTIMER_TICKS_TO_US(max));
+}
+
+int main(void)
+{
+    uint32_t start, duration, total = 0, max = 0;
+    uint32_t late, late_max = 0;
+    int pending = 0;
+    msg_t m;
+
+    printf("vtimer benchmark, %d timers, %d us slack.\n", BENCH_TIMERS, BENCH_SLACK_US);
+    msg_init_queue(msg_queue, sizeof(msg_queue) / sizeof(msg_t));
+
+    for (int i = 0; i < BENCH_TIMERS; i++) {
+        timex_t interval = timex_set(0, BENCH_MIN_US + bench_random() % BENCH_SPREAD_US);
+
+        vtimer_set_slack(&timers[i], BENCH_SLACK_US);
+
+        start = hwtimer_now();
+        vtimer_set_msg(&timers[i], interval, thread_getpid(), (void*) i);
+        duration = hwtimer_now() - start;
+
+        total += duration;
+        if (duration > max) {
+            max = duration;
+        }
+        pending++;
+    }
+    print_duration("set", BENCH_TIMERS, total, max);
+
+    total = max = 0;
+    for (int i = 0; i < BENCH_TIMERS; i += 2) {
+        start = hwtimer_now();
+        vtimer_remove(&timers[i]);
+        duration = hwtimer_now() - start;
+
+        total += duration;
+        if (duration > max) {
+            max = duration;
+        }
+        pending--;
+    }
+    print_duration("removed", (BENCH_TIMERS + 1) / 2, total, max);
+
+    while (pending) {
+        msg_receive(&m);
+        if (m.type != MSG_TIMER) {
+            continue;
+        }
+
+        timex_t now = vtimer_now();
+        vtimer_t *t = &timers[m.content.value];
+        if ((m.content.value & 1) == 0) {
+            printf("removed timer %u fired!\n", m.content.value);
+            continue;
+        }
+
+        late = (now.seconds == t->absolute.seconds) ? now.microseconds - t->absolute.microseconds : 0;
+        if (late > late_max) {
+            late_max = late;
+        }
+        pending--;
+    }
+    printf("all timers fired, latest %lu us late\n", (unsigned long) late_max);
+
+#if VTIMERSTATISTICS
+    printf("vtimer: set %lu, fired %lu, cascaded %lu, irq off max %lu us, interrupt max %lu us\n",
+           (unsigned long) vtimer_statistic.set, (unsigned long) vtimer_statistic.fired,
+           (unsigned long) vtimer_statistic.cascaded, (unsigned long) vtimer_statistic.irq_off_max,
+           (unsigned long) vtimer_statistic.callback_max);
+    printf("vtimer: %lu interrupts, %lu timers coalesced\n",
+           (unsigned long) vtimer_statistic.wakeups, (unsigned long) vtimer_statistic.coalesced);
+#endif
+
+    puts("done.");
+    return 0;
+}
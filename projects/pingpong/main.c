@@ -2,6 +2,7 @@
 #include <thread.h>
 #include <msg.h>
 #include <kernel.h>
+#include <sched.h>
 
 void second_thread(void) {
     printf("second_thread starting.\n");
@@ -31,5 +32,10 @@ int main(void)
                 msg_send(&m, pid, true);
                 msg_receive(&m);
                 printf("Got msg with content %i\n", m.content.value);
+#if SCHEDSTATISTICS
+                if ((m.content.value % 1000) == 0) {
+                    sched_print_latency();
+                }
+#endif
     }
 }
@@ -0,0 +1,141 @@
+/*
+ * RFC 5444 reader benchmark
+ *
+ * Parses the packets of the interop 2010 tests over and over, with a
+ * packet, a message and an address consumer that look at every TLV, and
+ * reports the parse rate. Entries the reader cannot take from its arena
+ * are counted: parsing is expected to get along without the heap.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hwtimer.h>
+
+#include "sys/common/common_types.h"
+#include "sys/common/avl.h"
+#include "sys/common/avl_comp.h"
+#include "sys/net/rfc5444/rfc5444_reader.h"
+#include "test_rfc5444_interop.h"
+
+#ifndef BENCH_ROUNDS
+#define BENCH_ROUNDS    (2000UL)
+#endif
+
+static enum rfc5444_result _tlv_callback(
+    struct rfc5444_reader_tlvblock_consumer *,
+    struct rfc5444_reader_tlvblock_entry *,
+    struct rfc5444_reader_tlvblock_context *context);
+static enum rfc5444_result _block_callback(
+    struct rfc5444_reader_tlvblock_consumer *,
+    struct rfc5444_reader_tlvblock_context *context);
+
+static struct rfc5444_reader_tlvblock_consumer_entry _msg_entries[] = {
+  { .type = 0 },
+  { .type = 1 },
+  { .type = 2 },
+  { .type = 3 },
+  { .type = 7 },
+};
+static struct rfc5444_reader_tlvblock_consumer_entry _addr_entries[] = {
+  { .type = 0 },
+  { .type = 1 },
+  { .type = 2 },
+  { .type = 3 },
+};
+
+static struct rfc5444_reader_tlvblock_consumer _packet_consumer = {
+  .tlv_callback = _tlv_callback,
+};
+static struct rfc5444_reader_tlvblock_consumer _msg_consumer = {
+  .tlv_callback = _tlv_callback,
+  .block_callback = _block_callback,
+};
+static struct rfc5444_reader_tlvblock_consumer _addr_consumer = {
+  .tlv_callback = _tlv_callback,
+  .block_callback = _block_callback,
+};
+static struct rfc5444_reader reader;
+
+static struct avl_tree _test_tree;
+
+static unsigned long tlvs, blocks, heap_entries;
+
+static enum rfc5444_result
+_tlv_callback(struct rfc5444_reader_tlvblock_consumer *consumer __attribute__((unused)),
+    struct rfc5444_reader_tlvblock_entry *entry __attribute__((unused)),
+    struct rfc5444_reader_tlvblock_context *context __attribute__((unused))) {
+  tlvs++;
+  return RFC5444_OKAY;
+}
+
+static enum rfc5444_result
+_block_callback(struct rfc5444_reader_tlvblock_consumer *consumer __attribute__((unused)),
+    struct rfc5444_reader_tlvblock_context *context __attribute__((unused))) {
+  blocks++;
+  return RFC5444_OKAY;
+}
+
+static struct rfc5444_reader_tlvblock_entry *
+_malloc_tlvblock_entries(size_t count) {
+  heap_entries++;
+  return calloc(count, sizeof(struct rfc5444_reader_tlvblock_entry));
+}
+
+static struct rfc5444_reader_addrblock_entry *
+_malloc_addrblock_entry(void) {
+  heap_entries++;
+  return calloc(1, sizeof(struct rfc5444_reader_addrblock_entry));
+}
+
+void
+add_test(struct test_packet *p) {
+  if (_test_tree.comp == NULL) {
+    avl_init(&_test_tree, avl_comp_strcasecmp, false, NULL);
+  }
+
+  p->_node.key = p->test;
+  avl_insert(&_test_tree, &p->_node);
+}
+
+int
+main(int argc __attribute__((unused)), char **argv __attribute__((unused))) {
+  struct test_packet *packet;
+  unsigned long round, packets = 0, bytes = 0, errors = 0, us;
+  unsigned long start;
+
+  hwtimer_init();
+
+  reader.malloc_tlvblock_entries = _malloc_tlvblock_entries;
+  reader.malloc_addrblock_entry = _malloc_addrblock_entry;
+  rfc5444_reader_init(&reader);
+  rfc5444_reader_add_packet_consumer(&reader, &_packet_consumer, NULL, 0, 0);
+  rfc5444_reader_add_defaultmsg_consumer(&reader, &_msg_consumer,
+      _msg_entries, ARRAYSIZE(_msg_entries), 0);
+  rfc5444_reader_add_defaultaddress_consumer(&reader, &_addr_consumer,
+      _addr_entries, ARRAYSIZE(_addr_entries), 0);
+
+  printf("RFC 5444 reader benchmark, %u byte arena.\n", RFC5444_READER_ARENA_SIZE);
+
+  start = hwtimer_now();
+  for (round = 0; round < BENCH_ROUNDS; round++) {
+    avl_for_each_element(&_test_tree, packet, _node) {
+      if (rfc5444_reader_handle_packet(&reader, packet->binary, packet->binlen) != RFC5444_OKAY) {
+        errors++;
+      }
+      packets++;
+      bytes += packet->binlen;
+    }
+  }
+  us = HWTIMER_TICKS_TO_US(hwtimer_now() - start);
+
+  printf("%lu packets (%lu bytes) in %lu us: %lu ns/packet, %lu packets/s\n",
+      packets, bytes, us, (unsigned long)((unsigned long long)us * 1000 / packets),
+      (unsigned long)((unsigned long long)packets * 1000000 / (us ? us : 1)));
+  printf("%lu TLVs, %lu blocks, %lu errors, %lu entries from the heap\n",
+      tlvs, blocks, errors, heap_entries);
+
+  rfc5444_reader_cleanup(&reader);
+  return 0;
+}
@@ -0,0 +1,229 @@
+/*
+ * RFC 5444 writer test for referenced address tlv values
+ *
+ * The writer has no addrtlv buffer, all address tlv values are referenced.
+ * The packet has a sequence number and a packet tlv that uses less space
+ * than allocated, so the header has to be written in front of the tlvs
+ * the packet is sent from.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "sys/net/rfc5444/rfc5444_context.h"
+#include "sys/net/rfc5444/rfc5444_writer.h"
+#include "cunit.h"
+
+#define MSG_TYPE 1
+
+static void write_packet(struct rfc5444_writer *,
+    struct rfc5444_writer_interface *, void *, size_t);
+static void addPacketHeader(struct rfc5444_writer *,
+    struct rfc5444_writer_interface *);
+static void addPacketTLVs(struct rfc5444_writer *,
+    struct rfc5444_writer_interface *);
+static void finishPacketTLVs(struct rfc5444_writer *,
+    struct rfc5444_writer_interface *);
+static void addAddresses(struct rfc5444_writer *wr,
+    struct rfc5444_writer_content_provider *provider);
+static struct rfc5444_writer_address *_malloc_address_entry(void);
+static struct rfc5444_writer_addrtlv *_malloc_addrtlv_entry(void);
+
+static uint8_t msg_buffer[128];
+
+static struct rfc5444_writer writer = {
+  .msg_buffer = msg_buffer,
+  .msg_size = sizeof(msg_buffer),
+  .malloc_address_entry = _malloc_address_entry,
+  .malloc_addrtlv_entry = _malloc_addrtlv_entry,
+};
+
+static struct rfc5444_writer_pkthandler pkthandler = {
+  .addPacketTLVs = addPacketTLVs,
+  .finishPacketTLVs = finishPacketTLVs,
+};
+
+static struct rfc5444_writer_content_provider cpr = {
+  .msg_type = MSG_TYPE,
+  .addAddresses = addAddresses,
+};
+
+static struct rfc5444_writer_addrtlv_block addrtlvs[] = {
+  { .type = 3 },
+};
+
+static uint8_t packet_buffer_if[128];
+static struct rfc5444_writer_interface interface = {
+  .packet_buffer = packet_buffer_if,
+  .packet_size = sizeof(packet_buffer_if),
+  .addPacketHeader = addPacketHeader,
+  .sendPacket = write_packet,
+};
+
+static uint8_t pkttlv_value[] = { 0xaa, 0xbb };
+static uint8_t addrtlv_value[] = { 0x11, 0x22 };
+
+static uint8_t result[] = {
+/* packet header with sequence number and tlvblock */
+    0x0c, 0x12, 0x34,
+/* tlvblock, tlv type 1 with value */
+    0, 5, 1, 0x10, 2, 0xaa, 0xbb,
+/* message header, type 1, addrlen 4 */
+    1, 0x03, 0, 22,
+/* empty message tlvblock */
+    0, 0,
+/* addressblock 10.0.0.1-3 */
+    3, 0x80, 3, 10, 0, 0, 1, 2, 3,
+/* address tlvblock, tlv type 3 with the same value for all addresses */
+    0, 5, 3, 0x10, 2, 0x11, 0x22,
+};
+
+static int tlvcount, packets, heap_entries;
+static enum rfc5444_result addrtlv_result;
+static bool copy_value, in_packet_buffer;
+static uint8_t sent[128];
+static size_t sent_length;
+
+static void addPacketHeader(struct rfc5444_writer *wr,
+    struct rfc5444_writer_interface *iface) {
+  rfc5444_writer_set_pkt_header(wr, iface, true);
+  rfc5444_writer_set_pkt_seqno(wr, iface, 0x1234);
+}
+
+static void addPacketTLVs(struct rfc5444_writer *wr,
+    struct rfc5444_writer_interface *iface) {
+  rfc5444_writer_allocate_packettlv(wr, iface, false, 4);
+}
+
+static void finishPacketTLVs(struct rfc5444_writer *wr,
+    struct rfc5444_writer_interface *iface) {
+  rfc5444_writer_set_packettlv(wr, iface, 1, 0, pkttlv_value, sizeof(pkttlv_value));
+}
+
+static void addMessageHeader(struct rfc5444_writer *wr, struct rfc5444_writer_message *msg) {
+  rfc5444_writer_set_msg_header(wr, msg, false, false, false, false);
+}
+
+static void addAddresses(struct rfc5444_writer *wr,
+    struct rfc5444_writer_content_provider *provider) {
+  uint8_t ip[4] = { 10, 0, 0, 0 };
+  struct rfc5444_writer_address *addr;
+  int i;
+
+  for (i=0; i<tlvcount; i++) {
+    ip[3] = i+1;
+
+    addr = rfc5444_writer_add_address(wr, provider->creator, ip, 32, false);
+    if (copy_value) {
+      addrtlv_result = rfc5444_writer_add_addrtlv(wr, addr, addrtlvs[0]._tlvtype,
+          addrtlv_value, sizeof(addrtlv_value), false);
+    }
+    else {
+      addrtlv_result = rfc5444_writer_add_addrtlv_ref(wr, addr, addrtlvs[0]._tlvtype,
+          addrtlv_value, sizeof(addrtlv_value), false);
+    }
+  }
+}
+
+static void write_packet(struct rfc5444_writer *w __attribute__ ((unused)),
+    struct rfc5444_writer_interface *iface __attribute__ ((unused)),
+    void *buffer, size_t length) {
+  size_t i, j;
+  uint8_t *buf = buffer;
+
+  /* the writer cleans the packet buffer after sending */
+  packets++;
+  in_packet_buffer = buf >= packet_buffer_if && buf + length <= packet_buffer_if + sizeof(packet_buffer_if);
+  sent_length = length < sizeof(sent) ? length : sizeof(sent);
+  memcpy(sent, buffer, sent_length);
+
+  for (j=0; j<length; j+=32) {
+    printf("%04zx:", j);
+
+    for (i=j; i<length && i < j+31; i++) {
+      printf("%s%02x", ((i&3) == 0) ? " " : "", (int)(buf[i]));
+    }
+    printf("\n");
+  }
+  printf("\n");
+}
+
+static struct rfc5444_writer_address *
+_malloc_address_entry(void) {
+  heap_entries++;
+  return calloc(1, sizeof(struct rfc5444_writer_address));
+}
+
+static struct rfc5444_writer_addrtlv *
+_malloc_addrtlv_entry(void) {
+  heap_entries++;
+  return calloc(1, sizeof(struct rfc5444_writer_addrtlv));
+}
+
+static void clear_elements(void) {
+  tlvcount = 0;
+  packets = 0;
+  heap_entries = 0;
+  addrtlv_result = RFC5444_OKAY;
+  copy_value = false;
+  in_packet_buffer = false;
+  sent_length = 0;
+}
+
+static void test_reference_3(void) {
+  START_TEST();
+
+  tlvcount = 3;
+
+  CHECK_TRUE(0 == rfc5444_writer_create_message_allif(&writer, 1), "Parser should return 0");
+  rfc5444_writer_flush(&writer, &interface, false);
+
+  CHECK_TRUE(addrtlv_result == RFC5444_OKAY, "addrtlv result: %d\n", addrtlv_result);
+  CHECK_TRUE(packets == 1, "bad number of packets: %d\n", packets);
+  CHECK_TRUE(heap_entries == 0, "entries from the heap: %d\n", heap_entries);
+  CHECK_TRUE(in_packet_buffer, "packet not sent from the packet buffer");
+  CHECK_TRUE(sent_length == sizeof(result), "bad packet length: %zu\n", sent_length);
+  CHECK_TRUE(sent_length == sizeof(result) && memcmp(sent, result, sizeof(result)) == 0,
+      "bad packet content");
+
+  END_TEST();
+}
+
+static void test_copy_without_buffer(void) {
+  START_TEST();
+
+  tlvcount = 1;
+  copy_value = true;
+
+  rfc5444_writer_create_message_allif(&writer, 1);
+
+  CHECK_TRUE(addrtlv_result == RFC5444_OUT_OF_ADDRTLV_MEM, "addrtlv result: %d\n", addrtlv_result);
+  CHECK_TRUE(heap_entries == 0, "entries from the heap: %d\n", heap_entries);
+
+  END_TEST();
+}
+
+int main(int argc __attribute__ ((unused)), char **argv __attribute__ ((unused))) {
+  struct rfc5444_writer_message *msg;
+
+  rfc5444_writer_init(&writer);
+
+  rfc5444_writer_register_interface(&writer, &interface);
+  rfc5444_writer_register_pkthandler(&writer, &pkthandler);
+
+  msg = rfc5444_writer_register_message(&writer, MSG_TYPE, false, 4);
+  msg->addMessageHeader = addMessageHeader;
+
+  rfc5444_writer_register_msgcontentprovider(&writer, &cpr, addrtlvs, ARRAYSIZE(addrtlvs));
+
+  BEGIN_TESTING(clear_elements);
+
+  test_reference_3();
+  test_copy_without_buffer();
+
+  rfc5444_writer_cleanup(&writer);
+
+  return FINISH_TESTING();
+}
@@ -48,7 +48,7 @@ void init(char *str){
                 printf("ERROR: radio_address not an 8 bit integer\n");
                 return;
             }
-            sixlowpan_init(TRANSCEIVER_CC1100,r_addr,0);
+            sixlowpan_init(TRANSCEIVER_DEFAULT,r_addr,0);
             break;
         case 'r':
             printf("INFO: Initialize as router on radio address %hu\n", r_addr);
@@ -56,7 +56,7 @@ void init(char *str){
                 printf("ERROR: radio_address not an 8 bit integer\n");
                 return;
             }
-            sixlowpan_init(TRANSCEIVER_CC1100, r_addr,0);
+            sixlowpan_init(TRANSCEIVER_DEFAULT, r_addr,0);
             ipv6_init_iface_as_router();
             break;
         case 'a':
@@ -65,7 +65,7 @@ void init(char *str){
                 printf("ERROR: radio_address not an 8 bit integer\n");
                 return;
             }
-            sixlowpan_adhoc_init(TRANSCEIVER_CC1100, &std_addr, r_addr);
+            sixlowpan_adhoc_init(TRANSCEIVER_DEFAULT, &std_addr, r_addr);
             break;
         case 'b':
             printf("INFO: Initialize as border router on radio address %hu\n", r_addr);
@@ -73,7 +73,7 @@ void init(char *str){
                 printf("ERROR: radio_address not an 8 bit integer\n");
                 return;
             }
-            res = border_initialize(TRANSCEIVER_CC1100, &std_addr);
+            res = border_initialize(TRANSCEIVER_DEFAULT, &std_addr);
             switch (res) {
                 case (SUCCESS): printf("INFO: Border router initialized.\n"); break;
                 case (SIXLOWERROR_ADDRESS): printf("ERROR: Illegal IP address: "); 
@@ -57,7 +57,7 @@ void init(char *str){
                 printf("ERROR: address not an 8 bit integer\n");
                 return;
             }
-			state = rpl_init(TRANSCEIVER_CC1100, r_addr);
+			state = rpl_init(TRANSCEIVER_DEFAULT, r_addr);
 			if(state != SUCCESS){
 				printf("Error initializing RPL\n");
 			}
@@ -69,7 +69,7 @@ void init(char *str){
                 printf("ERROR: address not an 8 bit integer\n");
                 return;
             }
-            state = rpl_init(TRANSCEIVER_CC1100, r_addr);
+            state = rpl_init(TRANSCEIVER_DEFAULT, r_addr);
             if(state != SUCCESS){
                 printf("Error initializing RPL\n");
             }
@@ -80,7 +80,7 @@ void init(char *str){
     }
 
     /* set channel to 10 */
-    tcmd.transceivers = TRANSCEIVER_CC1100;
+    tcmd.transceivers = TRANSCEIVER_DEFAULT;
     tcmd.data = &chan;
     m.type = SET_CHANNEL;
     m.content.ptr = (void*) &tcmd;
@@ -91,6 +91,12 @@ void init(char *str){
     thread_create(tr_wd_stack, TR_WD_STACKSIZE, PRIORITY_MAIN-3, CREATE_STACKTEST, wakeup_thread, "TX/RX WD");
 
  }
+static uint32_t now_seconds(void){
+	timex_t now = vtimer_now();
+	timex_normalize(&now);
+	return now.seconds;
+}
+
 void loop(char *str){
 	rpl_routing_entry_t * rtable;
 	while(1){
@@ -112,7 +118,7 @@ void loop(char *str){
 				ipv6_print_addr(&rtable[i].address);
 				puts("next hop");
 				ipv6_print_addr(&rtable[i].next_hop);
-				printf("entry %d lifetime %d\n",i,rtable[i].lifetime);
+				printf("entry %d prefix length %d lifetime %lu\n",i,rtable[i].prefix_len,(unsigned long)(rtable[i].expires - now_seconds()));
 				if(!rpl_equal_id(&rtable[i].address, &rtable[i].next_hop)){
 					puts("multi-hop");
 				}
@@ -135,7 +141,7 @@ void table(char *str){
 	for(int i=0;i<RPL_MAX_ROUTING_ENTRIES;i++){
 		if(rtable[i].used){
 			ipv6_print_addr(&rtable[i].address);
-			printf("entry %d lifetime %d\n",i,rtable[i].lifetime);
+			printf("entry %d prefix length %d lifetime %lu\n",i,rtable[i].prefix_len,(unsigned long)(rtable[i].expires - now_seconds()));
 			if(!rpl_equal_id(&rtable[i].address, &rtable[i].next_hop)){
 				puts("multi-hop");
 			}
@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <mutex.h>
+
+#include <thread.h>
+#include <flags.h>
+#include <kernel.h>
+#include <sched.h>
+
+static mutex_t mutex;
+
+static void low_thread(void) {
+    mutex_lock_recursive(&mutex);
+    mutex_lock_recursive(&mutex);
+    puts(" low: locked mutex twice, sleeping.");
+    thread_sleep();
+    puts(" low: woke up.");
+    mutex_unlock_recursive(&mutex, 0);
+    puts(" low: unlocked once.");
+    mutex_unlock_recursive(&mutex, 0);
+    if (active_thread->priority == active_thread->base_priority) {
+        puts(" low: unlocked, back at own priority.");
+    }
+}
+
+static void medium_thread(void) {
+    puts(" medium: running.");
+}
+
+static void high_thread(void) {
+    puts(" high: locking mutex...");
+    mutex_lock(&mutex);
+    puts(" high: got mutex.");
+    mutex_unlock(&mutex, 0);
+}
+
+static char low_stack[KERNEL_CONF_STACKSIZE_MAIN];
+static char medium_stack[KERNEL_CONF_STACKSIZE_MAIN];
+static char high_stack[KERNEL_CONF_STACKSIZE_MAIN];
+
+void mutex_inherit(char* cmdline)
+{
+    mutex_init(&mutex);
+
+    int low = thread_create(low_stack, KERNEL_CONF_STACKSIZE_MAIN, PRIORITY_MAIN-1, CREATE_STACKTEST, low_thread, "low");
+    thread_create(high_stack, KERNEL_CONF_STACKSIZE_MAIN, PRIORITY_MAIN-3, CREATE_STACKTEST, high_thread, "high");
+
+    if (sched_threads[low]->priority == PRIORITY_MAIN-3) {
+        puts("main: low inherited priority of high.");
+    }
+
+    /* without inheritance, medium would run before low */
+    thread_create(medium_stack, KERNEL_CONF_STACKSIZE_MAIN, PRIORITY_MAIN-2, CREATE_STACKTEST | CREATE_WOUT_YIELD, medium_thread, "medium");
+    thread_wakeup(low);
+
+    puts("main: done.");
+}
@@ -29,12 +29,14 @@ void shell_putchar(int c) {
 }
 
 void mutex_trylock_fail(char* cmdline);
+void mutex_inherit(char* cmdline);
 void test_thread_sleep(char* line);
 
 const shell_command_t shell_commands[] = {
     {"start_test", "", print_teststart},
     {"end_test", "", print_testend},
     {"mutex_trylock_fail", "", mutex_trylock_fail},
+    {"mutex_inherit", "", mutex_inherit},
     {"thread_sleep", "", test_thread_sleep},
     {NULL, NULL, NULL}
 };
@@ -2,6 +2,7 @@
 #include <thread.h>
 #include <flags.h>
 #include <kernel.h>
+#include <sched.h>
 
 #define STACK_SIZE  (8192)
 
@@ -15,4 +16,7 @@ int main(void)
 {
     (void) thread_create(t2_stack, STACK_SIZE, PRIORITY_MAIN-1, CREATE_WOUT_YIELD | CREATE_STACKTEST, second_thread, "nr2");
     puts("first thread\n");
+#if SCHEDSTATISTICS
+    sched_print_latency();
+#endif
 }
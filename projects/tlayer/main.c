@@ -36,6 +36,7 @@
 #define RECV_FROM_TCP_THREAD_STACK_SIZE2	512
 #define UDP_APP_STACK_SIZE					3072
 #define TCP_APP_STACK_SIZE					3072
+#define TCP_TPUT_CHUNK_SIZE					(4 * TCP_MAX_CWND)
 
 uint8_t udp_server_thread_pid;
 char udp_server_stack_buffer[UDP_APP_STACK_SIZE];
@@ -70,9 +71,13 @@ typedef struct tcp_msg_t
 	{
 	int		 	node_number;
 	char		tcp_string_msg[80];
+	uint32_t	bulk_bytes;
 	}tcp_message_t;
 tcp_message_t current_message;
 
+// Payload of the throughput test, handed to send() in chunks of several windows
+static uint8_t tcp_tput_buffer[TCP_TPUT_CHUNK_SIZE];
+
 void recv_from_tcp_thread1 (void);
 void recv_from_tcp_thread2 (void);
 
@@ -251,7 +256,21 @@ void send_tcp_thread (void)
 			{
 			tcp_socket_id = recv_socket_id1;
 			}
-		if (send(tcp_socket_id, (void*) current_message.tcp_string_msg, strlen(current_message.tcp_string_msg)+1, 0) < 0)
+		if (current_message.bulk_bytes > 0)
+			{
+			while (current_message.bulk_bytes > 0)
+				{
+				uint32_t chunk = (current_message.bulk_bytes > TCP_TPUT_CHUNK_SIZE) ? TCP_TPUT_CHUNK_SIZE : current_message.bulk_bytes;
+				if (send(tcp_socket_id, (void*) tcp_tput_buffer, chunk, 0) < 0)
+					{
+					printf("Could not send, %lu bytes left!\n", current_message.bulk_bytes);
+					break;
+					}
+				current_message.bulk_bytes -= chunk;
+				}
+			current_message.bulk_bytes = 0;
+			}
+		else if (send(tcp_socket_id, (void*) current_message.tcp_string_msg, strlen(current_message.tcp_string_msg)+1, 0) < 0)
 			{
 			printf("Could not send %s!\n", current_message.tcp_string_msg);
 			}
@@ -316,6 +335,36 @@ void send_tcp_bandwidth_test(char *str)
 	printf("Time: %f seconds, Bandwidth: %f byte/second\n", secs, (count*48)/secs);
 	}
 
+void send_tcp_throughput_test(char *str)
+	{
+	msg_t send_msg, recv_msg;
+	timex_t start, total;
+	tcp_statistic_t before;
+	uint32_t bytes = 0, i;
+	double secs;
+
+	sscanf(str, "tcp_tput %lu", &bytes);
+	for (i = 0; i < TCP_TPUT_CHUNK_SIZE; i++)
+		{
+		tcp_tput_buffer[i] = 'a' + (i % 26);
+		}
+	memcpy(&before, &tcp_statistic, sizeof(tcp_statistic_t));
+
+	start = vtimer_now();
+	current_message.bulk_bytes = bytes;
+	send_msg.content.value = 1;
+	msg_send_receive(&send_msg, &recv_msg, tcp_send_pid);
+	total = timex_sub(vtimer_now(), start);
+
+	secs = total.microseconds / 1000000.0f;
+	printf("Sent %lu bytes in %f seconds, Throughput: %f byte/second\n", bytes, secs, bytes/secs);
+	printf("Segments: %lu, Retransmits: %lu, Fast retransmits: %lu, Dup ACKs: %lu\n",
+			tcp_statistic.segments_sent - before.segments_sent,
+			tcp_statistic.retransmits - before.retransmits,
+			tcp_statistic.fast_retransmits - before.fast_retransmits,
+			tcp_statistic.dup_acks - before.dup_acks);
+	}
+
 void connect_tcp(char *str)
 	{
 	msg_t send_msg;
@@ -667,6 +716,8 @@ const shell_command_t shell_commands[] = {
     {"continue_process", "", continue_process},
     {"close_tcp", "", close_tcp},
     {"tcp_bw", "tcp_bw NO_OF_PACKETS", send_tcp_bandwidth_test},
+    {"tcp_tput", "tcp_tput NO_OF_BYTES", send_tcp_throughput_test},
+
     {"boots", "", boot_server},
     {"bootc", "", boot_client},
     {"print_nbr_cache", "", show_nbr_cache},
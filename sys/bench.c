@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <hwtimer.h>
+#include <bench.h>
+
+unsigned long bench_errors;
+
+uint32_t bench_start(void) {
+    bench_reset_errors();
+    return hwtimer_now();
+}
+
+void bench_reset_errors(void) {
+    bench_errors = 0;
+}
+
+unsigned long bench_elapsed_us(uint32_t start) {
+    unsigned long us = HWTIMER_TICKS_TO_US(hwtimer_now() - start);
+    return us ? us : 1;
+}
+
+unsigned long bench_ns_per(uint32_t start, unsigned long count) {
+    /* a few seconds in ns already overflow 32 bits */
+    return (unsigned long) ((uint64_t) bench_elapsed_us(start) * 1000 / count);
+}
+
+void bench_check(int ok) {
+    if (!ok) {
+        bench_errors++;
+    }
+}
+
+void bench_run(const char *name, const char *unit, unsigned long count,
+               void (*op)(unsigned long)) {
+    uint32_t start;
+    unsigned long us;
+
+    start = bench_start();
+    for (unsigned long i = 0; i < count; i++) {
+        op(i);
+    }
+    us = bench_elapsed_us(start);
+    printf("%-9s %lu %s in %lu us: %lu %s/s, %lu errors\n", name, count, unit,
+           us, (unsigned long) ((uint64_t) count * 1000000 / us), unit,
+           bench_errors);
+}
@@ -5,7 +5,6 @@
 
 #include <stdio.h>
 #include <errno.h>
-#include <irq.h>
 #include <posix_io.h>
 
 //#define ENABLE_DEBUG
@@ -71,9 +70,9 @@ void chardev_loop(ringbuffer_t *rb) {
             }
         }
 
-        if (rb->avail && (r != NULL)) {
-            int state = disableIRQ();
-            int nbytes = min(r->nbytes, rb->avail);
+        if (rb_avail(rb) && (r != NULL)) {
+            /* the ringbuffer is safe against the writing interrupt */
+            int nbytes = min(r->nbytes, rb_avail(rb));
             DEBUG("uart0_thread [%i]: sending %i bytes received from %i to pid %i\n", pid, nbytes, m.sender_pid, reader_pid);
             rb_get_elements(rb, r->buffer, nbytes);
             r->nbytes = nbytes;
@@ -85,7 +84,6 @@ void chardev_loop(ringbuffer_t *rb) {
             msg_reply(&m, &m);
 
             r = NULL;
-            restoreIRQ(state);
         }
     }
 }
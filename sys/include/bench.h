@@ -0,0 +1,50 @@
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include <stdint.h>
+
+/**
+ * @brief Checks failed since the last bench_start() or bench_reset_errors().
+ */
+extern unsigned long bench_errors;
+
+/**
+ * @brief Starts a measurement and clears the error count.
+ *
+ * @return hwtimer ticks to pass to bench_elapsed_us() or bench_ns_per()
+ */
+uint32_t bench_start(void);
+
+/**
+ * @brief Clears the error count for checks that are not timed.
+ */
+void bench_reset_errors(void);
+
+/**
+ * @brief Microseconds since start, at least 1 so rates can be divided by it.
+ */
+unsigned long bench_elapsed_us(uint32_t start);
+
+/**
+ * @brief Nanoseconds each of count operations took since start.
+ */
+unsigned long bench_ns_per(uint32_t start, unsigned long count);
+
+/**
+ * @brief Counts an error unless ok.
+ */
+void bench_check(int ok);
+
+/**
+ * @brief Times count calls of op, which checks its own results, and prints
+ *        the rate and the number of failed checks.
+ *
+ * @param name  name of the case, printed first
+ * @param unit  what a call of op does, e.g. "lookups"
+ * @param count calls of op, each gets its number from 0 to count - 1
+ * @param op    the operation
+ */
+void bench_run(const char *name, const char *unit, unsigned long count,
+               void (*op)(unsigned long));
+
+#endif /* __BENCH_H */
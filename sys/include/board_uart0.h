@@ -5,9 +5,17 @@ extern int uart0_handler_pid;
 
 void board_uart0_init(void);
 void uart0_handle_incoming(int c);
+void uart0_handle_incoming_buf(const char *buf, int n);
 void uart0_notify_thread(void);
 
 int uart0_readc(void);
+
+/**
+ * @brief   Read up to n bytes, blocks until at least one is available
+ *
+ * @return number of bytes read
+ */
+int uart0_read(char *buf, int n);
 void uart0_putc(int c);
 
 #endif /* __BOARD_UART0_H */
@@ -2,6 +2,7 @@
 #define TRANSCEIVER_H 
 
 #include <radio/types.h>
+#include <cpu-conf.h>
 
 /* Stack size for transceiver thread */
 #ifdef ENABLE_DEBUG
@@ -19,6 +20,9 @@
  * of two */
 #define TRANSCEIVER_MSG_BUFFER_SIZE     (32)
 
+/* Senders kept waiting while the driver's TX queue is full */
+#define TRANSCEIVER_TX_WAITING_SIZE     (4)
+
 /**
  * @brief Message types for transceiver interface
  */
@@ -26,6 +30,8 @@ enum transceiver_msg_type_t {
     /* Message types for driver <-> transceiver communication */
     RCV_PKT_CC1020,        ///< packet was received by CC1020 transceiver
     RCV_PKT_CC1100,        ///< packet was received by CC1100 transceiver
+    RCV_PKT_NATIVE,        ///< packet was received by native virtual radio
+    SND_PKT_DONE,          ///< driver finished sending a queued packet
 
     /* Message types for transceiver <-> upper layer communication */
     PKT_PENDING,    ///< packet pending in transceiver buffer
@@ -52,9 +58,17 @@ enum transceiver_msg_type_t {
 typedef enum {
     TRANSCEIVER_NONE,       ///< Invalid
     TRANSCEIVER_CC1100,     ///< CC110X transceivers
-    TRANSCEIVER_CC1020      ///< CC1020 transceivers
+    TRANSCEIVER_CC1020,     ///< CC1020 transceivers
+    TRANSCEIVER_NATIVE = 4  ///< virtual radio of native nodes
 } transceiver_type_t;
 
+/**
+ * @brief The transceiver of the platform, overridden in cpu-conf.h
+ */
+#ifndef TRANSCEIVER_DEFAULT
+#define TRANSCEIVER_DEFAULT TRANSCEIVER_CC1100
+#endif
+
 /**
  * @brief Manage registered threads per transceiver
  */
@@ -9,6 +9,18 @@
  *
  * (As of now, not resetting, restarting, removing and checking are not implemented)
  *
+ * Timers due within the current long term tick (SECONDS_PER_TICK seconds)
+ * are kept in a hierarchical timer wheel of VTIMER_WHEEL_LEVELS levels with
+ * 2^VTIMER_WHEEL_BITS slots each, timers further away in one of
+ * VTIMER_LONGTERM_SLOTS buckets hashed by their tick. Setting and removing a
+ * timer is O(1), the earliest timer is found with one bitmap lookup per
+ * level. Timers are moved to lower levels when their slot comes up, so each
+ * timer is touched at most VTIMER_WHEEL_LEVELS times before it fires.
+ *
+ * A timer given a slack with vtimer_set_slack() may fire up to that many
+ * microseconds late. Its expiry is rounded to the roundest time within the
+ * slack, so timers due around the same time fire in a single interrupt.
+ *
  * @{
  */
 
@@ -19,20 +31,36 @@
 #ifndef __VTIMER_H
 #define __VTIMER_H 
 
-#include <queue.h>
 #include <timex.h>
 
 #define MSG_TIMER 12345
 
+/** Bits of the microsecond timestamp resolved per wheel level */
+#ifndef VTIMER_WHEEL_BITS
+#define VTIMER_WHEEL_BITS       (4)
+#endif
+#define VTIMER_WHEEL_SLOTS      (1 << VTIMER_WHEEL_BITS)
+#define VTIMER_WHEEL_LEVELS     ((32 + VTIMER_WHEEL_BITS - 1) / VTIMER_WHEEL_BITS)
+
+/** Number of buckets for timers beyond the current long term tick */
+#ifndef VTIMER_LONGTERM_SLOTS
+#define VTIMER_LONGTERM_SLOTS   (8)
+#endif
+
 /**
  * A vtimer object.
  *
  * This structure is used for declaring a vtimer. This should not be used by programmers, use the vtimer_set_*-functions instead.
+ * A vtimer has to be zeroed before it is set for the first time, which
+ * static ones are.
  *
  * \hideinitializer
  */
 typedef struct vtimer_t {
-    queue_node_t queue_entry;
+    struct vtimer_t *next;
+    struct vtimer_t *prev;
+    uint16_t slot;              ///< wheel or long term slot + 1, 0 if not set
+    uint32_t slack;             ///< microseconds the timer may fire late
     timex_t absolute;
     void(*action)(void*);
     void* arg;
@@ -84,6 +112,16 @@ int vtimer_set_msg(vtimer_t *t, timex_t interval, unsigned int pid, void *ptr);
  */
 int vtimer_set_wakeup(vtimer_t *t, timex_t interval, int pid);
 
+/**
+ * @brief   allow a vtimer to fire late so it can share an interrupt with others
+ *
+ * Takes effect the next time the timer is set and stays until changed.
+ *
+ * @param[in]   t           pointer to preinitialised vtimer_t
+ * @param[in]   slack       microseconds the timer may fire late, 0 for none
+ */
+void vtimer_set_slack(vtimer_t *t, uint32_t slack);
+
 /**
  * @brief   remove a vtimer
  * @param[in]   t           pointer to preinitialised vtimer_t
@@ -91,4 +129,18 @@ int vtimer_set_wakeup(vtimer_t *t, timex_t interval, int pid);
  */
 int vtimer_remove(vtimer_t *t);
 
+#if VTIMERSTATISTICS
+typedef struct {
+    uint32_t set;               ///< timers set
+    uint32_t fired;             ///< timers fired
+    uint32_t wakeups;           ///< vtimer interrupts
+    uint32_t coalesced;         ///< timers fired by an interrupt that already fired one
+    uint32_t cascaded;          ///< timers moved to a lower wheel level
+    uint32_t irq_off_max;       ///< longest interrupt lock in vtimer_set() and vtimer_remove() (us)
+    uint32_t callback_max;      ///< longest vtimer interrupt (us)
+} vtimer_statistic_t;
+
+extern vtimer_statistic_t vtimer_statistic;
+#endif
+
 #endif /* __VTIMER_H */
@@ -1,6 +1,4 @@
-#include <stdio.h>
 #include <stdint.h>
-#include <malloc.h>
 #include <string.h>
 
 #include "ringbuffer.h"
@@ -8,102 +6,132 @@
 //#define DEBUG(...) printf (__VA_ARGS__)
 #define DEBUG(...)
 
+/* keeps the compiler from moving buffer accesses across an index update,
+ * enough on the single core targets where the other side is an interrupt */
+#define RB_BARRIER()    __asm__ __volatile__("" ::: "memory")
+
+/* position in buf of a free running index */
+static inline unsigned int rb_pos(ringbuffer_t *rb, unsigned int index) {
+    return (index < rb->size) ? index : index - rb->size;
+}
+
+static inline unsigned int rb_advance(ringbuffer_t *rb, unsigned int index, unsigned int n) {
+    index += n;
+    if (index >= 2 * rb->size) index -= 2 * rb->size;
+    return index;
+}
+
+static inline unsigned int rb_fill(ringbuffer_t *rb, unsigned int read, unsigned int write) {
+    return (write >= read) ? write - read : write + 2 * rb->size - read;
+}
+
 void ringbuffer_init(ringbuffer_t *rb, char* buffer, unsigned int bufsize) {
     rb->buf = buffer;
-    rb->start = 0;
-    rb->end = 0;
     rb->size = bufsize;
-    rb->avail = 0;
+    rb->read = 0;
+    rb->write = 0;
+    rb->overflows = 0;
 }
 
-void rb_add_elements(ringbuffer_t* rb, char *buf, int n) {
-    for (int i = 0; i < n; i++) {
-        rb_add_element(rb, buf[i]);
-    }
+unsigned int rb_avail(ringbuffer_t *rb) {
+    return rb_fill(rb, rb->read, rb->write);
 }
 
-void rb_add_element(ringbuffer_t* rb, char c) {
-    if (rb->avail == rb->size) rb_get_element(rb);
+unsigned int rb_free(ringbuffer_t *rb) {
+    return rb->size - rb_fill(rb, rb->read, rb->write);
+}
 
-    rb->buf[rb->end++] = c;
-    if (rb->end >= rb->size) rb->end = 0;
+unsigned int rb_peek_write(ringbuffer_t *rb, char **data) {
+    unsigned int write = rb->write;
+    unsigned int space = rb->size - rb_fill(rb, rb->read, write);
+    unsigned int pos = rb_pos(rb, write);
 
-    rb->avail++;
+    /* stop at the end of buf, the rest is at its start */
+    if (space > rb->size - pos) space = rb->size - pos;
+
+    *data = rb->buf + pos;
+    return space;
 }
 
-int rb_get_element(ringbuffer_t *rb) {
-    if (rb->avail == 0) return -1;
-    
-    rb->avail--;
+void rb_commit_write(ringbuffer_t *rb, unsigned int n) {
+    RB_BARRIER();
+    rb->write = rb_advance(rb, rb->write, n);
+}
 
-    int c = (char)rb->buf[rb->start++];
-    if (rb->start >= rb->size) rb->start = 0;
+int rb_add_element(ringbuffer_t* rb, char c) {
+    unsigned int write = rb->write;
 
-    return c;
+    if (rb_fill(rb, rb->read, write) == rb->size) {
+        rb->overflows++;
+        return 0;
+    }
+
+    rb->buf[rb_pos(rb, write)] = c;
+    RB_BARRIER();
+    rb->write = rb_advance(rb, write, 1);
+    return 1;
 }
 
-int rb_get_elements(ringbuffer_t *rb, char* buf, int n) {
+int rb_add_elements(ringbuffer_t* rb, const char *buf, int n) {
     int count = 0;
-    while (rb->avail && (count < n)) {
-        buf[count++] = rb_get_element(rb);
+    char *data;
+    unsigned int chunk;
+
+    /* at most two rounds, up to the end of buf and from its start */
+    while ((count < n) && (chunk = rb_peek_write(rb, &data)) != 0) {
+        if (chunk > (unsigned int) (n - count)) chunk = n - count;
+        memcpy(data, buf + count, chunk);
+        rb_commit_write(rb, chunk);
+        count += chunk;
+    }
+
+    if (count < n) {
+        DEBUG("ringbuffer: dropped %i bytes\n", n - count);
+        rb->overflows += n - count;
     }
     return count;
 }
 
-/*
-int main(int argc, char *argv[] ){
-    ringbuffer r;
-    char buffer[5];
-    ringbuffer_init(&r, buffer, sizeof(buffer));
-
-    rb_add_element(&r, 1);
-    rb_add_element(&r, 2);
-    rb_add_element(&r, 3);
-    rb_add_element(&r, 4);
-    rb_add_element(&r, 5);
-    rb_add_element(&r, 6);
-    rb_add_element(&r, 7);
-    rb_add_element(&r, 8);
-    rb_add_element(&r, 9);
-    rb_add_element(&r, 10);
-    
-    int c;
-    while ( r.avail ) {
-        c = rb_get_element(&r);
-        if (c == -1) break;
-        printf("c=%i\n", (int)c);
-    }
+unsigned int rb_peek_read(ringbuffer_t *rb, char **data) {
+    unsigned int read = rb->read;
+    unsigned int avail = rb_fill(rb, read, rb->write);
+    unsigned int pos = rb_pos(rb, read);
 
-    rb_add_element(&r, 1);
-    rb_add_element(&r, 2);
-    rb_add_element(&r, 3);
-    rb_add_element(&r, 4);
-    rb_add_element(&r, 5);
+    if (avail > rb->size - pos) avail = rb->size - pos;
+
+    RB_BARRIER();
+    *data = rb->buf + pos;
+    return avail;
+}
 
-    char buffer2[10];
+void rb_commit_read(ringbuffer_t *rb, unsigned int n) {
+    RB_BARRIER();
+    rb->read = rb_advance(rb, rb->read, n);
+}
 
-    int n = rb_get_elements(&r, buffer2, sizeof(buffer2));
+int rb_get_element(ringbuffer_t *rb) {
+    unsigned int read = rb->read;
 
-    for (int i = 0; i < n; i++) {
-        printf("%i\n", buffer2[i]);
-    }
+    if (read == rb->write) return -1;
 
-    rb_add_element(&r, 1);
-    rb_add_element(&r, 2);
-    rb_add_element(&r, 3);
-    rb_add_element(&r, 4);
-    rb_add_element(&r, 5);
-    rb_add_element(&r, 6);
-    rb_add_element(&r, 7);
-    rb_add_element(&r, 8);
-    rb_add_element(&r, 9);
-    rb_add_element(&r, 10);
-    
-    while ( r.avail ) {
-        c = rb_get_element(&r);
-        if (c == -1) break;
-        printf("c=%i\n", (int)c);
-    }
+    RB_BARRIER();
+    int c = (unsigned char)rb->buf[rb_pos(rb, read)];
+    RB_BARRIER();
+    rb->read = rb_advance(rb, read, 1);
 
-    return 0;
-}*/
+    return c;
+}
+
+int rb_get_elements(ringbuffer_t *rb, char* buf, int n) {
+    int count = 0;
+    char *data;
+    unsigned int chunk;
+
+    while ((count < n) && (chunk = rb_peek_read(rb, &data)) != 0) {
+        if (chunk > (unsigned int) (n - count)) chunk = n - count;
+        memcpy(buf + count, data, chunk);
+        rb_commit_read(rb, chunk);
+        count += chunk;
+    }
+    return count;
+}
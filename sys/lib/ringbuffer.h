@@ -1,18 +1,87 @@
+/**
+ * Single producer, single consumer ring buffer
+ *
+ * One context (usually an interrupt handler) writes, one context (usually
+ * a thread) reads. The writer only ever moves the write index and the
+ * reader only ever moves the read index, so neither side has to disable
+ * interrupts. Any other use, e.g. two writers, needs external locking.
+ *
+ * When the buffer is full new bytes are dropped and counted in
+ * overflows, the bytes already queued are never overwritten.
+ *
+ * Both indices run from 0 to 2 * size - 1, which tells a full buffer from
+ * an empty one without an extra counter and works for any buffer size.
+ */
+
 #ifndef __RINGBUFFER_H
-#define __RINGBUFFER_H 
+#define __RINGBUFFER_H
 
 typedef struct ringbuffer {
     char *buf;
-    unsigned int        start;
-    unsigned int        end;
-    unsigned int        size;
-    unsigned int        avail;
+    unsigned int            size;
+    volatile unsigned int   read;       ///< only changed by the reader
+    volatile unsigned int   write;      ///< only changed by the writer
+    volatile unsigned int   overflows;  ///< bytes dropped, only changed by the writer
 } ringbuffer_t;
 
 void ringbuffer_init(ringbuffer_t *rb, char* buffer, unsigned int bufsize);
-void rb_add_element(ringbuffer_t *rb, char c);
-void rb_add_elements(ringbuffer_t *rb, char *buf, int n);
+
+/**
+ * @return number of bytes that can be read
+ */
+unsigned int rb_avail(ringbuffer_t *rb);
+
+/**
+ * @return number of bytes that can be written
+ */
+unsigned int rb_free(ringbuffer_t *rb);
+
+/* writer side */
+
+/**
+ * @return 1 if c was queued, 0 if the buffer was full
+ */
+int rb_add_element(ringbuffer_t *rb, char c);
+
+/**
+ * @brief   Queue as much of buf as fits
+ *
+ * @return number of bytes queued, the rest is counted as overflow
+ */
+int rb_add_elements(ringbuffer_t *rb, const char *buf, int n);
+
+/**
+ * @brief   Get the contiguous free region at the write index
+ *
+ * Lets a driver receive or DMA straight into the buffer. Publish the
+ * bytes written with rb_commit_write().
+ *
+ * @return size of the region at *data, 0 if the buffer is full
+ */
+unsigned int rb_peek_write(ringbuffer_t *rb, char **data);
+void rb_commit_write(ringbuffer_t *rb, unsigned int n);
+
+/* reader side */
+
+/**
+ * @return next byte as unsigned char or -1 if the buffer is empty
+ */
 int rb_get_element(ringbuffer_t *rb);
+
+/**
+ * @return number of bytes copied to buf, at most n
+ */
 int rb_get_elements(ringbuffer_t *rb, char *buf, int n);
 
+/**
+ * @brief   Get the contiguous readable region at the read index
+ *
+ * Lets the reader parse in place. Release the bytes consumed with
+ * rb_commit_read().
+ *
+ * @return size of the region at *data, 0 if the buffer is empty
+ */
+unsigned int rb_peek_read(ringbuffer_t *rb, char **data);
+void rb_commit_read(ringbuffer_t *rb, unsigned int n);
+
 #endif /* __RINGBUFFER_H */
@@ -5,6 +5,7 @@
  *      Author: Oliver
  */
 #include <thread.h>
+#include <irq.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -20,6 +21,7 @@
 #include "sys/net/net_help/msg_help.h"
 
 socket_internal_t sockets[MAX_SOCKETS];
+tcp_statistic_t tcp_statistic;
 
 void printf_tcp_context(tcp_hc_context_t *current_tcp_context)
 	{
@@ -115,6 +117,11 @@ void print_internal_socket(socket_internal_t *current_socket_internal)
 	socket_t *current_socket = &current_socket_internal->socket_values;
 	printf("\n--------------------------\n");
 	printf("ID: %i, RECV PID: %i SEND PID: %i\n",	current_socket_internal->socket_id,	current_socket_internal->recv_pid, current_socket_internal->send_pid);
+	if (isUDPSocket(current_socket_internal->socket_id))
+		{
+		printf("Queued: %u bytes, dropped: %u datagrams\n", rb_avail(&current_socket_internal->udp_recv_queue),
+				current_socket_internal->udp_recv_drops);
+		}
 	print_socket(current_socket);
 	printf("\n--------------------------\n");
 	}
@@ -243,6 +250,10 @@ int socket(int domain, int type, int protocol)
 		current_socket->type = type;
 		current_socket->protocol = protocol;
 		current_socket->tcp_control.state = CLOSED;
+		ringbuffer_init(&sockets[i-1].udp_recv_queue, sockets[i-1].udp_recv_buffer, UDP_RECV_QUEUE_SIZE);
+		sem_init(&sockets[i-1].udp_recv_count, 0);
+		mutex_stat_register(&sockets[i-1].tcp_buffer_mutex, "tcp_buffer");
+		mutex_stat_register(&sockets[i-1].tcp_retransmit_mutex, "tcp_retransmit");
 		return sockets[i-1].socket_id;
 		}
 	}
@@ -360,6 +371,11 @@ int check_tcp_consistency(socket_t *current_tcp_socket, tcp_hdr_t *tcp_header)
 		// segment repetition, maybe ACK got lost?
 		return SEQ_NO_TOO_SMALL;
 		}
+	else if ((current_tcp_socket->tcp_control.rcv_nxt > 0) && (tcp_header->seq_nr > current_tcp_socket->tcp_control.rcv_nxt))
+		{
+		// segment behind a gap, an earlier segment got lost
+		return SEQ_NO_TOO_BIG;
+		}
 	return PACKET_OK;
 	}
 
@@ -388,7 +404,8 @@ void switch_tcp_packet_byte_order(tcp_hdr_t *current_tcp_packet)
 	current_tcp_packet->urg_pointer = HTONS(current_tcp_packet->urg_pointer);
 	}
 
-int send_tcp(socket_internal_t *current_socket, tcp_hdr_t *current_tcp_packet, ipv6_hdr_t *temp_ipv6_header, uint8_t flags, uint8_t payload_length)
+static int send_tcp_seq(socket_internal_t *current_socket, tcp_hdr_t *current_tcp_packet, ipv6_hdr_t *temp_ipv6_header, uint32_t seq_nr,
+		uint8_t flags, uint8_t payload_length)
 	{
 	socket_t *current_tcp_socket = &current_socket->socket_values;
 	uint8_t header_length = TCP_HDR_LEN/4;
@@ -404,8 +421,7 @@ int send_tcp(socket_internal_t *current_socket, tcp_hdr_t *current_tcp_packet, i
 		}
 
 	set_tcp_packet(current_tcp_packet, current_tcp_socket->local_address.sin6_port, current_tcp_socket->foreign_address.sin6_port,
-						(flags == TCP_ACK ? current_tcp_socket->tcp_control.send_una-1 : current_tcp_socket->tcp_control.send_una),
-						current_tcp_socket->tcp_control.rcv_nxt, header_length, flags, current_tcp_socket->tcp_control.rcv_wnd, 0, 0);
+						seq_nr, current_tcp_socket->tcp_control.rcv_nxt, header_length, flags, current_tcp_socket->tcp_control.rcv_wnd, 0, 0);
 
 	// Fill IPv6 Header
 	memcpy(&(temp_ipv6_header->destaddr), &current_tcp_socket->foreign_address.sin6_addr, 16);
@@ -434,6 +450,66 @@ int send_tcp(socket_internal_t *current_socket, tcp_hdr_t *current_tcp_packet, i
 #endif
 	}
 
+int send_tcp(socket_internal_t *current_socket, tcp_hdr_t *current_tcp_packet, ipv6_hdr_t *temp_ipv6_header, uint8_t flags, uint8_t payload_length)
+	{
+	tcp_cb_t *tcp_control = &current_socket->socket_values.tcp_control;
+	return send_tcp_seq(current_socket, current_tcp_packet, temp_ipv6_header,
+			(flags == TCP_ACK ? tcp_control->send_una-1 : tcp_control->send_una), flags, payload_length);
+	}
+
+// (Re)transmit a segment of the retransmission queue, caller holds tcp_retransmit_mutex
+int send_tcp_segment(socket_internal_t *current_socket, tcp_segment_t *segment)
+	{
+	uint8_t send_buffer[IPV6_HDR_LEN+TCP_HDR_LEN+STATIC_MSS];
+	ipv6_hdr_t *temp_ipv6_header = ((ipv6_hdr_t*)(&send_buffer));
+	tcp_hdr_t *current_tcp_packet = ((tcp_hdr_t*)(&send_buffer[IPV6_HDR_LEN]));
+
+	memcpy(&send_buffer[IPV6_HDR_LEN+TCP_HDR_LEN], segment->data, segment->length);
+	segment->send_time = vtimer_now();
+	tcp_statistic.segments_sent++;
+
+#ifdef TCP_HC
+	// Compressed headers of lost segments may have left the receivers context behind
+	current_socket->socket_values.tcp_control.tcp_context.hc_type = (segment->retransmitted ? FULL_HEADER : COMPRESSED_HEADER);
+#endif
+	return send_tcp_seq(current_socket, current_tcp_packet, temp_ipv6_header, segment->seq_nr, 0, segment->length);
+	}
+
+tcp_segment_t *tcp_retransmit_queue_head(socket_internal_t *current_socket)
+	{
+	if (current_socket->tcp_retransmit_count == 0)
+		{
+		return NULL;
+		}
+	return &current_socket->tcp_retransmit_queue[current_socket->tcp_retransmit_head];
+	}
+
+// Drop every byte below ack_nr from the retransmission queue, caller holds tcp_retransmit_mutex
+void tcp_retransmit_queue_ack(socket_internal_t *current_socket, uint32_t ack_nr)
+	{
+	tcp_segment_t *segment;
+	uint32_t acked_bytes;
+
+	while ((segment = tcp_retransmit_queue_head(current_socket)) != NULL)
+		{
+		if ((int32_t)(ack_nr - segment->seq_nr) <= 0)
+			{
+			break;
+			}
+		acked_bytes = ack_nr - segment->seq_nr;
+		if (acked_bytes < segment->length)
+			{
+			// Receiver took only the part of the segment fitting into its window
+			memmove(segment->data, segment->data+acked_bytes, segment->length-acked_bytes);
+			segment->seq_nr = ack_nr;
+			segment->length -= acked_bytes;
+			break;
+			}
+		current_socket->tcp_retransmit_head = (current_socket->tcp_retransmit_head+1) % TCP_RETRANSMIT_QUEUE_SIZE;
+		current_socket->tcp_retransmit_count--;
+		}
+	}
+
 void set_tcp_cb(tcp_cb_t *tcp_control, uint32_t rcv_nxt, uint16_t rcv_wnd, uint32_t send_nxt, uint32_t send_una, uint16_t send_wnd)
 	{
 	tcp_control->rcv_nxt = rcv_nxt;
@@ -590,9 +666,10 @@ int connect(int socket, sockaddr6_t *addr, uint32_t addrlen)
 	return 0;
 	}
 
-void calculate_rto(tcp_cb_t *tcp_control, long current_time)
+void calculate_rto(tcp_cb_t *tcp_control, uint32_t rtt_sample)
 	{
-	double rtt = current_time - tcp_control->last_packet_time.microseconds;
+	double rtt = rtt_sample;
+
 	double srtt = tcp_control->srtt;
 	double rttvar = tcp_control->rttvar;
 	double rto = tcp_control->rto;
@@ -620,18 +697,28 @@ void calculate_rto(tcp_cb_t *tcp_control, long current_time)
 	tcp_control->rto = rto;
 	}
 
+// Give up on unacknowledged data, caller holds tcp_retransmit_mutex
+static int32_t abort_send(socket_internal_t *current_int_tcp_socket)
+	{
+	current_int_tcp_socket->tcp_retransmit_count = 0;
+	current_int_tcp_socket->socket_values.tcp_control.send_nxt = current_int_tcp_socket->socket_values.tcp_control.send_una;
+	current_int_tcp_socket->tcp_send_pending = 0;
+	mutex_unlock(&current_int_tcp_socket->tcp_retransmit_mutex, 0);
+	return -1;
+	}
+
 int32_t send(int s, void *msg, uint32_t len, int flags)
 	{
 	// Variables
 	msg_t recv_msg;
-	int32_t sent_bytes = 0, total_sent_bytes = 0;
+	uint32_t queued_bytes = 0, flight_size, usable_window;
+	uint16_t segment_size;
+	uint8_t sent_bytes;
+	int irq_state;
 	socket_internal_t *current_int_tcp_socket;
 	socket_t *current_tcp_socket;
-	uint8_t send_buffer[BUFFER_SIZE];
-	memset(send_buffer, 0, BUFFER_SIZE);
-	ipv6_hdr_t *temp_ipv6_header = ((ipv6_hdr_t*)(&send_buffer));
-	tcp_hdr_t *current_tcp_packet = ((tcp_hdr_t*)(&send_buffer[IPV6_HDR_LEN]));
-
+	tcp_cb_t *tcp_control;
+	tcp_segment_t *segment;
 
 	// Check if socket exists and is TCP socket
 	if (!isTCPSocket(s))
@@ -641,9 +728,10 @@ int32_t send(int s, void *msg, uint32_t len, int flags)
 
 	current_int_tcp_socket = getSocket(s);
 	current_tcp_socket = &current_int_tcp_socket->socket_values;
+	tcp_control = &current_tcp_socket->tcp_control;
 
 	// Check for ESTABLISHED STATE
-	if (current_tcp_socket->tcp_control.state != ESTABLISHED)
+	if (tcp_control->state != ESTABLISHED)
 		{
 		return -1;
 		}
@@ -651,138 +739,123 @@ int32_t send(int s, void *msg, uint32_t len, int flags)
 	// Add thread PID
 	current_int_tcp_socket->send_pid = thread_getpid();
 
-	recv_msg.type = UNDEFINED;
+	segment_size = (tcp_control->mss < STATIC_MSS) ? tcp_control->mss : STATIC_MSS;
+	if (tcp_control->cwnd == 0)
+		{
+		// First data on this connection, begin with slow start
+		tcp_control->cwnd = TCP_INITIAL_CWND;
+		tcp_control->ssthresh = TCP_MAX_CWND;
+		tcp_control->recover = tcp_control->send_nxt;
+		}
+	if (tcp_control->rto == 0)
+		{
+		tcp_control->rto = TCP_INITIAL_ACK_TIMEOUT;
+		}
+	current_int_tcp_socket->tcp_send_pending = 1;
 
 	while (1)
 		{
-		current_tcp_socket->tcp_control.no_of_retries = 0;
+		mutex_lock(&current_int_tcp_socket->tcp_retransmit_mutex);
+		current_int_tcp_socket->tcp_ack_pending = 0;
 
-#ifdef TCP_HC
-		current_tcp_socket->tcp_control.tcp_context.hc_type = COMPRESSED_HEADER;
-		// Remember TCP Context for possible TCP_RETRY
-		tcp_hc_context_t saved_tcp_context;
-		memcpy(&saved_tcp_context, &current_tcp_socket->tcp_control.tcp_context, sizeof(tcp_hc_context_t)-1);
-#endif
-
-		while (recv_msg.type != TCP_ACK)
+		// Fill the send window, min(cwnd, receiver window), with new segments
+		while ((queued_bytes < len) && (current_int_tcp_socket->tcp_retransmit_count < TCP_RETRANSMIT_QUEUE_SIZE))
 			{
-			// Add packet data
-			if (current_tcp_socket->tcp_control.send_wnd > current_tcp_socket->tcp_control.mss)
+			flight_size = tcp_control->send_nxt - tcp_control->send_una;
+			usable_window = (tcp_control->cwnd < tcp_control->send_wnd) ? tcp_control->cwnd : tcp_control->send_wnd;
+			sent_bytes = ((len-queued_bytes) > segment_size) ? segment_size : (len-queued_bytes);
+
+			// With nothing in flight one segment is always sent, it probes a closed receiver window
+			if ((flight_size > 0) && (flight_size + sent_bytes > usable_window))
 				{
-				// Window size > Maximum Segment Size
-				if ((len-total_sent_bytes) > current_tcp_socket->tcp_control.mss)
-					{
-					memcpy(&send_buffer[IPV6_HDR_LEN+TCP_HDR_LEN], msg, current_tcp_socket->tcp_control.mss);
-					sent_bytes = current_tcp_socket->tcp_control.mss;
-					total_sent_bytes += sent_bytes;
-					}
-				else
-					{
-					memcpy(&send_buffer[IPV6_HDR_LEN+TCP_HDR_LEN], msg+total_sent_bytes, len-total_sent_bytes);
-					sent_bytes = len-total_sent_bytes;
-					total_sent_bytes = len;
-					}
+				break;
 				}
-			else
+			// The receiver drops segments behind a hole, hold new data until the loss is repaired
+			if ((int32_t)(tcp_control->recover - tcp_control->send_una) > 0)
 				{
-				// Window size <= Maximum Segment Size
-				if ((len-total_sent_bytes) > current_tcp_socket->tcp_control.send_wnd)
-					{
-					memcpy(&send_buffer[IPV6_HDR_LEN+TCP_HDR_LEN], msg, current_tcp_socket->tcp_control.send_wnd);
-					sent_bytes = current_tcp_socket->tcp_control.send_wnd;
-					total_sent_bytes += sent_bytes;
-					}
-				else
-					{
-					memcpy(&send_buffer[IPV6_HDR_LEN+TCP_HDR_LEN], msg+total_sent_bytes, len-total_sent_bytes);
-					sent_bytes = len-total_sent_bytes;
-					total_sent_bytes = len;
-					}
+				break;
 				}
 
-			current_tcp_socket->tcp_control.send_nxt += sent_bytes;
-			current_tcp_socket->tcp_control.send_wnd -= sent_bytes;
 
-			if (send_tcp(current_int_tcp_socket, current_tcp_packet, temp_ipv6_header, 0, sent_bytes) != 1)
+			segment = &current_int_tcp_socket->tcp_retransmit_queue[(current_int_tcp_socket->tcp_retransmit_head +
+					current_int_tcp_socket->tcp_retransmit_count) % TCP_RETRANSMIT_QUEUE_SIZE];
+			segment->seq_nr = tcp_control->send_nxt;
+			segment->length = sent_bytes;
+			segment->retransmitted = 0;
+			memcpy(segment->data, ((uint8_t*)msg)+queued_bytes, sent_bytes);
+			current_int_tcp_socket->tcp_retransmit_count++;
+
+			if (flight_size == 0)
+				{
+				// Retransmission timer runs from the oldest unacknowledged segment
+				tcp_control->last_packet_time = vtimer_now();
+				tcp_control->no_of_retries = 0;
+				}
+			tcp_control->send_nxt += sent_bytes;
+			queued_bytes += sent_bytes;
+
+			if (send_tcp_segment(current_int_tcp_socket, segment) != 1)
 				{
 				// Error while sending tcp data
-				current_tcp_socket->tcp_control.send_nxt -= sent_bytes;
-				current_tcp_socket->tcp_control.send_wnd += sent_bytes;
-#ifdef TCP_HC
-				memcpy(&current_tcp_socket->tcp_control.tcp_context, &saved_tcp_context, sizeof(tcp_hc_context_t));
-				current_tcp_socket->tcp_control.tcp_context.hc_type = COMPRESSED_HEADER;
-#endif
 				printf("Error while sending, returning to application thread!\n");
-				return -1;
+				return abort_send(current_int_tcp_socket);
 				}
+			}
+
+		if ((queued_bytes == len) && (current_int_tcp_socket->tcp_retransmit_count == 0))
+			{
+			// Got ACK for every sent byte
+			current_int_tcp_socket->tcp_send_pending = 0;
+			mutex_unlock(&current_int_tcp_socket->tcp_retransmit_mutex, 0);
+			return queued_bytes;
+			}
+		mutex_unlock(&current_int_tcp_socket->tcp_retransmit_mutex, 0);
 
-			// Remember current time
-			current_tcp_socket->tcp_control.last_packet_time.microseconds = hwtimer_now();
-			net_msg_receive(&recv_msg);
-			switch (recv_msg.type)
+		// Wait for ACKs opening the window, see handle_tcp_ack_packet(), or for the retransmission timer.
+		// An ACK handled while we were sending is latched in tcp_ack_pending and refills without blocking.
+		irq_state = disableIRQ();
+		if (current_int_tcp_socket->tcp_ack_pending)
+			{
+			restoreIRQ(irq_state);
+			continue;
+			}
+		net_msg_receive(&recv_msg);
+		restoreIRQ(irq_state);
+		switch (recv_msg.type)
+			{
+			case TCP_RETRY:
 				{
-				case TCP_ACK:
-					{
-					if (current_tcp_socket->tcp_control.no_of_retries == 0)
-						{
-						calculate_rto(&current_tcp_socket->tcp_control, hwtimer_now());
-						}
-					tcp_hdr_t *tcp_header = ((tcp_hdr_t*)(recv_msg.content.ptr));
-					if ((current_tcp_socket->tcp_control.send_nxt == tcp_header->ack_nr) && (total_sent_bytes == len))
-						{
-						current_tcp_socket->tcp_control.send_una = tcp_header->ack_nr;
-						current_tcp_socket->tcp_control.send_nxt = tcp_header->ack_nr;
-						current_tcp_socket->tcp_control.send_wnd = tcp_header->window;
-						// Got ACK for every sent byte
-#ifdef TCP_HC
-						current_tcp_socket->tcp_control.tcp_context.hc_type = COMPRESSED_HEADER;
-#endif
-						return sent_bytes;
-						}
-					else if ((current_tcp_socket->tcp_control.send_nxt == tcp_header->ack_nr) && (total_sent_bytes != len))
-						{
-						current_tcp_socket->tcp_control.send_una = tcp_header->ack_nr;
-						current_tcp_socket->tcp_control.send_nxt = tcp_header->ack_nr;
-						current_tcp_socket->tcp_control.send_wnd = tcp_header->window;
-						// Got ACK for every sent byte
-#ifdef TCP_HC
-						current_tcp_socket->tcp_control.tcp_context.hc_type = COMPRESSED_HEADER;
-#endif
-						break;
-						}
-//					else
-//						{
-//						// TODO: If window size > MSS, ACK was valid only for a few segments, handle retransmit of missing segments
-//						break;
-//						}
-					break;
-					}
-				case TCP_RETRY:
-					{
-					current_tcp_socket->tcp_control.send_nxt -= sent_bytes;
-					current_tcp_socket->tcp_control.send_wnd += sent_bytes;
-					total_sent_bytes -= sent_bytes;
-#ifdef TCP_HC
-					memcpy(&current_tcp_socket->tcp_control.tcp_context, &saved_tcp_context, sizeof(tcp_hc_context_t));
-					current_tcp_socket->tcp_control.tcp_context.hc_type = MOSTLY_COMPRESSED_HEADER;
-#endif
-					break;
-					}
-				case TCP_TIMEOUT:
+				mutex_lock(&current_int_tcp_socket->tcp_retransmit_mutex);
+				segment = tcp_retransmit_queue_head(current_int_tcp_socket);
+				if (segment != NULL)
 					{
-					current_tcp_socket->tcp_control.send_nxt -= sent_bytes;
-					current_tcp_socket->tcp_control.send_wnd += sent_bytes;
-#ifdef TCP_HC
-					memcpy(&current_tcp_socket->tcp_control.tcp_context, &saved_tcp_context, sizeof(tcp_hc_context_t));
-					current_tcp_socket->tcp_control.tcp_context.hc_type = COMPRESSED_HEADER;
-#endif
-					return -1;
-					break;
+					// Retransmission timeout, collapse the congestion window and resend the oldest segment.
+					// Later segments were dropped by the receiver and follow on the partial ACKs until recover.
+					flight_size = tcp_control->send_nxt - tcp_control->send_una;
+					tcp_control->ssthresh = ((flight_size/2) > (2*segment_size)) ? (flight_size/2) : (2*segment_size);
+					tcp_control->cwnd = segment_size;
+					tcp_control->dup_acks = 0;
+					tcp_control->recover = tcp_control->send_nxt;
+					segment->retransmitted = 1;
+					tcp_statistic.retransmits++;
+					send_tcp_segment(current_int_tcp_socket, segment);
+					tcp_control->last_packet_time = vtimer_now();
 					}
+				mutex_unlock(&current_int_tcp_socket->tcp_retransmit_mutex, 0);
+				break;
+				}
+			case TCP_TIMEOUT:
+				{
+				mutex_lock(&current_int_tcp_socket->tcp_retransmit_mutex);
+				return abort_send(current_int_tcp_socket);
+				}
+			default:
+				{
+				// TCP_ACK, refill the window
+				break;
 				}
 			}
 		}
-	return sent_bytes;
 	}
 
 uint8_t read_from_socket(socket_internal_t *current_int_tcp_socket, void *buf, int len)
@@ -812,8 +885,7 @@ uint8_t read_from_socket(socket_internal_t *current_int_tcp_socket, void *buf, i
 int recv(int s, void *buf, uint32_t len, int flags)
 	{
 	// Variables
-	uint8_t read_bytes;
-	msg_t m_recv, m_send;
+	msg_t m_recv;
 	socket_internal_t *current_int_tcp_socket;
 	// Check if socket exists
 	if (!isTCPSocket(s))
@@ -833,9 +905,7 @@ int recv(int s, void *buf, uint32_t len, int flags)
 	msg_receive(&m_recv);
 	if ((exists_socket(s)) && (current_int_tcp_socket->tcp_input_buffer_end > 0))
 		{
-		read_bytes = read_from_socket(current_int_tcp_socket, buf, len);
-		net_msg_reply(&m_recv, &m_send, UNDEFINED);
-		return read_bytes;
+		return read_from_socket(current_int_tcp_socket, buf, len);
 		}
 
 	// Received FIN
@@ -854,28 +924,34 @@ int32_t recvfrom(int s, void *buf, uint32_t len, int flags, sockaddr6_t *from, u
 	{
 	if (isUDPSocket(s))
 		{
-		msg_t m_recv, m_send;
-		ipv6_hdr_t *ipv6_header;
-		udp_hdr_t *udp_header;
-		uint8_t *payload;
-		getSocket(s)->recv_pid = thread_getpid();
-
-		msg_receive(&m_recv);
+		socket_internal_t *udp_socket = getSocket(s);
+		udp_recv_hdr_t recv_header;
+		uint32_t read_bytes, skip;
+		char *data;
+		udp_socket->recv_pid = thread_getpid();
 
-		ipv6_header = ((ipv6_hdr_t*)m_recv.content.ptr);
-		udp_header = ((udp_hdr_t*)(m_recv.content.ptr + IPV6_HDR_LEN));
-		payload = (uint8_t*)(m_recv.content.ptr + IPV6_HDR_LEN+UDP_HDR_LEN);
+		// Datagrams wait in the queue of the socket, udp_packet_handler() never waits for us
+		sem_wait(&udp_socket->udp_recv_count);
+		rb_get_elements(&udp_socket->udp_recv_queue, (char*)&recv_header, sizeof(udp_recv_hdr_t));
 
+		read_bytes = (recv_header.length < len) ? recv_header.length : len;
 		memset(buf, 0, len);
-		memcpy(buf, payload, udp_header->length-UDP_HDR_LEN);
-		memcpy(&from->sin6_addr, &ipv6_header->srcaddr, 16);
+		rb_get_elements(&udp_socket->udp_recv_queue, buf, read_bytes);
+		// The rest of a datagram larger than buf is discarded
+		for (skip = recv_header.length - read_bytes; skip > 0; skip -= read_bytes)
+			{
+			read_bytes = rb_peek_read(&udp_socket->udp_recv_queue, &data);
+			read_bytes = (read_bytes < skip) ? read_bytes : skip;
+			rb_commit_read(&udp_socket->udp_recv_queue, read_bytes);
+			}
+
+		memcpy(&from->sin6_addr, &recv_header.srcaddr, 16);
 		from->sin6_family = AF_INET6;
 		from->sin6_flowinfo = 0;
-		from->sin6_port = udp_header->src_port;
+		from->sin6_port = recv_header.src_port;
 		*fromlen = sizeof(sockaddr6_t);
 
-		msg_reply(&m_recv, &m_send);
-		return udp_header->length-UDP_HDR_LEN;
+		return (recv_header.length < len) ? recv_header.length : len;
 		}
 	else if (isTCPSocket(s))
 		{
@@ -1077,7 +1153,12 @@ socket_internal_t *getWaitingConnectionSocket(int socket, ipv6_hdr_t *ipv6_heade
 	for (i = 1; i < MAX_SOCKETS+1; i++)
 		{
 		current_socket = getSocket(i);
+		if (current_socket == NULL)
+			{
+			continue;
+			}
 		// Connection establishment ACK, Check for 4 touple and state
+
 		if ((ipv6_header != NULL) && (tcp_header != NULL))
 			{
 			if (is_four_touple(current_socket, ipv6_header, tcp_header) && (current_socket->socket_values.tcp_control.state == SYN_RCVD))
@@ -9,10 +9,12 @@
 #define SOCKET_H_
 
 #include <stdint.h>
+#include <ringbuffer.h>
 #include "tcp.h"
 #include "udp.h"
 #include "in.h"
 #include "sys/net/sixlowpan/sixlowip.h"
+#include "sys/net/sixlowpan/semaphore.h"
 
 /*
  * Types
@@ -111,14 +113,25 @@
 #define EPHEMERAL_PORTS 	49152
 
 #define STATIC_MSS			48
-#define STATIC_WINDOW		1 * STATIC_MSS
+#define STATIC_WINDOW		4 * STATIC_MSS
 #define MAX_TCP_BUFFER		1 * STATIC_WINDOW
 
+#define TCP_RETRANSMIT_QUEUE_SIZE	4								/* unacknowledged segments per socket */
+#define TCP_INITIAL_CWND			(2 * STATIC_MSS)
+#define TCP_MAX_CWND				(TCP_RETRANSMIT_QUEUE_SIZE * STATIC_MSS)
+#define TCP_DUP_ACK_THRESHOLD		3								/* duplicate ACKs triggering fast retransmit */
+
 #define INC_PACKET			0
 #define OUT_PACKET			1
 
 #define SEND_MSG_BUF_SIZE	64
 
+#define UDP_RECV_MAX_PAYLOAD	(MTU - IPV6_HDR_LEN - UDP_HDR_LEN)	/* largest payload of a received datagram */
+
+#ifndef UDP_RECV_QUEUE_SIZE
+#define UDP_RECV_QUEUE_SIZE	(sizeof(udp_recv_hdr_t) + UDP_RECV_MAX_PAYLOAD)	/* bytes of received datagrams per socket, at least one of maximum size */
+#endif
+
 typedef struct socka6
 	{
     uint8_t     		sin6_family;    		/* AF_INET6 */
@@ -161,6 +174,11 @@ typedef struct tcp_control_block
 	double				rttvar;
 	double				rto;
 
+	uint16_t			cwnd;				// congestion window in bytes
+	uint16_t			ssthresh;
+	uint8_t				dup_acks;
+	uint32_t			recover;			// send_nxt when fast recovery was entered
+
 #ifdef TCP_HC
 	tcp_hc_context_t	tcp_context;
 #endif
@@ -177,6 +195,24 @@ typedef struct sock_t
 	sockaddr6_t			foreign_address;
 	} socket_t;
 
+// Sent but not yet acknowledged data, kept for retransmission
+typedef struct tcp_seg_t
+	{
+	uint32_t			seq_nr;
+	uint8_t				length;
+	uint8_t				retransmitted;		// no RTT sample from retransmitted segments (Karn)
+	timex_t				send_time;
+	uint8_t				data[STATIC_MSS];
+	} tcp_segment_t;
+
+// Queued in front of each received datagram
+typedef struct udp_recv_hdr_t
+	{
+	ipv6_addr_t			srcaddr;
+	uint16_t			src_port;
+	uint16_t			length;				// of the payload
+	} udp_recv_hdr_t;
+
 typedef struct socket_in_t
 	{
 	uint8_t				socket_id;
@@ -186,9 +222,29 @@ typedef struct socket_in_t
 	mutex_t				tcp_buffer_mutex;
 	socket_t			socket_values;
 	uint8_t				tcp_input_buffer[MAX_TCP_BUFFER];
+	uint8_t				tcp_send_pending;	// send() waits for window space or ACKs
+	uint8_t				tcp_ack_pending;	// an ACK changed the window since send() last filled it
+	mutex_t				tcp_retransmit_mutex;
+	uint8_t				tcp_retransmit_head;
+	uint8_t				tcp_retransmit_count;
+	tcp_segment_t		tcp_retransmit_queue[TCP_RETRANSMIT_QUEUE_SIZE];
+	ringbuffer_t		udp_recv_queue;		// udp_recv_hdr_t and payload of each datagram not yet read
+	sem_t				udp_recv_count;		// datagrams in udp_recv_queue
+	uint16_t			udp_recv_drops;		// datagrams dropped for a full udp_recv_queue
+	char				udp_recv_buffer[UDP_RECV_QUEUE_SIZE];
 	} socket_internal_t;
 
+typedef struct tcp_stat_t
+	{
+	uint32_t			segments_sent;
+	uint32_t			retransmits;		// segments resent after a timeout
+	uint32_t			fast_retransmits;	// segments resent after duplicate ACKs
+	uint32_t			dup_acks;
+	} tcp_statistic_t;
+
 extern socket_internal_t sockets[MAX_SOCKETS];
+extern tcp_statistic_t tcp_statistic;
+
 
 int socket(int domain, int type, int protocol);
 int connect(int socket, sockaddr6_t *addr, uint32_t addrlen);
@@ -220,5 +276,11 @@ void set_tcp_packet(tcp_hdr_t *tcp_hdr, uint16_t src_port, uint16_t dst_port, ui
 int check_tcp_consistency(socket_t *current_tcp_socket, tcp_hdr_t *tcp_header);
 void switch_tcp_packet_byte_order(tcp_hdr_t *current_tcp_packet);
 int send_tcp(socket_internal_t *current_socket, tcp_hdr_t *current_tcp_packet, ipv6_hdr_t *temp_ipv6_header, uint8_t flags, uint8_t payload_length);
+int send_tcp_segment(socket_internal_t *current_socket, tcp_segment_t *segment);
+tcp_segment_t *tcp_retransmit_queue_head(socket_internal_t *current_socket);
+void tcp_retransmit_queue_ack(socket_internal_t *current_socket, uint32_t ack_nr);
+void calculate_rto(tcp_cb_t *tcp_control, uint32_t rtt);
 bool isTCPSocket(uint8_t s);
+bool isUDPSocket(uint8_t s);
+
 #endif /* SOCKET_H_ */
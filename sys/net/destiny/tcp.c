@@ -59,39 +59,159 @@ uint16_t tcp_csum(ipv6_hdr_t *ipv6_header, tcp_hdr_t *tcp_header)
 
 uint8_t handle_payload(ipv6_hdr_t *ipv6_header, tcp_hdr_t *tcp_header, socket_internal_t *tcp_socket, uint8_t *payload)
 	{
-	msg_t m_send_tcp, m_recv_tcp;
+	msg_t m_send_tcp;
 	uint8_t tcp_payload_len = ipv6_header->length-TCP_HDR_LEN;
 	uint8_t acknowledged_bytes = 0;
 	if (tcp_payload_len > tcp_socket->socket_values.tcp_control.rcv_wnd)
 		{
 		mutex_lock(&tcp_socket->tcp_buffer_mutex);
-		memcpy(tcp_socket->tcp_input_buffer, payload, tcp_socket->socket_values.tcp_control.rcv_wnd);
+		memcpy(tcp_socket->tcp_input_buffer+tcp_socket->tcp_input_buffer_end, payload, tcp_socket->socket_values.tcp_control.rcv_wnd);
 		acknowledged_bytes = tcp_socket->socket_values.tcp_control.rcv_wnd;
-		tcp_socket->socket_values.tcp_control.rcv_wnd = 0;
 		tcp_socket->tcp_input_buffer_end = tcp_socket->tcp_input_buffer_end + tcp_socket->socket_values.tcp_control.rcv_wnd;
+		tcp_socket->socket_values.tcp_control.rcv_wnd = 0;
 		mutex_unlock(&tcp_socket->tcp_buffer_mutex, 0);
 		}
 	else
 		{
 		mutex_lock(&tcp_socket->tcp_buffer_mutex);
-		memcpy(tcp_socket->tcp_input_buffer, payload, tcp_payload_len);
+		memcpy(tcp_socket->tcp_input_buffer+tcp_socket->tcp_input_buffer_end, payload, tcp_payload_len);
 		tcp_socket->socket_values.tcp_control.rcv_wnd = tcp_socket->socket_values.tcp_control.rcv_wnd - tcp_payload_len;
 		acknowledged_bytes = tcp_payload_len;
 		tcp_socket->tcp_input_buffer_end = tcp_socket->tcp_input_buffer_end + tcp_payload_len;
 		mutex_unlock(&tcp_socket->tcp_buffer_mutex, 0);
 		}
+	// Wake up recv(), the data waits in tcp_input_buffer
 	if (thread_getstatus(tcp_socket->recv_pid) == STATUS_RECEIVE_BLOCKED)
 		{
-		net_msg_send_recv(&m_send_tcp, &m_recv_tcp, tcp_socket->recv_pid, UNDEFINED);
+		net_msg_send(&m_send_tcp, tcp_socket->recv_pid, 0, UNDEFINED);
 		}
 
 	return acknowledged_bytes;
 	}
 
+// Cumulative ACK for the sliding window of send(), runs with tcp_retransmit_mutex held
+static uint8_t handle_established_ack(tcp_hdr_t *tcp_header, socket_internal_t *tcp_socket)
+	{
+	tcp_cb_t *tcp_control = &tcp_socket->socket_values.tcp_control;
+	tcp_segment_t *segment;
+	uint32_t acked_bytes, flight_size;
+	uint16_t segment_size = (tcp_control->mss < STATIC_MSS) ? tcp_control->mss : STATIC_MSS;
+	uint8_t partial_ack;
+
+	switch (check_tcp_consistency(&tcp_socket->socket_values, tcp_header))
+		{
+		case PACKET_OK:
+			{
+			acked_bytes = tcp_header->ack_nr - tcp_control->send_una;
+
+			// Karn: only segments sent once give a valid RTT sample
+			segment = tcp_retransmit_queue_head(tcp_socket);
+			if ((segment != NULL) && !segment->retransmitted &&
+					((int32_t)(tcp_header->ack_nr - (segment->seq_nr + segment->length)) >= 0))
+				{
+				calculate_rto(tcp_control, timex_sub(vtimer_now(), segment->send_time).microseconds);
+				}
+
+			tcp_retransmit_queue_ack(tcp_socket, tcp_header->ack_nr);
+			tcp_control->send_una = tcp_header->ack_nr;
+			tcp_control->send_wnd = tcp_header->window;
+			tcp_control->last_packet_time = vtimer_now();
+			tcp_control->no_of_retries = 0;
+
+			// The receiver drops segments behind a hole, resend them one by one until recover is acknowledged
+			partial_ack = ((int32_t)(tcp_control->recover - tcp_header->ack_nr) > 0);
+			segment = tcp_retransmit_queue_head(tcp_socket);
+			if (partial_ack && (segment != NULL))
+				{
+				segment->retransmitted = 1;
+				tcp_statistic.retransmits++;
+				send_tcp_segment(tcp_socket, segment);
+				}
+
+			if (tcp_control->dup_acks >= TCP_DUP_ACK_THRESHOLD)
+				{
+				if (partial_ack)
+					{
+					// Deflate by the acknowledged data, the retransmitted segment stays in flight
+					tcp_control->cwnd = (tcp_control->cwnd > acked_bytes) ? (tcp_control->cwnd - acked_bytes) : 0;
+					tcp_control->cwnd += segment_size;
+					}
+				else
+					{
+					// Leave fast recovery
+					tcp_control->cwnd = tcp_control->ssthresh;
+					tcp_control->dup_acks = 0;
+					}
+				}
+			else
+				{
+				tcp_control->dup_acks = 0;
+				if (tcp_control->cwnd < tcp_control->ssthresh)
+					{
+					// Slow start
+					tcp_control->cwnd += (acked_bytes < segment_size) ? acked_bytes : segment_size;
+					}
+				else
+					{
+					// Congestion avoidance, about one segment per RTT
+					tcp_control->cwnd += ((segment_size*segment_size/tcp_control->cwnd) > 0) ?
+							(segment_size*segment_size/tcp_control->cwnd) : 1;
+					}
+				if (tcp_control->cwnd > TCP_MAX_CWND)
+					{
+					tcp_control->cwnd = TCP_MAX_CWND;
+					}
+				}
+			return 1;
+			}
+		case ACK_NO_TOO_SMALL:
+			{
+			segment = tcp_retransmit_queue_head(tcp_socket);
+			if ((segment == NULL) || (tcp_header->ack_nr != tcp_control->send_una) || (tcp_header->window != tcp_control->send_wnd))
+				{
+				// Old ACK or window update
+				tcp_control->send_wnd = tcp_header->window;
+				return 1;
+				}
+			tcp_statistic.dup_acks++;
+			tcp_control->dup_acks++;
+			if (tcp_control->dup_acks > TCP_DUP_ACK_THRESHOLD)
+				{
+				// Every further duplicate ACK means a segment has left the network
+				tcp_control->cwnd += segment_size;
+				return 1;
+				}
+			// Early retransmit (RFC 5827), with less than four segments in flight three duplicates never arrive
+			if ((tcp_control->dup_acks < TCP_DUP_ACK_THRESHOLD) &&
+					((tcp_socket->tcp_retransmit_count < 2) || (tcp_control->dup_acks < tcp_socket->tcp_retransmit_count-1)))
+				{
+				return 0;
+				}
+
+			// Fast retransmit, the receiver keeps asking for the oldest segment
+			flight_size = tcp_control->send_nxt - tcp_control->send_una;
+			tcp_control->ssthresh = ((flight_size/2) > (2*segment_size)) ? (flight_size/2) : (2*segment_size);
+			tcp_control->cwnd = tcp_control->ssthresh + tcp_control->dup_acks*segment_size;
+			tcp_control->dup_acks = TCP_DUP_ACK_THRESHOLD;
+			tcp_control->recover = tcp_control->send_nxt;
+			segment->retransmitted = 1;
+			tcp_statistic.fast_retransmits++;
+			send_tcp_segment(tcp_socket, segment);
+			tcp_control->last_packet_time = vtimer_now();
+			return 0;
+
+			}
+		default:
+			{
+			return 0;
+			}
+		}
+	}
+
 void handle_tcp_ack_packet(ipv6_hdr_t *ipv6_header, tcp_hdr_t *tcp_header, socket_internal_t *tcp_socket)
 	{
 	msg_t m_recv_tcp, m_send_tcp;
-	uint8_t target_pid;
+	uint8_t target_pid, window_changed;
 
 	if (tcp_socket->socket_values.tcp_control.state == LAST_ACK)
 		{
@@ -115,13 +235,25 @@ void handle_tcp_ack_packet(ipv6_hdr_t *ipv6_header, tcp_hdr_t *tcp_header, socke
 		}
 	else if (tcp_socket->socket_values.tcp_control.state == ESTABLISHED)
 		{
-		if (check_tcp_consistency(&tcp_socket->socket_values, tcp_header) == PACKET_OK)
+		mutex_lock(&tcp_socket->tcp_retransmit_mutex);
+		window_changed = handle_established_ack(tcp_header, tcp_socket);
+		if (window_changed && tcp_socket->tcp_send_pending)
+			{
+			// send() checks the flag before it blocks, so a busy send() still refills the window
+			tcp_socket->tcp_ack_pending = 1;
+			}
+		mutex_unlock(&tcp_socket->tcp_retransmit_mutex, 0);
+
+		// Wake send() if it already waits
+		if (window_changed && tcp_socket->tcp_send_pending &&
+				(thread_getstatus(tcp_socket->send_pid) == STATUS_RECEIVE_BLOCKED))
 			{
 			m_send_tcp.content.ptr = (char*)tcp_header;
 			net_msg_send(&m_send_tcp, tcp_socket->send_pid, 0, TCP_ACK);
-			return;
 			}
+		return;
 		}
+
 	printf("NO WAY OF HANDLING THIS ACK!\n");
 	}
 
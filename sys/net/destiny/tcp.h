@@ -50,7 +50,8 @@ enum tcp_codes
 	CLOSE_CONN			= 2,
 	SEQ_NO_TOO_SMALL	= 3,
 	ACK_NO_TOO_SMALL 	= 4,
-	ACK_NO_TOO_BIG		= 5
+	ACK_NO_TOO_BIG		= 5,
+	SEQ_NO_TOO_BIG		= 6
 	};
 
 #define REMOVE_RESERVED 		0xFC
@@ -139,6 +139,9 @@ void tcp_general_timer(void)
 	vtimer_t tcp_vtimer;
 	timex_t interval = timex_set(0, TCP_TIMER_RESOLUTION);
 
+	tcp_vtimer.slot = 0;
+	vtimer_set_slack(&tcp_vtimer, TCP_TIMER_SLACK);
+
 	while (1)
 		{
 		inc_global_variables();
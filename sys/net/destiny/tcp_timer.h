@@ -9,6 +9,7 @@
 #define TCP_TIMER_H_
 
 #define TCP_TIMER_RESOLUTION		500*1000
+#define TCP_TIMER_SLACK				50*1000		// lets the timer share interrupts
 
 #define SECOND						1000.0f*1000.0f
 #define TCP_TIMER_STACKSIZE			512
@@ -23,9 +23,34 @@ uint16_t udp_csum(ipv6_hdr_t *ipv6_header, udp_hdr_t *udp_header)
     return (sum == 0) ? 0xffff : HTONS(sum);
 	}
 
+// Queues a datagram for recvfrom() without waiting for the socket owner
+static void udp_enqueue(socket_internal_t *udp_socket, ipv6_hdr_t *ipv6_header, udp_hdr_t *udp_header, uint8_t *payload)
+	{
+	udp_recv_hdr_t recv_header;
+
+	recv_header.length = udp_header->length-UDP_HDR_LEN;
+	if (sizeof(udp_recv_hdr_t) + recv_header.length > UDP_RECV_QUEUE_SIZE)
+		{
+		printf("Dropped UDP Message of %u bytes, larger than the receive queue!\n", recv_header.length);
+		udp_socket->udp_recv_drops++;
+		return;
+		}
+	if (rb_free(&udp_socket->udp_recv_queue) < sizeof(udp_recv_hdr_t) + recv_header.length)
+		{
+		udp_socket->udp_recv_drops++;
+		return;
+		}
+
+	memcpy(&recv_header.srcaddr, &ipv6_header->srcaddr, 16);
+	recv_header.src_port = udp_header->src_port;
+	rb_add_elements(&udp_socket->udp_recv_queue, (char*)&recv_header, sizeof(udp_recv_hdr_t));
+	rb_add_elements(&udp_socket->udp_recv_queue, (char*)payload, recv_header.length);
+	sem_signal(&udp_socket->udp_recv_count);
+	}
+
 void udp_packet_handler(void)
 	{
-	msg_t m_recv_ip, m_send_ip, m_recv_udp, m_send_udp;
+	msg_t m_recv_ip, m_send_ip;
 	ipv6_hdr_t *ipv6_header;
 	udp_hdr_t *udp_header;
 	uint8_t *payload;
@@ -46,8 +71,7 @@ void udp_packet_handler(void)
 			udp_socket = get_udp_socket(ipv6_header, udp_header);
 			if (udp_socket != NULL)
 				{
-				m_send_udp.content.ptr = (char*)ipv6_header;
-				msg_send_receive(&m_send_udp, &m_recv_udp, udp_socket->recv_pid);
+				udp_enqueue(udp_socket, ipv6_header, udp_header, payload);
 				}
 			else
 				{
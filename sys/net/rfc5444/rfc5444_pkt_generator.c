@@ -46,7 +46,7 @@
 #include "rfc5444_writer.h"
 #include "rfc5444_api_config.h"
 
-static void _write_pktheader(struct rfc5444_writer_interface *interf);
+static void _write_pktheader(struct rfc5444_writer_interface *interf, uint8_t *ptr);
 
 /**
  * Internal function to start generation of a packet
@@ -90,7 +90,9 @@ _rfc5444_writer_begin_packet(struct rfc5444_writer *writer,
 
 /**
  * Flush the current messages in the writer buffer and send
- * a complete packet.
+ * a complete packet. The packet is handed to the interface in place,
+ * the header and the packet tlvs are moved up to the messages instead
+ * of moving the messages down.
  * @param writer pointer to writer context
  * @param interf pointer to interface to flush
  * @param force true if the writer should create an empty packet if necessary
@@ -99,6 +101,7 @@ void
 rfc5444_writer_flush(struct rfc5444_writer *writer,
     struct rfc5444_writer_interface *interf, bool force) {
   struct rfc5444_writer_pkthandler *handler;
+  uint8_t *ptr;
   size_t len;
 
 #if WRITER_STATE_MACHINE == true
@@ -133,9 +136,6 @@ rfc5444_writer_flush(struct rfc5444_writer *writer,
     interf->finishPacketHeader(writer, interf);
   }
 
-  /* write packet header (including tlvblock length if necessary */
-  _write_pktheader(interf);
-
   /* calculate true length of header (optional tlv block !) */
   len = 1;
   if (interf->_has_seqno) {
@@ -145,15 +145,19 @@ rfc5444_writer_flush(struct rfc5444_writer *writer,
     len += 2;
   }
 
-  /* compress packet buffer */
-  if (interf->_bin_msgs_size) {
-    memmove(&interf->_pkt.buffer[len + interf->_pkt.added + interf->_pkt.set],
-        &interf->_pkt.buffer[interf->_pkt.header + interf->_pkt.added + interf->_pkt.allocated],
-        interf->_bin_msgs_size);
+  /* close the gap of unused allocated tlv space in front of the messages */
+  if (interf->_pkt.allocated > interf->_pkt.set) {
+    memmove(&interf->_pkt.buffer[interf->_pkt.header + interf->_pkt.allocated - interf->_pkt.set],
+        &interf->_pkt.buffer[interf->_pkt.header],
+        interf->_pkt.added + interf->_pkt.set);
   }
 
+  /* write packet header (including tlvblock length if necessary) in front of the tlvs */
+  ptr = &interf->_pkt.buffer[interf->_pkt.header + interf->_pkt.allocated - interf->_pkt.set - len];
+  _write_pktheader(interf, ptr);
+
   /* send packet */
-  interf->sendPacket(writer, interf, interf->_pkt.buffer,
+  interf->sendPacket(writer, interf, ptr,
       len + interf->_pkt.added + interf->_pkt.set + interf->_bin_msgs_size);
 
   /* cleanup length information */
@@ -168,8 +172,7 @@ rfc5444_writer_flush(struct rfc5444_writer *writer,
 #endif
 
 #if DEBUG_CLEANUP == true
-  memset(&interf->_pkt.buffer[len + interf->_pkt.added], 0,
-      interf->_pkt.max - len - interf->_pkt.added);
+  memset(interf->_pkt.buffer, 0, interf->_pkt.max);
 #endif
 }
 
@@ -284,16 +287,17 @@ rfc5444_writer_set_pkt_seqno(struct rfc5444_writer *writer __attribute__ ((unuse
 /**
  * Write the header of a packet into the packet buffer
  * @param writer pointer to writer interface object
+ * @param ptr pointer to first byte of the packet
  */
 static void
-_write_pktheader(struct rfc5444_writer_interface *interf) {
-  uint8_t *ptr;
+_write_pktheader(struct rfc5444_writer_interface *interf, uint8_t *ptr) {
+  uint8_t *flags;
   size_t len;
 
-  ptr = interf->_pkt.buffer;
+  flags = ptr;
   *ptr++ = 0;
   if (interf->_has_seqno) {
-    interf->_pkt.buffer[0] |= RFC5444_PKT_FLAG_SEQNO;
+    *flags |= RFC5444_PKT_FLAG_SEQNO;
     *ptr++ = (interf->_seqno >> 8);
     *ptr++ = (interf->_seqno & 255);
   }
@@ -301,7 +305,7 @@ _write_pktheader(struct rfc5444_writer_interface *interf) {
   /* tlv-block ? */
   len = interf->_pkt.added + interf->_pkt.set;
   if (len > 0) {
-    interf->_pkt.buffer[0] |= RFC5444_PKT_FLAG_TLV;
+    *flags |= RFC5444_PKT_FLAG_TLV;
     *ptr++ = (len >> 8);
     *ptr++ = (len & 255);
   }
@@ -43,7 +43,6 @@
 #include <string.h>
 
 #include "sys/common/avl.h"
-#include "sys/common/avl_comp.h"
 #include "sys/common/common_types.h"
 #include "rfc5444_reader.h"
 #include "rfc5444_api_config.h"
@@ -60,13 +59,14 @@ static int _calc_tlvblock_intorder(struct rfc5444_reader_tlvblock_entry *entry);
 static bool _has_same_tlvtype(int int_type1, int int_type2);
 static uint8_t _rfc5444_get_u8(uint8_t **ptr, uint8_t *end, enum rfc5444_result *result);
 static uint16_t _rfc5444_get_u16(uint8_t **ptr, uint8_t *end, enum rfc5444_result *result);
-static void _free_tlvblock(struct rfc5444_reader *parser, struct avl_tree *entries);
+static void _free_tlvblock(struct rfc5444_reader *parser, struct rfc5444_reader_tlvblock *entries);
+static uint16_t _count_tlvs(uint8_t *ptr, uint8_t *end, uint8_t *eob);
 static int _parse_tlv(struct rfc5444_reader_tlvblock_entry *entry, uint8_t **ptr,
     uint8_t *eob, uint8_t addr_count);
 static int _parse_tlvblock(struct rfc5444_reader *parser,
-    struct avl_tree *tlvblock, uint8_t **ptr, uint8_t *eob, uint8_t addr_count);
+    struct rfc5444_reader_tlvblock *tlvblock, uint8_t **ptr, uint8_t *eob, uint8_t addr_count);
 static int _schedule_tlvblock(struct rfc5444_reader_tlvblock_consumer *consumer,
-    struct rfc5444_reader_tlvblock_context *context, struct avl_tree *entries, uint8_t idx);
+    struct rfc5444_reader_tlvblock_context *context, struct rfc5444_reader_tlvblock *entries, uint8_t idx);
 static int _parse_addrblock(struct rfc5444_reader_addrblock_entry *addr_entry,
     struct rfc5444_reader_tlvblock_context *tlv_context, uint8_t **ptr, uint8_t *eob);
 static int _handle_message(struct rfc5444_reader *parser,
@@ -77,7 +77,9 @@ static struct rfc5444_reader_tlvblock_consumer *_add_consumer(
 static void _free_consumer(struct avl_tree *consumer_tree,
     struct rfc5444_reader_tlvblock_consumer *consumer);
 static struct rfc5444_reader_addrblock_entry *_malloc_addrblock_entry(void);
-static struct rfc5444_reader_tlvblock_entry *_malloc_tlvblock_entry(void);
+static struct rfc5444_reader_tlvblock_entry *_malloc_tlvblock_entries(size_t count);
+static void *_arena_alloc(struct rfc5444_reader *parser, size_t size);
+static bool _is_arena_entry(struct rfc5444_reader *parser, void *entry);
 
 static uint8_t rfc5444_get_pktversion(uint8_t v);
 
@@ -99,13 +101,15 @@ rfc5444_reader_init(struct rfc5444_reader *context) {
 
   if (context->malloc_addrblock_entry == NULL)
     context->malloc_addrblock_entry = _malloc_addrblock_entry;
-  if (context->malloc_tlvblock_entry == NULL)
-    context->malloc_tlvblock_entry = _malloc_tlvblock_entry;
+  if (context->malloc_tlvblock_entries == NULL)
+    context->malloc_tlvblock_entries = _malloc_tlvblock_entries;
 
   if (context->free_addrblock_entry == NULL)
     context->free_addrblock_entry = free;
-  if (context->free_tlvblock_entry == NULL)
-    context->free_tlvblock_entry = free;
+  if (context->free_tlvblock_entries == NULL)
+    context->free_tlvblock_entries = free;
+
+  context->_arena_used = 0;
 }
 
 /**
@@ -129,7 +133,7 @@ rfc5444_reader_cleanup(struct rfc5444_reader *context) {
 enum rfc5444_result
 rfc5444_reader_handle_packet(struct rfc5444_reader *parser, uint8_t *buffer, size_t length) {
   struct rfc5444_reader_tlvblock_context context;
-  struct avl_tree entries;
+  struct rfc5444_reader_tlvblock entries;
   struct rfc5444_reader_tlvblock_consumer *consumer, *last_started;
   uint8_t *ptr, *eob;
   bool has_tlv;
@@ -145,6 +149,9 @@ rfc5444_reader_handle_packet(struct rfc5444_reader *parser, uint8_t *buffer, siz
   context.type = RFC5444_CONTEXT_PACKET;
   context.reader = parser;
 
+  /* nothing of the last packet is in use anymore */
+  parser->_arena_used = 0;
+
   /* read header of packet */
   first_byte = _rfc5444_get_u8(&ptr, eob, &result);
   context.pkt_version = rfc5444_get_pktversion(first_byte);
@@ -172,8 +179,8 @@ rfc5444_reader_handle_packet(struct rfc5444_reader *parser, uint8_t *buffer, siz
     return result;
   }
 
-  /* initialize avl_tree */
-  avl_init(&entries, avl_comp_uint32, true, NULL);
+  /* initialize tlvblock */
+  memset(&entries, 0, sizeof(entries));
   last_started = NULL;
 
   /* check for packet tlv */
@@ -463,16 +470,71 @@ _rfc5444_get_u16(uint8_t **ptr, uint8_t *end, enum rfc5444_result *error) {
 }
 
 /**
- * free a list of linked tlv_block entries
- * @param entries avl_tree of tlv_block entries
+ * free the tlv_block entries of a tlvblock
+ * @param entries pointer to tlvblock
  */
 static void
-_free_tlvblock(struct rfc5444_reader *parser, struct avl_tree *entries) {
-  struct rfc5444_reader_tlvblock_entry *tlv, *ptr;
+_free_tlvblock(struct rfc5444_reader *parser, struct rfc5444_reader_tlvblock *entries) {
+  if (entries->tlvs != NULL && !_is_arena_entry(parser, entries->tlvs)) {
+    parser->free_tlvblock_entries(entries->tlvs);
+  }
+  entries->tlvs = NULL;
+  entries->count = 0;
+}
+
+/**
+ * count the TLVs of a TLV block without decoding them. Up to the first
+ * bad TLV the count matches the TLVs _parse_tlv() decodes.
+ * @param ptr pointer to first TLV of the block
+ * @param end pointer to first byte after the TLV block
+ * @param eob pointer to first byte after the datastream
+ * @return number of TLVs starting inside the block
+ */
+static uint16_t
+_count_tlvs(uint8_t *ptr, uint8_t *end, uint8_t *eob) {
+  uint16_t count = 0, length;
+  uint8_t flags;
+
+  while (ptr < end) {
+    count++;
+    if (ptr + 2 > eob) {
+      break;
+    }
 
-  avl_remove_all_elements(entries, tlv, node, ptr) {
-    parser->free_tlvblock_entry(tlv);
+    /* skip type, flags, type extension and indices */
+    flags = ptr[1];
+    ptr += 2;
+    if ((flags & RFC5444_TLV_FLAG_TYPEEXT) != 0) {
+      ptr++;
+    }
+    if ((flags & RFC5444_TLV_FLAG_SINGLE_IDX) != 0) {
+      ptr++;
+    }
+    else if ((flags & RFC5444_TLV_FLAG_MULTI_IDX) != 0) {
+      ptr += 2;
+    }
+
+    /* skip length and value */
+    length = 0;
+    if ((flags & RFC5444_TLV_FLAG_VALUE) != 0) {
+      if ((flags & RFC5444_TLV_FLAG_EXTVALUE) != 0) {
+        if (ptr + 2 > eob) {
+          break;
+        }
+        length = (ptr[0] << 8) | ptr[1];
+        ptr += 2;
+      }
+      else {
+        if (ptr + 1 > eob) {
+          break;
+        }
+        length = ptr[0];
+        ptr++;
+      }
+    }
+    ptr += length;
   }
+  return count;
 }
 
 /**
@@ -580,8 +642,8 @@ _parse_tlv(struct rfc5444_reader_tlvblock_entry *entry, uint8_t **ptr, uint8_t *
 }
 
 /**
- * parse a TLV block into a list of linked tlvblock_entries.
- * @param tlvblock pointer to avl_tree to store generates tlvblock entries
+ * parse a TLV block into a sorted array of tlvblock_entries.
+ * @param tlvblock pointer to tlvblock to store generated tlvblock entries
  * @param ptr pointer to pointer to begin of datastream, will be
  *   incremented to the first byte after the block if no error happened.
  *   Will be set to eob if an error happened.
@@ -591,11 +653,10 @@ _parse_tlv(struct rfc5444_reader_tlvblock_entry *entry, uint8_t **ptr, uint8_t *
  */
 static enum rfc5444_result
 _parse_tlvblock(struct rfc5444_reader *parser,
-    struct avl_tree *tlvblock, uint8_t **ptr, uint8_t *eob, uint8_t addr_count) {
+    struct rfc5444_reader_tlvblock *tlvblock, uint8_t **ptr, uint8_t *eob, uint8_t addr_count) {
   enum rfc5444_result result = RFC5444_OKAY;
-  struct rfc5444_reader_tlvblock_entry *tlv1 = NULL;
   struct rfc5444_reader_tlvblock_entry entry;
-  uint16_t length = 0;
+  uint16_t length = 0, count, i;
   uint8_t *end = NULL;
 
   /* get length of TLV block */
@@ -607,31 +668,37 @@ _parse_tlvblock(struct rfc5444_reader *parser,
     goto cleanup_parse_tlvblock;
   }
 
+  /* get memory to store all TLV block entries */
+  count = _count_tlvs(*ptr, end, eob);
+  if (count > 0) {
+    tlvblock->tlvs = _arena_alloc(parser, count * sizeof(entry));
+    if (tlvblock->tlvs == NULL) {
+      tlvblock->tlvs = parser->malloc_tlvblock_entries(count);
+    }
+    if (tlvblock->tlvs == NULL) {
+      /* not enough memory left ! */
+      result = RFC5444_OUT_OF_MEMORY;
+      goto cleanup_parse_tlvblock;
+    }
+  }
+
   /* clear static buffer */
   memset(&entry, 0, sizeof(entry));
 
   /* parse tlvs */
-  while (*ptr < end) {
+  while (*ptr < end && tlvblock->count < count) {
     /* parse next TLV into static buffer */
     if ((result = _parse_tlv(&entry, ptr, eob, addr_count)) != RFC5444_OKAY) {
       /* error while parsing TLV */
       goto cleanup_parse_tlvblock;
     }
 
-    /* get memory to store TLV block entry */
-    tlv1 = parser->malloc_tlvblock_entry();
-    if (tlv1 == NULL) {
-      /* not enough memory left ! */
-      result = RFC5444_OUT_OF_MEMORY;
-      goto cleanup_parse_tlvblock;
+    /* insert into sorted array, behind entries of the same type */
+    for (i = tlvblock->count; i > 0 && tlvblock->tlvs[i-1].int_order > entry.int_order; i--) {
+      memcpy(&tlvblock->tlvs[i], &tlvblock->tlvs[i-1], sizeof(entry));
     }
-
-    /* copy TLV block entry into allocated memory */
-    memcpy (tlv1, &entry, sizeof(entry));
-
-    /* put into sorted list */
-    tlv1->node.key = &tlv1->int_order;
-    avl_insert(tlvblock, &tlv1->node);
+    memcpy(&tlvblock->tlvs[i], &entry, sizeof(entry));
+    tlvblock->count++;
   }
 cleanup_parse_tlvblock:
   if (result != RFC5444_OKAY) {
@@ -645,7 +712,7 @@ cleanup_parse_tlvblock:
  * Call callbacks for parsed TLV blocks
  * @param consumer pointer to first consumer for this message type
  * @param context pointer to context for tlv block
- * @param entries pointer avl_tree of tlv block entries
+ * @param entries pointer to tlvblock
  * @param index of current address inside the addressblock, 0 for message tlv block
  * @return RFC5444_TLV_DROP_ADDRESS if the current address should
  *   be dropped for later consumers, RFC5444_TLV_DROP_CONTEXT if
@@ -654,7 +721,7 @@ cleanup_parse_tlvblock:
  */
 static enum rfc5444_result
 _schedule_tlvblock(struct rfc5444_reader_tlvblock_consumer *consumer, struct rfc5444_reader_tlvblock_context *context,
-    struct avl_tree *entries, uint8_t idx) {
+    struct rfc5444_reader_tlvblock *entries, uint8_t idx) {
   struct rfc5444_reader_tlvblock_entry *tlv = NULL;
   struct rfc5444_reader_tlvblock_consumer_entry *cons_entry;
   bool constraints_failed;
@@ -664,12 +731,12 @@ _schedule_tlvblock(struct rfc5444_reader_tlvblock_consumer *consumer, struct rfc
   constraints_failed = false;
 
   /* initialize tlv pointers, there must be TLVs */
-  if (avl_is_empty(entries)) {
+  if (entries->count == 0) {
     tlv = NULL;
     tlv_order = TLVTYPE_ORDER_INFINITE;
   }
   else {
-    tlv = avl_first_element(entries, tlv, node);
+    tlv = &entries->tlvs[0];
     tlv_order = tlv->int_order;
   }
 
@@ -768,12 +835,12 @@ _schedule_tlvblock(struct rfc5444_reader_tlvblock_consumer *consumer, struct rfc
     }
     if (tlv_order <= cons_order && tlv != NULL) {
       /* advance tlv pointer */
-      if (avl_is_last(entries, &tlv->node)) {
+      if (tlv == &entries->tlvs[entries->count - 1]) {
         tlv = NULL;
         tlv_order = TLVTYPE_ORDER_INFINITE;
       }
       else {
-        tlv = avl_next_element(tlv, node);
+        tlv++;
         tlv_order = tlv->int_order;
       }
     }
@@ -934,13 +1001,13 @@ _parse_addrblock(struct rfc5444_reader_addrblock_entry *addr_entry,
  * Call start and tlvblock callbacks for message tlv consumer
  * @param consumer pointer to tlvblock consumer object
  * @param tlv_context current tlv context
- * @param tlv_entries pointer to tlventry avltree
+ * @param tlv_entries pointer to tlvblock
  * @return RFC5444_OKAY if no error happend, RFC5444_DROP_ if a
  *   context (message or packet) should be dropped
  */
 static enum rfc5444_result
 schedule_msgtlv_consumer(struct rfc5444_reader_tlvblock_consumer *consumer,
-    struct rfc5444_reader_tlvblock_context *tlv_context, struct avl_tree *tlv_entries) {
+    struct rfc5444_reader_tlvblock_context *tlv_context, struct rfc5444_reader_tlvblock *tlv_entries) {
   enum rfc5444_result result = RFC5444_OKAY;
   tlv_context->type = RFC5444_CONTEXT_MESSAGE;
 
@@ -1081,20 +1148,22 @@ schedule_end_message_cbs(struct rfc5444_reader_tlvblock_context *tlv_context,
 static enum rfc5444_result
 _handle_message(struct rfc5444_reader *parser,
     struct rfc5444_reader_tlvblock_context *tlv_context, uint8_t **ptr, uint8_t *eob) {
-  struct avl_tree tlv_entries;
+  struct rfc5444_reader_tlvblock tlv_entries;
   struct rfc5444_reader_tlvblock_consumer *consumer, *same_order[2];
   struct list_entity addr_head;
   struct rfc5444_reader_addrblock_entry *addr, *safe;
   uint8_t *start, *end = NULL;
   uint8_t flags;
   uint16_t size;
+  size_t arena_mark;
 
   enum rfc5444_result result;
 
   /* initialize variables */
   result = RFC5444_OKAY;
+  arena_mark = parser->_arena_used;
   same_order[0] = same_order[1] = NULL;
-  avl_init(&tlv_entries, avl_comp_uint16, true, NULL);
+  memset(&tlv_entries, 0, sizeof(tlv_entries));
   list_init_head(&addr_head);
 
   /* remember start of message */
@@ -1158,25 +1227,33 @@ _handle_message(struct rfc5444_reader *parser,
   /* parse rest of message */
   while (*ptr < end) {
     /* get memory for storing the address block entry */
-    addr = parser->malloc_addrblock_entry();
+    addr = _arena_alloc(parser, sizeof(*addr));
+    if (addr == NULL) {
+      addr = parser->malloc_addrblock_entry();
+    }
     if (addr == NULL) {
       result = RFC5444_OUT_OF_MEMORY;
       goto cleanup_parse_message;
     }
 
-    /* initialize avl_tree */
-    avl_init(&addr->tlvblock, avl_comp_uint16, true, NULL);
+    /* initialize tlvblock */
+    addr->tlvblock.tlvs = NULL;
+    addr->tlvblock.count = 0;
 
     /* parse address block... */
     if ((result = _parse_addrblock(addr, tlv_context, ptr, end)) != RFC5444_OKAY) {
-      parser->free_addrblock_entry(addr);
+      if (!_is_arena_entry(parser, addr)) {
+        parser->free_addrblock_entry(addr);
+      }
       goto cleanup_parse_message;
     }
 
     /* ... and corresponding tlvblock */
     result = _parse_tlvblock(parser, &addr->tlvblock, ptr, end, addr->num_addr);
     if (result != RFC5444_OKAY) {
-      parser->free_addrblock_entry(addr);
+      if (!_is_arena_entry(parser, addr)) {
+        parser->free_addrblock_entry(addr);
+      }
       goto cleanup_parse_message;
     }
 
@@ -1263,11 +1340,16 @@ cleanup_parse_message:
   /* free address tlvblocks */
   list_for_each_element_safe(&addr_head, addr, list_node, safe) {
     _free_tlvblock(parser, &addr->tlvblock);
-    parser->free_addrblock_entry(addr);
+    if (!_is_arena_entry(parser, addr)) {
+      parser->free_addrblock_entry(addr);
+    }
   }
 
   /* free message tlvblock */
   _free_tlvblock(parser, &tlv_entries);
+
+  /* the next message reuses the arena */
+  parser->_arena_used = arena_mark;
   *ptr = end;
 #if DISALLOW_CONSUMER_CONTEXT_DROP == false
   if (result == RFC5444_DROP_MESSAGE) {
@@ -1358,12 +1440,49 @@ _malloc_addrblock_entry(void) {
 }
 
 /**
- * Internal memory allocation function for rfc5444_reader_tlvblock_entry
- * @return pointer to cleared rfc5444_reader_tlvblock_entry
+ * Internal memory allocation function for an array of
+ * rfc5444_reader_tlvblock_entry
+ * @param count number of entries
+ * @return pointer to cleared array
  */
 static struct rfc5444_reader_tlvblock_entry *
-_malloc_tlvblock_entry(void) {
-  return calloc(1, sizeof(struct rfc5444_reader_tlvblock_entry));
+_malloc_tlvblock_entries(size_t count) {
+  return calloc(count, sizeof(struct rfc5444_reader_tlvblock_entry));
+}
+
+/**
+ * Take cleared memory for a tlvblock or addrblock entry from the arena
+ * of the parser
+ * @param parser pointer to parser context
+ * @param size size of the entry
+ * @return pointer to entry, NULL if the arena is exhausted
+ */
+static void *
+_arena_alloc(struct rfc5444_reader *parser, size_t size) {
+  void *entry;
+
+  /* keep the pointers inside the entries aligned */
+  size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  if (parser->_arena_used + size > sizeof(parser->_arena)) {
+    return NULL;
+  }
+
+  entry = &parser->_arena[parser->_arena_used];
+  parser->_arena_used += size;
+  memset(entry, 0, size);
+  return entry;
+}
+
+/**
+ * @param parser pointer to parser context
+ * @param entry pointer to tlvblock or addrblock entry
+ * @return true if the entry was taken from the arena of the parser,
+ *   false if it was allocated by the malloc callbacks
+ */
+static bool
+_is_arena_entry(struct rfc5444_reader *parser, void *entry) {
+  return (uint8_t *)entry >= parser->_arena
+      && (uint8_t *)entry < parser->_arena + sizeof(parser->_arena);
 }
 
 /**
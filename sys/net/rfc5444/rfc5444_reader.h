@@ -46,6 +46,15 @@
 #include "sys/common/common_types.h"
 #include "rfc5444_context.h"
 
+/*
+ * Bytes of the arena the tlvblock and addrblock entries of a packet are
+ * taken from. The malloc callbacks of the reader are only used if a
+ * packet does not fit.
+ */
+#ifndef RFC5444_READER_ARENA_SIZE
+#define RFC5444_READER_ARENA_SIZE 2048
+#endif
+
 /* Bitarray with 256 elements for skipping addresses/tlvs */
 struct rfc5444_reader_bitarray256 {
   uint32_t a[256/32];
@@ -62,9 +71,6 @@ enum rfc5444_reader_tlvblock_context_type {
  * This struct temporary holds the content of a decoded TLV.
  */
 struct rfc5444_reader_tlvblock_entry {
-  /* single linked list of entries */
-  struct avl_node node;
-
   /* tlv type */
   uint8_t type;
 
@@ -102,6 +108,15 @@ struct rfc5444_reader_tlvblock_entry {
   struct rfc5444_reader_bitarray256 int_drop_tlv;
 };
 
+/* decoded TLVs of a TLV block */
+struct rfc5444_reader_tlvblock {
+  /* array of TLVs, sorted by int_order, same ones in packet order */
+  struct rfc5444_reader_tlvblock_entry *tlvs;
+
+  /* number of TLVs */
+  uint16_t count;
+};
+
 /* common context for packet, message and address TLV block */
 struct rfc5444_reader_tlvblock_context {
   /* backpointer to reader */
@@ -151,7 +166,7 @@ struct rfc5444_reader_addrblock_entry {
   struct list_entity list_node;
 
   /* corresponding tlv block */
-  struct avl_tree tlvblock;
+  struct rfc5444_reader_tlvblock tlvblock;
 
   /* number of addresses */
   uint8_t num_addr;
@@ -285,12 +300,16 @@ struct rfc5444_reader {
   /* callback for message forwarding */
   void (*forward_message)(struct rfc5444_reader_tlvblock_context *context, uint8_t *buffer, size_t length);
 
-  /* callbacks for memory management */
-  struct rfc5444_reader_tlvblock_entry* (*malloc_tlvblock_entry)(void);
+  /* callbacks for memory management if the arena is exhausted */
+  struct rfc5444_reader_tlvblock_entry* (*malloc_tlvblock_entries)(size_t count);
   struct rfc5444_reader_addrblock_entry* (*malloc_addrblock_entry)(void);
 
-  void (*free_tlvblock_entry)(void *);
+  void (*free_tlvblock_entries)(void *);
   void (*free_addrblock_entry)(void *);
+
+  /* arena for the entries of the packet being parsed */
+  size_t _arena_used;
+  uint8_t _arena[RFC5444_READER_ARENA_SIZE] __attribute__((aligned (8)));
 };
 
 EXPORT void rfc5444_reader_init(struct rfc5444_reader *);
@@ -54,7 +54,12 @@
 static struct rfc5444_writer_tlvtype *_register_addrtlvtype(
     struct rfc5444_writer_message *msg, uint8_t tlv, uint8_t tlvext);
 static int _msgaddr_avl_comp(const void *k1, const void *k2, void *ptr);
+static enum rfc5444_result _add_addrtlv(struct rfc5444_writer *writer,
+    struct rfc5444_writer_address *addr, struct rfc5444_writer_tlvtype *tlvtype,
+    const void *value, size_t length, bool allow_dup, bool copy);
 static void *_copy_addrtlv_value(struct rfc5444_writer *writer, const void *value, size_t length);
+static void *_arena_alloc(struct rfc5444_writer *writer, size_t size);
+static bool _is_arena_entry(struct rfc5444_writer *writer, void *entry);
 static void _free_tlvtype_tlvs(struct rfc5444_writer *writer, struct rfc5444_writer_tlvtype *tlvtype);
 static void _lazy_free_message(struct rfc5444_writer *writer, struct rfc5444_writer_message *msg);
 static struct rfc5444_writer_message *_get_message(struct rfc5444_writer *writer, uint8_t msgid);
@@ -73,7 +78,7 @@ _get_fulltype(uint8_t type, uint8_t exttype) {
 void
 rfc5444_writer_init(struct rfc5444_writer *writer) {
   assert (writer->msg_buffer != NULL && writer->msg_size > 0);
-  assert (writer->addrtlv_buffer != NULL && writer->addrtlv_size > 0);
+  assert (writer->addrtlv_buffer != NULL || writer->addrtlv_size == 0);
 
   /* set default memory handler functions */
   if (!writer->malloc_address_entry)
@@ -87,6 +92,9 @@ rfc5444_writer_init(struct rfc5444_writer *writer) {
 
   list_init_head(&writer->_interfaces);
 
+  writer->_addrtlv_used = 0;
+  writer->_arena_used = 0;
+
   /* initialize packet buffer */
   writer->_msg.buffer = writer->msg_buffer;
   _rfc5444_tlv_writer_init(&writer->_msg, 0, writer->msg_size);
@@ -166,6 +174,48 @@ rfc5444_writer_cleanup(struct rfc5444_writer *writer) {
 enum rfc5444_result
 rfc5444_writer_add_addrtlv(struct rfc5444_writer *writer, struct rfc5444_writer_address *addr,
     struct rfc5444_writer_tlvtype *tlvtype, const void *value, size_t length, bool allow_dup) {
+  return _add_addrtlv(writer, addr, tlvtype, value, length, allow_dup, true);
+}
+
+/**
+ * Adds a tlv to an address without copying its value into the addrtlv
+ * buffer. The value must stay unchanged until the message has been
+ * created. Addresses using the same pointer for a value are compared
+ * without looking at the value.
+ * This function must not be called outside the message_addresses callback.
+ *
+ * @param writer pointer to writer context
+ * @param addr pointer to address object
+ * @param tlvtype pointer to predefined tlvtype object
+ * @param value pointer to value or NULL if no value
+ * @param length length of value in bytes or 0 if no value
+ * @param allow_dup true if multiple TLVs of the same type are allowed,
+ *   false otherwise
+ * @return RFC5444_OKAY if tlv has been added successfully, RFC5444_... otherwise
+ */
+enum rfc5444_result
+rfc5444_writer_add_addrtlv_ref(struct rfc5444_writer *writer, struct rfc5444_writer_address *addr,
+    struct rfc5444_writer_tlvtype *tlvtype, const void *value, size_t length, bool allow_dup) {
+  return _add_addrtlv(writer, addr, tlvtype, value, length, allow_dup, false);
+}
+
+/**
+ * Adds a tlv to an address.
+ * @param writer pointer to writer context
+ * @param addr pointer to address object
+ * @param tlvtype pointer to predefined tlvtype object
+ * @param value pointer to value or NULL if no value
+ * @param length length of value in bytes or 0 if no value
+ * @param allow_dup true if multiple TLVs of the same type are allowed,
+ *   false otherwise
+ * @param copy true if the value is copied into the addrtlv buffer,
+ *   false if it is referenced
+ * @return RFC5444_OKAY if tlv has been added successfully, RFC5444_... otherwise
+ */
+static enum rfc5444_result
+_add_addrtlv(struct rfc5444_writer *writer, struct rfc5444_writer_address *addr,
+    struct rfc5444_writer_tlvtype *tlvtype, const void *value, size_t length,
+    bool allow_dup, bool copy) {
   struct rfc5444_writer_addrtlv *addrtlv;
 
 #if WRITER_STATE_MACHINE == true
@@ -177,7 +227,8 @@ rfc5444_writer_add_addrtlv(struct rfc5444_writer *writer, struct rfc5444_writer_
     return RFC5444_DUPLICATE_TLV;
   }
 
-  if ((addrtlv = writer->malloc_addrtlv_entry()) == NULL) {
+  addrtlv = _arena_alloc(writer, sizeof(*addrtlv));
+  if (addrtlv == NULL && (addrtlv = writer->malloc_addrtlv_entry()) == NULL) {
     /* out of memory error */
     return RFC5444_OUT_OF_MEMORY;
   }
@@ -186,10 +237,15 @@ rfc5444_writer_add_addrtlv(struct rfc5444_writer *writer, struct rfc5444_writer_
   addrtlv->address = addr;
   addrtlv->tlvtype = tlvtype;
 
-  /* copy value(length) */
+  /* copy or reference value(length) */
   addrtlv->length = length;
-  if (length > 0 && (addrtlv->value = _copy_addrtlv_value(writer, value, length)) == NULL) {
-    writer->free_addrtlv_entry(addrtlv);
+  if (length > 0 && !copy) {
+    addrtlv->value = value;
+  }
+  else if (length > 0 && (addrtlv->value = _copy_addrtlv_value(writer, value, length)) == NULL) {
+    if (!_is_arena_entry(writer, addrtlv)) {
+      writer->free_addrtlv_entry(addrtlv);
+    }
     return RFC5444_OUT_OF_ADDRTLV_MEM;
   }
 
@@ -252,7 +308,8 @@ rfc5444_writer_add_address(struct rfc5444_writer *writer __attribute__ ((unused)
 
 
   if (address == NULL) {
-    if ((address = writer->malloc_address_entry()) == NULL) {
+    address = _arena_alloc(writer, sizeof(*address));
+    if (address == NULL && (address = writer->malloc_address_entry()) == NULL) {
       return NULL;
     }
 
@@ -684,7 +741,9 @@ _free_tlvtype_tlvs(struct rfc5444_writer *writer, struct rfc5444_writer_tlvtype
   avl_remove_all_elements(&tlvtype->_tlv_tree, addrtlv, tlv_node, ptr) {
     /* remove from address too */
     avl_remove(&addrtlv->address->_addrtlv_tree, &addrtlv->addrtlv_node);
-    writer->free_addrtlv_entry(addrtlv);
+    if (!_is_arena_entry(writer, addrtlv)) {
+      writer->free_addrtlv_entry(addrtlv);
+    }
   }
 }
 
@@ -700,13 +759,18 @@ _rfc5444_writer_free_addresses(struct rfc5444_writer *writer, struct rfc5444_wri
     avl_remove_all_elements(&addr->_addrtlv_tree, addrtlv, addrtlv_node, safe_addrtlv) {
       /* remove from tlvtype too */
       avl_remove(&addrtlv->tlvtype->_tlv_tree, &addrtlv->tlv_node);
-      writer->free_addrtlv_entry(addrtlv);
+      if (!_is_arena_entry(writer, addrtlv)) {
+        writer->free_addrtlv_entry(addrtlv);
+      }
+    }
+    if (!_is_arena_entry(writer, addr)) {
+      writer->free_address_entry(addr);
     }
-    writer->free_address_entry(addr);
   }
 
-  /* allow overwriting of addrtlv-value buffer */
+  /* allow overwriting of addrtlv-value buffer and arena */
   writer->_addrtlv_used = 0;
+  writer->_arena_used = 0;
 }
 /**
  * Free message object if not in use anymore
@@ -739,3 +803,38 @@ static struct rfc5444_writer_addrtlv*
 _malloc_addrtlv_entry(void) {
   return calloc(1, sizeof(struct rfc5444_writer_addrtlv));
 }
+
+/**
+ * Take cleared memory for an address or address tlv object from the
+ * arena of the writer
+ * @param writer pointer to writer context
+ * @param size size of the object
+ * @return pointer to object, NULL if the arena is exhausted
+ */
+static void *
+_arena_alloc(struct rfc5444_writer *writer, size_t size) {
+  void *entry;
+
+  /* keep the pointers inside the objects aligned */
+  size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  if (writer->_arena_used + size > sizeof(writer->_arena)) {
+    return NULL;
+  }
+
+  entry = &writer->_arena[writer->_arena_used];
+  writer->_arena_used += size;
+  memset(entry, 0, size);
+  return entry;
+}
+
+/**
+ * @param writer pointer to writer context
+ * @param entry pointer to address or address tlv object
+ * @return true if the object was taken from the arena of the writer,
+ *   false if it was allocated by the malloc callbacks
+ */
+static bool
+_is_arena_entry(struct rfc5444_writer *writer, void *entry) {
+  return (uint8_t *)entry >= writer->_arena
+      && (uint8_t *)entry < writer->_arena + sizeof(writer->_arena);
+}
@@ -51,6 +51,15 @@ struct rfc5444_writer_message;
 #include "rfc5444_context.h"
 #include "rfc5444_tlv_writer.h"
 
+/*
+ * Bytes of the arena the address and address tlv objects of a message
+ * are taken from. The malloc callbacks of the writer are only used if
+ * a message does not fit.
+ */
+#ifndef RFC5444_WRITER_ARENA_SIZE
+#define RFC5444_WRITER_ARENA_SIZE 2048
+#endif
+
 /*
  * Macros to iterate over existing addresses in a message(fragment)
  * during message generation (finishMessageHeader/finishMessageTLVs
@@ -105,7 +114,7 @@ struct rfc5444_writer_addrtlv {
    * use the same storage for the value (the pointer should
    * be the same)
    */
-  void *value;
+  const void *value;
 
   /*
    * true if the TLV has the same length/value for the
@@ -300,6 +309,8 @@ struct rfc5444_writer_interface {
   /* callback for interface specific packet handling */
   void (*addPacketHeader)(struct rfc5444_writer *, struct rfc5444_writer_interface *);
   void (*finishPacketHeader)(struct rfc5444_writer *, struct rfc5444_writer_interface *);
+
+  /* gets the packet in place, somewhere inside packet_buffer */
   void (*sendPacket)(struct rfc5444_writer *, struct rfc5444_writer_interface *, void *, size_t);
 
   /* internal handling for packet sequence numbers */
@@ -343,11 +354,17 @@ struct rfc5444_writer {
   /* length of message buffer */
   size_t msg_size;
 
-  /* buffer for addrtlv values of a message */
+  /*
+   * buffer for copied addrtlv values of a message,
+   * NULL if all values are referenced
+   */
   uint8_t *addrtlv_buffer;
   size_t addrtlv_size;
 
-  /* callbacks for memory management, NULL for calloc()/free() */
+  /*
+   * callbacks for memory management if the arena is exhausted,
+   * NULL for calloc()/free()
+   */
   struct rfc5444_writer_address* (*malloc_address_entry)(void);
   struct rfc5444_writer_addrtlv* (*malloc_addrtlv_entry)(void);
 
@@ -369,6 +386,10 @@ struct rfc5444_writer {
   /* number of bytes of addrtlv buffer currently used */
   size_t _addrtlv_used;
 
+  /* arena for the addresses and address tlvs of the current message */
+  size_t _arena_used;
+  uint8_t _arena[RFC5444_WRITER_ARENA_SIZE] __attribute__((aligned (8)));
+
   /* internal state of writer */
   enum rfc5444_internal_state _state;
 };
@@ -379,6 +400,9 @@ EXPORT struct rfc5444_writer_address *rfc5444_writer_add_address(struct rfc5444_
 EXPORT enum rfc5444_result rfc5444_writer_add_addrtlv(struct rfc5444_writer *writer,
     struct rfc5444_writer_address *addr, struct rfc5444_writer_tlvtype *tlvtype,
     const void *value, size_t length, bool allow_dup);
+EXPORT enum rfc5444_result rfc5444_writer_add_addrtlv_ref(struct rfc5444_writer *writer,
+    struct rfc5444_writer_address *addr, struct rfc5444_writer_tlvtype *tlvtype,
+    const void *value, size_t length, bool allow_dup);
 
 /* functions that can be called from add/finishMessageTLVs callback */
 EXPORT enum rfc5444_result rfc5444_writer_add_messagetlv(struct rfc5444_writer *writer,
@@ -2,6 +2,7 @@
 #include <string.h>
 
 #include <board_uart0.h>
+#include <mutex.h>
 
 #include "flowcontrol.h"
 #include "sixlowpan.h"
@@ -16,6 +17,15 @@
 #define END_ESC     0xDC
 #define ESC_ESC     0xDD
 
+#define SERIAL_IN_CHUNK     (32)
+
+/* bytes already fetched from uart0 but not yet parsed */
+static uint8_t serial_in[SERIAL_IN_CHUNK];
+static int serial_in_pos;
+static int serial_in_len;
+
+static mutex_t serial_out_mutex;
+
 void demultiplex(border_packet_t *packet, int len) {
     switch (packet->type) {
         case (BORDER_PACKET_RAW_TYPE):{
@@ -97,13 +107,27 @@ void multiplex_send_addr_over_uart(ipv6_addr_t *addr) {
     flowcontrol_send_over_uart((border_packet_t *) serial_buf, sizeof (border_addr_packet_t));
 }
 
+/* fetches whole chunks from uart0, one message per chunk instead of per byte */
+static uint8_t serial_readc(void) {
+    if (serial_in_pos == serial_in_len) {
+        serial_in_len = uart0_read((char *)serial_in, sizeof(serial_in));
+        serial_in_pos = 0;
+        if (serial_in_len <= 0) {
+            /* uart0 not opened, end the packet */
+            serial_in_len = 0;
+            return END;
+        }
+    }
+    return serial_in[serial_in_pos++];
+}
+
 int readpacket(uint8_t *packet_buf, size_t size) {
     uint8_t *line_buf_ptr = packet_buf;
     uint8_t byte = END+1;
     uint8_t esc = 0;
     
     while (1) {
-        byte = uart0_readc();
+        byte = serial_readc();
         
         if (byte == END) {
             break;
@@ -137,37 +161,42 @@ int readpacket(uint8_t *packet_buf, size_t size) {
         *line_buf_ptr++ = byte;
     }
     
-    return (line_buf_ptr - packet_buf - 1);
+    return (line_buf_ptr - packet_buf);
 }
 
 int writepacket(uint8_t *packet_buf, size_t size) {
     uint8_t *byte_ptr = packet_buf;
     
+    if (size > BORDER_BUFFER_SIZE) {
+        return -1;
+    }
+    
+    /* ACKs and retransmissions come from other threads than the packets */
+    mutex_lock(&serial_out_mutex);
+    
     while ((byte_ptr - packet_buf) < size) {
-        if ((byte_ptr - packet_buf) > BORDER_BUFFER_SIZE) {
-            return -1;
-        }
-        
         switch (*byte_ptr) {
             case(END):{
-                *byte_ptr = END_ESC;
                 uart0_putc(ESC);
+                uart0_putc(END_ESC);
                 break;
             }
             case(ESC):{
-                *byte_ptr = ESC_ESC;
                 uart0_putc(ESC);
+                uart0_putc(ESC_ESC);
                 break;
             }
             default:{
+                uart0_putc(*byte_ptr);
                 break;
             }
         }
-        uart0_putc(*byte_ptr);
         byte_ptr++;
     }
     
     uart0_putc(END);
     
+    mutex_unlock(&serial_out_mutex, 0);
+    
     return (byte_ptr - packet_buf);
 }
@@ -10,7 +10,7 @@
 #include "flowcontrol.h"
 
 
-static int set_timeout(vtimer_t *timeout, long useconds, void *args);
+static void set_timeout(void);
 static void sending_slot(void);
 
 char sending_slot_stack[SENDING_SLOT_STACK_SIZE];
@@ -20,80 +20,186 @@ flowcontrol_stat_t slwin_stat;
 sem_t connection_established;
 int16_t synack_seqnum = -1;
 
+static uint32_t now_us(void) {
+    timex_t now = vtimer_now();
+    return now.seconds * 1000000 + now.microseconds;
+}
+
+static void transmit(struct send_slot *slot) {
+    slot->tx = ++slwin_stat.transmissions;
+    writepacket(slot->frame, slot->frame_len);
+}
+
+/*
+ * An acknowledged frame got through after everything transmitted before,
+ * unless it was retransmitted: the acknowledgement may be the first one's.
+ */
+static void delivered(struct send_slot *slot) {
+    if (!slot->retransmitted &&
+            (int16_t)(slot->tx - slwin_stat.delivered_tx) > 0) {
+        slwin_stat.delivered_tx = slot->tx;
+    }
+}
+
 ipv6_addr_t init_threeway_handshake() {
     border_syn_packet_t *syn;
+    border_synack_packet_t synack;
     msg_t m;
     m.content.ptr = NULL;
     msg_send(&m,border_get_serial_reader(),1);
     msg_receive(&m);
-        
+
+    /* the serial reader passes the SYN's length in the type field */
     syn = (border_syn_packet_t *)m.content.ptr;
-    border_conf_header_t *synack = (border_conf_header_t *)get_serial_out_buffer(0);
     ipv6_addr_t addr;
     memcpy(&addr, &(syn->addr), sizeof (ipv6_addr_t));
-    
+
     slwin_stat.next_exp = syn->next_seq_num;
     slwin_stat.last_frame = syn->next_exp - 1;
     slwin_stat.last_ack = slwin_stat.last_frame;
-    
-    synack->empty = 0;
-    synack->type = BORDER_PACKET_CONF_TYPE;
-    synack->conftype = BORDER_CONF_SYNACK;
-    
-    sending_slot_pid = thread_create(sending_slot_stack, SENDING_SLOT_STACK_SIZE, PRIORITY_MAIN-1, CREATE_SLEEPING, sending_slot, "sending slot");
-    flowcontrol_send_over_uart((border_packet_t *)synack, sizeof (border_conf_header_t));
-    
-    synack_seqnum = synack->seq_num;
-        
+
+    /* never more frames in flight than the driver can take, older
+     * drivers do not announce a window, they take one frame */
+    slwin_stat.send_win_size = BORDER_SWS;
+    if (m.type < sizeof (border_syn_packet_t)) {
+        slwin_stat.send_win_size = 1;
+    }
+    else if (syn->window < slwin_stat.send_win_size) {
+        slwin_stat.send_win_size = (syn->window > 0) ? syn->window : 1;
+    }
+    sem_init(&slwin_stat.send_win_not_full, slwin_stat.send_win_size);
+
+    synack.empty = 0;
+    synack.type = BORDER_PACKET_CONF_TYPE;
+    synack.conftype = BORDER_CONF_SYNACK;
+    synack.window = BORDER_RWS;
+
+    sending_slot_pid = thread_create(sending_slot_stack, SENDING_SLOT_STACK_SIZE, PRIORITY_MAIN-1, CREATE_STACKTEST, sending_slot, "sending slot");
+    flowcontrol_send_over_uart((border_packet_t *)&synack, sizeof (border_synack_packet_t));
+
+    synack_seqnum = synack.seq_num;
+
     return addr;
 }
 
 ipv6_addr_t flowcontrol_init() {
     int i;
-    
-    sem_init(&slwin_stat.send_win_not_full,BORDER_SWS);
-    for(i = 0; i < BORDER_SWS; i++) {
-        slwin_stat.send_win[i].frame_len = 0;
-    }
+
+    mutex_init(&slwin_stat.mutex);
     memset(&slwin_stat.send_win,0, sizeof(struct send_slot) * BORDER_SWS);
-        
+    slwin_stat.srtt = 0;
+    slwin_stat.rttvar = 0;
+    slwin_stat.rto = BORDER_SL_TIMEOUT;
+    slwin_stat.transmissions = 0;
+    slwin_stat.delivered_tx = 0;
+
     for(i = 0; i < BORDER_RWS; i++) {
         slwin_stat.recv_win[i].received = 0;
         slwin_stat.recv_win[i].frame_len = 0;
     }
     memset(&slwin_stat.recv_win,0, sizeof(struct recv_slot) * BORDER_RWS);
-    
+
     return init_threeway_handshake();
 }
 
+/* retransmits every frame of the window whose timeout is due */
+static void retransmit(void) {
+    uint32_t now = now_us();
+    uint8_t seq_num, expired = 0;
+    struct send_slot *slot;
+
+    for (seq_num = slwin_stat.last_ack + 1; seq_num != (uint8_t)(slwin_stat.last_frame + 1); seq_num++) {
+        slot = &(slwin_stat.send_win[seq_num % BORDER_SWS]);
+        if (!slot->acked && (int32_t)(now - slot->deadline) >= 0) {
+            transmit(slot);
+            slot->retransmitted = 1;
+            expired = 1;
+        }
+    }
+
+    if (!expired) {
+        return;
+    }
+
+    /* back off once per timeout, restarting the timer of the whole window */
+    slwin_stat.rto = (2 * slwin_stat.rto < BORDER_RTO_MAX) ? 2 * slwin_stat.rto : BORDER_RTO_MAX;
+
+    for (seq_num = slwin_stat.last_ack + 1; seq_num != (uint8_t)(slwin_stat.last_frame + 1); seq_num++) {
+        slot = &(slwin_stat.send_win[seq_num % BORDER_SWS]);
+        if (!slot->acked) {
+            slot->deadline = now + slwin_stat.rto;
+        }
+    }
+}
+
 static void sending_slot(void) {
     msg_t m;
-    uint8_t seq_num;
-    struct send_slot *slot;
-    border_packet_t *tmp;
 
     while(1) {
         msg_receive(&m);
-        seq_num = *((uint8_t *)m.content.ptr);
-        slot = &(slwin_stat.send_win[seq_num % BORDER_SWS]);
-        tmp = (border_packet_t*) slot->frame;
+        if (m.type != MSG_TIMER) {
+            continue;
+        }
 
-        if (seq_num == tmp->seq_num) {
-            writepacket(slot->frame,slot->frame_len);
-            
-            if (set_timeout(&slot->timeout, BORDER_SL_TIMEOUT, (void*) m.content.ptr) != 0) {
-                printf("ERROR: Error invoking timeout timer\n");
-            }
+        mutex_lock(&slwin_stat.mutex);
+        retransmit();
+        set_timeout();
+        mutex_unlock(&slwin_stat.mutex, 0);
+    }
+}
+
+/* sets the one timer of the window to its earliest retransmission */
+static void set_timeout(void) {
+    uint32_t now = now_us();
+    int32_t next = 0, left;
+    uint8_t seq_num, pending = 0;
+    struct send_slot *slot;
+
+    vtimer_remove(&slwin_stat.timeout);
+
+    for (seq_num = slwin_stat.last_ack + 1; seq_num != (uint8_t)(slwin_stat.last_frame + 1); seq_num++) {
+        slot = &(slwin_stat.send_win[seq_num % BORDER_SWS]);
+        if (slot->acked) {
+            continue;
         }
+        left = (int32_t)(slot->deadline - now);
+        if (!pending || left < next) {
+            next = left;
+            pending = 1;
+        }
+    }
+
+    if (!pending) {
+        return;
+    }
+
+    if (next < 1) {
+        next = 1;
     }
+    vtimer_set_msg(&slwin_stat.timeout, timex_set(next / 1000000, next % 1000000), sending_slot_pid, NULL);
 }
 
-static int set_timeout(vtimer_t *timeout, long useconds, void *args) {
-    timex_t interval;
-    interval.seconds = useconds / 1000000;
-    interval.microseconds = (useconds % 1000000) * 1000;
-   
-    return vtimer_set_msg(timeout, interval, sending_slot_pid, args);
+/* Jacobson/Karels estimate, as for TCP (RFC 6298) */
+static void update_rto(uint32_t rtt) {
+    uint32_t delta;
+
+    if (slwin_stat.srtt == 0) {
+        slwin_stat.srtt = rtt;
+        slwin_stat.rttvar = rtt / 2;
+    }
+    else {
+        delta = (slwin_stat.srtt > rtt) ? slwin_stat.srtt - rtt : rtt - slwin_stat.srtt;
+        slwin_stat.rttvar = (3 * slwin_stat.rttvar + delta) / 4;
+        slwin_stat.srtt = (7 * slwin_stat.srtt + rtt) / 8;
+    }
+
+    slwin_stat.rto = slwin_stat.srtt + 4 * slwin_stat.rttvar;
+    if (slwin_stat.rto < BORDER_RTO_MIN) {
+        slwin_stat.rto = BORDER_RTO_MIN;
+    }
+    else if (slwin_stat.rto > BORDER_RTO_MAX) {
+        slwin_stat.rto = BORDER_RTO_MAX;
+    }
 }
 
 static int in_window(uint8_t seq_num, uint8_t min, uint8_t max) {
@@ -104,65 +210,139 @@ static int in_window(uint8_t seq_num, uint8_t min, uint8_t max) {
 
 void flowcontrol_send_over_uart(border_packet_t *packet, int len) {
     struct send_slot *slot;
-    uint8_t args[] = {packet->seq_num};
-    
+
     sem_wait(&(slwin_stat.send_win_not_full));
+    mutex_lock(&slwin_stat.mutex);
+
     packet->seq_num = ++slwin_stat.last_frame;
     slot = &(slwin_stat.send_win[packet->seq_num % BORDER_SWS]);
     memcpy(slot->frame, (uint8_t *)packet, len);
     slot->frame_len = len;
-    if (set_timeout(&slot->timeout, BORDER_SL_TIMEOUT, (void *)args) != 0) {
-        printf("ERROR: Error invoking timeout timer\n");
-        return;
-    }
-    writepacket((uint8_t *)packet, len);
+    slot->sent = now_us();
+    slot->deadline = slot->sent + slwin_stat.rto;
+    slot->acked = 0;
+    slot->retransmitted = 0;
+
+    transmit(slot);
+    set_timeout();
+
+    mutex_unlock(&slwin_stat.mutex, 0);
 }
 
 void send_ack(uint8_t seq_num) {
-    border_packet_t *packet = (border_packet_t *)get_serial_out_buffer(0);
-    packet->empty = 0;
-    packet->type = BORDER_PACKET_ACK_TYPE;
-    packet->seq_num = seq_num;
-    writepacket((uint8_t *)packet, sizeof (border_packet_t));
+    border_ack_packet_t packet;
+    uint8_t i;
+
+    packet.empty = 0;
+    packet.type = BORDER_PACKET_ACK_TYPE;
+    packet.seq_num = seq_num;
+    memset(packet.sack, 0, BORDER_SACK_LEN);
+
+    /* frames received behind the gap at seq_num + 1 */
+    for (i = 0; i < BORDER_RWS - 1; i++) {
+        if (slwin_stat.recv_win[(uint8_t)(seq_num + 2 + i) % BORDER_RWS].received) {
+            packet.sack[i / 8] |= 1 << (i % 8);
+        }
+    }
+
+    writepacket((uint8_t *)&packet, sizeof (border_ack_packet_t));
 }
 
-void flowcontrol_deliver_from_uart(border_packet_t *packet, int len) {
-    if (packet->type == BORDER_PACKET_ACK_TYPE) {
-        if (in_window(packet->seq_num, slwin_stat.last_ack+1, slwin_stat.last_frame)) {
-            if (synack_seqnum == packet->seq_num) {
-                synack_seqnum = -1;
-                sem_signal(&connection_established);
+static void deliver_ack(border_ack_packet_t *ack, int len) {
+    struct send_slot *slot;
+    uint32_t now = now_us();
+    int32_t rtt = -1;
+    uint8_t i, seq_num;
+
+    mutex_lock(&slwin_stat.mutex);
+
+    /* older drivers acknowledge without them */
+    if (len >= sizeof (border_ack_packet_t)) {
+        for (i = 0; i < 8 * BORDER_SACK_LEN; i++) {
+            seq_num = ack->seq_num + 2 + i;
+            if ((ack->sack[i / 8] & (1 << (i % 8))) &&
+                    in_window(seq_num, slwin_stat.last_ack+1, slwin_stat.last_frame)) {
+                slot = &(slwin_stat.send_win[seq_num % BORDER_SWS]);
+                /* round trips only from frames first acknowledged now (Karn) */
+                if (!slot->acked && !slot->retransmitted) {
+                    rtt = now - slot->sent;
+                }
+                slot->acked = 1;
+                delivered(slot);
             }
-            do {
-                struct send_slot *slot;
-                slot = &(slwin_stat.send_win[++slwin_stat.last_ack % BORDER_SWS]);
-                vtimer_remove(&slot->timeout);
-                memset(&slot->frame,0,BORDER_BUFFER_SIZE);
-                sem_signal(&slwin_stat.send_win_not_full);
-            } while (slwin_stat.last_ack != packet->seq_num);
         }
+    }
+
+    if (in_window(ack->seq_num, slwin_stat.last_ack+1, slwin_stat.last_frame)) {
+        if (synack_seqnum == ack->seq_num) {
+            synack_seqnum = -1;
+            sem_signal(&connection_established);
+        }
+
+        slot = &(slwin_stat.send_win[ack->seq_num % BORDER_SWS]);
+        if (rtt < 0 && !slot->acked && !slot->retransmitted) {
+            rtt = now - slot->sent;
+        }
+
+        do {
+            slot = &(slwin_stat.send_win[++slwin_stat.last_ack % BORDER_SWS]);
+            delivered(slot);
+            slot->acked = 0;
+            slot->frame_len = 0;
+            sem_signal(&slwin_stat.send_win_not_full);
+        } while (slwin_stat.last_ack != ack->seq_num);
+    }
+
+    if (rtt >= 0) {
+        update_rto(rtt);
+    }
+
+    /*
+     * The UART keeps frames in order, those transmitted before an
+     * acknowledged one are lost: repeat them without waiting for the
+     * timeout.
+     */
+    for (seq_num = slwin_stat.last_ack + 1; seq_num != (uint8_t)(slwin_stat.last_frame + 1); seq_num++) {
+        slot = &(slwin_stat.send_win[seq_num % BORDER_SWS]);
+        if (!slot->acked && (int16_t)(slot->tx - slwin_stat.delivered_tx) < 0) {
+            transmit(slot);
+            slot->retransmitted = 1;
+            slot->deadline = now + slwin_stat.rto;
+        }
+    }
+
+    set_timeout();
+
+    mutex_unlock(&slwin_stat.mutex, 0);
+}
+
+void flowcontrol_deliver_from_uart(border_packet_t *packet, int len) {
+    if (packet->type == BORDER_PACKET_ACK_TYPE) {
+        deliver_ack((border_ack_packet_t *)packet, len);
     } else {
         struct recv_slot *slot;
-        
+
         slot = &(slwin_stat.recv_win[packet->seq_num % BORDER_RWS]);
-        if (    !in_window(packet->seq_num, 
-                slwin_stat.next_exp, 
-                slwin_stat.next_exp + BORDER_RWS - 1)) {
-            return;
+
+        /*
+         * Frames before the window were delivered already, their ACK got
+         * lost, so it is repeated below.
+         */
+        if (    in_window(packet->seq_num,
+                slwin_stat.next_exp,
+                slwin_stat.next_exp + BORDER_RWS - 1) && !slot->received) {
+            memcpy(slot->frame, (uint8_t *)packet, len);
+            slot->frame_len = len;
+            slot->received = 1;
         }
-        
-        memcpy(slot->frame, (uint8_t *)packet, len);
-        slot->received = 1;
-        
-        if (packet->seq_num == slwin_stat.next_exp) {
-            while (slot->received) {
-                demultiplex((border_packet_t *)slot->frame, slot->frame_len);
-                memset(&slot->frame,0,BORDER_BUFFER_SIZE);
-                slot->received = 0;
-                slot = &slwin_stat.recv_win[++(slwin_stat.next_exp) % BORDER_RWS];
-            }
+
+        slot = &(slwin_stat.recv_win[slwin_stat.next_exp % BORDER_RWS]);
+        while (slot->received) {
+            demultiplex((border_packet_t *)slot->frame, slot->frame_len);
+            slot->received = 0;
+            slot = &slwin_stat.recv_win[++(slwin_stat.next_exp) % BORDER_RWS];
         }
-        
+
         send_ack(slwin_stat.next_exp - 1);
     }
 }
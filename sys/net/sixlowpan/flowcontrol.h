@@ -2,6 +2,7 @@
 #define FLOWCONTROL_H
 
 #include <stdint.h>
+#include <mutex.h>
 #include <vtimer.h>
 
 #include "semaphore.h"
@@ -16,23 +17,57 @@
 #define BORDER_CONF_SYN           0
 #define BORDER_CONF_SYNACK        1
 
-#define BORDER_SWS                1
-#define BORDER_RWS                1
-#define BORDER_SL_TIMEOUT         500 // microseconds, maybe smaller
+/*
+ * Selective repeat: the sending window in use is the smaller of
+ * BORDER_SWS and the receiving window the driver announces in its SYN,
+ * the driver's likewise.
+ */
+#ifndef BORDER_SWS
+#define BORDER_SWS                16
+#endif
+#ifndef BORDER_RWS
+#define BORDER_RWS                16
+#endif
+#define BORDER_SACK_LEN           8     // bytes of selective acknowledgements
 
-#define SENDING_SLOT_STACK_SIZE     (256)
+#if BORDER_RWS > 8 * BORDER_SACK_LEN + 1
+#error "BORDER_RWS must not exceed 8 * BORDER_SACK_LEN + 1"
+#endif
+/* slots are indexed by sequence number modulo window size */
+#if (BORDER_SWS & (BORDER_SWS - 1)) || (BORDER_RWS & (BORDER_RWS - 1))
+#error "BORDER_SWS and BORDER_RWS must be powers of two"
+#endif
+
+/* retransmission timeout in microseconds, adapted to the round trip time */
+#define BORDER_SL_TIMEOUT         500000    // until the first round trip is measured
+#define BORDER_RTO_MIN            20000
+#define BORDER_RTO_MAX            4000000
+
+#define SENDING_SLOT_STACK_SIZE     (512)
 
 typedef struct flowcontrol_stat_t {
     /* Sender state */
     uint8_t last_ack;
     uint8_t last_frame;
+    uint8_t send_win_size;
     sem_t send_win_not_full;
+    mutex_t mutex;              // sender state, shared with the retransmitter
+    vtimer_t timeout;           // earliest retransmission of the window
+    uint32_t srtt;              // smoothed round trip time, 0 until measured
+    uint32_t rttvar;
+    uint32_t rto;
+    uint16_t transmissions;     // frames written, retransmissions included
+    uint16_t delivered_tx;      // latest transmission of an acknowledged frame
     struct send_slot {
-        vtimer_t timeout; 
+        uint32_t sent;          // time of the first transmission
+        uint32_t deadline;      // time of the next retransmission
+        uint8_t acked;          // selectively acknowledged
+        uint8_t retransmitted;  // no round trip sample then (Karn)
+        uint16_t tx;            // transmissions at the last one of the frame
         uint8_t frame[BORDER_BUFFER_SIZE];
         size_t frame_len;
     } send_win[BORDER_SWS];
-    
+
     /* Receiver state */
     uint8_t next_exp;
     struct recv_slot {
@@ -49,8 +84,28 @@ typedef struct __attribute__ ((packed)) border_syn_packet_t {
     uint8_t conftype;
     uint8_t next_exp;
     ipv6_addr_t addr;
+    uint8_t window;             // receiving window of the driver
 } border_syn_packet_t;
 
+typedef struct __attribute__ ((packed)) border_synack_packet_t {
+    uint8_t empty;
+    uint8_t type;
+    uint8_t seq_num;
+    uint8_t conftype;
+    uint8_t window;             // our receiving window
+} border_synack_packet_t;
+
+/*
+ * Acknowledges all frames up to seq_num, bit i of sack (LSB of sack[0]
+ * first) frame seq_num + 2 + i on top.
+ */
+typedef struct __attribute__ ((packed)) border_ack_packet_t {
+    uint8_t empty;
+    uint8_t type;
+    uint8_t seq_num;
+    uint8_t sack[BORDER_SACK_LEN];
+} border_ack_packet_t;
+
 ipv6_addr_t flowcontrol_init();
 void flowcontrol_send_over_uart(border_packet_t *packet, int len);
 void flowcontrol_deliver_from_uart(border_packet_t *packet, int len);
@@ -18,6 +18,12 @@ char rpl_process_buf[RPL_PROCESS_STACKSIZE];
 char i_am_root = 0;
 rpl_of_t *objective_functions[NUMBER_IMPLEMENTED_OFS];
 rpl_routing_entry_t routing_table[RPL_MAX_ROUTING_ENTRIES];
+//host routes by the hash of their address, prefix routes sorted by falling
+//length and unused entries are chained through routing_table[].next
+static uint8_t routing_hash[RPL_ROUTING_HASH_SIZE];
+static uint8_t prefix_routes;
+static uint8_t free_routes = RPL_ROUTING_END;
+static uint32_t next_expiry;
 unsigned int rpl_process_pid;
 ipv6_addr_t my_address;
 mutex_t rpl_send_mutex;
@@ -164,6 +170,7 @@ uint8_t rpl_init(transceiver_type_t trans, uint16_t rpl_address){
 	ipv6_set_ll_prefix(&ll_address);
     ipv6_get_saddr(&my_address, &ll_address);
 	set_rpl_process_pid(rpl_process_pid);
+	set_rpl_forward_handler(rpl_forward);
 
 	//some fake routing entries...
 	/*if(rpl_address != 1){
@@ -311,8 +318,16 @@ void send_DAO(ipv6_addr_t *destination, uint8_t lifetime, bool default_lifetime,
 	mutex_lock(&rpl_send_mutex);
 	rpl_dodag_t * my_dodag;
 	my_dodag = rpl_get_my_dodag();
+	if(my_dodag == NULL || my_dodag->my_preferred_parent == NULL){
+		mutex_unlock(&rpl_send_mutex, 0);
+		return;
+	}
 	
-	if(destination == NULL){
+	if(my_dodag->mop == NON_STORING_MODE){
+		//straight to the root, the nodes in between keep no routes
+		destination = &my_dodag->dodag_id;
+	}
+	else if(destination == NULL){
 		destination = &my_dodag->my_preferred_parent->addr;
 	}
 	if(default_lifetime){
@@ -326,10 +341,6 @@ void send_DAO(ipv6_addr_t *destination, uint8_t lifetime, bool default_lifetime,
 	icmp_send_buf->code = ICMP_CODE_DAO; 
 	icmp_send_buf->checksum = ~icmpv6_csum(PROTO_NUM_ICMPV6);
 
-	if(my_dodag == NULL){
-		mutex_unlock(&rpl_send_mutex, 0);
-		return;
-	}
 	rpl_send_dao_buf = get_rpl_send_dao_buf();
 	memset(rpl_send_dao_buf,0,sizeof(*rpl_send_dao_buf));
 	rpl_send_dao_buf->rpl_instanceid = my_dodag->instance->id;
@@ -340,12 +351,16 @@ void send_DAO(ipv6_addr_t *destination, uint8_t lifetime, bool default_lifetime,
 	//Alle Ziele aus der Routing Tabelle als Target eintragen
 	uint8_t entries = 0;
 	uint8_t continue_index = 0;
+	if(my_dodag->mop == NON_STORING_MODE){
+		//every node reports its own parent to the root
+		start_index = RPL_MAX_ROUTING_ENTRIES;
+	}
 	for(uint8_t i=start_index; i<RPL_MAX_ROUTING_ENTRIES;i++){
 		if(routing_table[i].used){
 			rpl_send_opt_target_buf->type=RPL_OPT_TARGET;
 			rpl_send_opt_target_buf->length=RPL_OPT_TARGET_LEN;
 			rpl_send_opt_target_buf->flags=0x00;
-			rpl_send_opt_target_buf->prefix_length= RPL_DODAG_ID_LEN;
+			rpl_send_opt_target_buf->prefix_length= routing_table[i].prefix_len;
 			memcpy(&rpl_send_opt_target_buf->target,&routing_table[i].address,sizeof(ipv6_addr_t));
 			opt_len += RPL_OPT_TARGET_LEN +2;
 			rpl_send_opt_transit_buf = get_rpl_send_opt_transit_buf(DAO_BASE_LEN + opt_len);
@@ -370,7 +385,7 @@ void send_DAO(ipv6_addr_t *destination, uint8_t lifetime, bool default_lifetime,
 	rpl_send_opt_target_buf->type=RPL_OPT_TARGET;
 	rpl_send_opt_target_buf->length=RPL_OPT_TARGET_LEN;
 	rpl_send_opt_target_buf->flags=0x00;
-	rpl_send_opt_target_buf->prefix_length= RPL_DODAG_ID_LEN;
+	rpl_send_opt_target_buf->prefix_length= RPL_ROUTE_HOST_LEN;
 	memcpy(&rpl_send_opt_target_buf->target,&my_address,sizeof(ipv6_addr_t));
 	opt_len += RPL_OPT_TARGET_LEN +2;
 
@@ -381,7 +396,11 @@ void send_DAO(ipv6_addr_t *destination, uint8_t lifetime, bool default_lifetime,
 	rpl_send_opt_transit_buf->path_control=0x00;
 	rpl_send_opt_transit_buf->path_sequence=0x00;
 	rpl_send_opt_transit_buf->path_lifetime=lifetime;
-	opt_len += RPL_OPT_TRANSIT_LEN +2;
+	if(my_dodag->mop == NON_STORING_MODE){
+		rpl_send_opt_transit_buf->length=RPL_OPT_TRANSIT_PARENT_LEN;
+		memcpy(&rpl_send_opt_transit_buf->parent,&my_dodag->my_preferred_parent->addr,sizeof(ipv6_addr_t));
+	}
+	opt_len += rpl_send_opt_transit_buf->length +2;
 	
 	uint16_t plen = ICMPV6_HDR_LEN + DAO_BASE_LEN + opt_len;
 	rpl_send(destination,(uint8_t*)icmp_send_buf, plen, PROTO_NUM_ICMPV6, NULL);
@@ -580,7 +599,7 @@ void recv_rpl_dio(void){
 			printf("DIO with Rank < ROOT_RANK\n");
 			return;
 		}
-		if(dio_dodag.mop != RPL_DEFAULT_MOP){
+		if(dio_dodag.mop != STORING_MODE_NO_MC && dio_dodag.mop != NON_STORING_MODE){
 			printf("Required MOP not supported\n");
 			return;
 		}
@@ -721,6 +740,10 @@ void recv_rpl_dao(void){
 		printf("[Error] got DAO without beeing part of a Dodag\n");
 		return;
 	}
+	if(my_dodag->mop == NON_STORING_MODE && !i_am_root){
+		//DAOs are for the root only
+		return;
+	}
 	ipv6_buf = get_rpl_ipv6_buf();
 	rpl_dao_buf = get_rpl_dao_buf();
 	int len = DAO_BASE_LEN;
@@ -743,10 +766,6 @@ void recv_rpl_dao(void){
 			}
 			case(RPL_OPT_TARGET):{
 				rpl_opt_target_buf = get_rpl_opt_target_buf(len);
-				if(rpl_opt_target_buf->prefix_length != RPL_DODAG_ID_LEN){
-					printf("prefixes are not supported yet");
-					break;
-				}
 				len += rpl_opt_target_buf->length +2;
 				rpl_opt_transit_buf = get_rpl_opt_transit_buf(len);
 				if(rpl_opt_transit_buf->type != RPL_OPT_TRANSIT){
@@ -755,7 +774,17 @@ void recv_rpl_dao(void){
 				}
 				len += rpl_opt_transit_buf->length +2;
 				//Die eigentliche Lebenszeit einer Route errechnet sich aus  (Lifetime aus DAO) * (Lifetime Unit) Sekunden
-				rpl_add_routing_entry(&rpl_opt_target_buf->target, &ipv6_buf->srcaddr, rpl_opt_transit_buf->path_lifetime * my_dodag->lifetime_unit);
+				if(my_dodag->mop == NON_STORING_MODE){
+					//the root keeps the parent of every target, rpl_get_source_route() walks them up
+					if(rpl_opt_transit_buf->length < RPL_OPT_TRANSIT_PARENT_LEN){
+						printf("[Error] - no parent address in Transit Information\n");
+						break;
+					}
+					rpl_add_routing_prefix(&rpl_opt_target_buf->target, rpl_opt_target_buf->prefix_length, &rpl_opt_transit_buf->parent, rpl_opt_transit_buf->path_lifetime * my_dodag->lifetime_unit);
+				}
+				else{
+					rpl_add_routing_prefix(&rpl_opt_target_buf->target, rpl_opt_target_buf->prefix_length, &ipv6_buf->srcaddr, rpl_opt_transit_buf->path_lifetime * my_dodag->lifetime_unit);
+				}
 				//puts("Updated route \n");
 				increment_seq = 1;
 				break;
@@ -797,6 +826,176 @@ void recv_rpl_dao_ack(void){
 
 }
 
+//leading octets two addresses have in common, at most 15 for the routing header
+static uint8_t rpl_common_octets(ipv6_addr_t *a, ipv6_addr_t *b){
+	uint8_t i = 0;
+	while(i < 15 && a->uint8[i] == b->uint8[i]){
+		i++;
+	}
+	return i;
+}
+
+//the path to destination the DAOs reported to the root in non-storing mode,
+//destination first and the root's child last; 0 if a parent is unknown or
+//the parents loop
+static uint8_t rpl_get_source_route(ipv6_addr_t *destination, ipv6_addr_t **route){
+	rpl_routing_entry_t *entry;
+	ipv6_addr_t *parent = rpl_get_next_hop(destination);
+	uint8_t hops = 1;
+	route[0] = destination;
+	while(parent != NULL && !rpl_equal_id(parent, &my_address)){
+		if(hops == RPL_MAX_SRH_HOPS){
+			return 0;
+		}
+		route[hops++] = parent;
+		entry = rpl_find_routing_entry(parent);
+		parent = (entry != NULL) ? &entry->next_hop : NULL;
+	}
+	return (parent != NULL) ? hops : 0;
+}
+
+//inserts a source routing header (RFC 6554) behind the IPv6 header and makes
+//the first hop the destination, size is the space of the packet's buffer
+static int8_t rpl_add_source_route(struct ipv6_hdr_t *ipv6, uint16_t size){
+	ipv6_addr_t *route[RPL_MAX_SRH_HOPS];
+	ipv6_addr_t *first;
+	rpl_srh_t *srh;
+	uint8_t *ptr;
+	uint8_t hops = rpl_get_source_route(&ipv6->destaddr, route);
+	uint8_t cmpri = 15, cmpre, pad, c;
+	uint16_t srh_len;
+
+	if(hops == 0){
+		return -1;
+	}
+	if(hops == 1){
+		//a child of the root
+		return 0;
+	}
+	//the elided octets are taken from the destination at each hop
+	first = route[hops - 1];
+	for(uint8_t i=1; i<hops-1; i++){
+		c = rpl_common_octets(first, route[i]);
+		if(c < cmpri){
+			cmpri = c;
+		}
+	}
+	cmpre = rpl_common_octets(first, route[0]);
+	if(cmpre > cmpri){
+		cmpre = cmpri;
+	}
+	srh_len = (hops - 2) * (16 - cmpri) + (16 - cmpre);
+	pad = (8 - srh_len % 8) % 8;
+	srh_len += RPL_SRH_LEN + pad;
+	if(IPV6_HDR_LEN + srh_len + ipv6->length > size){
+		return -1;
+	}
+
+	ptr = (uint8_t*)ipv6 + IPV6_HDR_LEN;
+	memmove(ptr + srh_len, ptr, ipv6->length);
+	srh = (rpl_srh_t*)ptr;
+	srh->nextheader = ipv6->nextheader;
+	srh->length = (srh_len - RPL_SRH_LEN) / 8;
+	srh->routing_type = RPL_SRH_TYPE;
+	srh->segments_left = hops - 1;
+	srh->compr = (cmpri << 4) | cmpre;
+	srh->pad_reserved = pad << 4;
+	srh->reserved = 0;
+	ptr += RPL_SRH_LEN;
+	for(uint8_t i=hops-1; i>0; i--){
+		c = (i == 1) ? cmpre : cmpri;
+		memcpy(ptr, &route[i - 1]->uint8[c], 16 - c);
+		ptr += 16 - c;
+	}
+	memset(ptr, 0, pad);
+
+	//route[0] is the destination field itself, done with it now
+	ipv6->destaddr = *first;
+	ipv6->nextheader = PROTO_NUM_ROUTING;
+	ipv6->length += srh_len;
+	return 0;
+}
+
+//RFC 6554 section 4.2 for a packet addressed to us
+static uint8_t rpl_srh_process(struct ipv6_hdr_t *ipv6){
+	uint8_t *ptr = (uint8_t*)ipv6 + IPV6_HDR_LEN;
+	rpl_srh_t *srh = (rpl_srh_t*)ptr;
+	uint16_t srh_len = RPL_SRH_LEN + 8 * srh->length;
+	uint8_t cmpri = srh->compr >> 4;
+	uint8_t cmpre = srh->compr & 0x0f;
+	uint8_t pad = srh->pad_reserved >> 4;
+	uint8_t n, i, c;
+	ipv6_addr_t next;
+
+	if(srh->routing_type != RPL_SRH_TYPE || srh_len > ipv6->length){
+		puts("[Error] malformed routing header, dropping package");
+		return 1;
+	}
+	if(srh->segments_left == 0){
+		//we are the destination, the rest of the stack knows no extension headers
+		ipv6->nextheader = srh->nextheader;
+		ipv6->length -= srh_len;
+		memmove(ptr, ptr + srh_len, ipv6->length);
+		return 0;
+	}
+	if(8 * srh->length < pad + 16 - cmpre){
+		puts("[Error] malformed routing header, dropping package");
+		return 1;
+	}
+	n = (8 * srh->length - pad - (16 - cmpre)) / (16 - cmpri) + 1;
+	if(srh->segments_left > n){
+		puts("[Error] malformed routing header, dropping package");
+		return 1;
+	}
+	srh->segments_left--;
+	i = n - srh->segments_left;
+	c = (i == n) ? cmpre : cmpri;
+	ptr += RPL_SRH_LEN + (i - 1) * (16 - cmpri);
+	next = ipv6->destaddr;
+	memcpy(&next.uint8[c], ptr, 16 - c);
+	if(ipv6_prefix_mcast_match(&next) || ipv6_iface_addr_match(&next) != NULL){
+		puts("[Error] routing header loops, dropping package");
+		return 1;
+	}
+	if(ipv6->hoplimit <= 1){
+		puts("[Error] hop limit exceeded, dropping package");
+		return 1;
+	}
+	ipv6->hoplimit--;
+	memcpy(ptr, &ipv6->destaddr.uint8[c], 16 - c);
+	ipv6->destaddr = next;
+	//the next address is a neighbour
+	lowpan_init((ieee_802154_long_t*)&(next.uint16[4]),(uint8_t*)ipv6);
+	return 1;
+}
+
+//next hop of a unicast packet, the root in non-storing mode source routes it
+static ipv6_addr_t *rpl_route(struct ipv6_hdr_t *ipv6, uint16_t size){
+	ipv6_addr_t *next_hop;
+	if(i_am_root && rpl_get_my_dodag()->mop == NON_STORING_MODE){
+		if(rpl_add_source_route(ipv6, size) != 0){
+			printf("[Error] destination unknown\n");
+			return NULL;
+		}
+		return &ipv6->destaddr;
+	}
+	next_hop = rpl_get_next_hop(&ipv6->destaddr);
+	if(next_hop == NULL){
+		if(i_am_root){
+			//oops... ich bin root und weiß nicht wohin mit dem paketn 
+			printf("[Error] destination unknown\n");
+			return NULL;
+		}
+		next_hop = rpl_get_my_preferred_parent();
+		if(next_hop == NULL){
+			//kein preferred parent eingetragen
+			puts("[Error] no preferred parent, dropping package");
+			return NULL;
+		}
+	}
+	return next_hop;
+}
+
 void rpl_send(ipv6_addr_t *destination, uint8_t *payload, uint16_t p_len, uint8_t next_header, void *tcp_socket){
 	uint8_t *p_ptr;
     ipv6_send_buf = get_rpl_send_ipv6_buf();
@@ -827,30 +1026,107 @@ void rpl_send(ipv6_addr_t *destination, uint8_t *payload, uint16_t p_len, uint8_
 	}
 	else{
 		//find right next hop before sending
-		ipv6_addr_t *next_hop = rpl_get_next_hop(&ipv6_send_buf->destaddr);
+		ipv6_addr_t *next_hop = rpl_route(ipv6_send_buf, sizeof(rpl_send_buffer));
 		if(next_hop == NULL){
-			if(i_am_root){
-				//oops... ich bin root und weiß nicht wohin mit dem paketn 
-				printf("[Error] destination unknown\n");
-				return;
-			}
-			else{
-				next_hop = rpl_get_my_preferred_parent();
-				if(next_hop == NULL){
-					//kein preferred parent eingetragen
-					puts("[Error] no preferred parent, dropping package");
-					return;
-				}
-			}
+			return;
 		}
+		packet_length = IPV6_HDR_LEN + ipv6_send_buf->length;
 	    lowpan_init((ieee_802154_long_t*)&(next_hop->uint16[4]),(uint8_t*)ipv6_send_buf);
 	}
 
 }
 
+//called by ipv6_process() for every packet that is not for the global address,
+//returns 1 if it was forwarded or dropped and 0 if it is to be processed here
+uint8_t rpl_forward(struct ipv6_hdr_t *ipv6){
+	rpl_dodag_t *my_dodag = rpl_get_my_dodag();
+	ipv6_addr_t *next_hop;
+	if(my_dodag == NULL){
+		return 0;
+	}
+	if(ipv6_prefix_mcast_match(&ipv6->destaddr) || ipv6_iface_addr_match(&ipv6->destaddr) != NULL){
+		if(ipv6->nextheader == PROTO_NUM_ROUTING){
+			return rpl_srh_process(ipv6);
+		}
+		return 0;
+	}
+	if(ipv6->hoplimit <= 1){
+		puts("[Error] hop limit exceeded, dropping package");
+		return 1;
+	}
+	ipv6->hoplimit--;
+	//the packet stays in the receive buffer
+	next_hop = rpl_route(ipv6, BUFFER_SIZE - LL_HDR_LEN);
+	if(next_hop != NULL){
+	    lowpan_init((ieee_802154_long_t*)&(next_hop->uint16[4]),(uint8_t*)ipv6);
+	}
+	return 1;
+}
+
+//route lifetimes count in seconds
+static uint32_t rpl_now(void){
+	timex_t now = vtimer_now();
+	timex_normalize(&now);
+	return now.seconds;
+}
+
+static uint8_t routing_hash_index(ipv6_addr_t *addr){
+	uint32_t h = addr->uint32[2] ^ addr->uint32[3];
+	h ^= h >> 16;
+	h ^= h >> 8;
+	return h & (RPL_ROUTING_HASH_SIZE - 1);
+}
+
+//the list a route belongs to
+static uint8_t *routing_list(ipv6_addr_t *addr, uint8_t prefix_len){
+	if(prefix_len == RPL_ROUTE_HOST_LEN){
+		return &routing_hash[routing_hash_index(addr)];
+	}
+	return &prefix_routes;
+}
+
+static bool rpl_prefix_match(ipv6_addr_t *addr, ipv6_addr_t *prefix, uint8_t prefix_len){
+	uint8_t bytes = prefix_len / 8;
+	uint8_t mask;
+	if(memcmp(addr, prefix, bytes) != 0){
+		return false;
+	}
+	if(prefix_len % 8){
+		mask = 0xff << (8 - prefix_len % 8);
+		return ((addr->uint8[bytes] ^ prefix->uint8[bytes]) & mask) == 0;
+	}
+	return true;
+}
+
+static rpl_routing_entry_t *rpl_find_route(ipv6_addr_t *prefix, uint8_t prefix_len){
+	for(uint8_t i = *routing_list(prefix, prefix_len); i != RPL_ROUTING_END; i = routing_table[i].next){
+		if(routing_table[i].prefix_len == prefix_len && rpl_prefix_match(prefix, &routing_table[i].address, prefix_len)){
+			return &routing_table[i];
+		}
+	}
+	return NULL;
+}
+
+static void rpl_remove_route(rpl_routing_entry_t *entry){
+	uint8_t index = entry - routing_table;
+	uint8_t *link = routing_list(&entry->address, entry->prefix_len);
+	while(*link != index){
+		link = &routing_table[*link].next;
+	}
+	*link = entry->next;
+	memset(entry, 0, sizeof(*entry));
+	entry->next = free_routes;
+	free_routes = index;
+}
+
 ipv6_addr_t *rpl_get_next_hop(ipv6_addr_t * addr){
-	for(uint8_t i=0; i<RPL_MAX_ROUTING_ENTRIES; i++){
-		if(routing_table[i].used && rpl_equal_id(&routing_table[i].address, addr)){
+	rpl_routing_entry_t *entry = rpl_find_routing_entry(addr);
+	if(entry != NULL){
+		return &entry->next_hop;
+	}
+	//sorted by falling length, the first match is the longest
+	for(uint8_t i = prefix_routes; i != RPL_ROUTING_END; i = routing_table[i].next){
+		if(rpl_prefix_match(addr, &routing_table[i].address, routing_table[i].prefix_len)){
 			return &routing_table[i].next_hop;
 		}
 	}
@@ -858,34 +1134,72 @@ ipv6_addr_t *rpl_get_next_hop(ipv6_addr_t * addr){
 }
 
 void rpl_add_routing_entry(ipv6_addr_t *addr, ipv6_addr_t *next_hop, uint16_t lifetime){
-	rpl_routing_entry_t * entry = rpl_find_routing_entry(addr);
-	if(entry != NULL){
-		entry->lifetime = lifetime;
+	rpl_add_routing_prefix(addr, RPL_ROUTE_HOST_LEN, next_hop, lifetime);
+}
+
+void rpl_add_routing_prefix(ipv6_addr_t *prefix, uint8_t prefix_len, ipv6_addr_t *next_hop, uint16_t lifetime){
+	rpl_routing_entry_t *entry;
+	uint8_t *link;
+	uint8_t index;
+
+	if(prefix_len > RPL_ROUTE_HOST_LEN){
 		return;
 	}
-	for(uint8_t i=0; i<RPL_MAX_ROUTING_ENTRIES; i++){
-		if(!routing_table[i].used){
-			routing_table[i].address = *addr;
-			routing_table[i].next_hop = *next_hop;
-			routing_table[i].lifetime = lifetime;
-			routing_table[i].used = 1;
-			break;
+	entry = rpl_find_route(prefix, prefix_len);
+	if(lifetime == 0){
+		//No-Path
+		if(entry != NULL){
+			rpl_remove_route(entry);
+		}
+		return;
+	}
+	if(entry == NULL){
+		if(free_routes == RPL_ROUTING_END){
+			return;
 		}
-	} 
+		index = free_routes;
+		entry = &routing_table[index];
+		free_routes = entry->next;
+
+		entry->used = 1;
+		entry->prefix_len = prefix_len;
+		for(uint8_t i=0; i<16; i++){
+			if(prefix_len >= 8 * (i + 1)){
+				entry->address.uint8[i] = prefix->uint8[i];
+			}
+			else if(prefix_len > 8 * i){
+				entry->address.uint8[i] = prefix->uint8[i] & (0xff << (8 * (i + 1) - prefix_len));
+			}
+			else{
+				entry->address.uint8[i] = 0;
+			}
+		}
+		//host routes go first in their bucket, prefix routes before the shorter ones
+		link = routing_list(prefix, prefix_len);
+		while(*link != RPL_ROUTING_END && routing_table[*link].prefix_len > prefix_len){
+			link = &routing_table[*link].next;
+		}
+		entry->next = *link;
+		*link = index;
+	}
+	//a DAO may well come over another child now
+	entry->next_hop = *next_hop;
+	entry->expires = rpl_now() + lifetime;
+	if(entry->expires < next_expiry){
+		next_expiry = entry->expires;
+	}
 }
 
 void rpl_del_routing_entry(ipv6_addr_t *addr){
-	for(uint8_t i=0; i<RPL_MAX_ROUTING_ENTRIES; i++){
-		if(routing_table[i].used && rpl_equal_id(&routing_table[i].address, addr)){
-			memset(&routing_table[i], 0, sizeof(routing_table[i]));
-			return;
-		}
+	rpl_routing_entry_t *entry = rpl_find_routing_entry(addr);
+	if(entry != NULL){
+		rpl_remove_route(entry);
 	}
 }
 
 rpl_routing_entry_t *rpl_find_routing_entry(ipv6_addr_t *addr){
-	for(uint8_t i=0; i<RPL_MAX_ROUTING_ENTRIES; i++){
-		if(routing_table[i].used && rpl_equal_id(&routing_table[i].address, addr)){
+	for(uint8_t i = routing_hash[routing_hash_index(addr)]; i != RPL_ROUTING_END; i = routing_table[i].next){
+		if(rpl_equal_id(&routing_table[i].address, addr)){
 			return &routing_table[i];
 		}
 	}
@@ -893,10 +1207,34 @@ rpl_routing_entry_t *rpl_find_routing_entry(ipv6_addr_t *addr){
 }
 
 void rpl_clear_routing_table(){
+	memset(routing_table, 0, sizeof(routing_table));
+	memset(routing_hash, RPL_ROUTING_END, sizeof(routing_hash));
+	prefix_routes = RPL_ROUTING_END;
 	for(uint8_t i=0; i<RPL_MAX_ROUTING_ENTRIES; i++){
-		memset(&routing_table[i], 0, sizeof(routing_table[i]));
+		routing_table[i].next = (i + 1 < RPL_MAX_ROUTING_ENTRIES) ? i + 1 : RPL_ROUTING_END;
 	}
+	free_routes = 0;
+	next_expiry = UINT32_MAX;
+}
 
+//called every second, only walks the table when a route is due
+void rpl_expire_routing_entries(void){
+	uint32_t now = rpl_now();
+	if(now < next_expiry){
+		return;
+	}
+	next_expiry = UINT32_MAX;
+	for(uint8_t i=0; i<RPL_MAX_ROUTING_ENTRIES; i++){
+		if(!routing_table[i].used){
+			continue;
+		}
+		if(routing_table[i].expires <= now){
+			rpl_remove_route(&routing_table[i]);
+		}
+		else if(routing_table[i].expires < next_expiry){
+			next_expiry = routing_table[i].expires;
+		}
+	}
 }
 
 rpl_routing_entry_t *rpl_get_routing_table(void){
@@ -22,9 +22,12 @@ void recv_rpl_dis(void);
 void recv_rpl_dao(void);
 void recv_rpl_dao_ack(void);
 void rpl_send(ipv6_addr_t *destination, uint8_t *payload, uint16_t p_len, uint8_t next_header, void *tcp_socket);
+uint8_t rpl_forward(struct ipv6_hdr_t *ipv6);
 ipv6_addr_t *rpl_get_next_hop(ipv6_addr_t * addr);
 void rpl_add_routing_entry(ipv6_addr_t *addr, ipv6_addr_t *next_hop, uint16_t lifetime);
+void rpl_add_routing_prefix(ipv6_addr_t *prefix, uint8_t prefix_len, ipv6_addr_t *next_hop, uint16_t lifetime);
 void rpl_del_routing_entry(ipv6_addr_t *addr);
 rpl_routing_entry_t * rpl_find_routing_entry(ipv6_addr_t *addr);
 void rpl_clear_routing_table();
+void rpl_expire_routing_entries(void);
 rpl_routing_entry_t *rpl_get_routing_table(void);
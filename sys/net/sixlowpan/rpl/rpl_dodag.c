@@ -191,7 +191,8 @@ rpl_parent_t * rpl_find_preferred_parent(void){
 	}
 	
 	if(!rpl_equal_id(&my_dodag->my_preferred_parent->addr, &best->addr)){
-		if(my_dodag->mop != NO_DOWNWARD_ROUTES){
+		//in non-storing mode the next DAO tells the root about the new parent
+		if(my_dodag->mop != NO_DOWNWARD_ROUTES && my_dodag->mop != NON_STORING_MODE){
 			//send DAO with ZERO_LIFETIME to old parent
 			send_DAO(&my_dodag->my_preferred_parent->addr, 0, false, 0);
 		}
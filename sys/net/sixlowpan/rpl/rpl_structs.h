@@ -29,6 +29,8 @@
 #define RPL_OPT_SOLICITED_INFO_LEN	19
 #define RPL_OPT_TARGET_LEN			18
 #define RPL_OPT_TRANSIT_LEN			4
+//with the parent address, in non-storing mode
+#define RPL_OPT_TRANSIT_PARENT_LEN	20
 
 //message options
 #define RPL_OPT_PAD1                 0
@@ -54,7 +56,9 @@
 
 // Default values
 
+#ifndef RPL_DEFAULT_MOP
 #define RPL_DEFAULT_MOP STORING_MODE_NO_MC
+#endif
 
 // RPL Constants and Variables
 
@@ -85,6 +89,14 @@
 #define RPL_MAX_INSTANCES 1
 #define RPL_MAX_PARENTS 5
 #define RPL_MAX_ROUTING_ENTRIES 128
+//host routes are hashed on their interface identifier, power of two
+#define RPL_ROUTING_HASH_SIZE 64
+//prefix length of a host route in bits
+#define RPL_ROUTE_HOST_LEN 128
+#define RPL_ROUTING_END 0xff
+#if RPL_MAX_ROUTING_ENTRIES >= RPL_ROUTING_END
+#error "RPL_MAX_ROUTING_ENTRIES must be below RPL_ROUTING_END"
+#endif
 #define RPL_ROOT_RANK 1
 #define RPL_DEFAULT_LIFETIME 0xff
 #define RPL_LIFETIME_UNIT 2
@@ -97,6 +109,11 @@
 #define RPL_DIS_D_MASK 0x20
 #define RPL_GROUNDED_SHIFT 7
 #define RPL_DEFAULT_OCP 0
+//source routing header (RFC 6554)
+#define RPL_SRH_LEN 8
+#define RPL_SRH_TYPE 3
+//longest source route the root inserts
+#define RPL_MAX_SRH_HOPS 16
 
 struct __attribute__((packed)) rpl_dio_t{
     uint8_t rpl_instanceid;
@@ -177,8 +194,23 @@ typedef struct __attribute__((packed)) rpl_opt_transit_t {
 	uint8_t path_control;
 	uint8_t path_sequence;
 	uint8_t path_lifetime;
+	//only sent in non-storing mode
+	ipv6_addr_t parent;
 } rpl_opt_transit_t;
 
+//routing header, followed by the addresses with their first CmprI (the last
+//one CmprE) octets elided
+typedef struct __attribute__((packed)) rpl_srh_t {
+	uint8_t nextheader;
+	//in 8 octet units, not counting the first 8 octets
+	uint8_t length;
+	uint8_t routing_type;
+	uint8_t segments_left;
+	uint8_t compr;
+	uint8_t pad_reserved;
+	uint16_t reserved;
+} rpl_srh_t;
+
 struct rpl_dodag_t;
 
 typedef struct rpl_parent_t {
@@ -238,8 +270,12 @@ typedef struct rpl_routing_entry_t {
 	uint8_t used;
 	ipv6_addr_t address;
 	ipv6_addr_t next_hop;
-	uint16_t lifetime;
-	
+	//vtimer_now() seconds at which the route times out
+	uint32_t expires;
+	//in bits, RPL_ROUTE_HOST_LEN for a host route
+	uint8_t prefix_len;
+	//next entry in the same hash bucket, the prefix routes or the free entries
+	uint8_t next;
 } rpl_routing_entry_t;
 
 #endif
@@ -52,6 +52,9 @@ void reset_trickletimer(void){
 void init_trickle(void){
 	//Create threads
 	ack_received = true;
+	vtimer_set_slack(&dao_timer, DAO_TIMER_SLACK);
+	vtimer_set_slack(&rt_timer, RT_TIMER_SLACK);
+
 	timer_over_pid = thread_create(timer_over_buf, TRICKLE_TIMER_STACKSIZE,
 								   PRIORITY_MAIN-1,CREATE_STACKTEST,
 								   trickle_timer_over, "trickle_timer_over");
@@ -65,7 +68,6 @@ void init_trickle(void){
 	rt_timer_over_pid = thread_create(routing_table_buf, RT_STACKSIZE,
 									  PRIORITY_MAIN-1, CREATE_STACKTEST,
 									  rt_timer_over, "rt_timer_over");
-	
 }
 
 void start_trickle(uint8_t DIOIntMin, uint8_t DIOIntDoubl, uint8_t DIORedundancyConstant){
@@ -179,21 +181,11 @@ void dao_ack_received(){
 }
 
 void rt_timer_over(void){
-	rpl_routing_entry_t * rt;
+	rt_time = timex_set(1,0);
 	while(1){
 		rpl_dodag_t * my_dodag = rpl_get_my_dodag();
+		rpl_expire_routing_entries();
 		if(my_dodag != NULL){
-			rt = rpl_get_routing_table();
-			for(uint8_t i=0; i<RPL_MAX_ROUTING_ENTRIES;i++){
-				if(rt[i].used){
-					if(rt[i].lifetime <= 1){
-						memset(&rt[i], 0,sizeof(rt[i]));
-					}
-					else{
-						rt[i].lifetime--;
-					}
-				}
-			}
 			//Parent is NULL for root too
             if(my_dodag->my_preferred_parent != NULL){
 				if(my_dodag->my_preferred_parent->lifetime <= 1){
@@ -205,7 +197,8 @@ void rt_timer_over(void){
 				}
 			}
 		}
-		//Wake up every second
-		vtimer_usleep(1000000);
+		//Wake up every second, rt_timer_over_pid may not be set yet
+		vtimer_set_wakeup(&rt_timer, rt_time, thread_getpid());
+		thread_sleep();
 	}
 }
@@ -9,6 +9,10 @@
 //#define DAO_DELAY_STACKSIZE 4096
 #define RT_STACKSIZE 512
 
+/* how late the DAO and routing table timers may fire to share interrupts */
+#define DAO_TIMER_SLACK (500*1000)
+#define RT_TIMER_SLACK (100*1000)
+
 void reset_trickletimer(void);
 void init_trickle(void);
 void start_trickle(uint8_t DIOINtMin, uint8_t DIOIntDoubl, uint8_t DIORedundancyConstatnt);
@@ -1,31 +1,51 @@
-#include <mutex.h>
+#include <irq.h>
+#include <kernel.h>
+#include <queue.h>
+#include <sched.h>
+#include <tcb.h>
 
 #include "semaphore.h"
 
 void sem_init(sem_t *sem, int8_t value) {
     sem->value = value;
-    mutex_init(&sem->mutex);
-    sem->locked = 0;
+    sem->queue.next = NULL;
 }
 
 int sem_wait(sem_t *sem) {
-    int res;
-    if(--(sem->value) <= 0 && !sem->locked) {
-        sem->locked = !(sem->locked);
-        res = mutex_lock(&(sem->mutex));
-        if (res < 0) {
-            return res;
-        }
+    queue_node_t n;
+    int irqstate = disableIRQ();
+    
+    /* a thread woken by sem_signal() may find the value taken again */
+    while (sem->value <= 0) {
+        sched_set_status((tcb_t*)active_thread, STATUS_SLEEPING);
+        
+        n.priority = (unsigned int) active_thread->priority;
+        n.data = (unsigned int) active_thread;
+        n.next = NULL;
+        queue_priority_add(&(sem->queue), &n);
+        
+        restoreIRQ(irqstate);
+        thread_yield();
+        irqstate = disableIRQ();
     }
+    sem->value--;
     
+    restoreIRQ(irqstate);
     return 0;
 }
 
 int sem_signal(sem_t *sem) {
-    if (++(sem->value) > 0 && sem->locked) {
-        sem->locked = !(sem->locked);
-        mutex_unlock(&(sem->mutex),0);
+    int irqstate = disableIRQ();
+    
+    sem->value++;
+    
+    if (sem->queue.next) {
+        queue_node_t *next = queue_remove_head(&(sem->queue));
+        tcb_t *process = (tcb_t*)next->data;
+        sched_set_status(process, STATUS_PENDING);
+        sched_switch(process->priority, active_thread->priority, inISR());
     }
     
+    restoreIRQ(irqstate);
     return 0;
 }
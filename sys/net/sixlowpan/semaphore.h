@@ -2,12 +2,11 @@
 #define SEMAPHORE_H
 
 #include <stdint.h>
-#include <mutex.h>
+#include <queue.h>
 
 typedef struct sem_t {
     int8_t value;
-    int8_t locked;
-    mutex_t mutex;
+    queue_node_t queue;     // threads blocked in sem_wait(), by priority
 } sem_t;
 
 void sem_init(sem_t *sem, int8_t value);
@@ -81,8 +81,10 @@ void serial_reader_f(void) {
             if (uart_buf->type == BORDER_PACKET_CONF_TYPE) {
                 border_conf_header_t *conf_packet = (border_conf_header_t*)uart_buf;
                 if (conf_packet->conftype == BORDER_CONF_SYN) {
+                    /* the driver repeats its SYN until it sees our SYNACK */
+                    m.type = bytes;
                     m.content.ptr = (char *)conf_packet;
-                    msg_send(&m, main_pid, 1);
+                    msg_send(&m, main_pid, 0);
                     continue;
                 }
             }
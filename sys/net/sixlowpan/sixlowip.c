@@ -13,7 +13,6 @@
 #include "sys/net/net_help/msg_help.h"
 #include "sys/net/sixlowpan/rpl/rpl.h"
 
-uint8_t ip_send_buffer[BUFFER_SIZE];
 uint8_t buffer[BUFFER_SIZE];
 msg_t msg_queue[IP_PKT_RECV_BUF_SIZE];
 struct ipv6_hdr_t* ipv6_buf;
@@ -25,14 +24,7 @@ uint8_t iface_addr_list_count = 0;
 int udp_packet_handler_pid = 0;
 int tcp_packet_handler_pid = 0;
 int rpl_process_pid = 0;
-
-struct ipv6_hdr_t* get_ipv6_buf_send(void){
-    return ((struct ipv6_hdr_t*)&(ip_send_buffer[LL_HDR_LEN]));
-}
-
-uint8_t * get_payload_buf_send(uint8_t ext_len){
-    return &(ip_send_buffer[LLHDR_IPV6HDR_LEN + ext_len]);
-}
+uint8_t (*rpl_forward_handler)(struct ipv6_hdr_t *ipv6) = NULL;
 
 struct ipv6_hdr_t* get_ipv6_buf(void){
     return ((struct ipv6_hdr_t*)&(buffer[LL_HDR_LEN]));
@@ -51,36 +43,22 @@ void sixlowpan_bootstrapping(void){
     init_rtr_sol(OPT_SLLAO);
 }
 
+/* the header is built on the stack and the payload compressed from where
+ * it is, so senders share no buffer */
 void sixlowpan_send(ipv6_addr_t *addr, uint8_t *payload, uint16_t p_len, uint8_t next_header){
-	uint8_t *p_ptr;
-	if (next_header == IPPROTO_TCP)
-		{
-		p_ptr = get_payload_buf_send(ipv6_ext_hdr_len);
-    	ipv6_buf = get_ipv6_buf_send();
-		}
-    else
-		{
-    	ipv6_buf = get_ipv6_buf();
-    	p_ptr = get_payload_buf(ipv6_ext_hdr_len);
-		}
-    icmp_buf = get_icmpv6_buf(ipv6_ext_hdr_len);
-    packet_length = 0;
+    ipv6_hdr_t hdr;
 
-    ipv6_buf->version_trafficclass = IPV6_VER;
-    ipv6_buf->trafficclass_flowlabel = 0;
-    ipv6_buf->flowlabel = 0;
-    ipv6_buf->nextheader = next_header;
-    ipv6_buf->hoplimit = MULTIHOP_HOPLIMIT;
-    ipv6_buf->length = p_len;    
+    hdr.version_trafficclass = IPV6_VER;
+    hdr.trafficclass_flowlabel = 0;
+    hdr.flowlabel = 0;
+    hdr.nextheader = next_header;
+    hdr.hoplimit = MULTIHOP_HOPLIMIT;
+    hdr.length = p_len;    
 
-    memcpy(&(ipv6_buf->destaddr), addr, 16);
-    ipv6_get_saddr(&(ipv6_buf->srcaddr), &(ipv6_buf->destaddr));
+    memcpy(&(hdr.destaddr), addr, 16);
+    ipv6_get_saddr(&(hdr.srcaddr), &(hdr.destaddr));
 
-    memcpy(p_ptr,payload,p_len);
-
-    packet_length = IPV6_HDR_LEN + p_len;
-
-    lowpan_init((ieee_802154_long_t*)&(ipv6_buf->destaddr.uint16[4]),(uint8_t*)ipv6_buf);
+    lowpan_send((ieee_802154_long_t*)&(hdr.destaddr.uint16[4]), &hdr, payload);
 }
 
 int icmpv6_demultiplex(const struct icmpv6_hdr_t *hdr) {
@@ -144,8 +122,12 @@ void ipv6_process(void){
 
         if ((ipv6_get_addr_match(&myaddr, &ipv6_buf->destaddr) >= 112) && (ipv6_buf->destaddr.uint8[15] != myaddr.uint8[15]))
 			{
-        	memcpy(get_ipv6_buf_send(), get_ipv6_buf(), IPV6_HDR_LEN+ipv6_buf->length);
-        	lowpan_init((ieee_802154_long_t*)&(ipv6_buf->destaddr.uint16[4]),(uint8_t*)get_ipv6_buf_send());
+        	lowpan_init((ieee_802154_long_t*)&(ipv6_buf->destaddr.uint16[4]),(uint8_t*)ipv6_buf);
+			}
+        else if ((ipv6_get_addr_match(&myaddr, &ipv6_buf->destaddr) < 112) &&
+                 (rpl_forward_handler != NULL) && rpl_forward_handler(ipv6_buf))
+			{
+			/* routed on by RPL, or source routed through us */
 			}
         else
 			{
@@ -492,3 +474,7 @@ void set_udp_packet_handler_pid(int pid) {
 void set_rpl_process_pid(int pid){
 	rpl_process_pid = pid;
 }
+
+void set_rpl_forward_handler(uint8_t (*handler)(struct ipv6_hdr_t *ipv6)){
+	rpl_forward_handler = handler;
+}
@@ -11,6 +11,7 @@
 #define MTU                         256
 /* IPv6 field values */ 
 #define IPV6_VER                    0x60
+#define PROTO_NUM_ROUTING           43
 #define PROTO_NUM_ICMPV6            58
 #define PROTO_NUM_NONE              59
 #define ND_HOPLIMIT                 0xFF
@@ -129,7 +130,6 @@ extern iface_t iface;
 struct icmpv6_hdr_t* get_icmpv6_buf(uint8_t ext_len);
 struct ipv6_hdr_t* get_ipv6_buf(void);
 uint8_t * get_payload_buf(uint8_t ext_len);
-uint8_t * get_payload_buf_send(uint8_t ext_len);
 
 int icmpv6_demultiplex(const struct icmpv6_hdr_t *hdr);
 void ipv6_init_iface_as_router(void);
@@ -165,4 +165,5 @@ uint8_t ipv6_next_hdr_unrec(uint8_t next_hdr);
 void set_tcp_packet_handler_pid(int pid);
 void set_udp_packet_handler_pid(int pid);
 void set_rpl_process_pid(int pid);
+void set_rpl_forward_handler(uint8_t (*handler)(struct ipv6_hdr_t *ipv6));
 #endif /* SIXLOWIP_H*/
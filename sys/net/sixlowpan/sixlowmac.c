@@ -7,7 +7,6 @@
 #include "sixlownd.h"
 #include "sixlowpan.h"
 #include <ltc4150.h>
-#include <hwtimer.h>
 #include "thread.h"
 #include "msg.h"
 #include "radio/radio.h"
@@ -34,6 +33,8 @@ int transceiver_type;
 static transceiver_command_t tcmd;
 uint16_t fragmentcounter = 0;
 
+sixlowmac_statistic_t sixlowmac_stat;
+
 uint8_t get_radio_address(void){
     int16_t address;
 
@@ -69,7 +70,7 @@ void set_radio_channel(uint8_t channel){
 void switch_to_rx(void){
     mesg.type = SWITCH_RX;
     mesg.content.ptr = (char*) &tcmd;
-    tcmd.transceivers = TRANSCEIVER_CC1100;
+    tcmd.transceivers = transceiver_type;
     msg_send(&mesg, transceiver_pid, 1);
 }
 
@@ -114,6 +115,7 @@ void recv_ieee802154_frame(void){
 
             /* deliver packet to network(6lowpan)-layer */
 			fragmentcounter++;
+			sixlowmac_stat.frames_received++;
 			lowpan_read(frame.payload, length, (ieee_802154_long_t*)&frame.src_addr,
 				  (ieee_802154_long_t*)&frame.dest_addr);
 
@@ -148,11 +150,25 @@ void set_ieee802154_frame_values(ieee802154_frame_t *frame){
     macdsn++;
 }
 
+/* random CSMA-CA backoff before the retry-th retransmission */
+static void backoff(uint8_t retry){
+    uint8_t be = SIXLOWMAC_MIN_BE + retry - 1;
+
+    if (be > SIXLOWMAC_MAX_BE) {
+        be = SIXLOWMAC_MAX_BE;
+    }
+    vtimer_usleep(((rand() % (1 << be)) + 1) * SIXLOWMAC_BACKOFF_PERIOD);
+}
+
 void send_ieee802154_frame(ieee_802154_long_t *addr, uint8_t *payload, 
                            uint8_t length, uint8_t mcast){
     uint16_t daddr;
+    uint8_t retry;
     /* TODO: check if dedicated response struct is necessary */
     msg_t transceiver_rsp;
+
+    /* one frame at a time, the radio packet and buffer are shared */
+    mutex_lock(&buf_mutex);
     r_src_addr = local_address;
     mesg.type = SND_PKT;
     mesg.content.ptr = (char*) &tcmd;
@@ -178,9 +194,6 @@ void send_ieee802154_frame(ieee_802154_long_t *addr, uint8_t *payload,
     memset(&buf,0,PAYLOAD_SIZE);
     init_802154_frame(&frame,(uint8_t*)&buf);
     memcpy(&buf[hdrlen],frame.payload,frame.payload_len);
-    
-    /* mutex unlock */
-    mutex_unlock(&buf_mutex, 0);
  
     p.length = hdrlen + frame.payload_len;
     if(mcast == 0){
@@ -190,10 +203,35 @@ void send_ieee802154_frame(ieee_802154_long_t *addr, uint8_t *payload,
     }
 
     p.data = buf;
-    msg_send_receive(&mesg, &transceiver_rsp, transceiver_pid);
-    printf("%s, %u: %lu\n", __FILE__, __LINE__, transceiver_rsp.content.value);
 
-    hwtimer_wait(5000);
+    /*
+     * The transceiver answers once the driver took the frame, a CC1100
+     * with a full TX queue keeps us waiting until it drained: no further
+     * pacing needed.
+     */
+    for (retry = 0; ; retry++) {
+        msg_send_receive(&mesg, &transceiver_rsp, transceiver_pid);
+        if (transceiver_rsp.content.value) {
+            sixlowmac_stat.frames_sent++;
+            break;
+        }
+        if (retry == SIXLOWMAC_MAX_RETRIES) {
+            sixlowmac_stat.frames_failed++;
+            break;
+        }
+        sixlowmac_stat.retries++;
+        backoff(retry + 1);
+    }
+    mutex_unlock(&buf_mutex, 0);
+}
+
+void sixlowmac_reset_statistic(void){
+    sixlowmac_stat.frames_sent = 0;
+    sixlowmac_stat.frames_failed = 0;
+    sixlowmac_stat.retries = 0;
+    sixlowmac_stat.frames_received = 0;
+    sixlowmac_stat.since = vtimer_now();
+    timex_normalize(&sixlowmac_stat.since);
 }
 
 void sixlowmac_init(transceiver_type_t type){
@@ -206,4 +244,5 @@ void sixlowmac_init(transceiver_type_t type){
     transceiver_register(type, recv_pid);
 
     macdsn = rand() % 256;    
+    sixlowmac_reset_statistic();
 }
@@ -8,12 +8,35 @@
 #include "sixlowip.h"
 #include "radio/radio.h"
 #include <transceiver.h>
+#include <timex.h>
 
 #define RADIO_STACK_SIZE            512
 #define RADIO_RCV_BUF_SIZE          64
 #define RADIO_SND_BUF_SIZE          100
 #define RADIO_SENDING_DELAY         1000
 
+/*
+ * Frames the transceiver refuses (channel busy, TX queue full) are sent
+ * again after a random backoff of up to 2^BE - 1 backoff periods, BE
+ * growing from SIXLOWMAC_MIN_BE to SIXLOWMAC_MAX_BE (IEEE 802.15.4 CSMA-CA).
+ */
+#ifndef SIXLOWMAC_MAX_RETRIES
+#define SIXLOWMAC_MAX_RETRIES       4
+#endif
+#define SIXLOWMAC_MIN_BE            3
+#define SIXLOWMAC_MAX_BE            5
+#define SIXLOWMAC_BACKOFF_PERIOD    320     // microseconds, aUnitBackoffPeriod
+
+typedef struct sixlowmac_statistic_t {
+    uint32_t frames_sent;
+    uint32_t frames_failed;     // given up after SIXLOWMAC_MAX_RETRIES
+    uint32_t retries;
+    uint32_t frames_received;
+    timex_t since;              // start of counting
+} sixlowmac_statistic_t;
+
+extern sixlowmac_statistic_t sixlowmac_stat;
+
 extern uint16_t fragmentcounter;
 
 uint8_t get_radio_address(void);
@@ -24,5 +47,6 @@ void init_802154_long_addr(ieee_802154_long_t *laddr);
 void init_802154_short_addr(ieee_802154_short_t *saddr);
 void sixlowmac_init(transceiver_type_t type);
 ieee_802154_long_t* mac_get_eui(ipv6_addr_t *ipaddr);
+void sixlowmac_reset_statistic(void);
 
 #endif /* SIXLOWMAC_H*/
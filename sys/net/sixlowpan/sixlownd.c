@@ -11,6 +11,8 @@
 #include <debug.h>
 #include <vtimer.h>
 #include <mutex.h>
+#include <thread.h>
+#include <msg.h>
 
 #define ENABLE_DEBUG
 
@@ -21,7 +23,7 @@ uint16_t packet_length;
 
 /* counter */
 uint8_t abr_count = 0;
-uint8_t nbr_count = 0;
+uint16_t nbr_count = 0;
 uint8_t def_rtr_count = 0;
 uint8_t rtr_sol_count = 0;
 uint8_t prefix_count = 0;
@@ -186,6 +188,7 @@ void recv_rtr_sol(void){
         opt_hdr_len += (opt_stllao_buf->length) << 3;
     }
     if(llao != NULL){
+        nbr_cache_lock();
         nbr_entry = nbr_cache_search(&ipv6_buf->srcaddr);
         if(nbr_entry != NULL){
             /* found neighbor in cache, update values and check long addr */
@@ -193,7 +196,7 @@ void recv_rtr_sol(void){
                 nbr_entry->isrouter = 0;
             } else {
                 /* new long addr found, update */
-                memcpy(&nbr_entry->laddr,&llao[2],8);
+                nbr_cache_set_laddr(nbr_entry, (ieee_802154_long_t*)&llao[2]);
                 nbr_entry->state = NBR_STATUS_STALE;
                 nbr_entry->isrouter = 0;
             }
@@ -203,6 +206,7 @@ void recv_rtr_sol(void){
                           0, NBR_STATUS_STALE, NBR_CACHE_TYPE_TEN, 
                           NBR_CACHE_LTIME_TEN, NULL);
         }
+        nbr_cache_unlock();
     }
 
     /* send solicited router advertisment */
@@ -659,6 +663,7 @@ void recv_nbr_sol(void){
                 llao = (uint8_t*)opt_stllao_buf;
                 if(llao != NULL && 
                    !(ipv6_addr_unspec_match(&ipv6_buf->srcaddr))){
+                    nbr_cache_lock();
                     nbr_entry = nbr_cache_search(&(ipv6_buf->srcaddr));
                     if(nbr_entry != NULL){
                         switch(opt_stllao_buf->length){
@@ -676,7 +681,8 @@ void recv_nbr_sol(void){
                                 if(memcmp(&llao[2],&(nbr_entry->laddr),8) == 0){
                                     nbr_entry->isrouter = 0;
                                 } else {
-                                    memcpy(&nbr_entry->laddr, &llao[2],8);
+                                    nbr_cache_set_laddr(nbr_entry, 
+                                        (ieee_802154_long_t*)&llao[2]);
                                     nbr_entry->state = NBR_STATUS_STALE;
                                     nbr_entry->isrouter = 0;
                                 }
@@ -708,6 +714,7 @@ void recv_nbr_sol(void){
                                 break;
                         }
                     }
+                    nbr_cache_unlock();
                 }
                 break;
             }
@@ -721,13 +728,14 @@ void recv_nbr_sol(void){
                     if((opt_aro_buf->length == 2) && 
                        (opt_aro_buf->status == 0)){
                         /* check neighbor cache for duplicates */
+                        nbr_cache_lock();
                         nbr_entry = nbr_cache_search(&(ipv6_buf->srcaddr));
                         if(nbr_entry == NULL){
                             /* create neighbor cache */
                             aro_state = nbr_cache_add(&ipv6_buf->srcaddr,
                                                       &(opt_aro_buf->eui64),0,
-                                                      NBR_STATUS_STALE, NBR_CACHE_TYPE_TEN,
-                                                      opt_aro_buf->reg_ltime, NULL);
+                                                      NBR_STATUS_STALE, NBR_CACHE_TYPE_REG,
+                                                      HTONS(opt_aro_buf->reg_ltime) * 60, NULL);
                         } else {
                             if(memcmp(&(nbr_entry->addr.uint16[4]), 
                                &(opt_aro_buf->eui64.uint16[0]),8) == 0){
@@ -736,7 +744,9 @@ void recv_nbr_sol(void){
                                     /* delete neighbor cache entry */
                                     nbr_cache_rem(&nbr_entry->addr); 
                                 } else {
-                                    set_remaining_time(&(nbr_entry->ltime), (uint32_t)opt_aro_buf->reg_ltime);
+                                    /* registration lifetime in minutes */
+                                    nbr_entry->type = NBR_CACHE_TYPE_REG;
+                                    nbr_cache_set_ltime(nbr_entry, (uint32_t)HTONS(opt_aro_buf->reg_ltime) * 60);
                                     nbr_entry->state = NBR_STATUS_STALE;
                                     nbr_entry->isrouter = 0;
                                     memcpy(&(nbr_entry->addr.uint8[0]),
@@ -748,6 +758,7 @@ void recv_nbr_sol(void){
                                 aro_state = OPT_ARO_STATE_DUP_ADDR;
                             }
                         } 
+                        nbr_cache_unlock();
                     }
                 }
                 break;
@@ -868,6 +879,7 @@ void recv_nbr_adv(void){
     addr = ipv6_iface_addr_match(&nbr_adv_buf->tgtaddr); 
     
     if(addr == NULL){
+        nbr_cache_lock();
         nbr_entry = nbr_cache_search(&nbr_adv_buf->tgtaddr);
         if(nbr_entry != NULL){
             if(llao != 0){
@@ -876,13 +888,13 @@ void recv_nbr_adv(void){
             }
             if(nbr_entry->state == NBR_STATUS_INCOMPLETE){
                 if(llao == NULL){
+                    nbr_cache_unlock();
                     return;
                 }
                 /* TODO: untersheiden zwischen short und long stllao option */
-                memcpy(&nbr_entry->laddr, &llao[2], 8);
+                nbr_cache_set_laddr(nbr_entry, (ieee_802154_long_t*)&llao[2]);
                 if(nbr_adv_buf->rso & NBR_ADV_FLAG_S){
-                    nbr_entry->state = NBR_STATUS_REACHABLE;
-                    /* TODO: set rechability */
+                    nbr_cache_set_reachable(nbr_entry);
                 } else {
                     nbr_entry->state = NBR_STATUS_STALE;
                 }
@@ -892,17 +904,18 @@ void recv_nbr_adv(void){
                     if(nbr_entry->state == NBR_STATUS_REACHABLE){
                         nbr_entry->state = NBR_STATUS_STALE;
                     }
+                    nbr_cache_unlock();
                     return;
                 } else {
                     if((nbr_adv_buf->rso & NBR_ADV_FLAG_O) || 
                        (!(nbr_adv_buf->rso & NBR_ADV_FLAG_O) && llao != 0 &&
                        !new_ll)){
                         if(llao != 0){
-                            memcpy(&nbr_entry->laddr, &llao[2], 8);
+                            nbr_cache_set_laddr(nbr_entry, 
+                                                (ieee_802154_long_t*)&llao[2]);
                         }
                         if(nbr_adv_buf->rso & NBR_ADV_FLAG_S){
-                            nbr_entry->state = NBR_STATUS_REACHABLE;
-                            /* TODO: set rechablility */
+                            nbr_cache_set_reachable(nbr_entry);
                         } else {
                             if(llao != 0 && new_ll){
                                 nbr_entry->state = NBR_STATUS_STALE;
@@ -912,6 +925,7 @@ void recv_nbr_adv(void){
                 }
             }   
         }
+        nbr_cache_unlock();
     }
 }
 
@@ -991,61 +1005,297 @@ void init_para_prob(ipv6_addr_t *src, ipv6_addr_t *dest, uint8_t code, uint32_t
 //------------------------------------------------------------------------------
 // neighbor cache functions
 
-nbr_cache_t * nbr_cache_search(ipv6_addr_t *ipaddr){
+/* entries are found through an index on the IPv6 address and one on the
+ * EUI-64, and kept in least recently used order for eviction */
+static nbr_cache_t *nbr_addr_hash[NBR_CACHE_HASH_SIZE];
+static nbr_cache_t *nbr_eui_hash[NBR_CACHE_HASH_SIZE];
+static nbr_cache_t *nbr_lru_head = NULL;
+static nbr_cache_t *nbr_lru_tail = NULL;
+static nbr_cache_t *nbr_free = NULL;
+static mutex_t nbr_cache_mutex;
+/* earliest lifetime nbr_cache_auto_rem() sleeps for, 0 for none */
+static uint32_t nbr_next_expiry = 0;
+
+static uint32_t nbr_now(void){
+    timex_t now = vtimer_now();
+    timex_normalize(&now);
+    return now.seconds;
+}
+
+static uint8_t nbr_addr_hash_key(ipv6_addr_t *addr){
+    uint32_t h = addr->uint32[2] ^ addr->uint32[3];
+    h ^= h >> 16;
+    h ^= h >> 8;
+    return h & (NBR_CACHE_HASH_SIZE - 1);
+}
+
+static uint8_t nbr_eui_hash_key(ieee_802154_long_t *laddr){
+    uint16_t h = laddr->uint16[0] ^ laddr->uint16[1] ^ laddr->uint16[2] ^
+                 laddr->uint16[3];
+    h ^= h >> 8;
+    return h & (NBR_CACHE_HASH_SIZE - 1);
+}
+
+static void nbr_lru_unlink(nbr_cache_t *entry){
+    if(entry->lru_prev != NULL){
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        nbr_lru_head = entry->lru_next;
+    }
+    if(entry->lru_next != NULL){
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        nbr_lru_tail = entry->lru_prev;
+    }
+}
+
+static void nbr_lru_add(nbr_cache_t *entry){
+    entry->lru_prev = NULL;
+    entry->lru_next = nbr_lru_head;
+    if(nbr_lru_head != NULL){
+        nbr_lru_head->lru_prev = entry;
+    } else {
+        nbr_lru_tail = entry;
+    }
+    nbr_lru_head = entry;
+}
+
+static void nbr_eui_unlink(nbr_cache_t *entry){
+    nbr_cache_t **link = &nbr_eui_hash[nbr_eui_hash_key(&entry->laddr)];
+    while(*link != entry){
+        link = &(*link)->eui_next;
+    }
+    *link = entry->eui_next;
+}
+
+static void nbr_eui_add(nbr_cache_t *entry){
+    uint8_t key = nbr_eui_hash_key(&entry->laddr);
+    entry->eui_next = nbr_eui_hash[key];
+    nbr_eui_hash[key] = entry;
+}
+
+static void nbr_cache_free(nbr_cache_t *entry){
+    nbr_cache_t **link = &nbr_addr_hash[nbr_addr_hash_key(&entry->addr)];
+    while(*link != entry){
+        link = &(*link)->addr_next;
+    }
+    *link = entry->addr_next;
+    if(entry->has_laddr){
+        nbr_eui_unlink(entry);
+    }
+    nbr_lru_unlink(entry);
+    memset(entry, 0, sizeof(nbr_cache_t));
+    entry->lru_next = nbr_free;
+    nbr_free = entry;
+    nbr_count--;
+}
+
+static uint8_t nbr_expired(nbr_cache_t *entry, uint32_t now){
+    return entry->expires != 0 && entry->expires <= now;
+}
+
+/* moves a live entry to the front, REACHABLE times out to STALE */
+static nbr_cache_t *nbr_cache_use(nbr_cache_t *entry, uint32_t now){
+    if(nbr_expired(entry, now)){
+        nbr_cache_free(entry);
+        return NULL;
+    }
+    if(entry->state == NBR_STATUS_REACHABLE && entry->reachable <= now){
+        entry->state = NBR_STATUS_STALE;
+    }
+    nbr_lru_unlink(entry);
+    nbr_lru_add(entry);
+    return entry;
+}
+
+/* the auto remove thread waits until the earliest lifetime, a message
+ * stays queued if it is not waiting yet */
+static void nbr_cache_wake(uint32_t expires){
+    msg_t m;
+    if(expires != 0 && (nbr_next_expiry == 0 || expires < nbr_next_expiry)){
+        nbr_next_expiry = expires;
+        if(nd_nbr_cache_rem_pid != 0){
+            msg_send(&m, nd_nbr_cache_rem_pid, 0);
+        }
+    }
+}
+
+void nbr_cache_lock(void){
+    mutex_lock_recursive(&nbr_cache_mutex);
+}
+
+void nbr_cache_unlock(void){
+    mutex_unlock_recursive(&nbr_cache_mutex, 0);
+}
+
+void nbr_cache_init(void){
     int i;
-    for(i = 0; i < NBR_CACHE_SIZE; i++){
-        if(memcmp(&(nbr_cache[i].addr.uint8[0]), &(ipaddr->uint8[0]), 16) == 0){
-            return &nbr_cache[i];
-        } 
+    memset(nbr_cache, 0, sizeof(nbr_cache));
+    memset(nbr_addr_hash, 0, sizeof(nbr_addr_hash));
+    memset(nbr_eui_hash, 0, sizeof(nbr_eui_hash));
+    nbr_lru_head = NULL;
+    nbr_lru_tail = NULL;
+    nbr_free = NULL;
+    for(i = NBR_CACHE_SIZE - 1; i >= 0; i--){
+        nbr_cache[i].lru_next = nbr_free;
+        nbr_free = &nbr_cache[i];
     }
-    return NULL;
+    nbr_count = 0;
+    nbr_next_expiry = 0;
+}
+
+nbr_cache_t * nbr_cache_search(ipv6_addr_t *ipaddr){
+    nbr_cache_t *entry;
+    mutex_lock_recursive(&nbr_cache_mutex);
+    entry = nbr_addr_hash[nbr_addr_hash_key(ipaddr)];
+    while(entry != NULL && 
+          memcmp(&(entry->addr.uint8[0]), &(ipaddr->uint8[0]), 16) != 0){
+        entry = entry->addr_next;
+    }
+    if(entry != NULL){
+        entry = nbr_cache_use(entry, nbr_now());
+    }
+    mutex_unlock_recursive(&nbr_cache_mutex, 0);
+    return entry;
+}
+
+nbr_cache_t * nbr_cache_search_eui64(ieee_802154_long_t *laddr){
+    nbr_cache_t *entry, *next;
+    uint32_t now = nbr_now();
+    mutex_lock_recursive(&nbr_cache_mutex);
+    /* the first live one, a host may have more addresses */
+    for(entry = nbr_eui_hash[nbr_eui_hash_key(laddr)]; entry != NULL; 
+        entry = next){
+        next = entry->eui_next;
+        if(memcmp(&(entry->laddr), laddr, 8) == 0 && 
+           nbr_cache_use(entry, now) != NULL){
+            break;
+        }
+    }
+    mutex_unlock_recursive(&nbr_cache_mutex, 0);
+    return entry;
 }
 
 uint8_t nbr_cache_add(ipv6_addr_t *ipaddr, ieee_802154_long_t *laddr, 
                    uint8_t isrouter, uint8_t state, uint8_t type,
-                   uint16_t ltime, ieee_802154_short_t *saddr){
-    if(nbr_count == NBR_CACHE_SIZE){
+                   uint32_t ltime, ieee_802154_short_t *saddr){
+    nbr_cache_t *entry;
+    uint32_t now = nbr_now();
+    uint8_t key;
+
+    mutex_lock_recursive(&nbr_cache_mutex);
+    if(nbr_free == NULL){
+        /* make room, registered entries stay until their lifetime is up */
+        for(entry = nbr_lru_tail; entry != NULL; entry = entry->lru_prev){
+            if(nbr_expired(entry, now) || entry->type != NBR_CACHE_TYPE_REG){
+                nbr_cache_free(entry);
+                break;
+            }
+        }
+    }
+    if(nbr_free == NULL){
+        mutex_unlock_recursive(&nbr_cache_mutex, 0);
         printf("ERROR: neighbor cache full\n");
         return OPT_ARO_STATE_NBR_CACHE_FULL;
     }
     
-    memcpy(&(nbr_cache[nbr_count].addr), ipaddr, 16);
-    memcpy(&(nbr_cache[nbr_count].laddr), laddr, 8);
-    nbr_cache[nbr_count].isrouter = isrouter;
-    nbr_cache[nbr_count].state = state;
-    nbr_cache[nbr_count].type = type;
-    
-    //vtimer_set_wakeup(&(nbr_cache[nbr_count].ltime), t, 
-    //                  nd_nbr_cache_rem_pid);        
-
+    entry = nbr_free;
+    nbr_free = entry->lru_next;
+    memcpy(&(entry->addr), ipaddr, 16);
+    if(laddr != NULL){
+        memcpy(&(entry->laddr), laddr, 8);
+        entry->has_laddr = 1;
+        nbr_eui_add(entry);
+    }
+    if(saddr != NULL){
+        memcpy(&(entry->saddr), saddr, 2);
+    }
+    entry->isrouter = isrouter;
+    entry->state = state;
+    entry->type = type;
+    entry->expires = (type == NBR_CACHE_TYPE_GC) ? 0 : now + ltime;
+    entry->reachable = now + NBR_REACHABLE_TIME;
+    key = nbr_addr_hash_key(ipaddr);
+    entry->addr_next = nbr_addr_hash[key];
+    nbr_addr_hash[key] = entry;
+    nbr_lru_add(entry);
     nbr_count++;
+    nbr_cache_wake(entry->expires);
+    mutex_unlock_recursive(&nbr_cache_mutex, 0);
     
     return OPT_ARO_STATE_SUCCESS;
 }
 
+void nbr_cache_set_laddr(nbr_cache_t *entry, ieee_802154_long_t *laddr){
+    mutex_lock_recursive(&nbr_cache_mutex);
+    if(entry->has_laddr){
+        nbr_eui_unlink(entry);
+    }
+    memcpy(&(entry->laddr), laddr, 8);
+    entry->has_laddr = 1;
+    nbr_eui_add(entry);
+    mutex_unlock_recursive(&nbr_cache_mutex, 0);
+}
+
+void nbr_cache_set_ltime(nbr_cache_t *entry, uint32_t ltime){
+    mutex_lock_recursive(&nbr_cache_mutex);
+    entry->expires = nbr_now() + ltime;
+    nbr_cache_wake(entry->expires);
+    mutex_unlock_recursive(&nbr_cache_mutex, 0);
+}
+
+void nbr_cache_set_reachable(nbr_cache_t *entry){
+    mutex_lock_recursive(&nbr_cache_mutex);
+    entry->state = NBR_STATUS_REACHABLE;
+    entry->reachable = nbr_now() + NBR_REACHABLE_TIME;
+    mutex_unlock_recursive(&nbr_cache_mutex, 0);
+}
+
+/* thread removing neighbors whose lifetime is up */
 void nbr_cache_auto_rem(void){
-    int i;
-    for(i = 0; i < NBR_CACHE_SIZE; i++){
-        if(get_remaining_time(&(nbr_cache[i].ltime)) == 0 && 
-           nbr_cache[i].type == NBR_CACHE_TYPE_TEN){
-            memmove(&(nbr_cache[i]),&(nbr_cache[nbr_count]), 
-                    sizeof(nbr_cache_t));
-            memset(&(nbr_cache[nbr_count]), 0, sizeof(nbr_cache_t));
-            nbr_count--;
+    static vtimer_t timer;
+    static msg_t msg_queue[NBR_CACHE_MSG_QUEUE_SIZE];
+    nbr_cache_t *entry, *prev;
+    uint32_t now;
+    msg_t m;
+    msg_init_queue(msg_queue, NBR_CACHE_MSG_QUEUE_SIZE);
+    while(1){
+        mutex_lock_recursive(&nbr_cache_mutex);
+        now = nbr_now();
+        nbr_next_expiry = 0;
+        for(entry = nbr_lru_tail; entry != NULL; entry = prev){
+            prev = entry->lru_prev;
+            if(nbr_expired(entry, now)){
+                nbr_cache_free(entry);
+            } else if(entry->expires != 0 && 
+                      (nbr_next_expiry == 0 || entry->expires < nbr_next_expiry)){
+                nbr_next_expiry = entry->expires;
+            }
         }
+        /* armed under the lock, nbr_cache_wake() queues a message for
+         * an earlier one added after the scan */
+        vtimer_remove(&timer);
+        if(nbr_next_expiry != 0){
+            vtimer_set_msg(&timer, timex_set(nbr_next_expiry - now, 0), 
+                           thread_getpid(), NULL);
+        }
+        mutex_unlock_recursive(&nbr_cache_mutex, 0);
+        msg_receive(&m);
     }
 }
 
 void nbr_cache_rem(ipv6_addr_t *addr){
-    int i;
-    for(i = 0; i < NBR_CACHE_SIZE; i++){
-        if(memcmp(&(nbr_cache[i].addr.uint8[0]),&(addr->uint8[0]),16) == 0){
-            memmove(&(nbr_cache[i]),&(nbr_cache[nbr_count]), 
-                    sizeof(nbr_cache_t));
-            memset(&(nbr_cache[nbr_count]), 0, sizeof(nbr_cache_t));
-            nbr_count--;     
-        }
+    nbr_cache_t *entry;
+    mutex_lock_recursive(&nbr_cache_mutex);
+    entry = nbr_addr_hash[nbr_addr_hash_key(addr)];
+    while(entry != NULL && 
+          memcmp(&(entry->addr.uint8[0]),&(addr->uint8[0]),16) != 0){
+        entry = entry->addr_next;
+    }
+    if(entry != NULL){
+        nbr_cache_free(entry);
     }
+    mutex_unlock_recursive(&nbr_cache_mutex, 0);
 }
 
 //------------------------------------------------------------------------------
@@ -79,12 +79,22 @@
 #define OPT_ABRO_HDR_LEN                24
 /* authoritive border router cache size */
 #define ABR_CACHE_SIZE                  2
-/* neighbor cache size */
-#define NBR_CACHE_SIZE                  8
+/* neighbor cache size, border routers serving many hosts want more */
+#ifndef NBR_CACHE_SIZE
+#define NBR_CACHE_SIZE                  32
+#endif
+/* buckets of the address and the EUI-64 index, power of two */
+#ifndef NBR_CACHE_HASH_SIZE
+#define NBR_CACHE_HASH_SIZE             16
+#endif
 #define NBR_CACHE_TYPE_GC               1
 #define NBR_CACHE_TYPE_REG              2
 #define NBR_CACHE_TYPE_TEN              3
 #define NBR_CACHE_LTIME_TEN             20 
+/* message queue of the auto remove thread, must be a power of two */
+#define NBR_CACHE_MSG_QUEUE_SIZE        2
+/* rfc4861 10. REACHABLE_TIME in seconds */
+#define NBR_REACHABLE_TIME              30
 /* neighbor status values */
 #define NBR_STATUS_INCOMPLETE           0
 #define NBR_STATUS_REACHABLE            1
@@ -212,7 +222,13 @@ typedef struct __attribute__ ((packed)) nbr_cache_t {
     ipv6_addr_t addr;
     ieee_802154_long_t laddr;
     ieee_802154_short_t saddr;
-    timex_t ltime;
+    uint32_t expires;       /* seconds, garbage-collectible entries never */
+    uint32_t reachable;     /* seconds until REACHABLE turns STALE */
+    uint8_t has_laddr;
+    struct nbr_cache_t *addr_next;
+    struct nbr_cache_t *eui_next;
+    struct nbr_cache_t *lru_prev;   /* most recently used first */
+    struct nbr_cache_t *lru_next;   /* also chains the free entries */
 } nbr_cache_t;
 
 /* default router list - rfc4861 5.1. */
@@ -237,10 +253,19 @@ abr_cache_t *abr_add_context(   uint16_t version, ipv6_addr_t *abr_addr,
                                 uint8_t cid);
 void abr_remove_context(uint8_t cid);
 
+void nbr_cache_init(void);
+/* entries returned by the search functions are only valid while the
+ * caller holds the cache lock, the auto remove thread may free them */
+void nbr_cache_lock(void);
+void nbr_cache_unlock(void);
 nbr_cache_t * nbr_cache_search(ipv6_addr_t *ipaddr);
+nbr_cache_t * nbr_cache_search_eui64(ieee_802154_long_t *laddr);
 uint8_t nbr_cache_add(ipv6_addr_t *ipaddr, ieee_802154_long_t *laddr,
                    uint8_t isrouter, uint8_t state, uint8_t type,
-                   uint16_t ltime, ieee_802154_short_t *saddr);
+                   uint32_t ltime, ieee_802154_short_t *saddr);
+void nbr_cache_set_laddr(nbr_cache_t *entry, ieee_802154_long_t *laddr);
+void nbr_cache_set_ltime(nbr_cache_t *entry, uint32_t ltime);
+void nbr_cache_set_reachable(nbr_cache_t *entry);
 void nbr_cache_auto_rem(void);
 void nbr_cache_rem(ipv6_addr_t *addr);
 uint16_t icmpv6_csum(uint8_t proto);
@@ -16,6 +16,7 @@
 #include "sixlowborder.h"
 #include "sixlowip.h"
 #include "sixlownd.h"
+#include "semaphore.h"
 #include "transceiver.h"
 #include "ieee802154_frame.h"
 #include "sys/net/destiny/in.h"
@@ -25,23 +26,24 @@ uint16_t packet_length;
 uint8_t packet_dispatch;
 uint16_t tag;
 uint8_t header_size = 0;
-uint8_t max_frame = 0;
-uint8_t max_frag_initial = 0;
-uint8_t position;
-uint8_t max_frag;
 
 struct ipv6_hdr_t *ipv6_buf;
 
-/* length of compressed packet */
-uint16_t comp_len;
 uint8_t frag_size;
-uint8_t reas_buf[512];
-uint8_t comp_buf[512];
-uint8_t byte_offset;
+uint16_t byte_offset;
 uint8_t first_frag = 0;
-lowpan_reas_buf_t *head = NULL;
+lowpan_reas_buf_t reas_bufs[LOWPAN_REAS_BUF_COUNT];
+lowpan_reas_buf_t *reas_free = NULL;
+lowpan_reas_buf_t *reas_hash[LOWPAN_REAS_HASH_SIZE];
+lowpan_reas_buf_t *reas_lru_head = NULL;
+lowpan_reas_buf_t *reas_lru_tail = NULL;
 lowpan_reas_buf_t *packet_fifo = NULL;
+lowpan_reas_statistic_t lowpan_reas_statistic;
 mutex_t fifo_mutex;
+lowpan_tx_buf_t lowpan_tx_bufs[LOWPAN_TX_BUF_COUNT];
+lowpan_tx_buf_t *lowpan_tx_free = NULL;
+sem_t lowpan_tx_free_count;
+mutex_t lowpan_tx_mutex;
 
 unsigned int ip_process_pid;
 unsigned int nd_nbr_cache_rem_pid = 0;
@@ -50,7 +52,6 @@ unsigned int transfer_pid = 0;
 
 iface_t iface;
 ipv6_addr_t lladdr;
-ieee_802154_long_t laddr;
 mutex_t buf_mutex;
 mutex_t lowpan_context_mutex;
 
@@ -60,99 +61,129 @@ char con_buf[CON_STACKSIZE];
 char lowpan_transfer_buf[LOWPAN_TRANSFER_BUF_STACKSIZE];
 lowpan_context_t contexts[LOWPAN_CONTEXT_MAX];
 uint8_t context_len = 0;
+lowpan_iphc_template_t iphc_cache[LOWPAN_IPHC_CACHE_SIZE];
+lowpan_iphc_template_t *iphc_cache_hash[LOWPAN_IPHC_CACHE_HASH_SIZE];
+lowpan_iphc_template_t *iphc_cache_lru_head = NULL;
+lowpan_iphc_template_t *iphc_cache_lru_tail = NULL;
+uint8_t iphc_cache_used = 0;
+lowpan_iphc_cache_statistic_t lowpan_iphc_cache_statistic;
 uint8_t static_route = 0;
 uint16_t local_address = 0;
 
 void lowpan_context_auto_remove(void);
 
-/* deliver packet to mac*/
+/* takes a transmit buffer, waiting for one if all are in use */
+static lowpan_tx_buf_t *lowpan_tx_alloc(void){
+    lowpan_tx_buf_t *tx;
+
+    sem_wait(&lowpan_tx_free_count);
+    mutex_lock(&lowpan_tx_mutex);
+    tx = lowpan_tx_free;
+    lowpan_tx_free = tx->next;
+    mutex_unlock(&lowpan_tx_mutex,0);
+    return tx;
+}
+
+static void lowpan_tx_release(lowpan_tx_buf_t *tx){
+    mutex_lock(&lowpan_tx_mutex);
+    tx->next = lowpan_tx_free;
+    lowpan_tx_free = tx;
+    mutex_unlock(&lowpan_tx_mutex,0);
+    sem_signal(&lowpan_tx_free_count);
+}
+
+/* writes a fragment header, first fragments have no offset */
+static void lowpan_frag_hdr(uint8_t *frag, uint8_t dispatch, uint16_t size,
+                            uint16_t datagram_tag, uint16_t offset){
+    frag[0] = (((dispatch << 8) | size) >> 8) & 0xff;
+    frag[1] = ((dispatch << 8) | size) & 0xff;
+    frag[2] = (datagram_tag >> 8) & 0xff;
+    frag[3] = datagram_tag & 0xff;
+    if(dispatch != 0xc0){
+        frag[4] = offset / 8;
+    }
+}
+
+/* deliver packet to mac */
 void lowpan_init(ieee_802154_long_t *addr, uint8_t *data){
-    uint8_t mcast = 0;
+    lowpan_send(addr, (ipv6_hdr_t *) data, &data[IPV6_HDR_LEN]);
+}
 
-	ipv6_buf = (ipv6_hdr_t *) data;
+/* compresses and fragments a datagram in a transmit buffer of its own,
+ * so any number of threads may send at a time, the header and the
+ * payload are only read */
+void lowpan_send(ieee_802154_long_t *addr, ipv6_hdr_t *ipv6, uint8_t *payload){
+    ieee_802154_long_t dest;
+    lowpan_tx_buf_t *tx;
+    uint8_t *data;
+    uint8_t *frag;
+    uint8_t mcast = 0;
+    uint8_t max_frame = PAYLOAD_SIZE - IEEE_802154_MAX_HDR_LEN;
+    uint8_t max_frag;
+    uint16_t length;
+    uint16_t position;
+    uint16_t datagram_tag;
+
+    if(IPV6_HDR_LEN + ipv6->length > MTU){
+        return;
+    }
 
-	memcpy(&laddr.uint8[0], &addr->uint8[0], 8);
+    memcpy(&dest.uint8[0], &addr->uint8[0], 8);
 
-    if(ipv6_prefix_mcast_match(&ipv6_buf->destaddr)){
+    if(ipv6_prefix_mcast_match(&ipv6->destaddr)){
         /* send broadcast */
         mcast = 1;
     } 
 
-    lowpan_iphc_encoding(&laddr, ipv6_buf, data);
-    data = &comp_buf[0];
-    packet_length = comp_len;
+    tx = lowpan_tx_alloc();
+    /* fragment headers go in front of the fragment in place */
+    data = &tx->data[FRAG_PART_N_HDR_LEN];
+    length = lowpan_iphc_encoding(&dest, ipv6, payload, data);
     
     if (static_route == 1)
 		{
-		if (laddr.uint8[7] < local_address)
+		if (dest.uint8[7] < local_address)
 			{
-			laddr.uint8[7] = local_address - 1;
+			dest.uint8[7] = local_address - 1;
 			}
 		else
 			{
-			laddr.uint8[7] = local_address + 1;
+			dest.uint8[7] = local_address + 1;
 			}
 		}
 
     /* check if packet needs to be fragmented */
-    if(packet_length + header_size > PAYLOAD_SIZE - IEEE_802154_MAX_HDR_LEN){
-        uint8_t fragbuf[packet_length + header_size];
-        uint8_t remaining;
-        uint8_t i = 2;
+    if(length + header_size > max_frame){
+        mutex_lock(&lowpan_tx_mutex);
+        datagram_tag = tag++;
+        mutex_unlock(&lowpan_tx_mutex,0);
+
         /* first fragment */
-        max_frame = PAYLOAD_SIZE - IEEE_802154_MAX_HDR_LEN;
-        max_frag_initial = ((max_frame - 4 - header_size) / 8) * 8;
-       
-        memcpy(fragbuf + 4, data, max_frag_initial); 
-        
-        fragbuf[0] = (((0xc0 << 8) | packet_length) >> 8) & 0xff;
-        fragbuf[1] = ((0xc0 << 8) | packet_length) & 0xff;
-        fragbuf[2] = (tag >> 8) & 0xff;
-        fragbuf[3] = tag & 0xff;  
-
-        send_ieee802154_frame(&laddr,(uint8_t*)&fragbuf, 
-                              max_frag_initial + header_size + 4, mcast);
-        /* subsequent fragments */
-        position = max_frag_initial;
-        max_frag = ((max_frame - 5) / 8) * 8;
-
-        data += position;        
-
-        while(packet_length - position > max_frame - 5){
-            memset(&fragbuf,0,packet_length + header_size);
-            memcpy(fragbuf + 5, data, max_frag);
-        
-            fragbuf[0] = (((0xe0 << 8) | packet_length) >> 8) & 0xff;
-            fragbuf[1] = ((0xe0 << 8) | packet_length) & 0xff;
-            fragbuf[2] = (tag >> 8) & 0xff; 
-            fragbuf[3] = tag & 0xff;
-            fragbuf[4] = position / 8;
-            
-            send_ieee802154_frame(&laddr,(uint8_t*)&fragbuf, max_frag + 5, 
+        position = ((max_frame - FRAG_PART_ONE_HDR_LEN - header_size) / 8) * 8;
+        frag = data - FRAG_PART_ONE_HDR_LEN;
+        lowpan_frag_hdr(frag, 0xc0, length, datagram_tag, 0);
+        send_ieee802154_frame(&dest, frag, 
+                              position + header_size + FRAG_PART_ONE_HDR_LEN, mcast);
+
+        /* subsequent fragments, over the part already sent */
+        max_frag = ((max_frame - FRAG_PART_N_HDR_LEN) / 8) * 8;
+        while(length - position > max_frame - FRAG_PART_N_HDR_LEN){
+            frag = data + position - FRAG_PART_N_HDR_LEN;
+            lowpan_frag_hdr(frag, 0xe0, length, datagram_tag, position);
+            send_ieee802154_frame(&dest, frag, max_frag + FRAG_PART_N_HDR_LEN, 
                                   mcast);
-            data += max_frag;
             position += max_frag;
-
-            i++;      
         }
        
-        remaining = packet_length - position;
-
-        memset(&fragbuf,0,packet_length + header_size);
-        memcpy(fragbuf + 5, data, remaining); 
-        
-        fragbuf[0] = (((0xe0 << 8) | packet_length) >> 8) & 0xff;
-        fragbuf[1] = ((0xe0 << 8) | packet_length) & 0xff;
-        fragbuf[2] = (tag >> 8) & 0xff;
-        fragbuf[3] = tag & 0xff;
-        fragbuf[4] = position / 8;
-
-        send_ieee802154_frame(&laddr, (uint8_t*)&fragbuf, remaining + 5, mcast);
+        frag = data + position - FRAG_PART_N_HDR_LEN;
+        lowpan_frag_hdr(frag, 0xe0, length, datagram_tag, position);
+        send_ieee802154_frame(&dest, frag,
+                              length - position + FRAG_PART_N_HDR_LEN, mcast);
     } else {
-        send_ieee802154_frame(&laddr, data, packet_length, mcast);
+        send_ieee802154_frame(&dest, data, length, mcast);
     } 
 
-    tag++;
+    lowpan_tx_release(tx);
 }
 
 void printLongLocalAddr(ieee_802154_long_t *saddr)
@@ -166,8 +197,7 @@ void printLongLocalAddr(ieee_802154_long_t *saddr)
 void printReasBuffers(void)
 	{
 	lowpan_reas_buf_t *temp_buffer;
-	lowpan_interval_list_t *temp_interval;
-	temp_buffer = head;
+	temp_buffer = reas_lru_head;
 
 	printf("\n\n--- Reassembly Buffers ---\n");
 
@@ -175,20 +205,24 @@ void printReasBuffers(void)
 		{
 		printLongLocalAddr(&temp_buffer->s_laddr);
 		printf("Ident.: %i, Packet Size: %i/%i, Timestamp: %li\n", temp_buffer->ident_no, temp_buffer->current_packet_size, temp_buffer->packet_size, temp_buffer->timestamp);
-		temp_interval = temp_buffer->interval_list_head;
-		while (temp_interval != NULL)
+		printf("\tReceived:");
+		for (int i = 0; i < (temp_buffer->packet_size + 63) / 64; i++)
 			{
-			printf("\t%i - %i\n", temp_interval->start, temp_interval->end);
-			temp_interval = temp_interval->next;
+			printf(" %02x", temp_buffer->received[i]);
 			}
-		temp_buffer = temp_buffer->next;
+		printf("\n");
+		temp_buffer = temp_buffer->lru_next;
 		}
+
+	printf("Datagrams: %lu, completed: %lu, timeouts: %lu, evicted: %lu, duplicates: %lu, dropped: %lu\n",
+		lowpan_reas_statistic.datagrams, lowpan_reas_statistic.completed,
+		lowpan_reas_statistic.timeouts, lowpan_reas_statistic.evicted,
+		lowpan_reas_statistic.duplicates, lowpan_reas_statistic.dropped);
 	}
 
 void printFIFOBuffers(void)
 	{
 	lowpan_reas_buf_t *temp_buffer;
-	lowpan_interval_list_t *temp_interval;
 	temp_buffer = packet_fifo;
 
 	printf("\n\n--- Reassembly Buffers ---\n");
@@ -197,12 +231,6 @@ void printFIFOBuffers(void)
 		{
 		printLongLocalAddr(&temp_buffer->s_laddr);
 		printf("Ident.: %i, Packet Size: %i/%i, Timestamp: %li\n", temp_buffer->ident_no, temp_buffer->current_packet_size, temp_buffer->packet_size, temp_buffer->timestamp);
-		temp_interval = temp_buffer->interval_list_head;
-		while (temp_interval != NULL)
-			{
-			printf("\t%i - %i\n", temp_interval->start, temp_interval->end);
-			temp_interval = temp_interval->next;
-			}
 		temp_buffer = temp_buffer->next;
 		}
 	}
@@ -258,250 +286,243 @@ void lowpan_transfer(void)
 		}
 	}
 
-uint8_t ll_get_addr_match(ieee_802154_long_t *src, ieee_802154_long_t *dst){
-    uint8_t val = 0, xor;
-    for(int i = 0; i < 8; i++){
-        /* if bytes are equal add 8 */
-        if(src->uint8[i] == dst->uint8[i]){
-            val += 8;
-        } else {
-            xor = src->uint8[i] ^ dst->uint8[i];
-            /* while bits from byte equal add 1 */
-            for(int j = 0; j < 8; j++){
-                if((xor & 0x80) == 0){
-                    val++;
-                    xor = xor << 1;
-                } else {
-                    break;
-                }
-            }
-        }
-    }
-    return val;
-}
-
-lowpan_reas_buf_t *new_packet_buffer(uint16_t datagram_size, uint16_t datagram_tag, ieee_802154_long_t *s_laddr, ieee_802154_long_t *d_laddr,
-		lowpan_reas_buf_t *current_buf, lowpan_reas_buf_t *temp_buf)
+uint8_t reas_hash_key(uint16_t datagram_size, uint16_t datagram_tag, ieee_802154_long_t *s_laddr)
 	{
-	lowpan_reas_buf_t *new_buf = NULL;
-
-	/* Allocate new memory for a new packet to be reassembled */
-	new_buf = malloc(sizeof(lowpan_reas_buf_t));
+	return (s_laddr->uint8[6] ^ s_laddr->uint8[7] ^ datagram_tag ^ (datagram_tag >> 8) ^ datagram_size) &
+		(LOWPAN_REAS_HASH_SIZE - 1);
+	}
 
-	if (new_buf != NULL)
+void reas_lru_unlink(lowpan_reas_buf_t *current_buf)
+	{
+	if (current_buf->lru_prev != NULL)
 		{
-		init_reas_bufs(new_buf);
-
-		new_buf->packet = malloc(datagram_size);
-		if(new_buf->packet != NULL)
-			{
-			memcpy(&new_buf->s_laddr, s_laddr, SIXLOWPAN_IPV6_LL_ADDR_LEN);
-			memcpy(&new_buf->d_laddr, d_laddr, SIXLOWPAN_IPV6_LL_ADDR_LEN);
-
-			new_buf->ident_no = datagram_tag;
-			new_buf->packet_size = datagram_size;
-			new_buf->timestamp = vtimer_now().microseconds;
-
-			if ((current_buf == NULL) && (temp_buf == NULL))
-				{
-				head = new_buf;
-				}
-			else
-				{
-				temp_buf->next = new_buf;
-				}
-			return new_buf;
-			}
-		else
-			{
-			return NULL;
-			}
+		current_buf->lru_prev->lru_next = current_buf->lru_next;
 		}
 	else
 		{
-		return NULL;
+		reas_lru_head = current_buf->lru_next;
+		}
+	if (current_buf->lru_next != NULL)
+		{
+		current_buf->lru_next->lru_prev = current_buf->lru_prev;
+		}
+	else
+		{
+		reas_lru_tail = current_buf->lru_prev;
 		}
 	}
 
-lowpan_reas_buf_t *get_packet_frag_buf(uint16_t datagram_size, uint16_t datagram_tag, ieee_802154_long_t *s_laddr, ieee_802154_long_t *d_laddr)
+void reas_lru_add(lowpan_reas_buf_t *current_buf)
 	{
-	lowpan_reas_buf_t *current_buf = NULL, *temp_buf = NULL;
-	current_buf = head;
-	while (current_buf != NULL)
+	current_buf->lru_prev = NULL;
+	current_buf->lru_next = reas_lru_head;
+	if (reas_lru_head != NULL)
 		{
-		if (((ll_get_addr_match(&current_buf->s_laddr, s_laddr)) == 64) &&
-			((ll_get_addr_match(&current_buf->d_laddr, d_laddr)) == 64) &&
-			(current_buf->packet_size == datagram_size) &&
-			(current_buf->ident_no == datagram_tag) &&
-			current_buf->interval_list_head != NULL)
-			{
-			/* Found buffer for current packet fragment */
-			current_buf->timestamp = vtimer_now().microseconds;
-			return current_buf;
-			}
-		temp_buf = current_buf;
-		current_buf = current_buf->next;
+		reas_lru_head->lru_prev = current_buf;
 		}
-
-	return new_packet_buffer(datagram_size, datagram_tag, s_laddr, d_laddr, current_buf, temp_buf);
+	else
+		{
+		reas_lru_tail = current_buf;
+		}
+	reas_lru_head = current_buf;
 	}
 
-uint8_t isInInterval(uint8_t start1, uint8_t end1, uint8_t start2, uint8_t end2)
+/* takes an incomplete datagram out of the hash table and the LRU list */
+void reas_unlink(lowpan_reas_buf_t *current_buf)
 	{
-	/* 1: Interval 1 and 2 are the same or overlapping */
-	/* 0: Interval 1 and 2 are not overlapping or the same */
+	lowpan_reas_buf_t **link;
 
-	if 	(((start1 < start2) && (start2 <= end1)) ||
-		((start2 < start1) && (start1 <= end2)) ||
-		((start1 == start2) && (end1 == end2)))
+	link = &reas_hash[reas_hash_key(current_buf->packet_size, current_buf->ident_no, &current_buf->s_laddr)];
+	while (*link != current_buf)
 		{
-		return 1;
+		link = &(*link)->hash_next;
 		}
-	else
+	*link = current_buf->hash_next;
+
+	reas_lru_unlink(current_buf);
+	}
+
+/* returns a buffer to the free list, the transfer thread frees concurrently */
+void reas_release(lowpan_reas_buf_t *current_buf)
+	{
+	if (current_buf->frame != NULL)
 		{
-		return 0;
+		pktbuf_release(current_buf->frame);
+		current_buf->frame = NULL;
 		}
+
+	mutex_lock(&fifo_mutex);
+	current_buf->next = reas_free;
+	reas_free = current_buf;
+	mutex_unlock(&fifo_mutex, 0);
 	}
 
-uint8_t handle_packet_frag_interval(lowpan_reas_buf_t *current_buf, uint8_t datagram_offset,  uint8_t frag_size)
+/* takes a free buffer, dropping the least recently used incomplete
+ * datagram if there is none */
+lowpan_reas_buf_t *reas_alloc(void)
 	{
-	/* 0: Error, discard fragment */
-	/* 1: Finished correctly */
-	lowpan_interval_list_t *temp_interval = NULL, *current_interval = NULL, *new_interval = NULL;
-	current_interval = current_buf->interval_list_head;
-	while (current_interval != NULL)
+	lowpan_reas_buf_t *new_buf;
+
+	mutex_lock(&fifo_mutex);
+	new_buf = reas_free;
+	if (new_buf != NULL)
 		{
-		if (isInInterval(current_interval->start, current_interval->end, datagram_offset, datagram_offset+frag_size) == 1)
-			{
-			/* Interval is overlapping or the same as one of a previous fragment, discard fragment */
-			return 0;
-			}
-		temp_interval = current_interval;
-		current_interval = current_interval->next;
+		reas_free = new_buf->next;
 		}
-	new_interval = malloc(sizeof(lowpan_interval_list_t));
+	mutex_unlock(&fifo_mutex, 0);
 
-	if (new_interval != NULL)
+	if ((new_buf == NULL) && (reas_lru_tail != NULL))
 		{
-		new_interval->start = datagram_offset;
-		new_interval->end = datagram_offset+frag_size-1;
-		new_interval->next = NULL;
-		if ((current_interval == NULL) && (temp_interval == NULL))
-			{
-			current_buf->interval_list_head = new_interval;
-			}
-		else
+		new_buf = reas_lru_tail;
+		reas_unlink(new_buf);
+		if (new_buf->frame != NULL)
 			{
-			temp_interval->next = new_interval;
+			pktbuf_release(new_buf->frame);
 			}
-		return 1;
+		lowpan_reas_statistic.evicted++;
 		}
 
-	return 0;
+	if (new_buf != NULL)
+		{
+		init_reas_bufs(new_buf);
+		}
+	return new_buf;
 	}
 
-lowpan_reas_buf_t *collect_garbage_fifo(lowpan_reas_buf_t *current_buf)
+lowpan_reas_buf_t *new_packet_buffer(uint16_t datagram_size, uint16_t datagram_tag, ieee_802154_long_t *s_laddr, ieee_802154_long_t *d_laddr)
 	{
-	lowpan_interval_list_t *temp_list, *current_list;
-	lowpan_reas_buf_t *temp_buf, *my_buf, *return_buf;
-
-	mutex_lock(&fifo_mutex);
+	lowpan_reas_buf_t *new_buf;
+	uint8_t key;
 
-	temp_buf = packet_fifo;
-	my_buf = temp_buf;
-
-	if (packet_fifo == current_buf)
+	if (datagram_size > LOWPAN_REAS_MAX_SIZE)
 		{
-		packet_fifo = current_buf->next;
-		return_buf = packet_fifo;
+		return NULL;
 		}
-	else
+
+	new_buf = reas_alloc();
+	if (new_buf != NULL)
 		{
-		while (temp_buf != current_buf)
-			{
-			my_buf = temp_buf;
-			temp_buf = temp_buf->next;
-			}
+		memcpy(&new_buf->s_laddr, s_laddr, SIXLOWPAN_IPV6_LL_ADDR_LEN);
+		memcpy(&new_buf->d_laddr, d_laddr, SIXLOWPAN_IPV6_LL_ADDR_LEN);
 
-		my_buf->next = current_buf->next;
+		new_buf->ident_no = datagram_tag;
+		new_buf->packet_size = datagram_size;
+		new_buf->packet = new_buf->data;
+		new_buf->timestamp = vtimer_now().microseconds;
 
-		return_buf = my_buf->next;
+		key = reas_hash_key(datagram_size, datagram_tag, s_laddr);
+		new_buf->hash_next = reas_hash[key];
+		reas_hash[key] = new_buf;
+		reas_lru_add(new_buf);
+
+		lowpan_reas_statistic.datagrams++;
 		}
-	mutex_unlock(&fifo_mutex, 0);
+	return new_buf;
+	}
 
-	current_list = current_buf->interval_list_head;
-	temp_list = current_list;
+lowpan_reas_buf_t *get_packet_frag_buf(uint16_t datagram_size, uint16_t datagram_tag, ieee_802154_long_t *s_laddr, ieee_802154_long_t *d_laddr)
+	{
+	lowpan_reas_buf_t *current_buf;
 
-	while (current_list != NULL)
+	current_buf = reas_hash[reas_hash_key(datagram_size, datagram_tag, s_laddr)];
+	while (current_buf != NULL)
 		{
-		temp_list = current_list->next;
-		free(current_list);
-		current_list = temp_list;
+		if ((current_buf->packet_size == datagram_size) &&
+			(current_buf->ident_no == datagram_tag) &&
+			(memcmp(&current_buf->s_laddr, s_laddr, SIXLOWPAN_IPV6_LL_ADDR_LEN) == 0) &&
+			(memcmp(&current_buf->d_laddr, d_laddr, SIXLOWPAN_IPV6_LL_ADDR_LEN) == 0))
+			{
+			/* Found buffer for current packet fragment */
+			current_buf->timestamp = vtimer_now().microseconds;
+			reas_lru_unlink(current_buf);
+			reas_lru_add(current_buf);
+			return current_buf;
+			}
+		current_buf = current_buf->hash_next;
 		}
 
-	free(current_buf->packet);
-	free(current_buf);
+	return new_packet_buffer(datagram_size, datagram_tag, s_laddr, d_laddr);
+	}
+
+uint8_t handle_packet_frag_units(lowpan_reas_buf_t *current_buf, uint16_t datagram_offset,  uint8_t frag_size)
+	{
+	/* 0: Error, discard fragment */
+	/* 1: Finished correctly */
+	uint16_t first = datagram_offset / 8;
+	uint16_t last = (datagram_offset + frag_size - 1) / 8;
+	uint16_t i;
 
-	return return_buf;
+	for (i = first; i <= last; i++)
+		{
+		if (current_buf->received[i / 8] & (1 << (i % 8)))
+			{
+			/* Overlapping or the same as a previous fragment, discard fragment */
+			return 0;
+			}
+		}
+	for (i = first; i <= last; i++)
+		{
+		current_buf->received[i / 8] |= 1 << (i % 8);
+		}
+	return 1;
 	}
 
-lowpan_reas_buf_t *collect_garbage(lowpan_reas_buf_t *current_buf)
+void collect_garbage_fifo(lowpan_reas_buf_t *current_buf)
 	{
-	lowpan_interval_list_t *temp_list, *current_list;
-	lowpan_reas_buf_t *temp_buf, *my_buf, *return_buf;
+	lowpan_reas_buf_t *temp_buf, *my_buf;
 
-	temp_buf = head;
-	my_buf = temp_buf;
+	mutex_lock(&fifo_mutex);
 
-	if (head == current_buf)
+	if (packet_fifo == current_buf)
 		{
-		head = current_buf->next;
-		return_buf = head;
+		packet_fifo = current_buf->next;
 		}
 	else
 		{
+		temp_buf = packet_fifo;
 		while (temp_buf != current_buf)
 			{
 			my_buf = temp_buf;
 			temp_buf = temp_buf->next;
 			}
-
 		my_buf->next = current_buf->next;
-
-		return_buf = my_buf->next;
-		}
-
-	current_list = current_buf->interval_list_head;
-	temp_list = current_list;
-
-	while (current_list != NULL)
-		{
-		temp_list = current_list->next;
-		free(current_list);
-		current_list = temp_list;
 		}
+	mutex_unlock(&fifo_mutex, 0);
 
-	free(current_buf->packet);
-	free(current_buf);
+	reas_release(current_buf);
+	}
 
-	return return_buf;
+void collect_garbage(lowpan_reas_buf_t *current_buf)
+	{
+	reas_unlink(current_buf);
+	reas_release(current_buf);
 	}
 
-void handle_packet_fragment(uint8_t *data, uint8_t datagram_offset,  uint16_t datagram_size,
+void handle_packet_fragment(uint8_t *data, uint16_t datagram_offset,  uint16_t datagram_size,
 		uint16_t datagram_tag, ieee_802154_long_t *s_laddr, ieee_802154_long_t *d_laddr,
 		uint8_t hdr_length, uint8_t frag_size)
 	{
 	lowpan_reas_buf_t *current_buf;
+
+	if ((frag_size == 0) || (datagram_offset + frag_size > datagram_size))
+		{
+		lowpan_reas_statistic.dropped++;
+		printf("ERROR: received invalid fragment\n");
+		return;
+		}
+
 	/* Is there already a reassembly buffer for this packet fragment? */
 	current_buf = get_packet_frag_buf(datagram_size, datagram_tag, s_laddr, d_laddr);
-	if ((current_buf != NULL) && (handle_packet_frag_interval(current_buf, datagram_offset, frag_size) == 1))
+	if ((current_buf != NULL) && (handle_packet_frag_units(current_buf, datagram_offset, frag_size) == 1))
 		{
 		/* Copy fragment bytes into corresponding packet space area */
 		memcpy(current_buf->packet+datagram_offset, data+hdr_length, frag_size);
 		current_buf->current_packet_size += frag_size;
 		if (current_buf->current_packet_size == current_buf->packet_size)
 			{
+			reas_unlink(current_buf);
 			add_fifo_packet(current_buf);
+			lowpan_reas_statistic.completed++;
 			if (thread_getstatus(transfer_pid) == STATUS_SLEEPING)
 				{
 				thread_wakeup(transfer_pid);
@@ -510,13 +531,15 @@ void handle_packet_fragment(uint8_t *data, uint8_t datagram_offset,  uint16_t da
 		}
 	else
 		{
-		/* No memory left or duplicate */
+		/* No buffer left, too large or duplicate */
 		if (current_buf == NULL)
 			{
-			printf("ERROR: no memory left!\n");
+			lowpan_reas_statistic.dropped++;
+			printf("ERROR: no reassembly buffer left!\n");
 			}
 		else
 			{
+			lowpan_reas_statistic.duplicates++;
 			printf("ERROR: duplicate fragment!\n");
 			}
 		}
@@ -524,37 +547,17 @@ void handle_packet_fragment(uint8_t *data, uint8_t datagram_offset,  uint16_t da
 
 void check_timeout(void)
 	{
-	lowpan_reas_buf_t *temp_buf, *smallest_time = NULL;
 	long cur_time;
-	int count = 0;
 
 	cur_time = vtimer_now().microseconds;
-	temp_buf = head;
 
-	while (temp_buf != NULL)
+	/* the least recently used datagram got its last fragment first */
+	while ((reas_lru_tail != NULL) &&
+		((cur_time - reas_lru_tail->timestamp) >= LOWPAN_REAS_BUF_TIMEOUT))
 		{
-		if ((cur_time - temp_buf->timestamp) >= LOWPAN_REAS_BUF_TIMEOUT)
-			{
-			printf("TIMEOUT! cur_time: %li, temp_buf: %li\n", cur_time, temp_buf->timestamp);
-			temp_buf = collect_garbage(temp_buf);
-			}
-		else
-			{
-			if (smallest_time == NULL)
-				{
-				smallest_time = temp_buf;
-				}
-			else if (temp_buf->timestamp < smallest_time->timestamp)
-				{
-				smallest_time = temp_buf;
-				}
-			temp_buf = temp_buf->next;
-			count++;
-			}
-		}
-	if ((count > 10) && (smallest_time != NULL))
-		{
-		collect_garbage(smallest_time);
+		printf("TIMEOUT! cur_time: %li, temp_buf: %li\n", cur_time, reas_lru_tail->timestamp);
+		lowpan_reas_statistic.timeouts++;
+		collect_garbage(reas_lru_tail);
 		}
 	}
 
@@ -562,20 +565,7 @@ void add_fifo_packet(lowpan_reas_buf_t *current_packet)
 	{
 	lowpan_reas_buf_t *temp_buf, *my_buf;
 
-	if (head == current_packet)
-		{
-		head = current_packet->next;
-		}
-	else
-		{
-		temp_buf = head;
-		while (temp_buf != current_packet)
-			{
-			my_buf = temp_buf;
-			temp_buf = temp_buf->next;
-			}
-		my_buf->next = current_packet->next;
-		}
+	current_packet->next = NULL;
 	mutex_lock(&fifo_mutex);
 	if (packet_fifo == NULL)
 		{
@@ -592,7 +582,6 @@ void add_fifo_packet(lowpan_reas_buf_t *current_packet)
 		my_buf->next = current_packet;
 		}
 	mutex_unlock(&fifo_mutex, 0);
-	current_packet->next = NULL;
 	}
 
 void lowpan_read(uint8_t *data, uint8_t length, ieee_802154_long_t *s_laddr,
@@ -647,9 +636,35 @@ void lowpan_read(uint8_t *data, uint8_t length, ieee_802154_long_t *s_laddr,
     /* Regular Packet */
     else
 		{
-    	lowpan_reas_buf_t *current_buf = get_packet_frag_buf(length, 0, s_laddr, d_laddr);
-    	/* Copy packet bytes into corresponding packet space area */
-		memcpy(current_buf->packet, data, length);
+    	lowpan_reas_buf_t *current_buf = reas_alloc();
+		if (current_buf == NULL)
+			{
+			lowpan_reas_statistic.dropped++;
+			printf("ERROR: no reassembly buffer left!\n");
+			return;
+			}
+		memcpy(&current_buf->s_laddr, s_laddr, SIXLOWPAN_IPV6_LL_ADDR_LEN);
+		memcpy(&current_buf->d_laddr, d_laddr, SIXLOWPAN_IPV6_LL_ADDR_LEN);
+		current_buf->packet_size = length;
+		current_buf->timestamp = vtimer_now().microseconds;
+
+		/* unfragmented packets stay in the radio frame's pktbuf */
+		if ((current_buf->frame = pktbuf_get(data)) != NULL)
+			{
+			pktbuf_hold(current_buf->frame);
+			current_buf->packet = data;
+			}
+		else if (length <= LOWPAN_REAS_MAX_SIZE)
+			{
+			current_buf->packet = current_buf->data;
+			memcpy(current_buf->packet, data, length);
+			}
+		else
+			{
+			reas_release(current_buf);
+			lowpan_reas_statistic.dropped++;
+			return;
+			}
 		current_buf->current_packet_size += length;
 		add_fifo_packet(current_buf);
 		if (thread_getstatus(transfer_pid) == STATUS_SLEEPING)
@@ -666,14 +681,248 @@ void lowpan_ipv6_set_dispatch(uint8_t *data){
     packet_length++;
 }
 
-/* draft-ietf-6lowpan-hc-13#section-3.1 */
-void lowpan_iphc_encoding(ieee_802154_long_t *dest, ipv6_hdr_t *ipv6_buf_extra, uint8_t * ptr){
-	ipv6_buf = ipv6_buf_extra;
+/* returns the bucket of a (source, destination, link-layer destination) triple */
+static uint8_t iphc_cache_hash_key(ipv6_addr_t *src, ipv6_addr_t *dst,
+                                   ieee_802154_long_t *dest){
+    return (src->uint8[15] ^ dst->uint8[13] ^ dst->uint8[14] ^ dst->uint8[15] ^
+            dest->uint8[7]) & (LOWPAN_IPHC_CACHE_HASH_SIZE - 1);
+}
 
-    uint16_t payload_length = ipv6_buf->length;
-    uint8_t lowpan_iphc[2];
-    uint8_t *ipv6_hdr_fields = &comp_buf[2];
+static void iphc_cache_lru_unlink(lowpan_iphc_template_t *tmpl){
+    if(tmpl->lru_prev != NULL){
+        tmpl->lru_prev->lru_next = tmpl->lru_next;
+    } else {
+        iphc_cache_lru_head = tmpl->lru_next;
+    }
+    if(tmpl->lru_next != NULL){
+        tmpl->lru_next->lru_prev = tmpl->lru_prev;
+    } else {
+        iphc_cache_lru_tail = tmpl->lru_prev;
+    }
+}
+
+static void iphc_cache_lru_add(lowpan_iphc_template_t *tmpl){
+    tmpl->lru_prev = NULL;
+    tmpl->lru_next = iphc_cache_lru_head;
+    if(iphc_cache_lru_head != NULL){
+        iphc_cache_lru_head->lru_prev = tmpl;
+    } else {
+        iphc_cache_lru_tail = tmpl;
+    }
+    iphc_cache_lru_head = tmpl;
+}
+
+/* drops all compiled headers, they depend on the contexts and the
+ * interface address */
+void lowpan_iphc_cache_flush(void){
+    memset(iphc_cache_hash, 0, sizeof(iphc_cache_hash));
+    iphc_cache_lru_head = NULL;
+    iphc_cache_lru_tail = NULL;
+    iphc_cache_used = 0;
+}
+
+/* compiles the address fields: CID, SAC/SAM, M, DAC/DAM of the second
+ * IPHC byte, the context identifier extension and the inline addresses */
+static void iphc_compile_addr(lowpan_iphc_template_t *tmpl,
+                              ieee_802154_long_t *dest){
+    ipv6_addr_t *src = &tmpl->srcaddr;
+    ipv6_addr_t *dst = &tmpl->destaddr;
     lowpan_context_t *con = NULL;
+    uint8_t *addr = tmpl->addr;
+    uint8_t addr_pos = 0;
+
+    tmpl->iphc1 = 0;
+    tmpl->cid = 0;
+
+    /* CID: Context Identifier Extension: */
+    if((lowpan_context_lookup(src) != NULL) || 
+       (lowpan_context_lookup(dst) != NULL)){
+        tmpl->iphc1 |= LOWPAN_IPHC_CID;
+    }
+
+    /* SAC: Source Address Compression */
+    if(ipv6_addr_unspec_match(src)){
+        /* SAC = 1 and SAM = 00 */
+        tmpl->iphc1 |= LOWPAN_IPHC_SAC;
+    } else if((con = lowpan_context_lookup(src)) != NULL ||
+              ipv6_prefix_ll_match(src)){
+        if(con != NULL){
+            /* 1: Source address compression uses stateful, context-based
+             *    compression. */
+            tmpl->iphc1 |= LOWPAN_IPHC_SAC;
+            tmpl->cid |= (con->num << 4);
+        }
+        /* else 0: Source address compression uses stateless compression.*/
+        
+        if(memcmp(&(src->uint8[8]),&(iface.laddr.uint8[0]), 8) == 0){
+            /* 0 bits. The address is derived using context information
+             * and possibly the link-layer addresses.*/
+            tmpl->iphc1 |= 0x30;
+        } else if((src->uint16[4] == 0) && 
+                  (src->uint16[5] == 0) &&
+                  (src->uint16[6] == 0) &&
+                  ((src->uint8[14]) & 0x80) == 0){
+            /* 49-bit of interface identifier are 0, so we can compress
+             * source address-iid to 16-bit */
+            memcpy(&addr[addr_pos], &src->uint16[7], 2);
+            addr_pos += 2;
+            /* 16 bits. The address is derived using context information
+             * and the 16 bits carried inline. */
+            tmpl->iphc1 |= 0x20;
+        } else {
+            memcpy(&addr[addr_pos], &(src->uint16[4]), 8);
+            addr_pos += 8;
+            /* 64 bits. The address is derived using context information
+             * and the 64 bits carried inline. */            
+            tmpl->iphc1 |= 0x10;
+        }
+    } else {
+        /* full address carried inline */
+        memcpy(&addr[addr_pos], &(src->uint8[0]), 16);
+        addr_pos += 16;
+    }
+
+    /* M: Multicast Compression */
+    if(ipv6_prefix_mcast_match(dst)){
+        /* 1: Destination address is a multicast address. */
+        tmpl->iphc1 |= LOWPAN_IPHC_M;
+        /* just another cool if condition */
+        if((dst->uint8[1] == 2) && 
+           (dst->uint16[1] == 0) &&
+           (dst->uint16[2] == 0) &&
+           (dst->uint16[3] == 0) &&
+           (dst->uint16[4] == 0) &&
+           (dst->uint16[5] == 0) &&
+           (dst->uint16[6] == 0) &&
+           (dst->uint8[14] == 0)){
+            /* 11: 8 bits. The address takes the form FF02::00XX. */
+            tmpl->iphc1 |= 0x03;
+            addr[addr_pos] = dst->uint8[15];
+            addr_pos++;
+        } else if((dst->uint16[1] == 0) && 
+                  (dst->uint16[2] == 0) &&
+                  (dst->uint16[3] == 0) &&
+                  (dst->uint16[4] == 0) &&
+                  (dst->uint16[5] == 0) &&
+                  (dst->uint8[12] == 0)){
+            /* 10: 32 bits. The address takes the form FFXX::00XX:XXXX. */
+            tmpl->iphc1 |= 0x02;
+            /* copy second and last 3 byte */
+            addr[addr_pos] = dst->uint8[1];
+            addr_pos++;
+            memcpy(&addr[addr_pos], &dst->uint8[13], 3);
+            addr_pos += 3;     
+        } else if((dst->uint16[1] == 0) && 
+                  (dst->uint16[2] == 0) &&
+                  (dst->uint16[3] == 0) &&
+                  (dst->uint16[4] == 0) &&
+                  (dst->uint8[10] == 0)){
+            /* 01: 48 bits.  The address takes the form FFXX::00XX:XXXX:XXXX */
+            tmpl->iphc1 |= 0x01;
+            /* copy second and last 5 byte */
+            addr[addr_pos] = dst->uint8[1];
+            addr_pos++;
+            memcpy(&addr[addr_pos], &dst->uint8[11], 5);
+            addr_pos += 5;
+        } else {
+            memcpy(&addr[addr_pos], &dst->uint8[0], 16);
+            addr_pos += 16;
+        } 
+    } else if((con = lowpan_context_lookup(dst)) != NULL ||
+              ipv6_prefix_ll_match(dst)){
+        /* 0: Destination address is not a multicast address. */
+        if(con != NULL){
+            /* 1: Destination address compression uses stateful, context-based
+             * compression. */
+            tmpl->iphc1 |= LOWPAN_IPHC_DAC;
+            tmpl->cid |= con->num;
+        }
+
+        if(memcmp(&(dst->uint8[8]),&(dest->uint8[0]), 8) == 0){
+            /* 0 bits. The address is derived using context information
+             * and possibly the link-layer addresses.*/
+            tmpl->iphc1 |= 0x03;
+        } else if((dst->uint16[4] == 0) &&
+                  (dst->uint16[5] == 0) &&
+                  (dst->uint16[6] == 0) &&
+                  ((dst->uint8[14]) & 0x80) == 0){
+            /* 49-bit of interface identifier are 0, so we can compress
+             * source address-iid to 16-bit */
+            memcpy(&addr[addr_pos], &dst->uint16[7], 2);
+            addr_pos += 2;
+            /* 16 bits. The address is derived using context information
+             * and the 16 bits carried inline. */
+            tmpl->iphc1 |= 0x02;
+        } else {
+            memcpy(&addr[addr_pos], &(dst->uint16[4]), 8);
+            addr_pos += 8;
+            /* 64 bits. The address is derived using context information
+             * and the 64 bits carried inline. */
+            tmpl->iphc1 |= 0x01;
+        }
+    } else {
+        memcpy(&addr[addr_pos], &(dst->uint8[0]), 16);
+        addr_pos += 16;
+    }
+
+    tmpl->addr_len = addr_pos;
+}
+
+/* returns the compiled address fields for a flow, compiling them on a
+ * miss into a free or the least recently used template, call with
+ * lowpan_context_mutex held */
+static lowpan_iphc_template_t *iphc_cache_get(ipv6_addr_t *src,
+                                              ipv6_addr_t *dst,
+                                              ieee_802154_long_t *dest){
+    lowpan_iphc_template_t *tmpl;
+    lowpan_iphc_template_t **link;
+    uint8_t key = iphc_cache_hash_key(src, dst, dest);
+
+    for(tmpl = iphc_cache_hash[key]; tmpl != NULL; tmpl = tmpl->hash_next){
+        if((memcmp(&tmpl->destaddr, dst, sizeof(ipv6_addr_t)) == 0) &&
+           (memcmp(&tmpl->srcaddr, src, sizeof(ipv6_addr_t)) == 0) &&
+           (memcmp(&tmpl->dest_laddr, dest, 8) == 0)){
+            lowpan_iphc_cache_statistic.hits++;
+            if(tmpl != iphc_cache_lru_head){
+                iphc_cache_lru_unlink(tmpl);
+                iphc_cache_lru_add(tmpl);
+            }
+            return tmpl;
+        }
+    }
+
+    lowpan_iphc_cache_statistic.misses++;
+    if(iphc_cache_used < LOWPAN_IPHC_CACHE_SIZE){
+        tmpl = &iphc_cache[iphc_cache_used++];
+    } else {
+        tmpl = iphc_cache_lru_tail;
+        link = &iphc_cache_hash[iphc_cache_hash_key(&tmpl->srcaddr,
+                                                    &tmpl->destaddr,
+                                                    &tmpl->dest_laddr)];
+        while(*link != tmpl){
+            link = &(*link)->hash_next;
+        }
+        *link = tmpl->hash_next;
+        iphc_cache_lru_unlink(tmpl);
+    }
+
+    memcpy(&tmpl->srcaddr, src, sizeof(ipv6_addr_t));
+    memcpy(&tmpl->destaddr, dst, sizeof(ipv6_addr_t));
+    memcpy(&tmpl->dest_laddr, dest, 8);
+    iphc_compile_addr(tmpl, dest);
+
+    tmpl->hash_next = iphc_cache_hash[key];
+    iphc_cache_hash[key] = tmpl;
+    iphc_cache_lru_add(tmpl);
+    return tmpl;
+}
+
+/* draft-ietf-6lowpan-hc-13#section-3.1 */
+uint16_t lowpan_iphc_encoding(ieee_802154_long_t *dest, ipv6_hdr_t *ipv6,
+                              uint8_t *payload, uint8_t *comp){
+    uint8_t lowpan_iphc[2];
+    uint8_t *ipv6_hdr_fields = &comp[2];
+    lowpan_iphc_template_t *tmpl;
     uint16_t hdr_pos = 0;
     uint8_t tc;
 
@@ -681,19 +930,28 @@ void lowpan_iphc_encoding(ieee_802154_long_t *dest, ipv6_hdr_t *ipv6_buf_extra,
 
     /* set iphc dispatch */
     lowpan_iphc[0] = LOWPAN_IPHC_DISPATCH;
+
+    /* the address fields only change with the flow (or the contexts) */
+    mutex_lock(&lowpan_context_mutex);
+    tmpl = iphc_cache_get(&ipv6->srcaddr, &ipv6->destaddr, dest);
+    lowpan_iphc[1] = tmpl->iphc1;
+    if(tmpl->iphc1 & LOWPAN_IPHC_CID){
+        ipv6_hdr_fields[hdr_pos] = tmpl->cid;
+        hdr_pos++;
+    }
    
     /* TF: Traffic Class, Flow Label:
      * first we need to change DSCP and ECN because in 6lowpan-nd-13 these 
      * fields are reverse, the original order is DSCP/ECN (rfc 3168) */
-    tc = (ipv6_buf->version_trafficclass << 4) | (ipv6_buf->trafficclass_flowlabel >> 4);
+    tc = (ipv6->version_trafficclass << 4) | (ipv6->trafficclass_flowlabel >> 4);
     tc = (tc >> 2) | (tc << 6);
     
-    if((ipv6_buf->flowlabel == 0) && 
-       (ipv6_buf->trafficclass_flowlabel & 0x0f) == 0){
+    if((ipv6->flowlabel == 0) && 
+       (ipv6->trafficclass_flowlabel & 0x0f) == 0){
         /* flowlabel is elided */
         lowpan_iphc[0] |= LOWPAN_IPHC_FL_C;
-        if(((ipv6_buf->version_trafficclass & 0x0f) == 0) && 
-           ((ipv6_buf->trafficclass_flowlabel & 0xf0) == 0)){
+        if(((ipv6->version_trafficclass & 0x0f) == 0) && 
+           ((ipv6->trafficclass_flowlabel & 0xf0) == 0)){
             /* traffic class is elided */
             lowpan_iphc[0] |= LOWPAN_IPHC_TC_C;        
         } else {
@@ -703,18 +961,18 @@ void lowpan_iphc_encoding(ieee_802154_long_t *dest, ipv6_hdr_t *ipv6_buf_extra,
         } 
     } else {
         /* flowlabel not compressible */
-        if(((ipv6_buf->version_trafficclass & 0x0f) == 0) && 
-           ((ipv6_buf->trafficclass_flowlabel & 0xf0) == 0)){
+        if(((ipv6->version_trafficclass & 0x0f) == 0) && 
+           ((ipv6->trafficclass_flowlabel & 0xf0) == 0)){
             /* traffic class is elided */
             lowpan_iphc[0] |= LOWPAN_IPHC_TC_C;
             /* ECN + 2-bit Pad + Flow Label (3 bytes), DSCP is elided */
             ipv6_hdr_fields[hdr_pos] = ((tc & 0xc0) | 
-                               (ipv6_buf->trafficclass_flowlabel & 0x0f));
-            memcpy(&(ipv6_hdr_fields[hdr_pos]), &ipv6_buf->flowlabel , 2);
+                               (ipv6->trafficclass_flowlabel & 0x0f));
+            memcpy(&(ipv6_hdr_fields[hdr_pos]), &ipv6->flowlabel , 2);
             hdr_pos += 3;   
         } else {
             /* ECN + DSCP + 4-bit Pad + Flow Label (4 bytes) */
-            memcpy(&ipv6_hdr_fields[hdr_pos], &ipv6_buf->version_trafficclass, 4);
+            memcpy(&ipv6_hdr_fields[hdr_pos], &ipv6->version_trafficclass, 4);
             ipv6_hdr_fields[hdr_pos] = tc;
             hdr_pos += 4;
         }
@@ -722,11 +980,11 @@ void lowpan_iphc_encoding(ieee_802154_long_t *dest, ipv6_hdr_t *ipv6_buf_extra,
 
     /* NH: Next Header: 
      * TODO: NHC */
-    ipv6_hdr_fields[hdr_pos] = ipv6_buf->nextheader;
+    ipv6_hdr_fields[hdr_pos] = ipv6->nextheader;
     hdr_pos++;
 
     /* HLIM: Hop Limit: */
-    switch(ipv6_buf->hoplimit){
+    switch(ipv6->hoplimit){
         case(1):{
             /* 01: The Hop Limit field is compressed and the hop limit is 1. */
             lowpan_iphc[0] |= 0x01;
@@ -743,205 +1001,22 @@ void lowpan_iphc_encoding(ieee_802154_long_t *dest, ipv6_hdr_t *ipv6_buf_extra,
             break;
         }
         default:{
-            ipv6_hdr_fields[hdr_pos] = ipv6_buf->hoplimit;
+            ipv6_hdr_fields[hdr_pos] = ipv6->hoplimit;
             hdr_pos++;
             break;
         }
     }
 
-    mutex_lock(&lowpan_context_mutex);
-    /* CID: Context Identifier Extension: */
-    if((lowpan_context_lookup(&ipv6_buf->srcaddr) != NULL ) || 
-       (lowpan_context_lookup(&ipv6_buf->destaddr) != NULL)){
-        lowpan_iphc[1] |= LOWPAN_IPHC_CID;
-        memmove(&ipv6_hdr_fields[1],&ipv6_hdr_fields[0], hdr_pos);
-        hdr_pos++;
-    }
-
-    /* SAC: Source Address Compression */
-    if(ipv6_addr_unspec_match(&(ipv6_buf->srcaddr))){
-        /* SAC = 1 and SAM = 00 */
-        lowpan_iphc[1] |= LOWPAN_IPHC_SAC;
-    } else if((con = lowpan_context_lookup(&ipv6_buf->srcaddr)) != NULL) {
-        /* 1: Source address compression uses stateful, context-based
-         *    compression. */
-        lowpan_iphc[1] |= LOWPAN_IPHC_SAC;
-        ipv6_hdr_fields[0] |= (con->num << 4);
-        
-        if(memcmp(&(ipv6_buf->srcaddr.uint8[8]),&(iface.laddr.uint8[0]), 8) == 0){
-            /* 0 bits. The address is derived using context information
-             * and possibly the link-layer addresses.*/
-            lowpan_iphc[1] |= 0x30;
-        } else if((ipv6_buf->srcaddr.uint16[4] == 0) && 
-                  (ipv6_buf->srcaddr.uint16[5] == 0) &&
-                  (ipv6_buf->srcaddr.uint16[6] == 0) &&
-                  ((ipv6_buf->srcaddr.uint8[14]) & 0x80) == 0){
-            /* 49-bit of interface identifier are 0, so we can compress
-             * source address-iid to 16-bit */
-            memcpy(&ipv6_hdr_fields[hdr_pos], &ipv6_buf->srcaddr.uint16[7], 2);
-            hdr_pos += 2;
-            /* 16 bits. The address is derived using context information
-             * and the 16 bits carried inline. */
-            lowpan_iphc[1] |= 0x20;
-        } else {
-            memcpy(&ipv6_hdr_fields[hdr_pos], &(ipv6_buf->srcaddr.uint16[4]),8);
-            hdr_pos += 8;
-            /* 64 bits. The address is derived using context information
-             * and the 64 bits carried inline. */            
-            lowpan_iphc[1] |= 0x10;
-        }         
-    } else if(ipv6_prefix_ll_match(&ipv6_buf->srcaddr)){
-        /* 0: Source address compression uses stateless compression.*/
-        if(memcmp(&(ipv6_buf->srcaddr.uint8[8]),&(iface.laddr.uint8[0]), 8) == 0){
-            /* 0 bits. The address is derived using context information
-             * and possibly the link-layer addresses.*/
-            lowpan_iphc[1] |= 0x30;
-        } else if((ipv6_buf->srcaddr.uint16[4] == 0) && 
-                  (ipv6_buf->srcaddr.uint16[5] == 0) &&
-                  (ipv6_buf->srcaddr.uint16[6] == 0) &&
-                  ((ipv6_buf->srcaddr.uint8[14]) & 0x80) == 0){
-            /* 49-bit of interface identifier are 0, so we can compress
-             * source address-iid to 16-bit */
-            memcpy(&ipv6_hdr_fields[hdr_pos], &ipv6_buf->srcaddr.uint16[7], 2);
-            hdr_pos += 2;
-            /* 16 bits. The address is derived using context information
-             * and the 16 bits carried inline. */
-            lowpan_iphc[1] |= 0x20;
-        } else {
-            memcpy(&ipv6_hdr_fields[hdr_pos], &(ipv6_buf->srcaddr.uint16[4]),8);
-            hdr_pos += 8;
-            /* 64 bits. The address is derived using context information
-             * and the 64 bits carried inline. */            
-            lowpan_iphc[1] |= 0x10;
-        }          
-    } else {
-        /* full address carried inline */
-        memcpy(&ipv6_hdr_fields[hdr_pos], &(ipv6_buf->srcaddr.uint8[0]), 16);
-        hdr_pos += 16;
-    }
-
-    /* M: Multicast Compression */
-    if(ipv6_prefix_mcast_match(&ipv6_buf->destaddr)){
-        /* 1: Destination address is a multicast address. */
-        lowpan_iphc[1] |= LOWPAN_IPHC_M;
-        /* just another cool if condition */
-        if((ipv6_buf->destaddr.uint8[1] == 2) && 
-           (ipv6_buf->destaddr.uint16[1] == 0) &&
-           (ipv6_buf->destaddr.uint16[2] == 0) &&
-           (ipv6_buf->destaddr.uint16[3] == 0) &&
-           (ipv6_buf->destaddr.uint16[4] == 0) &&
-           (ipv6_buf->destaddr.uint16[5] == 0) &&
-           (ipv6_buf->destaddr.uint16[6] == 0) &&
-           (ipv6_buf->destaddr.uint8[14] == 0)){
-            /* 11: 8 bits. The address takes the form FF02::00XX. */
-            lowpan_iphc[1] |= 0x03;
-            ipv6_hdr_fields[hdr_pos] = ipv6_buf->destaddr.uint8[15];
-            hdr_pos++;
-        } else if((ipv6_buf->destaddr.uint16[1] == 0) && 
-                  (ipv6_buf->destaddr.uint16[2] == 0) &&
-                  (ipv6_buf->destaddr.uint16[3] == 0) &&
-                  (ipv6_buf->destaddr.uint16[4] == 0) &&
-                  (ipv6_buf->destaddr.uint16[5] == 0) &&
-                  (ipv6_buf->destaddr.uint8[12] == 0)){
-            /* 10: 32 bits. The address takes the form FFXX::00XX:XXXX. */
-            lowpan_iphc[1] |= 0x02;
-            /* copy second and last 3 byte */
-            ipv6_hdr_fields[hdr_pos] = ipv6_buf->destaddr.uint8[1];
-            hdr_pos++;
-            memcpy(&ipv6_hdr_fields[hdr_pos], &ipv6_buf->destaddr.uint8[13], 3);
-            hdr_pos += 3;     
-        } else if((ipv6_buf->destaddr.uint16[1] == 0) && 
-                  (ipv6_buf->destaddr.uint16[2] == 0) &&
-                  (ipv6_buf->destaddr.uint16[3] == 0) &&
-                  (ipv6_buf->destaddr.uint16[4] == 0) &&
-                  (ipv6_buf->destaddr.uint8[10] == 0)){
-            /* 01: 48 bits.  The address takes the form FFXX::00XX:XXXX:XXXX */
-            lowpan_iphc[1] |= 0x01;
-            /* copy second and last 5 byte */
-            ipv6_hdr_fields[hdr_pos] = ipv6_buf->destaddr.uint8[1];
-            hdr_pos++;
-            memcpy(&ipv6_hdr_fields[hdr_pos], &ipv6_buf->destaddr.uint8[11], 5);
-            hdr_pos += 5;
-        } else {
-            memcpy(&ipv6_hdr_fields[hdr_pos], &ipv6_buf->destaddr.uint8[0], 16);
-            hdr_pos += 16;
-        } 
-    } else {
-        /* 0: Destination address is not a multicast address. */
-        if((con = lowpan_context_lookup(&ipv6_buf->destaddr)) != NULL){
-            /* 1: Destination address compression uses stateful, context-based
-             * compression. */
-            lowpan_iphc[1] |= LOWPAN_IPHC_DAC;
-            ipv6_hdr_fields[0] = con->num;
-
-            if(memcmp(&(ipv6_buf->destaddr.uint8[8]),&(dest->uint8[0]), 8) == 0){
-                /* 0 bits. The address is derived using context information
-                 * and possibly the link-layer addresses.*/
-                lowpan_iphc[1] |= 0x03;
-            } else if((ipv6_buf->destaddr.uint16[4] == 0) &&
-                      (ipv6_buf->destaddr.uint16[5] == 0) &&
-                      (ipv6_buf->destaddr.uint16[6] == 0) &&
-                      ((ipv6_buf->destaddr.uint8[14]) & 0x80) == 0){
-                /* 49-bit of interface identifier are 0, so we can compress
-                 * source address-iid to 16-bit */
-                memcpy(&ipv6_hdr_fields[hdr_pos], &ipv6_buf->destaddr.uint16[7], 2);
-                hdr_pos += 2;
-                /* 16 bits. The address is derived using context information
-                 * and the 16 bits carried inline. */
-                lowpan_iphc[1] |= 0x02;
-            } else {
-                memcpy(&ipv6_hdr_fields[hdr_pos], &(ipv6_buf->destaddr.uint16[4]),8);
-                hdr_pos += 8;
-                /* 64 bits. The address is derived using context information
-                * and the 64 bits carried inline. */
-                lowpan_iphc[1] |= 0x01;
-            }
-        } else if(ipv6_prefix_ll_match(&ipv6_buf->destaddr)){
-            if(memcmp(&(ipv6_buf->destaddr.uint8[8]),&(dest->uint8[0]), 8) == 0){
-                /* 0 bits. The address is derived using context information
-                * and possibly the link-layer addresses.*/
-                lowpan_iphc[1] |= 0x03;
-            } else if((ipv6_buf->destaddr.uint16[4] == 0) &&
-                      (ipv6_buf->destaddr.uint16[5] == 0) &&
-                      (ipv6_buf->destaddr.uint16[6] == 0) &&
-                      ((ipv6_buf->destaddr.uint8[14]) & 0x80) == 0){
-                /* 49-bit of interface identifier are 0, so we can compress
-                 * source address-iid to 16-bit */
-                memcpy(&ipv6_hdr_fields[hdr_pos], &ipv6_buf->destaddr.uint16[7], 2);
-                hdr_pos += 2;
-                /* 16 bits. The address is derived using context information
-                 * and the 16 bits carried inline. */
-                lowpan_iphc[1] |= 0x02;
-            } else {
-                memcpy(&ipv6_hdr_fields[hdr_pos], &(ipv6_buf->destaddr.uint16[4]),8);
-                hdr_pos += 8;
-                /* 64 bits. The address is derived using context information
-                 * and the 64 bits carried inline. */
-                lowpan_iphc[1] |= 0x01;
-            }
-        } else {
-            memcpy(&ipv6_hdr_fields[hdr_pos],&(ipv6_buf->destaddr.uint8[0]), 16);
-            hdr_pos += 16;
-        }
-    }
+    memcpy(&ipv6_hdr_fields[hdr_pos], tmpl->addr, tmpl->addr_len);
+    hdr_pos += tmpl->addr_len;
     mutex_unlock(&lowpan_context_mutex,0);
     
-    comp_buf[0] = lowpan_iphc[0];
-    comp_buf[1] = lowpan_iphc[1];
+    comp[0] = lowpan_iphc[0];
+    comp[1] = lowpan_iphc[1];
 
-    /*uint8_t *ptr;
-    if (ipv6_buf->nextheader == IPPROTO_TCP)
-		{
-    	ptr = get_payload_buf_send(ipv6_ext_hdr_len);
-		}
-    else
-		{
-    	ptr = get_payload_buf(ipv6_ext_hdr_len);
-		}
-	*/
-    memcpy(&ipv6_hdr_fields[hdr_pos],&ptr[IPV6_HDR_LEN],ipv6_buf->length);
+    memcpy(&ipv6_hdr_fields[hdr_pos], payload, ipv6->length);
 
-    comp_len = 2 + hdr_pos + payload_length;
+    return 2 + hdr_pos + ipv6->length;
 }
 
 void lowpan_iphc_decoding(uint8_t *data, uint8_t length, 
@@ -1295,6 +1370,7 @@ void lowpan_context_remove(uint8_t num) {
     }
     
     abr_remove_context(num);
+    lowpan_iphc_cache_flush();
     
     for(j = i; j < LOWPAN_CONTEXT_MAX; j++) {
         contexts[j] = contexts[j+1];
@@ -1327,6 +1403,7 @@ lowpan_context_t *lowpan_context_update(uint8_t num, const ipv6_addr_t *prefix,
     context->length = length;
     context->comp = comp;
     context->lifetime = lifetime;
+    lowpan_iphc_cache_flush();
     return context;
 }
 
@@ -1340,7 +1417,7 @@ lowpan_context_t * lowpan_context_lookup(ipv6_addr_t *addr){
     lowpan_context_t *context = NULL;
     
     for(i = 0; i < lowpan_context_len(); i++){
-        if(contexts[i].length > 0 && memcmp((void*)addr,&(contexts[i].prefix),contexts[i].length) == 0){
+        if(contexts[i].length > 0 && memcmp((void*)addr,&(contexts[i].prefix),contexts[i].length / 8) == 0){  // length in bits
             if (context == NULL || context->length < contexts[i].length) {  // longer prefixes are always prefered
                 context = &contexts[i];
             }
@@ -1360,12 +1437,15 @@ lowpan_context_t * lowpan_context_num_lookup(uint8_t num){
 }
 
 void lowpan_context_auto_remove(void) {
+    static vtimer_t timer;
     timex_t minute = timex_set(60,0);
     int i;
     int8_t to_remove[LOWPAN_CONTEXT_MAX];
     int8_t to_remove_size;
+    vtimer_set_slack(&timer, LOWPAN_CONTEXT_TIMER_SLACK);
     while(1){
-        vtimer_sleep(minute);
+        vtimer_set_wakeup(&timer, minute, thread_getpid());
+        thread_sleep();
         to_remove_size = 0;
         mutex_lock(&lowpan_context_mutex);
         for(i = 0; i < lowpan_context_len(); i++) {
@@ -1388,7 +1468,11 @@ void init_reas_bufs(lowpan_reas_buf_t *buf) {
 	buf->packet_size =			0;
 	buf->current_packet_size = 	0;
 	buf->packet = 				NULL;
-	buf->interval_list_head	=	NULL;
+	buf->frame = 				NULL;
+	memset(buf->received, 0, sizeof(buf->received));
+	buf->hash_next = 			NULL;
+	buf->lru_prev = 			NULL;
+	buf->lru_next = 			NULL;
 	buf->next = 				NULL;
 }
 
@@ -1405,14 +1489,33 @@ void sixlowpan_init(transceiver_type_t trans, uint8_t r_addr, int as_border){
     set_radio_address(r_addr); 
     init_802154_short_addr(&(iface.saddr));
     init_802154_long_addr(&(iface.laddr));
+    lowpan_iphc_cache_flush();
     /* init global buffer mutex */
     mutex_init(&buf_mutex);
+    mutex_stat_register(&buf_mutex, "6lowpan buf");
     
     /* init lowpan context mutex */
     mutex_init(&lowpan_context_mutex);
+    mutex_stat_register(&lowpan_context_mutex, "lowpan_context");
 
     /* init packet_fifo mutex */
     mutex_init(&fifo_mutex);
+    mutex_stat_register(&fifo_mutex, "fifo");
+
+    /* init transmit buffers, mutex for them and the datagram tag */
+    mutex_init(&lowpan_tx_mutex);
+    mutex_stat_register(&lowpan_tx_mutex, "lowpan_tx");
+    for (int i = 0; i < LOWPAN_TX_BUF_COUNT; i++) {
+        lowpan_tx_bufs[i].next = lowpan_tx_free;
+        lowpan_tx_free = &lowpan_tx_bufs[i];
+    }
+    sem_init(&lowpan_tx_free_count, LOWPAN_TX_BUF_COUNT);
+
+    /* all reassembly buffers are free */
+    for (int i = 0; i < LOWPAN_REAS_BUF_COUNT; i++) {
+        reas_bufs[i].next = reas_free;
+        reas_free = &reas_bufs[i];
+    }
 
     local_address = r_addr;
 
@@ -1431,6 +1534,7 @@ void sixlowpan_init(transceiver_type_t trans, uint8_t r_addr, int as_border){
                         
     ipv6_iface_add_addr(&lladdr, ADDR_STATE_PREFERRED, 0, 0, 
                         ADDR_CONFIGURED_AUTO);
+    nbr_cache_init();
     if (as_border) {
         ip_process_pid = thread_create(ip_process_buf, IP_PROCESS_STACKSIZE, 
                                        PRIORITY_MAIN-1, CREATE_STACKTEST,
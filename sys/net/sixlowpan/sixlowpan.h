@@ -22,11 +22,42 @@
 #define LOWPAN_IPHC_NH          0x04
 #define LOWPAN_IPV6_DISPATCH    0x41
 #define LOWPAN_CONTEXT_MAX      16
+#define LOWPAN_CONTEXT_TIMER_SLACK  (1000*1000)
 
 #define LOWPAN_REAS_BUF_TIMEOUT	15 * 1000 * 1000 // TODO: Set back to 3 * 1000 * 1000
 
+/* Reassembly uses LOWPAN_REAS_BUF_COUNT * LOWPAN_REAS_MAX_SIZE bytes at most,
+ * datagrams are looked up by (source, destination, tag, size) in
+ * LOWPAN_REAS_HASH_SIZE buckets, when all buffers are in use the least
+ * recently used incomplete datagram is dropped. */
+#ifndef LOWPAN_REAS_BUF_COUNT
+#define LOWPAN_REAS_BUF_COUNT	4
+#endif
+#ifndef LOWPAN_REAS_MAX_SIZE
+#define LOWPAN_REAS_MAX_SIZE	(MTU + 1)
+#endif
+#define LOWPAN_REAS_HASH_SIZE	8
+#define LOWPAN_REAS_UNITS		(((LOWPAN_REAS_MAX_SIZE + 7) / 8 + 7) & ~7)
+
+/* Compiled IPHC address fields of the last LOWPAN_IPHC_CACHE_SIZE flows,
+ * looked up by (source, destination, link-layer destination), dropped
+ * whenever a context changes. */
+#ifndef LOWPAN_IPHC_CACHE_SIZE
+#define LOWPAN_IPHC_CACHE_SIZE	8
+#endif
+#ifndef LOWPAN_IPHC_CACHE_HASH_SIZE
+#define LOWPAN_IPHC_CACHE_HASH_SIZE	8
+#endif
+
+/* Senders compress and fragment in one of LOWPAN_TX_BUF_COUNT transmit
+ * buffers, as many threads transmit at a time, more wait for a buffer. */
+#ifndef LOWPAN_TX_BUF_COUNT
+#define LOWPAN_TX_BUF_COUNT	3
+#endif
+
 #include "transceiver.h"
 #include "sixlowip.h"
+#include <pktbuf.h>
 #include <vtimer.h>
 #include <mutex.h>
 #include <time.h>
@@ -43,12 +74,6 @@ typedef struct lowpan_context_t {
     uint16_t lifetime;
 } lowpan_context_t;
 
-typedef struct lowpan_interval_list_t {
-	uint8_t							start;
-	uint8_t							end;
-	struct lowpan_interval_list_t 	*next;
-} lowpan_interval_list_t;
-
 typedef struct lowpan_reas_buf_t {
 	ieee_802154_long_t 				s_laddr;					// Source Address
 	ieee_802154_long_t 				d_laddr;					// Destination Address
@@ -56,22 +81,64 @@ typedef struct lowpan_reas_buf_t {
 	long							timestamp;					// Timestamp of last packet fragment
 	uint16_t						packet_size;				// Size of reassembled packet with possible IPHC header
 	uint16_t						current_packet_size;		// Additive size of currently already received fragments
-	uint8_t							*packet;					// Pointer to allocated memory for reassembled packet + 6LoWPAN Dispatch Byte
-	lowpan_interval_list_t			*interval_list_head;		// Pointer to list of intervals of received packet fragments (if any)
-	struct lowpan_reas_buf_t		*next;						// Pointer to next reassembly buffer (if any)
+	uint8_t							*packet;					// Pointer to data or into frame, reassembled packet + 6LoWPAN Dispatch Byte
+	pktbuf_t						*frame;						// Radio frame packet points into instead of data (if any)
+	uint8_t							received[LOWPAN_REAS_UNITS / 8];	// Bitmap of received 8-octet units
+	uint8_t							data[LOWPAN_REAS_MAX_SIZE];	// Reassembly space
+	struct lowpan_reas_buf_t		*hash_next;					// Next datagram in the same hash bucket (if any)
+	struct lowpan_reas_buf_t		*lru_prev;					// Next more recently used datagram (if any)
+	struct lowpan_reas_buf_t		*lru_next;					// Next less recently used datagram (if any)
+	struct lowpan_reas_buf_t		*next;						// Next buffer in the packet fifo or free list (if any)
 } lowpan_reas_buf_t;
 
-extern lowpan_reas_buf_t *head;
+typedef struct {
+	uint32_t						datagrams;					// Fragmented datagrams started
+	uint32_t						completed;					// Fragmented datagrams reassembled
+	uint32_t						timeouts;					// Datagrams dropped after LOWPAN_REAS_BUF_TIMEOUT
+	uint32_t						evicted;					// Incomplete datagrams dropped for a newer one
+	uint32_t						duplicates;					// Fragments overlapping already received ones
+	uint32_t						dropped;					// Invalid, too large or unbufferable fragments
+} lowpan_reas_statistic_t;
+
+extern lowpan_reas_statistic_t lowpan_reas_statistic;
+
+typedef struct lowpan_tx_buf_t {
+	uint8_t							data[FRAG_PART_N_HDR_LEN + MTU + 1];	// Fragment header room, compressed datagram
+	struct lowpan_tx_buf_t			*next;						// Next buffer in the free list (if any)
+} lowpan_tx_buf_t;
+
+typedef struct lowpan_iphc_template_t {
+	ipv6_addr_t						srcaddr;					// Source Address
+	ipv6_addr_t						destaddr;					// Destination Address
+	ieee_802154_long_t				dest_laddr;					// Link-layer Destination Address
+	uint8_t							iphc1;						// CID, SAC/SAM, M, DAC/DAM of the second IPHC byte
+	uint8_t							cid;						// Context Identifier Extension
+	uint8_t							addr_len;					// Length of the inline addresses
+	uint8_t							addr[32];					// Inline Source and Destination Address
+	struct lowpan_iphc_template_t	*hash_next;					// Next template in the same hash bucket (if any)
+	struct lowpan_iphc_template_t	*lru_prev;					// Next more recently used template (if any)
+	struct lowpan_iphc_template_t	*lru_next;					// Next less recently used template (if any)
+} lowpan_iphc_template_t;
+
+typedef struct {
+	uint32_t						hits;						// Packets sent with a compiled template
+	uint32_t						misses;						// Templates compiled
+} lowpan_iphc_cache_statistic_t;
+
+extern lowpan_iphc_cache_statistic_t lowpan_iphc_cache_statistic;
 
 void sixlowpan_init(transceiver_type_t trans, uint8_t r_addr, int as_border);
 void sixlowpan_adhoc_init(transceiver_type_t trans, ipv6_addr_t *prefix, uint8_t r_addr);
 void lowpan_init(ieee_802154_long_t *addr, uint8_t *data);
+void lowpan_send(ieee_802154_long_t *addr, ipv6_hdr_t *ipv6, uint8_t *payload);
 void lowpan_read(uint8_t *data, uint8_t length, ieee_802154_long_t *s_laddr,
            ieee_802154_long_t *d_laddr);
-void lowpan_iphc_encoding(ieee_802154_long_t *dest, ipv6_hdr_t *ipv6_buf_extra, uint8_t * ptr);
+uint16_t lowpan_iphc_encoding(ieee_802154_long_t *dest, ipv6_hdr_t *ipv6,
+                              uint8_t *payload, uint8_t *comp);
 void lowpan_iphc_decoding(uint8_t *data, uint8_t length,
                           ieee_802154_long_t *s_laddr,
                           ieee_802154_long_t *d_laddr);
+void lowpan_iphc_cache_flush(void);
 uint8_t lowpan_context_len();
 void add_fifo_packet(lowpan_reas_buf_t *current_packet);
 lowpan_context_t * lowpan_context_update(
@@ -81,8 +148,8 @@ lowpan_context_t * lowpan_context_update(
 lowpan_context_t * lowpan_context_get();
 lowpan_context_t * lowpan_context_lookup(ipv6_addr_t *addr);
 lowpan_context_t * lowpan_context_num_lookup(uint8_t num);
-lowpan_reas_buf_t *collect_garbage_fifo(lowpan_reas_buf_t *current_buf);
-lowpan_reas_buf_t *collect_garbage(lowpan_reas_buf_t *current_buf);
+void collect_garbage_fifo(lowpan_reas_buf_t *current_buf);
+void collect_garbage(lowpan_reas_buf_t *current_buf);
 void check_timeout(void);
 void lowpan_ipv6_set_dispatch(uint8_t *data);
 void init_reas_bufs(lowpan_reas_buf_t *buf);
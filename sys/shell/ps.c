@@ -1,6 +1,7 @@
 #include <thread.h>
 #include <hwtimer.h>
 #include <sched.h>
+#include <mutex.h>
 #include <stdio.h>
 
 /* list of states copied from tcb.h */
@@ -52,5 +53,14 @@ void thread_print_all(void)
 
 void _ps_handler(char* unnused) {
     thread_print_all();
+#if SCHEDSTATISTICS
+    sched_print_latency();
+#endif
 }
 
+#if MUTEXSTATISTICS
+void _mutex_handler(char* unused) {
+    mutex_print_stats();
+}
+#endif
+
@@ -5,6 +5,9 @@ extern void _id_handler(char* id);
 
 #ifdef MODULE_PS
 extern void _ps_handler(char* unused);
+#if MUTEXSTATISTICS
+extern void _mutex_handler(char* unused);
+#endif
 #endif
 
 #ifdef MODULE_RTC
@@ -43,6 +46,10 @@ extern void _cc110x_ng_monitor_handler(char *mode);
 #endif
 #endif
 
+#ifdef MODULE_6LOWPAN
+extern void _macstat_handler(char *reset);
+#endif
+
 #ifdef MODULE_MCI
 extern void _get_sectorsize(char *unused);
 extern void _get_blocksize(char* unused);
@@ -55,6 +62,9 @@ const shell_command_t _shell_command_list[] = {
     {"id", "Gets or sets the node's id.", _id_handler},
 #ifdef MODULE_PS
     {"ps", "Prints information about running threads.", _ps_handler},
+#if MUTEXSTATISTICS
+    {"mutex", "Prints lock, wait and hold times of mutexes.", _mutex_handler},
+#endif
 #endif
 #ifdef MODULE_RTC
     {"date", "Gets or sets current date and time.", _date_handler},
@@ -87,6 +97,9 @@ const shell_command_t _shell_command_list[] = {
     {"monitor", "Enables or disables address checking for the CC1100 transceiver", _cc110x_ng_monitor_handler},
 #endif
 #endif
+#ifdef MODULE_6LOWPAN
+    {"macstat", "Prints the 6LoWPAN MAC frame counters, \"macstat reset\" clears them.", _macstat_handler},
+#endif
 #ifdef MODULE_MCI
     {DISK_READ_SECTOR_CMD, "Reads the specified sector of inserted memory card", _read_sector},
     {DISK_READ_BYTES_CMD, "Reads the specified bytes from inserted memory card", _read_bytes},
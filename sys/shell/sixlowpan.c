@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef MODULE_6LOWPAN
+#include <vtimer.h>
+#include "sys/net/sixlowpan/sixlowmac.h"
+
+void _macstat_handler(char *reset) {
+    timex_t now = vtimer_now();
+    uint32_t ms, tenths = 0;
+
+    timex_normalize(&now);
+    ms = (now.seconds - sixlowmac_stat.since.seconds) * 1000 +
+         (int32_t)(now.microseconds - sixlowmac_stat.since.microseconds) / 1000;
+    if (ms > 0) {
+        tenths = (uint32_t)((uint64_t) sixlowmac_stat.frames_sent * 10000 / ms);
+    }
+
+    printf("Frames sent: %lu (%lu.%lu/s), failed: %lu, retries: %lu, received: %lu in %lu ms\n",
+           sixlowmac_stat.frames_sent, tenths / 10, tenths % 10,
+           sixlowmac_stat.frames_failed, sixlowmac_stat.retries,
+           sixlowmac_stat.frames_received, ms);
+
+    if (strcmp(reset, "macstat reset") == 0) {
+        sixlowmac_reset_statistic();
+    }
+}
+#endif
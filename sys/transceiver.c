@@ -7,6 +7,7 @@
 
 #include <transceiver.h>
 #include <radio/types.h>
+#include <pktbuf.h>
 
 /* supported transceivers */
 #ifdef MODULE_CC110X
@@ -25,6 +26,14 @@
 #endif
 #endif
 
+#ifdef MODULE_NATIVENET
+#include <nativenet.h>
+#if (NATIVENET_MAX_DATA_LENGTH > PAYLOAD_SIZE)
+    #undef PAYLOAD_SIZE
+    #define PAYLOAD_SIZE (NATIVENET_MAX_DATA_LENGTH)
+#endif
+#endif
+
 //#define ENABLE_DEBUG (1)
 #include <debug.h>
 
@@ -37,7 +46,8 @@ registered_t reg[TRANSCEIVER_MAX_REGISTERED];
 
 /* packet buffers */
 radio_packet_t transceiver_buffer[TRANSCEIVER_BUFFER_SIZE];
-uint8_t data_buffer[TRANSCEIVER_BUFFER_SIZE * PAYLOAD_SIZE];
+/* pktbuf holding the payload of each transceiver_buffer entry */
+static pktbuf_t *transceiver_pktbuf[TRANSCEIVER_BUFFER_SIZE];
 
 /* message buffer */
 msg_t msg_buffer[TRANSCEIVER_MSG_BUFFER_SIZE];
@@ -49,6 +59,14 @@ int transceiver_pid; ///< the transceiver thread's pid
 static volatile uint8_t rx_buffer_pos = 0;
 static volatile uint8_t transceiver_buffer_pos = 0;
 
+#ifdef MODULE_CC110X_NG
+/* SND_PKT requests waiting for room in the driver's TX queue, their senders
+ * stay blocked until then */
+static msg_t tx_waiting[TRANSCEIVER_TX_WAITING_SIZE];
+static uint8_t tx_waiting_head = 0;
+static uint8_t tx_waiting_count = 0;
+#endif
+
 #ifdef MODULE_CC110X
 void *cc1100_payload;
 int cc1100_payload_size;
@@ -63,14 +81,22 @@ char transceiver_stack[TRANSCEIVER_STACK_SIZE];
 /*------------------------------------------------------------------------------------*/
 /* function prototypes */
 static void run(void);
-static void receive_packet(uint16_t type, uint8_t pos);
+static void receive_packet(uint16_t type, uint32_t pos);
+static void release_processed(void);
 #ifdef MODULE_CC110X_NG
-static void receive_cc110x_packet(radio_packet_t *trans_p);
+static pktbuf_t *receive_cc110x_packet(radio_packet_t *trans_p);
 #elif MODULE_CC110X
 void cc1100_packet_monitor(void* payload, int payload_size, protocol_t protocol, packet_info_t* packet_info);
-void receive_cc1100_packet(radio_packet_t *trans_p);
+pktbuf_t *receive_cc1100_packet(radio_packet_t *trans_p);
+#endif
+#ifdef MODULE_NATIVENET
+static pktbuf_t *receive_nativenet_packet(radio_packet_t *trans_p, pktbuf_t *pkt);
 #endif
 static uint8_t send_packet(transceiver_type_t t, void *pkt);
+#ifdef MODULE_CC110X_NG
+static uint8_t defer_send(msg_t *m);
+static void send_waiting(void);
+#endif
 static int16_t get_channel(transceiver_type_t t);
 static int16_t set_channel(transceiver_type_t t, void *channel);
 static int16_t get_address(transceiver_type_t t);
@@ -89,14 +115,14 @@ void transceiver_init(transceiver_type_t t) {
     uint8_t i;
 
     /* Initializing transceiver buffer and data buffer */
-    memset(transceiver_buffer, 0, TRANSCEIVER_BUFFER_SIZE);
-    memset(data_buffer, 0, TRANSCEIVER_BUFFER_SIZE * PAYLOAD_SIZE);
+    memset(transceiver_buffer, 0, sizeof(transceiver_buffer));
+    memset(transceiver_pktbuf, 0, sizeof(transceiver_pktbuf));
 
     for (i = 0; i < TRANSCEIVER_MAX_REGISTERED; i++) {
         reg[i].transceivers = TRANSCEIVER_NONE;
         reg[i].pid          = 0;
     }
-    if (t & TRANSCEIVER_CC1100) {
+    if (t & (TRANSCEIVER_CC1100 | TRANSCEIVER_NATIVE)) {
         transceivers |= t;
     }
     else {
@@ -114,11 +140,17 @@ int transceiver_start(void) {
         DEBUG("Transceiver started for CC1100\n");
 #ifdef MODULE_CC110X_NG
         cc110x_init(transceiver_pid);
-#else
+#elif defined(MODULE_CC110X)
         cc1100_init();
         cc1100_set_packet_monitor(cc1100_packet_monitor);
 #endif
     }
+#ifdef MODULE_NATIVENET
+    else if (transceivers & TRANSCEIVER_NATIVE) {
+        DEBUG("Transceiver started for native radio\n");
+        nativenet_init(transceiver_pid);
+    }
+#endif
     return transceiver_pid;
 }
 
@@ -162,13 +194,24 @@ void run(void) {
         switch (m.type) {
             case RCV_PKT_CC1020:
             case RCV_PKT_CC1100:
+            case RCV_PKT_NATIVE:
                 receive_packet(m.type, m.content.value);
                 break;
             case SND_PKT:
+#ifdef MODULE_CC110X_NG
+                if (defer_send(&m)) {
+                    break;
+                }
+#endif
                 response = send_packet(cmd->transceivers, cmd->data);
                 m.content.value = response;
                 msg_reply(&m, &m);
                 break;
+#ifdef MODULE_CC110X_NG
+            case SND_PKT_DONE:
+                send_waiting();
+                break;
+#endif
             case GET_CHANNEL:
                 *((int16_t*) cmd->data) = get_channel(cmd->transceivers);
                 msg_reply(&m, &m);
@@ -222,13 +265,16 @@ void cc1100_packet_monitor(void* payload, int payload_size, protocol_t protocol,
  *
  * @param type  The message type to determine which device has received the
  * packet
- * @param pos   The current device driver's buffer position
+ * @param pos   The current device driver's buffer position, or the pktbuf
+ *              for drivers that receive into pktbufs (RCV_PKT_NATIVE)
  */
-static void receive_packet(uint16_t type, uint8_t pos) {
+static void receive_packet(uint16_t type, uint32_t pos) {
     uint8_t i = 0;
     transceiver_type_t t;
     rx_buffer_pos = pos;
     msg_t m;
+
+    release_processed();
    
     DEBUG("Packet received\n");
     switch (type) {
@@ -238,6 +284,9 @@ static void receive_packet(uint16_t type, uint8_t pos) {
         case RCV_PKT_CC1100:
             t = TRANSCEIVER_CC1100;
             break;
+        case RCV_PKT_NATIVE:
+            t = TRANSCEIVER_NATIVE;
+            break;
         default:
             t = TRANSCEIVER_NONE;
             break;
@@ -254,23 +303,41 @@ static void receive_packet(uint16_t type, uint8_t pos) {
         /* inform upper layers of lost packet */
         m.type = ENOBUFFER;
         m.content.value = t;
+#ifdef MODULE_NATIVENET
+        if (type == RCV_PKT_NATIVE) {
+            pktbuf_release((pktbuf_t*) pos);
+        }
+#endif
     }
     /* copy packet and handle it */
     else {
         radio_packet_t *trans_p = &(transceiver_buffer[transceiver_buffer_pos]);
+        pktbuf_t *pkt = NULL;
         m.type = PKT_PENDING;
 
         if (type == RCV_PKT_CC1100) {
 #ifdef MODULE_CC110X_NG
-            receive_cc110x_packet(trans_p); 
-#else
-            receive_cc1100_packet(trans_p);
+            pkt = receive_cc110x_packet(trans_p); 
+#elif defined(MODULE_CC110X)
+            pkt = receive_cc1100_packet(trans_p);
 #endif
         }
+#ifdef MODULE_NATIVENET
+        else if (type == RCV_PKT_NATIVE) {
+            pkt = receive_nativenet_packet(trans_p, (pktbuf_t*) pos);
+        }
+#endif
         else {
             puts("Invalid transceiver type");
             return;
         }
+
+        transceiver_pktbuf[transceiver_buffer_pos] = pkt;
+        if (pkt == NULL) {
+            /* pool exhausted, inform upper layers of lost packet */
+            m.type = ENOBUFFER;
+            m.content.value = t;
+        }
     }
 
     /* finally notify waiting upper layers
@@ -288,46 +355,99 @@ static void receive_packet(uint16_t type, uint8_t pos) {
     }
 }
 
+/*
+ * @brief Drops the pktbufs of all transceiver buffer entries the upper layers
+ * are done with. Layers that keep a frame beyond processing-- take their own
+ * reference (see pktbuf_get()).
+ */
+static void release_processed(void) {
+    uint8_t i;
+    for (i = 0; i < TRANSCEIVER_BUFFER_SIZE; i++) {
+        if (!transceiver_buffer[i].processing && (transceiver_pktbuf[i] != NULL)) {
+            pktbuf_release(transceiver_pktbuf[i]);
+            transceiver_pktbuf[i] = NULL;
+        }
+    }
+}
+
 #ifdef MODULE_CC110X_NG
 /*
  * @brief process packets from CC1100
  *
  * @param trans_p   The current entry in the transceiver buffer
+ *
+ * @return the pktbuf holding the payload, NULL if the pool is exhausted
  */
-static void receive_cc110x_packet(radio_packet_t *trans_p) {
+static pktbuf_t *receive_cc110x_packet(radio_packet_t *trans_p) {
+    pktbuf_t *pkt = pktbuf_alloc();
+
     DEBUG("Handling CC1100 packet\n");
     /* disable interrupts while copying packet */
     dINT();
-    cc110x_packet_t p = cc110x_rx_buffer[rx_buffer_pos].packet;
+    cc110x_packet_t *p = &cc110x_rx_buffer[rx_buffer_pos].packet;
     
-    trans_p->src = p.phy_src;
-    trans_p->dst = p.address;
+    trans_p->src = p->phy_src;
+    trans_p->dst = p->address;
     trans_p->rssi = cc110x_rx_buffer[rx_buffer_pos].rssi;
     trans_p->lqi = cc110x_rx_buffer[rx_buffer_pos].lqi;
-    trans_p->length = p.length - CC1100_HEADER_LENGTH;
-    memcpy((void*) &(data_buffer[transceiver_buffer_pos * PAYLOAD_SIZE]), p.data, CC1100_MAX_DATA_LENGTH);
+    trans_p->length = p->length - CC1100_HEADER_LENGTH;
+    if (pkt != NULL) {
+        pkt->length = trans_p->length;
+        memcpy(pkt->data, p->data, trans_p->length);
+    }
     eINT();
 
     DEBUG("Packet %p was from %hu to %hu, size: %u\n", trans_p, trans_p->src, trans_p->dst, trans_p->length);
-    trans_p->data = (uint8_t*) &(data_buffer[transceiver_buffer_pos * CC1100_MAX_DATA_LENGTH]);
+    trans_p->data = (pkt != NULL) ? pkt->data : NULL;
+    return pkt;
 }
 #endif
 
 #ifdef MODULE_CC110X
-void receive_cc1100_packet(radio_packet_t *trans_p) {
+pktbuf_t *receive_cc1100_packet(radio_packet_t *trans_p) {
+    pktbuf_t *pkt = pktbuf_alloc();
+
     dINT();
     trans_p->src = cc1100_packet_info->source;
     trans_p->dst = cc1100_packet_info->destination;
     trans_p->rssi = cc1100_packet_info->rssi;
     trans_p->lqi = cc1100_packet_info->lqi;
     trans_p->length = cc1100_payload_size;
-    memcpy((void*) &(data_buffer[transceiver_buffer_pos * PAYLOAD_SIZE]), cc1100_payload, CC1100_MAX_DATA_LENGTH);
+    if (pkt != NULL) {
+        pkt->length = trans_p->length;
+        memcpy(pkt->data, cc1100_payload, trans_p->length);
+    }
     eINT();
 
-    trans_p->data = (uint8_t*) &(data_buffer[transceiver_buffer_pos * CC1100_MAX_DATA_LENGTH]);
+    trans_p->data = (pkt != NULL) ? pkt->data : NULL;
+    return pkt;
 }
 #endif
 
+#ifdef MODULE_NATIVENET
+/*
+ * @brief process packets from the native virtual radio
+ *
+ * The driver already received the frame into a pktbuf, which is used as is.
+ *
+ * @param trans_p   The current entry in the transceiver buffer
+ * @param pkt       The pktbuf handed over by the driver
+ *
+ * @return pkt
+ */
+static pktbuf_t *receive_nativenet_packet(radio_packet_t *trans_p, pktbuf_t *pkt) {
+    nativenet_frame_t *frame = (nativenet_frame_t*) pkt->data;
+
+    DEBUG("Handling native radio packet\n");
+    trans_p->src = frame->src;
+    trans_p->dst = frame->dst;
+    trans_p->rssi = frame->rssi;
+    trans_p->lqi = frame->lqi;
+    trans_p->length = frame->length;
+    trans_p->data = frame->data;
+    return pkt;
+}
+#endif
  
 /*------------------------------------------------------------------------------------*/
 /*
@@ -336,7 +456,8 @@ void receive_cc1100_packet(radio_packet_t *trans_p) {
  * @param t     The transceiver device
  * @param pkt   Generic pointer to the packet
  *
- * @return 1 on success, 0 otherwise
+ * @return 1 on success, 0 otherwise. The CC1100 only queues the packet, its
+ *         driver reports the transmission with SND_PKT_DONE.
  */
 static uint8_t send_packet(transceiver_type_t t, void *pkt) {
     uint8_t res = 0;
@@ -357,7 +478,7 @@ static uint8_t send_packet(transceiver_type_t t, void *pkt) {
             cc110x_pkt.flags = 0;
             memcpy(cc110x_pkt.data, p.data, p.length);
             res = cc110x_send(&cc110x_pkt);
-#else
+#elif defined(MODULE_CC110X)
             memcpy(cc1100_pkt, p.data, p.length);
             if ((snd_ret = cc1100_send_csmaca(p.dst, 4, 0, (char*) cc1100_pkt, p.length)) < 0) {
                 DEBUG("snd_ret (%u) = %i\n", p.length, snd_ret);
@@ -368,6 +489,11 @@ static uint8_t send_packet(transceiver_type_t t, void *pkt) {
             }
 #endif
             break;
+#ifdef MODULE_NATIVENET
+        case TRANSCEIVER_NATIVE:
+            res = nativenet_send(&p);
+            break;
+#endif
         default:
             puts("Unknown transceiver");
             break;
@@ -375,6 +501,51 @@ static uint8_t send_packet(transceiver_type_t t, void *pkt) {
     return res;
 }
 
+#ifdef MODULE_CC110X_NG
+/*
+ * @brief Keeps a SND_PKT request waiting while the CC1100's TX queue is full
+ *
+ * The sender stays blocked in msg_send_receive(), so the packet it points to
+ * stays valid until send_waiting() replies.
+ *
+ * @return 1 if the request waits, 0 if it has to be handled now
+ */
+static uint8_t defer_send(msg_t *m) {
+    transceiver_command_t *cmd = (transceiver_command_t*) m->content.ptr;
+
+    if ((cmd->transceivers != TRANSCEIVER_CC1100) ||
+        (!cc110x_tx_queue_full() && !tx_waiting_count)) {
+        return 0;
+    }
+    if (tx_waiting_count == TRANSCEIVER_TX_WAITING_SIZE) {
+        /* send_packet() fails and tells the sender */
+        return 0;
+    }
+
+    tx_waiting[(tx_waiting_head + tx_waiting_count) % TRANSCEIVER_TX_WAITING_SIZE] = *m;
+    tx_waiting_count++;
+    return 1;
+}
+
+/*
+ * @brief Hands waiting SND_PKT requests to the driver as its queue drains
+ */
+static void send_waiting(void) {
+    while (tx_waiting_count && !cc110x_tx_queue_full()) {
+        msg_t *m = &tx_waiting[tx_waiting_head];
+        transceiver_command_t *cmd = (transceiver_command_t*) m->content.ptr;
+
+        if (++tx_waiting_head == TRANSCEIVER_TX_WAITING_SIZE) {
+            tx_waiting_head = 0;
+        }
+        tx_waiting_count--;
+
+        m->content.value = send_packet(cmd->transceivers, cmd->data);
+        msg_reply(m, m);
+    }
+}
+#endif
+
 /*------------------------------------------------------------------------------------*/
 /*
  * @brief Sets the radio channel for any transceiver device
@@ -390,8 +561,12 @@ static int16_t set_channel(transceiver_type_t t, void *channel) {
         case TRANSCEIVER_CC1100:
 #ifdef MODULE_CC110X_NG
             return cc110x_set_channel(c);
-#else
+#elif defined(MODULE_CC110X)
             return cc1100_set_channel(c);
+#endif
+#ifdef MODULE_NATIVENET
+        case TRANSCEIVER_NATIVE:
+            return nativenet_set_channel(c);
 #endif
         default:
             return -1;
@@ -410,8 +585,12 @@ static int16_t get_channel(transceiver_type_t t) {
         case TRANSCEIVER_CC1100:
 #ifdef MODULE_CC110X_NG
             return cc110x_get_channel();
-#else
+#elif defined(MODULE_CC110X)
             return cc1100_get_channel();
+#endif
+#ifdef MODULE_NATIVENET
+        case TRANSCEIVER_NATIVE:
+            return nativenet_get_channel();
 #endif
         default:
             return -1;
@@ -430,8 +609,12 @@ static int16_t get_address(transceiver_type_t t) {
         case TRANSCEIVER_CC1100:
 #ifdef MODULE_CC110X_NG
             return cc110x_get_address();
-#else
+#elif defined(MODULE_CC110X)
             return cc1100_get_address();
+#endif
+#ifdef MODULE_NATIVENET
+        case TRANSCEIVER_NATIVE:
+            return nativenet_get_address();
 #endif
         default:
             return -1;
@@ -452,8 +635,12 @@ static int16_t set_address(transceiver_type_t t, void *address) {
         case TRANSCEIVER_CC1100:
 #ifdef MODULE_CC110X_NG
             return cc110x_set_address(addr);
-#else
+#elif defined(MODULE_CC110X)
             return cc1100_set_address(addr);
+#endif
+#ifdef MODULE_NATIVENET
+        case TRANSCEIVER_NATIVE:
+            return nativenet_set_address(addr);
 #endif
         default:
             return -1;
@@ -473,6 +660,11 @@ static void set_monitor(transceiver_type_t t, void *mode) {
             cc110x_set_monitor(*((uint8_t*) mode));
 #endif
             break;
+#ifdef MODULE_NATIVENET
+        case TRANSCEIVER_NATIVE:
+            nativenet_set_monitor(*((uint8_t*) mode));
+            break;
+#endif
         default:
             break;
     }
@@ -485,6 +677,11 @@ static void powerdown(transceiver_type_t t) {
             cc110x_switch_to_pwd();
 #endif
             break;
+#ifdef MODULE_NATIVENET
+        case TRANSCEIVER_NATIVE:
+            nativenet_powerdown();
+            break;
+#endif
         default:
             break;
     }
@@ -498,6 +695,11 @@ static void switch_to_rx(transceiver_type_t t) {
             cc110x_switch_to_rx();
 #endif
             break;
+#ifdef MODULE_NATIVENET
+        case TRANSCEIVER_NATIVE:
+            nativenet_switch_to_rx();
+            break;
+#endif
         default:
             break;
     }
@@ -32,6 +32,10 @@ void uart0_handle_incoming(int c) {
     rb_add_element(&uart0_ringbuffer, c);
 }
 
+void uart0_handle_incoming_buf(const char *buf, int n) {
+    rb_add_elements(&uart0_ringbuffer, buf, n);
+}
+
 void uart0_notify_thread(void) {
     msg_t m;
     m.type = 0;
@@ -44,6 +48,10 @@ int uart0_readc(void) {
     return c;
 }
 
+int uart0_read(char *buf, int n) {
+    return posix_read(uart0_handler_pid, buf, n);
+}
+
 void uart0_putc(int c) {
     putchar(c);
 }
@@ -1,7 +1,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <irq.h>
-#include <queue.h>
+#include <bitarithm.h>
 #include <timex.h>
 #include <hwtimer.h>
 #include <msg.h>
@@ -22,15 +22,21 @@
 void vtimer_callback(void *ptr);
 void vtimer_tick(void *ptr);
 static int vtimer_set(vtimer_t *timer);
-static int set_longterm(vtimer_t *timer);
-static int set_shortterm(vtimer_t *timer);
 
 #ifdef ENABLE_DEBUG
 static void vtimer_print(vtimer_t* t);
 #endif
 
-static queue_node_t longterm_queue_root;
-static queue_node_t shortterm_queue_root;
+#define WHEEL_SLOTS_TOTAL   (VTIMER_WHEEL_LEVELS * VTIMER_WHEEL_SLOTS)
+#define LONGTERM_SLOT(s)    (WHEEL_SLOTS_TOTAL + ((s) / SECONDS_PER_TICK) % VTIMER_LONGTERM_SLOTS)
+
+/* list heads, wheel level l slot i is at l * VTIMER_WHEEL_SLOTS + i,
+ * followed by the long term buckets */
+static vtimer_t *timer_slots[WHEEL_SLOTS_TOTAL + VTIMER_LONGTERM_SLOTS];
+/* occupied slots per wheel level */
+static unsigned wheel_bitmap[VTIMER_WHEEL_LEVELS];
+/* point in the current tick the wheel has been advanced to */
+static uint32_t wheel_now;
 
 static vtimer_t longterm_tick_timer;
 static uint32_t longterm_tick_start;
@@ -41,22 +47,115 @@ static uint32_t hwtimer_next_absolute;
 
 static uint32_t seconds = 0;
 
-static int set_longterm(vtimer_t *timer) {
-    timer->queue_entry.priority = timer->absolute.seconds;
-    queue_priority_add(&longterm_queue_root, (queue_node_t*)timer);
-    return 0;
+#if VTIMERSTATISTICS
+vtimer_statistic_t vtimer_statistic;
+#endif
+
+static void slot_add(vtimer_t *timer, unsigned slot) {
+    timer->prev = NULL;
+    timer->next = timer_slots[slot];
+    if (timer->next) {
+        timer->next->prev = timer;
+    }
+    timer_slots[slot] = timer;
+    timer->slot = slot + 1;
+
+    if (slot < WHEEL_SLOTS_TOTAL) {
+        wheel_bitmap[slot / VTIMER_WHEEL_SLOTS] |= 1U << (slot % VTIMER_WHEEL_SLOTS);
+    }
+}
+
+static void slot_remove(vtimer_t *timer) {
+    unsigned slot = timer->slot - 1;
+
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        timer_slots[slot] = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    timer->slot = 0;
+
+    if ((slot < WHEEL_SLOTS_TOTAL) && (timer_slots[slot] == NULL)) {
+        wheel_bitmap[slot / VTIMER_WHEEL_SLOTS] &= ~(1U << (slot % VTIMER_WHEEL_SLOTS));
+    }
 }
 
-static int update_shortterm() {
+/* checks the links too, so never set or uninitialised timers are told apart */
+static int is_set(vtimer_t *timer) {
+    if ((timer->slot == 0) || (timer->slot > WHEEL_SLOTS_TOTAL + VTIMER_LONGTERM_SLOTS)) {
+        return false;
+    }
+    if (timer->prev) {
+        return timer->prev->next == timer;
+    }
+    return timer_slots[timer->slot - 1] == timer;
+}
+
+static unsigned wheel_slot(int level, uint32_t start) {
+    return level * VTIMER_WHEEL_SLOTS +
+           ((start >> (level * VTIMER_WHEEL_BITS)) & (VTIMER_WHEEL_SLOTS - 1));
+}
+
+/* the level is given by the highest digit the expiry differs from wheel_now in */
+static void wheel_add(vtimer_t *timer) {
+    uint32_t expiry = timer->absolute.microseconds;
+    uint32_t diff;
+    unsigned level = 0;
+
+    if (expiry < wheel_now) {
+        expiry = wheel_now;
+    }
+
+    for (diff = (expiry ^ wheel_now) >> VTIMER_WHEEL_BITS; diff; diff >>= VTIMER_WHEEL_BITS) {
+        level++;
+    }
+
+    slot_add(timer, wheel_slot(level, expiry));
+}
+
+/* returns the lowest occupied level and when its first slot starts, -1 if empty */
+static int wheel_next(uint32_t *start) {
+    for (unsigned level = 0; level < VTIMER_WHEEL_LEVELS; level++) {
+        if (wheel_bitmap[level]) {
+            unsigned shift = (level + 1) * VTIMER_WHEEL_BITS;
+            uint32_t high = (shift < 32) ? (wheel_now & ~((1UL << shift) - 1)) : 0;
+
+            *start = high | ((uint32_t) bitarithm_lsb(wheel_bitmap[level]) << (level * VTIMER_WHEEL_BITS));
+            return level;
+        }
+    }
+    return -1;
+}
+
+static void update_shortterm(void) {
+    uint32_t start;
+    int level = wheel_next(&start);
+
+    if (level < 0) {
+        return;
+    }
+
+    /* a timer alone in its slot can be waited for directly instead of
+     * waking up to move it down the levels first */
+    if (level > 0) {
+        vtimer_t *timer = timer_slots[wheel_slot(level, start)];
+        if (timer->next == NULL) {
+            start = timer->absolute.microseconds;
+        }
+    }
+
     if (hwtimer_id != -1) {
-        if (hwtimer_next_absolute != shortterm_queue_root.next->priority) {
+        if (hwtimer_next_absolute != start) {
             hwtimer_remove(hwtimer_id);
         } else {
-            return 0;
+            return;
         }
     }
 
-    hwtimer_next_absolute = shortterm_queue_root.next->priority;
+    hwtimer_next_absolute = start;
 
     unsigned int next = hwtimer_next_absolute + longterm_tick_start;
     unsigned int now = hwtimer_now();
@@ -68,61 +167,98 @@ static int update_shortterm() {
     hwtimer_id = hwtimer_set_absolute(next, vtimer_callback, NULL);
 
     DEBUG("update_shortterm: Set hwtimer to %lu (now=%lu)\n", hwtimer_next_absolute + longterm_tick_start, hwtimer_now());
-    return 0;
+}
+
+static void vtimer_shoot(vtimer_t *timer) {
+#ifdef ENABLE_DEBUG
+    vtimer_print(timer);
+#endif
+    DEBUG("vtimer_callback(): Shooting %lu.\n", timer->absolute.microseconds);
+
+    if (timer->action == (void*) msg_send_int) {
+        msg_t msg; 
+        msg.type = MSG_TIMER;
+        msg.content.value = (unsigned int) timer->arg;
+        msg_send_int(&msg, timer->pid);
+    } else {
+        timer->action(timer->arg);
+    }    
+#if VTIMERSTATISTICS
+    vtimer_statistic.fired++;
+#endif
 }
 
 void vtimer_tick(void *ptr) {
     DEBUG("vtimer_tick().");
     seconds += SECONDS_PER_TICK;
 
-    longterm_tick_start = longterm_tick_timer.absolute.microseconds;
-    longterm_tick_timer.absolute.microseconds = longterm_tick_timer.absolute.microseconds + MICROSECONDS_PER_TICK;
-    set_shortterm(&longterm_tick_timer);
+    /* the wheel is empty but for the slot of the tick timer being shot */
+    longterm_tick_start += MICROSECONDS_PER_TICK;
+    wheel_now = 0;
+    wheel_add(&longterm_tick_timer);
 
-    while (longterm_queue_root.next) {
-        vtimer_t *timer = (vtimer_t*) longterm_queue_root.next;
+    vtimer_t *timer = timer_slots[LONGTERM_SLOT(seconds)];
+    while (timer) {
+        vtimer_t *next = timer->next;
         if (timer->absolute.seconds == seconds) {
-            timer = (vtimer_t*) queue_remove_head(&longterm_queue_root);
-            set_shortterm(timer);
-        } else {
-            break;
+            slot_remove(timer);
+            wheel_add(timer);
         }
+        timer = next;
     }
-
-    update_shortterm();
-}
-
-static int set_shortterm(vtimer_t *timer) {
-    DEBUG("set_shortterm(): Absolute: %lu %lu\n", timer->absolute.seconds, timer->absolute.microseconds);
-    timer->queue_entry.priority = timer->absolute.microseconds;
-    queue_priority_add(&shortterm_queue_root, (queue_node_t*)timer);
-    return 1;
 }
 
 void vtimer_callback(void *ptr) {
-    vtimer_t *timer;
+#if VTIMERSTATISTICS
+    uint32_t entered = hwtimer_now();
+    unsigned shot = 0;
+
+    vtimer_statistic.wakeups++;
+#endif
+    uint32_t start;
+    int level;
+
     in_callback = true;
     hwtimer_id = -1;
 
-    timer = (vtimer_t *)queue_remove_head(&shortterm_queue_root);
+    /* advance the wheel to every slot that is due, shooting the timers of
+     * level 0 and moving those of higher levels further down */
+    while ((level = wheel_next(&start)) >= 0) {
+        if (start > (uint32_t) (hwtimer_now() - longterm_tick_start)) {
+            break;
+        }
 
-#ifdef ENABLE_DEBUG
-    vtimer_print(timer);
+        unsigned slot = wheel_slot(level, start);
+        wheel_now = start;
+
+        vtimer_t *timer;
+        while ((timer = timer_slots[slot]) != NULL) {
+            slot_remove(timer);
+            if (level == 0) {
+                vtimer_shoot(timer);
+#if VTIMERSTATISTICS
+                if (shot++) {
+                    vtimer_statistic.coalesced++;
+                }
 #endif
-    DEBUG("vtimer_callback(): Shooting %lu.\n", timer->absolute.microseconds);
-
-    /* shoot timer */
-    if (timer->action == (void*) msg_send_int) {
-        msg_t msg; 
-        msg.type = MSG_TIMER;
-        msg.content.value = (unsigned int) timer->arg;
-        msg_send_int(&msg, timer->pid);
-    } else {
-        timer->action(timer->arg);
-    }    
+            } else {
+                wheel_add(timer);
+#if VTIMERSTATISTICS
+                vtimer_statistic.cascaded++;
+#endif
+            }
+        }
+    }
 
     in_callback = false;
     update_shortterm();
+
+#if VTIMERSTATISTICS
+    uint32_t duration = HWTIMER_TICKS_TO_US((uint32_t) hwtimer_now() - entered);
+    if (duration > vtimer_statistic.callback_max) {
+        vtimer_statistic.callback_max = duration;
+    }
+#endif
 }
 
 void normalize_to_tick(timex_t *time) {
@@ -143,6 +279,37 @@ void normalize_to_tick(timex_t *time) {
     DEBUG("     Result: %lu %lu\n", time->seconds, time->microseconds);
 }
 
+#if VTIMERSTATISTICS
+static void vtimer_irq_off(uint32_t ticks) {
+    uint32_t duration = HWTIMER_TICKS_TO_US(ticks);
+    if (duration > vtimer_statistic.irq_off_max) {
+        vtimer_statistic.irq_off_max = duration;
+    }
+}
+#endif
+
+/* moves the expiry to the roundest time within the slack, so timers due
+ * around the same time end up in one slot and share an interrupt */
+static void apply_slack(vtimer_t *timer) {
+    uint32_t expiry = timer->absolute.microseconds;
+    uint32_t limit = expiry + timer->slack;
+    uint32_t mask;
+
+    if ((limit < expiry) || (limit > MICROSECONDS_PER_TICK)) {
+        limit = MICROSECONDS_PER_TICK;
+    }
+
+    /* clear all bits below the highest one expiry and limit differ in */
+    mask = expiry ^ limit;
+    mask |= mask >> 1;
+    mask |= mask >> 2;
+    mask |= mask >> 4;
+    mask |= mask >> 8;
+    mask |= mask >> 16;
+
+    timer->absolute.microseconds = limit & ~(mask >> 1);
+}
+
 static int vtimer_set(vtimer_t *timer) {
     DEBUG("vtimer_set(): New timer. Offset: %lu %lu\n", timer->absolute.seconds, timer->absolute.microseconds);
 
@@ -159,26 +326,39 @@ static int vtimer_set(vtimer_t *timer) {
         }
     }
 
+    if (timer->slack) {
+        apply_slack(timer);
+    }
+
     int state = disableIRQ();
+#if VTIMERSTATISTICS
+    uint32_t locked = hwtimer_now();
+#endif
+
+    if (is_set(timer)) {
+        slot_remove(timer);
+    }
+
     if (timer->absolute.seconds != seconds){
         /* we're long-term */
         DEBUG("vtimer_set(): setting long_term\n");
-        result = set_longterm(timer);
+        slot_add(timer, LONGTERM_SLOT(timer->absolute.seconds));
     }
     else {
         DEBUG("vtimer_set(): setting short_term\n");
-        if (set_shortterm(timer)) {
+        wheel_add(timer);
 
-            /* delay update of next shortterm timer if we 
-            * are called from within vtimer_callback. */
-         
-            if (!in_callback) {
-                result = update_shortterm();
-            }
+        /* delay update of next shortterm timer if we 
+        * are called from within vtimer_callback. */
+        if (!in_callback) {
+            update_shortterm();
         }
     }
 
-
+#if VTIMERSTATISTICS
+    vtimer_statistic.set++;
+    vtimer_irq_off((uint32_t) hwtimer_now() - locked);
+#endif
     restoreIRQ(state);
 
     return result;
@@ -202,7 +382,7 @@ int vtimer_init() {
 
     DEBUG("vtimer_init(): Setting longterm tick to %lu\n", longterm_tick_timer.absolute.microseconds);
 
-    set_shortterm(&longterm_tick_timer);
+    wheel_add(&longterm_tick_timer);
     update_shortterm();
 
     restoreIRQ(state);
@@ -227,18 +407,35 @@ int vtimer_usleep(uint32_t usecs) {
 int vtimer_sleep(timex_t time) {
     int ret;
     vtimer_t t;
+    t.slot = 0;
+    t.slack = 0;
     ret = vtimer_set_wakeup(&t, time, thread_getpid());
     thread_sleep();
     return ret;
 }
 
+void vtimer_set_slack(vtimer_t *t, uint32_t slack) {
+    t->slack = slack;
+}
+
 int vtimer_remove(vtimer_t *t){
-    queue_remove(&shortterm_queue_root, (queue_node_t*)t);
-    queue_remove(&longterm_queue_root, (queue_node_t*)t);
-  
-    update_shortterm();
- 
-    if (! inISR() ) eINT();
+    int state = disableIRQ();
+#if VTIMERSTATISTICS
+    uint32_t locked = hwtimer_now();
+#endif
+
+    if (is_set(t)) {
+        slot_remove(t);
+
+        if (!in_callback) {
+            update_shortterm();
+        }
+    }
+
+#if VTIMERSTATISTICS
+    vtimer_irq_off((uint32_t) hwtimer_now() - locked);
+#endif
+    restoreIRQ(state);
     return 0; 
 }
 
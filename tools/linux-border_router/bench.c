@@ -0,0 +1,222 @@
+/**
+ * @file    bench.c
+ * @author  Freie Universität Berlin, Computer Systems & Telemetics
+ * @brief   Throughput benchmark for the serial interface of the 6LoWPAN
+ *          Border Router driver.
+ *
+ *          A pty pair stands in for the MSB-A2: a child process on the
+ *          master side plays the node, the driver's multiplexer works on
+ *          the slave side as it does on the real tty. First the node
+ *          sends <em>count</em> SLIP-encoded packets of <em>size</em>
+ *          bytes as fast as the pty takes them, which the driver reads
+ *          from an epoll loop like border_event_loop(). Then the driver
+ *          sends as many packets with writepacket() and the node counts
+ *          them. Both directions report packets per second and the CPU
+ *          the driver used meanwhile.
+ *
+ *          Usage: sixlowbench [count] [size]
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "multiplex.h"
+#include "serial.h"
+
+#define END         0xC0
+#define ESC         0xDB
+#define END_ESC     0xDC
+#define ESC_ESC     0xDD
+
+#define BENCH_COUNT     100000
+#define BENCH_SIZE      100
+#define NODE_BATCH      32      ///< Packets the node writes at once.
+
+int packet_size;
+int received, bad;
+
+struct bench_time {
+    struct timeval wall;
+    struct timeval cpu;
+};
+
+void bench_now(struct bench_time *t) {
+    struct rusage usage;
+
+    gettimeofday(&t->wall, NULL);
+    getrusage(RUSAGE_SELF, &usage);
+    timeradd(&usage.ru_utime, &usage.ru_stime, &t->cpu);
+}
+
+long usec_between(const struct timeval *start, const struct timeval *end) {
+    return (end->tv_sec - start->tv_sec) * 1000000L +
+            (end->tv_usec - start->tv_usec);
+}
+
+void print_result(const char *what, int count,
+        const struct bench_time *start, const struct bench_time *end) {
+    long wall = usec_between(&start->wall, &end->wall);
+    long cpu = usec_between(&start->cpu, &end->cpu);
+
+    if (wall <= 0) {
+        wall = 1;
+    }
+
+    printf("%s: %d packets of %d bytes in %ld ms, %ld packets/s, "
+            "%ld%% CPU, %ld ns CPU per packet\n",
+            what, count, packet_size, wall / 1000,
+            (long)((int64_t)count * 1000000 / wall), cpu * 100 / wall,
+            (long)((int64_t)cpu * 1000 / (count ? count : 1)));
+}
+
+void fill_packet(uint8_t *packet, int size) {
+    border_l3_header_t *l3_hdr = (border_l3_header_t *)packet;
+    int i;
+
+    l3_hdr->empty = 0;
+    l3_hdr->type = BORDER_PACKET_L3_TYPE;
+    l3_hdr->seq_num = 0;
+    l3_hdr->ethertype = ETHERTYPE_IPV6;
+
+    /* some END and ESC bytes to escape, like in real traffic */
+    for (i = sizeof (border_l3_header_t); i < size; i++) {
+        packet[i] = i * 0x2F;
+    }
+}
+
+int slip_encode(uint8_t *out, const uint8_t *packet, int size) {
+    uint8_t *ptr = out;
+    int i;
+
+    for (i = 0; i < size; i++) {
+        switch (packet[i]) {
+            case (END):{
+                *ptr++ = ESC;
+                *ptr++ = END_ESC;
+                break;
+            }
+            case (ESC):{
+                *ptr++ = ESC;
+                *ptr++ = ESC_ESC;
+                break;
+            }
+            default:
+                *ptr++ = packet[i];
+                break;
+        }
+    }
+    *ptr++ = END;
+
+    return ptr - out;
+}
+
+/* the node: sends count packets, then reports when it got count back */
+void node(int fd, int report_fd, int count) {
+    uint8_t packet[BUFFER_SIZE];
+    uint8_t *block = malloc(NODE_BATCH * (2 * BUFFER_SIZE + 1));
+    uint8_t buf[4096];
+    int len, sent, n, i, ends = 0;
+
+    fill_packet(packet, packet_size);
+    len = slip_encode(block, packet, packet_size);
+    for (i = 1; i < NODE_BATCH; i++) {
+        memcpy(block + i * len, block, len);
+    }
+
+    for (sent = 0; sent < count; sent += n) {
+        n = (count - sent < NODE_BATCH) ? count - sent : NODE_BATCH;
+        if (write(fd, block, n * len) != n * len) {
+            exit(1);
+        }
+    }
+
+    while (ends < count) {
+        if ((n = read(fd, buf, sizeof (buf))) <= 0) {
+            exit(1);
+        }
+        for (i = 0; i < n; i++) {
+            ends += (buf[i] == END);
+        }
+    }
+
+    write(report_fd, &ends, sizeof (ends));
+    exit(0);
+}
+
+void count_packet(uint8_t *packet, int len) {
+    received++;
+    if (len != packet_size) {
+        bad++;
+    }
+}
+
+int main(int argc, char **argv) {
+    struct bench_time start, end;
+    struct epoll_event ev;
+    uint8_t packet[BUFFER_SIZE];
+    int count = (argc > 1) ? atoi(argv[1]) : BENCH_COUNT;
+    int master, epoll_fd, report[2], ends, i;
+    pid_t pid;
+
+    packet_size = (argc > 2) ? atoi(argv[2]) : BENCH_SIZE;
+    if (count <= 0 || packet_size < sizeof (border_l3_header_t) ||
+            packet_size > BUFFER_SIZE) {
+        fprintf(stderr, "Usage: %s [count] [size <= %d]\n", argv[0], (int)BUFFER_SIZE);
+        return -1;
+    }
+
+    if ((master = posix_openpt(O_RDWR | O_NOCTTY)) < 0 ||
+            grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+    if (init_multiplex(ptsname(master)) != 0 || pipe(report) != 0) {
+        return -1;
+    }
+
+    fflush(stdout);
+    bench_now(&start);
+    if ((pid = fork()) == 0) {
+        node(master, report[1], count);
+    }
+
+    epoll_fd = epoll_create(1);
+    ev.events = EPOLLIN;
+    ev.data.fd = serial_port_fd();
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, serial_port_fd(), &ev);
+
+    while (received < count) {
+        if (epoll_wait(epoll_fd, &ev, 1, -1) == 1 &&
+                readpackets(count_packet) < 0) {
+            break;
+        }
+    }
+    bench_now(&end);
+    print_result("node -> driver", received, &start, &end);
+    if (bad) {
+        printf("%d packets with a wrong length\n", bad);
+    }
+
+    fill_packet(packet, packet_size);
+    bench_now(&start);
+    for (i = 0; i < count; i++) {
+        writepacket(packet, packet_size);
+    }
+    read(report[0], &ends, sizeof (ends));
+    bench_now(&end);
+    print_result("driver -> node", ends, &start, &end);
+
+    waitpid(pid, NULL, 0);
+    return 0;
+}
@@ -1,77 +1,137 @@
 #include <pthread.h>
-#include <semaphore.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <sys/timerfd.h>
+
 #ifdef BORDER_TESTING
 #include "testing.h"
 #endif
 
 #include "flowcontrol.h"
 #include "multiplex.h"
+#include "sixlowdriver.h"
 
 flowcontrol_stat_t slwin_stat;
 uint8_t connection_established;
 
-void* resend_thread_f (void *args) {
-    uint8_t seq_num = *((uint8_t *)args);
-    struct send_slot *slot = &(slwin_stat.send_win[seq_num % BORDER_SWS]);
-    
-    while(1) {
-        usleep(BORDER_SL_TIMEOUT);
-        if (seq_num == ((border_packet_t *)(slot->frame))->seq_num) {
-            writepacket(slot->frame,slot->frame_len);
-        } else {
-            return NULL;
+static void timespec_add_usec(struct timespec *t, long usec) {
+    t->tv_sec += usec / 1000000;
+    t->tv_nsec += (usec % 1000000) * 1000;
+    if (t->tv_nsec >= 1000000000) {
+        t->tv_sec++;
+        t->tv_nsec -= 1000000000;
+    }
+}
+
+static long timespec_diff_usec(const struct timespec *end, const struct timespec *start) {
+    return (end->tv_sec - start->tv_sec) * 1000000 +
+            (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+/* lock held */
+static void transmit(struct send_slot *slot) {
+    slot->tx = ++slwin_stat.transmissions;
+    writepacket(slot->frame, slot->frame_len);
+}
+
+/*
+ * An acknowledged frame got through after everything transmitted before,
+ * unless it was retransmitted: the acknowledgement may be the first one's.
+ */
+static void delivered(const struct send_slot *slot) {
+    if (!slot->retransmitted &&
+            (int16_t)(slot->tx - slwin_stat.delivered_tx) > 0) {
+        slwin_stat.delivered_tx = slot->tx;
+    }
+}
+
+/* runs the event loop for up to BORDER_SL_TIMEOUT or until the SYNACK */
+static void wait_for_synack(void) {
+    struct timespec now, end;
+    long timeout;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    timespec_add_usec(&end, BORDER_SL_TIMEOUT);
+
+    while (!connection_established) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        timeout = timespec_diff_usec(&end, &now) / 1000;
+        if (timeout <= 0) {
+            break;
+        }
+        if (border_poll(timeout) < 0) {
+            usleep(timeout * 1000);
         }
     }
 }
 
 void init_threeway_handshake(const struct in6_addr *addr) {
-    border_syn_packet_t *syn = (border_syn_packet_t *)get_serial_out_buffer(0);
-    syn->empty = 0;
-    syn->type = BORDER_PACKET_CONF_TYPE;
-    syn->next_seq_num = slwin_stat.last_frame + 1;
-    syn->conftype = BORDER_CONF_SYN;
-    syn->next_exp = slwin_stat.next_exp;
-    memcpy(&(syn->addr), addr, 16);
-    
+    /* not in the serial out buffer, the ACKs sent meanwhile use that */
+    border_syn_packet_t syn;
+    syn.empty = 0;
+    syn.type = BORDER_PACKET_CONF_TYPE;
+    syn.next_seq_num = slwin_stat.last_frame + 1;
+    syn.conftype = BORDER_CONF_SYN;
+    syn.next_exp = slwin_stat.next_exp;
+    memcpy(&(syn.addr), addr, 16);
+    syn.window = BORDER_RWS;
+
     do {
-        writepacket((uint8_t *)syn, sizeof (border_syn_packet_t));
-        usleep(BORDER_SL_TIMEOUT);
+        writepacket((uint8_t *)&syn, sizeof (border_syn_packet_t));
+        wait_for_synack();
     } while (!connection_established);
 }
 
-void signal_connection_established(void) {
+void signal_connection_established(uint8_t window) {
+    pthread_mutex_lock(&slwin_stat.lock);
+    slwin_stat.send_win_size = BORDER_SWS;
+    if (window < slwin_stat.send_win_size) {
+        slwin_stat.send_win_size = (window > 0) ? window : 1;
+    }
     connection_established = 1;
+    pthread_cond_broadcast(&slwin_stat.send_win_not_full);
+    pthread_mutex_unlock(&slwin_stat.lock);
 }
 
 void flowcontrol_init(const struct in6_addr *addr) {
     int i;
     slwin_stat.last_frame = 0xFF;
     slwin_stat.last_ack = slwin_stat.last_frame;
+    slwin_stat.send_win_size = 1;
     connection_established = 0;
-    
-    sem_init(&slwin_stat.send_win_not_full,0,BORDER_SWS);
-    for(i = 0; i < BORDER_SWS; i++) {        
-        slwin_stat.send_win[i].frame_len = 0;
-    }
+
+    pthread_mutex_init(&slwin_stat.lock, NULL);
+    pthread_cond_init(&slwin_stat.send_win_not_full, NULL);
+    slwin_stat.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    slwin_stat.srtt = 0;
+    slwin_stat.rttvar = 0;
+    slwin_stat.rto = BORDER_SL_TIMEOUT;
+    slwin_stat.transmissions = 0;
+    slwin_stat.delivered_tx = 0;
     memset(&slwin_stat.send_win,0, sizeof(struct send_slot) * BORDER_SWS);
-    
+
     slwin_stat.next_exp = 0;
-    
+
     for(i = 0; i < BORDER_RWS; i++) {
         slwin_stat.recv_win[i].received = 0;
         slwin_stat.recv_win[i].frame_len = 0;
     }
     memset(&slwin_stat.recv_win,0, sizeof(struct recv_slot) * BORDER_RWS);
-    
+
     init_threeway_handshake(addr);
 }
 
 void flowcontrol_destroy(void) {
-    sem_destroy(&slwin_stat.send_win_not_full);
+    close(slwin_stat.timer_fd);
+    pthread_cond_destroy(&slwin_stat.send_win_not_full);
+    pthread_mutex_destroy(&slwin_stat.lock);
+}
+
+int flowcontrol_timer_fd(void) {
+    return slwin_stat.timer_fd;
 }
 
 static int in_window(uint8_t seq_num, uint8_t min, uint8_t max) {
@@ -80,66 +140,246 @@ static int in_window(uint8_t seq_num, uint8_t min, uint8_t max) {
     return pos < maxpos;
 }
 
+static uint8_t frames_in_flight(void) {
+    return slwin_stat.last_frame - slwin_stat.last_ack;
+}
+
+int flowcontrol_send_ready(void) {
+    int ready;
+
+    pthread_mutex_lock(&slwin_stat.lock);
+    ready = connection_established &&
+            frames_in_flight() < slwin_stat.send_win_size;
+    pthread_mutex_unlock(&slwin_stat.lock);
+
+    return ready;
+}
+
+/* sets the timerfd to the earliest retransmission, lock held */
+static void set_timeout(void) {
+    struct itimerspec timer;
+    struct send_slot *slot;
+    uint8_t seq_num;
+
+    memset(&timer, 0, sizeof (timer));
+
+    for (seq_num = slwin_stat.last_ack + 1; seq_num != (uint8_t)(slwin_stat.last_frame + 1); seq_num++) {
+        slot = &(slwin_stat.send_win[seq_num % BORDER_SWS]);
+        if (slot->acked) {
+            continue;
+        }
+        if ((timer.it_value.tv_sec == 0 && timer.it_value.tv_nsec == 0) ||
+                timespec_diff_usec(&slot->deadline, &timer.it_value) < 0) {
+            timer.it_value = slot->deadline;
+        }
+    }
+
+    /* all zero disarms it */
+    timerfd_settime(slwin_stat.timer_fd, TFD_TIMER_ABSTIME, &timer, NULL);
+}
+
+/* Jacobson/Karels estimate, as for TCP (RFC 6298), lock held */
+static void update_rto(long rtt) {
+    long delta;
+
+    if (slwin_stat.srtt == 0) {
+        slwin_stat.srtt = rtt;
+        slwin_stat.rttvar = rtt / 2;
+    } else {
+        delta = (slwin_stat.srtt > rtt) ? slwin_stat.srtt - rtt : rtt - slwin_stat.srtt;
+        slwin_stat.rttvar = (3 * slwin_stat.rttvar + delta) / 4;
+        slwin_stat.srtt = (7 * slwin_stat.srtt + rtt) / 8;
+    }
+
+    slwin_stat.rto = slwin_stat.srtt + 4 * slwin_stat.rttvar;
+    if (slwin_stat.rto < BORDER_RTO_MIN) {
+        slwin_stat.rto = BORDER_RTO_MIN;
+    } else if (slwin_stat.rto > BORDER_RTO_MAX) {
+        slwin_stat.rto = BORDER_RTO_MAX;
+    }
+}
+
+void flowcontrol_retransmit(void) {
+    struct timespec now;
+    struct send_slot *slot;
+    uint64_t expirations;
+    uint8_t seq_num, expired = 0;
+
+    read(slwin_stat.timer_fd, &expirations, sizeof (expirations));
+
+    pthread_mutex_lock(&slwin_stat.lock);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    for (seq_num = slwin_stat.last_ack + 1; seq_num != (uint8_t)(slwin_stat.last_frame + 1); seq_num++) {
+        slot = &(slwin_stat.send_win[seq_num % BORDER_SWS]);
+        if (!slot->acked && timespec_diff_usec(&now, &slot->deadline) >= 0) {
+            transmit(slot);
+            slot->retransmitted = 1;
+            expired = 1;
+        }
+    }
+
+    if (expired) {
+        /*
+         * back off until a round trip can be measured again, once per
+         * timeout, and restart the timer of the whole window with it
+         */
+        slwin_stat.rto = (2 * slwin_stat.rto < BORDER_RTO_MAX) ? 2 * slwin_stat.rto : BORDER_RTO_MAX;
+
+        for (seq_num = slwin_stat.last_ack + 1; seq_num != (uint8_t)(slwin_stat.last_frame + 1); seq_num++) {
+            slot = &(slwin_stat.send_win[seq_num % BORDER_SWS]);
+            if (!slot->acked) {
+                slot->deadline = now;
+                timespec_add_usec(&slot->deadline, slwin_stat.rto);
+            }
+        }
+    }
+
+    set_timeout();
+    pthread_mutex_unlock(&slwin_stat.lock);
+}
+
 void send_ack(uint8_t seq_num) {
-    border_packet_t *packet = (border_packet_t *)get_serial_out_buffer(0);
-    packet->empty = 0;
-    packet->type = BORDER_PACKET_ACK_TYPE;
-    packet->seq_num = seq_num;
-    writepacket((uint8_t *)packet, sizeof (border_packet_t));
+    border_ack_packet_t packet;
+    int i;
+
+    packet.empty = 0;
+    packet.type = BORDER_PACKET_ACK_TYPE;
+    packet.seq_num = seq_num;
+    memset(packet.sack, 0, BORDER_SACK_LEN);
+
+    /* frames received behind the gap at seq_num + 1 */
+    for (i = 0; i < BORDER_RWS - 1; i++) {
+        if (slwin_stat.recv_win[(uint8_t)(seq_num + 2 + i) % BORDER_RWS].received) {
+            packet.sack[i / 8] |= 1 << (i % 8);
+        }
+    }
+
+    writepacket((uint8_t *)&packet, sizeof (border_ack_packet_t));
 }
 
 void flowcontrol_send_over_tty(border_packet_t *packet, int len) {
     struct send_slot *slot;
-    uint8_t args[] = {packet->seq_num};
-    
-    sem_wait(&(slwin_stat.send_win_not_full));
+
+    pthread_mutex_lock(&slwin_stat.lock);
+    while (!connection_established ||
+            frames_in_flight() >= slwin_stat.send_win_size) {
+        pthread_cond_wait(&slwin_stat.send_win_not_full, &slwin_stat.lock);
+    }
+
     packet->seq_num = ++slwin_stat.last_frame;
     slot = &(slwin_stat.send_win[packet->seq_num % BORDER_SWS]);
     memcpy(slot->frame, (uint8_t *)packet, len);
     slot->frame_len = len;
-    pthread_create(&slot->resend_thread, NULL, resend_thread_f, (void *)args);
+    slot->acked = 0;
+    slot->retransmitted = 0;
+    clock_gettime(CLOCK_MONOTONIC, &slot->sent);
+    slot->deadline = slot->sent;
+    timespec_add_usec(&slot->deadline, slwin_stat.rto);
 #ifdef BORDER_TESTING
     testing_start(packet->seq_num);
 #endif
-    writepacket((uint8_t *)packet, len);
+    transmit(slot);
+    set_timeout();
+    pthread_mutex_unlock(&slwin_stat.lock);
 }
 
-void flowcontrol_deliver_from_tty(const border_packet_t *packet, int len) {
-    if (packet->type == BORDER_PACKET_ACK_TYPE) {
-        if (in_window(packet->seq_num, slwin_stat.last_ack+1, slwin_stat.last_frame)) {
-            do {
-                struct send_slot *slot;
-                slot = &(slwin_stat.send_win[++slwin_stat.last_ack % BORDER_SWS]);
+static void deliver_ack(const border_ack_packet_t *ack, int len) {
+    struct timespec now;
+    struct send_slot *slot;
+    uint8_t seq_num;
+    long rtt = -1;
+    int i;
+
+    pthread_mutex_lock(&slwin_stat.lock);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    /* older nodes acknowledge without them */
+    if (len >= sizeof (border_ack_packet_t)) {
+        for (i = 0; i < 8 * BORDER_SACK_LEN; i++) {
+            seq_num = ack->seq_num + 2 + i;
+            if ((ack->sack[i / 8] & (1 << (i % 8))) &&
+                    in_window(seq_num, slwin_stat.last_ack+1, slwin_stat.last_frame)) {
+                slot = &(slwin_stat.send_win[seq_num % BORDER_SWS]);
+                /* round trips only from frames first acknowledged now (Karn) */
+                if (!slot->acked && !slot->retransmitted) {
+                    rtt = timespec_diff_usec(&now, &slot->sent);
+                }
+                slot->acked = 1;
+                delivered(slot);
+            }
+        }
+    }
+
+    if (in_window(ack->seq_num, slwin_stat.last_ack+1, slwin_stat.last_frame)) {
+        slot = &(slwin_stat.send_win[ack->seq_num % BORDER_SWS]);
+        if (rtt < 0 && !slot->acked && !slot->retransmitted) {
+            rtt = timespec_diff_usec(&now, &slot->sent);
+        }
+
+        do {
+            slot = &(slwin_stat.send_win[++slwin_stat.last_ack % BORDER_SWS]);
 #ifdef BORDER_TESTING
-                testing_stop(slwin_stat.last_ack);
+            testing_stop(slwin_stat.last_ack);
 #endif
-                pthread_cancel(slot->resend_thread);
-                memset(&slot->frame,0,BUFFER_SIZE);
-                slot->frame_len = 0;
-                sem_post(&slwin_stat.send_win_not_full);
-            } while (slwin_stat.last_ack != packet->seq_num);
+            delivered(slot);
+            slot->acked = 0;
+            slot->frame_len = 0;
+        } while (slwin_stat.last_ack != ack->seq_num);
+
+        pthread_cond_broadcast(&slwin_stat.send_win_not_full);
+    }
+
+    if (rtt >= 0) {
+        update_rto(rtt);
+    }
+
+    /*
+     * The tty keeps frames in order, so the ones transmitted before an
+     * acknowledged frame are lost: repeat them right away instead of
+     * waiting for their timeout.
+     */
+    for (seq_num = slwin_stat.last_ack + 1; seq_num != (uint8_t)(slwin_stat.last_frame + 1); seq_num++) {
+        slot = &(slwin_stat.send_win[seq_num % BORDER_SWS]);
+        if (!slot->acked && (int16_t)(slot->tx - slwin_stat.delivered_tx) < 0) {
+            transmit(slot);
+            slot->retransmitted = 1;
+            slot->deadline = now;
+            timespec_add_usec(&slot->deadline, slwin_stat.rto);
         }
+    }
+
+    set_timeout();
+    pthread_mutex_unlock(&slwin_stat.lock);
+}
+
+void flowcontrol_deliver_from_tty(const border_packet_t *packet, int len) {
+    if (packet->type == BORDER_PACKET_ACK_TYPE) {
+        deliver_ack((const border_ack_packet_t *)packet, len);
     } else {
         struct recv_slot *slot;
-        
+
         slot = &slwin_stat.recv_win[packet->seq_num % BORDER_RWS];
-        if (    !in_window(packet->seq_num, 
-                slwin_stat.next_exp, 
-                slwin_stat.next_exp + BORDER_RWS - 1)) {
-            return;
+
+        /*
+         * Frames before the window were delivered already, their ACK got
+         * lost, so it is repeated below.
+         */
+        if (    in_window(packet->seq_num,
+                slwin_stat.next_exp,
+                slwin_stat.next_exp + BORDER_RWS - 1) && !slot->received) {
+            memcpy(slot->frame, (uint8_t *)packet, len);
+            slot->frame_len = len;
+            slot->received = 1;
         }
-        memcpy(slot->frame, (uint8_t *)packet, len);
-        slot->received = 1;
-        
-        if (packet->seq_num == slwin_stat.next_exp) {
-            while (slot->received) {
-                demultiplex((border_packet_t *)slot->frame, slot->frame_len);
-                memset(&slot->frame,0,BUFFER_SIZE);
-                slot->received = 0;
-                slot = &slwin_stat.recv_win[++slwin_stat.next_exp % BORDER_RWS];
-            }
+
+        slot = &slwin_stat.recv_win[slwin_stat.next_exp % BORDER_RWS];
+        while (slot->received) {
+            demultiplex((border_packet_t *)slot->frame, slot->frame_len);
+            slot->received = 0;
+            slot = &slwin_stat.recv_win[++slwin_stat.next_exp % BORDER_RWS];
         }
-        
+
         send_ack(slwin_stat.next_exp - 1);
     }
 }
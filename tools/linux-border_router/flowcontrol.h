@@ -11,7 +11,7 @@
 
 #include <stdint.h>
 #include <pthread.h>
-#include <semaphore.h>
+#include <time.h>
 
 #include <netinet/in.h>
 
@@ -24,9 +24,31 @@
 #define BORDER_CONF_SYN           0       ///< Configuration packet type for SYN-Packets.
 #define BORDER_CONF_SYNACK        1       ///< Configuration packet type for SYN/ACK-Packets.
 
-#define BORDER_SWS                1       ///< Sending window size for flow control.
-#define BORDER_RWS                1       ///< Receiving window size for flow control.
-#define BORDER_SL_TIMEOUT         500000  ///< Timeout time (in µsec) for flow control.
+/**
+ * @brief   Sending window size for flow control.
+ * 
+ * Selective repeat: the sending window in use is the smaller of this
+ * and the receiving window the MSB-A2 announces in its SYNACK.
+ */
+#ifndef BORDER_SWS
+#define BORDER_SWS                64
+#endif
+#ifndef BORDER_RWS
+#define BORDER_RWS                64      ///< Receiving window size for flow control, announced in the SYN.
+#endif
+#define BORDER_SACK_LEN           8       ///< Bytes of selective acknowledgements in an ACK.
+
+#if BORDER_RWS > 8 * BORDER_SACK_LEN + 1
+#error "BORDER_RWS must not exceed 8 * BORDER_SACK_LEN + 1"
+#endif
+/* slots are indexed by sequence number modulo window size */
+#if (BORDER_SWS & (BORDER_SWS - 1)) || (BORDER_RWS & (BORDER_RWS - 1))
+#error "BORDER_SWS and BORDER_RWS must be powers of two"
+#endif
+
+#define BORDER_SL_TIMEOUT         500000  ///< Retransmission timeout (in µsec) until the first round trip is measured.
+#define BORDER_RTO_MIN            20000   ///< Lower bound of the adaptive retransmission timeout (in µsec).
+#define BORDER_RTO_MAX            4000000 ///< Upper bound of the adaptive retransmission timeout (in µsec).
 
 /**
  * @brief   State of the sliding window algorithm, used for flow control
@@ -37,15 +59,31 @@ typedef struct flowcontrol_stat_t {
     /* Sender state */
     uint8_t last_ack;                   ///< Sequence number of the last received acknowledgement.
     uint8_t last_frame;                 ///< Sequence number of the last send frame.
+    uint8_t send_win_size;              ///< Sending window in use, s. @ref BORDER_SWS.
+    pthread_mutex_t lock;               ///< Guards the sender state.
     /**
-     * @brief   Semaphore, that locks if sending window is full.
+     * @brief   Signaled when the sending window has room again.
      */
-    sem_t send_win_not_full;
+    pthread_cond_t send_win_not_full;
+    /**
+     * @brief   timerfd set to the earliest retransmission of the
+     *          sending window, served by the event loop.
+     */
+    int timer_fd;
+    long srtt;                          ///< Smoothed round trip time (in µsec), 0 until measured.
+    long rttvar;                        ///< Round trip time variation (in µsec).
+    long rto;                           ///< Current retransmission timeout (in µsec).
+    uint16_t transmissions;             ///< Counts the frames written to the tty, retransmissions included.
+    uint16_t delivered_tx;              ///< Latest transmission of an acknowledged frame.
     /**
      * @brief a slot in the sending window
      */
     struct send_slot {
-        pthread_t resend_thread;        ///< Thread that handles the resending of this slot's frame (if needed).
+        struct timespec sent;           ///< Time of the first transmission of this slot's frame.
+        struct timespec deadline;       ///< Time of the next retransmission of this slot's frame.
+        uint8_t acked;                  ///< != 0 if this slot's frame was selectively acknowledged.
+        uint8_t retransmitted;          ///< != 0 if this slot's frame was retransmitted, no RTT sample then (Karn).
+        uint16_t tx;                    ///< Value of transmissions at the last transmission of this slot's frame.
         uint8_t frame[BUFFER_SIZE];     ///< This slot's frame.
         size_t frame_len;               ///< The length of this slot's frame.
     } send_win[BORDER_SWS];             ///< The sending window.
@@ -89,15 +127,58 @@ typedef struct __attribute__ ((packed)) border_syn_packet_t {
      */
     uint8_t next_exp;
     struct in6_addr addr;   ///< IPv6-Address of this border router.
+    uint8_t window;         ///< Receiving window of this border router.
 } border_syn_packet_t;
 
+/**
+ * @brief   Describes a SYN/ACK packet, the MSB-A2's answer to a
+ *          @ref border_syn_packet_t.
+ * @extends border_conf_header_t
+ */
+typedef struct __attribute__ ((packed)) border_synack_packet_t {
+    uint8_t empty;
+    uint8_t type;
+    uint8_t seq_num;
+    uint8_t conftype;
+    uint8_t window;         ///< Receiving window of the MSB-A2.
+} border_synack_packet_t;
+
+/**
+ * @brief   Describes an acknowledgement packet.
+ * @extends border_packet_t
+ * 
+ * Acknowledges all frames up to @ref border_packet_t::seq_num, and
+ * selectively the frames <em>seq_num + 2 + i</em> for every bit 
+ * <em>i</em> set in <em>sack</em> (least significant bit of 
+ * <em>sack[0]</em> first).
+ */
+typedef struct __attribute__ ((packed)) border_ack_packet_t {
+    uint8_t empty;
+    uint8_t type;
+    uint8_t seq_num;
+    uint8_t sack[BORDER_SACK_LEN];  ///< Frames received behind the first missing one.
+} border_ack_packet_t;
+
 /**
  * @brief   Sets the flow control algorithm to the initial state.
  * @param[in]   addr    The IP address that should be communicated to the
  *                      LoWPAN interface.
+ * 
+ * Returns once the three-way handshake is done, running the event loop
+ * (s. border_poll()) while it waits for the SYNACK.
  */
 void flowcontrol_init(const struct in6_addr *addr);
 
+/**
+ * @brief   Tells if flowcontrol_send_over_tty() would send at once.
+ * @return  1 if the connection is established and the sending window
+ *          has room for another packet, 0 if not.
+ * 
+ * The event loop only reads from the TUN interface while this holds,
+ * since a full window waits for ACKs the event loop itself receives.
+ */
+int flowcontrol_send_ready(void);
+
 /**
  * @brief   Destroys the state struct for the flow control algorithm.
  */
@@ -106,8 +187,24 @@ void flowcontrol_destroy(void);
 /**
  * @brief   Singals the flow control algorith, that an connection
  *          was established (because a SYNACK packet was received).
+ * @param[in]   window  Receiving window of the MSB-A2.
+ */
+void signal_connection_established(uint8_t window);
+
+/**
+ * @brief   Returns the timerfd of the retransmission timer.
+ * @return  A file descriptor that gets readable when
+ *          flowcontrol_retransmit() has frames to retransmit.
+ */
+int flowcontrol_timer_fd(void);
+
+/**
+ * @brief   Retransmits the frames of the sending window whose
+ *          timeout ran out.
+ * 
+ * Called by the event loop when flowcontrol_timer_fd() is readable.
  */
-void signal_connection_established(void);
+void flowcontrol_retransmit(void);
 
 /**
  * @brief   Sends a packet via the serial interface.
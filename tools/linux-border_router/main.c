@@ -5,7 +5,14 @@
 #include "sixlowdriver.h"
 
 #ifdef BORDER_TESTING
+#include <pthread.h>
+
 #include "testing.h"
+
+void *event_loop_f(void *arg) {
+    border_event_loop();
+    return NULL;
+}
 #endif
 
 int main(int argc, char **argv) {
@@ -23,6 +30,7 @@ int main(int argc, char **argv) {
 #ifdef BORDER_TESTING
         char ping_addr[IPV6_ADDR_LEN];
         float interval;
+        pthread_t event_loop;
         
         if (argc < 9) {
             fprintf(stderr, "Usage: %s r_addr if_name tty_dev ping_id result_dir skeleton_file ping_count interval\n", argv[0]);
@@ -32,9 +40,10 @@ int main(int argc, char **argv) {
         sscanf(argv[8], "%f", &interval);
         sprintf(ping_addr, "abcd::%s/64",argv[4]);
         
+        pthread_create(&event_loop, NULL, event_loop_f, NULL);
         start_test(ping_addr,argv[5],argv[6],atoi(argv[7]),interval);
 #else       
-        while(1);
+        return border_event_loop();
 #endif
     }
     return 0;
@@ -1,8 +1,11 @@
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <arpa/inet.h>
+#include <sys/uio.h>
 
 #include "flowcontrol.h"
 #include "multiplex.h"
@@ -14,6 +17,9 @@
 #define END_ESC     0xDC
 #define ESC_ESC     0xDD
 
+#define SERIAL_READ_BLOCK   4096    ///< Bytes asked from the tty per read.
+#define SERIAL_WRITE_IOV    64      ///< Pieces of a packet per writev.
+
 uint8_t serial_out_buf[BUFFER_SIZE];
 uint8_t serial_in_buf[BUFFER_SIZE];
 
@@ -37,104 +43,169 @@ int init_multiplex(const char *tty_dev) {
     return open_serial_port(tty_dev);
 }
 
-uint8_t serial_read_byte() {
-    unsigned char c;
-    
-    read_serial_port(&c, 1);
-    
-    return (uint8_t)c;
+/* SLIP decoder state, kept across reads since packets span them */
+static size_t in_len = 0;
+static uint8_t in_esc = 0;
+static uint8_t in_translate = 1;
+
+static pthread_mutex_t serial_out_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const uint8_t slip_end = END;
+static const uint8_t slip_esc_end[] = {ESC, END_ESC};
+static const uint8_t slip_esc_esc[] = {ESC, ESC_ESC};
+
+static void decoder_reset(void) {
+    in_len = 0;
+    in_esc = 0;
+    in_translate = 1;
 }
 
-int readpacket(uint8_t *packet_buf, size_t size) {
-    uint8_t *line_buf_ptr = packet_buf;
-    uint8_t byte = END+1;
-    uint8_t esc = 0;
-    uint8_t translate = 1;
+int readpackets(void (*handle)(uint8_t *packet_buf, int len)) {
+    uint8_t block[SERIAL_READ_BLOCK];
+    uint8_t byte;
+    int n, i;
+    
+    n = read_serial_port(block, SERIAL_READ_BLOCK);
+    
+    if (n < 0) {
+        /* readable was a false alarm */
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    if (n == 0) {
+        return -1;
+    }
     
-    while ((line_buf_ptr - packet_buf) < size-1) {
-        byte = serial_read_byte();
+    for (i = 0; i < n; i++) {
+        byte = block[i];
         
-        if (translate && byte == END) {
-            break;
+        if (in_translate && byte == END) {
+            if (in_len > 0) {
+                handle(serial_in_buf, in_len);
+            }
+            decoder_reset();
+            continue;
         }
         
-        if (line_buf_ptr == packet_buf && byte != 0) {
-            translate = 0;
+        if (in_len == 0 && byte != 0) {
+            in_translate = 0;
         }
         
-        if (line_buf_ptr > packet_buf && !translate && byte == '\n') {
-            *line_buf_ptr++ = '\0';
-            return line_buf_ptr - packet_buf;
+        if (in_len > 0 && !in_translate && byte == '\n') {
+            serial_in_buf[in_len++] = '\0';
+            handle(serial_in_buf, in_len);
+            decoder_reset();
+            continue;
         }
         
-        if (translate) {
-            if (esc) {
-                esc = 0;
+        if (in_translate) {
+            if (in_esc) {
+                in_esc = 0;
                 switch (byte) {
                     case(END_ESC):{
-                        *line_buf_ptr++ = END;
-                        continue;
+                        byte = END;
+                        break;
                     }
                     case(ESC_ESC):{
-                        *line_buf_ptr++ = ESC;
-                        continue;
+                        byte = ESC;
+                        break;
                     }
                     default:
                         continue;
                 }
             }
-                    
-            if (byte == ESC) {
-                esc = 1;
+            else if (byte == ESC) {
+                in_esc = 1;
                 continue;
             }
         }
         
-        *line_buf_ptr++ = byte;
+        serial_in_buf[in_len++] = byte;
+        
+        /* too long for any packet, hand over what we have like before */
+        if (in_len == BUFFER_SIZE - 1) {
+            handle(serial_in_buf, in_len);
+            decoder_reset();
+        }
     }
     
-    return (line_buf_ptr - packet_buf);
+    return n;
 }
 
-
+/* writes all of iov, advancing it over partial writes */
+static int write_serial_iov(struct iovec *iov, int iovcnt) {
+    ssize_t n;
+    
+    while (iovcnt > 0) {
+        n = writev(serial_port_fd(), iov, iovcnt);
+        
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        
+        while (iovcnt > 0 && n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    
+    return 0;
+}
 
 int writepacket(uint8_t *packet_buf, size_t size) {
-    uint8_t packet_tmp[2*BUFFER_SIZE];
+    struct iovec iov[SERIAL_WRITE_IOV];
     uint8_t *byte_ptr = packet_buf;
-    uint8_t *tmp_ptr = packet_tmp;
+    uint8_t *run = packet_buf;
+    int iovcnt = 0, res = 0;
     
-    if (2*size + 1 > BUFFER_SIZE) {
+    if (size > BUFFER_SIZE) {
         return -1;
     }
     
+    /* 
+     * The unescaped runs of the packet go out in place, only the escape
+     * sequences come from elsewhere. Leave room for a run and an escape
+     * sequence, or a run and the END byte.
+     */
+    pthread_mutex_lock(&serial_out_lock);
+    
     while ((byte_ptr - packet_buf) < size) {
-        switch (*byte_ptr) {
-            case(END):{
-                *byte_ptr = END_ESC;
-                *tmp_ptr = ESC;
-                tmp_ptr++;
-                break;
+        if (*byte_ptr == END || *byte_ptr == ESC) {
+            if (byte_ptr > run) {
+                iov[iovcnt].iov_base = run;
+                iov[iovcnt++].iov_len = byte_ptr - run;
             }
-            case(ESC):{
-                *byte_ptr = ESC_ESC;
-                *tmp_ptr = ESC;
-                tmp_ptr++;
-                break;
-            }
-            default:{
-                break;
+            iov[iovcnt].iov_base = (void *)((*byte_ptr == END) ? slip_esc_end : slip_esc_esc);
+            iov[iovcnt++].iov_len = 2;
+            run = byte_ptr + 1;
+            
+            if (iovcnt > SERIAL_WRITE_IOV - 2) {
+                res |= write_serial_iov(iov, iovcnt);
+                iovcnt = 0;
             }
         }
-        
-        *tmp_ptr = *byte_ptr;
         byte_ptr++;
-        tmp_ptr++;
     }
     
-    *tmp_ptr++ = END;
-    write_serial_port(packet_tmp, tmp_ptr - packet_tmp);
+    if (byte_ptr > run) {
+        iov[iovcnt].iov_base = run;
+        iov[iovcnt++].iov_len = byte_ptr - run;
+    }
+    iov[iovcnt].iov_base = (void *)&slip_end;
+    iov[iovcnt++].iov_len = 1;
+    res |= write_serial_iov(iov, iovcnt);
     
-    return 0;
+    pthread_mutex_unlock(&serial_out_lock);
+    
+    return res;
 }
 
 void demultiplex(const border_packet_t *packet, int len) {
@@ -164,8 +235,13 @@ void demultiplex(const border_packet_t *packet, int len) {
             border_conf_header_t *conf_header_buf = (border_conf_header_t *)packet;
             switch (conf_header_buf->conftype) {
                 case (BORDER_CONF_SYNACK):{
+                    border_synack_packet_t *synack = (border_synack_packet_t *)packet;
+                    
                     printf("INFO: SYNACK-Packet %d received\n",conf_header_buf->seq_num);
-                    signal_connection_established();
+                    /* older nodes do not announce a window, they take one frame */
+                    signal_connection_established(
+                            (len >= sizeof (border_synack_packet_t)) ? synack->window : 1
+                        );
                     break;
                 }
                 case (BORDER_CONF_CONTEXT):{
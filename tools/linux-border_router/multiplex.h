@@ -172,14 +172,20 @@ void multiplex_send_context_over_tty(const border_context_t *context);
 void multiplex_send_addr_over_tty(struct in6_addr *addr);
 
 /**
- * @brief   Reads a packet up to a length of <em>size</em> bytes from 
- *          the serial interface and saves it to <em>packet_buf</em>.
- * @param[out]  packet_buf  The buffer the read packet should be written
- *                          into.
- * @param[in]   size        The maximum number of bytes to be read.
- * @return  The number of bytes read.
+ * @brief   Reads the bytes that are waiting on the serial interface
+ *          and hands every packet completed by them to <em>handle</em>.
+ * @param[in]   handle  Called with each complete packet and its length.
+ *                      The packet is only valid during the call.
+ * @return  The number of bytes read, 0 if none were waiting, -1 if the
+ *          serial interface was closed or failed.
+ * 
+ * Reads up to a block at once, so it should only be called when the
+ * serial interface is readable. Packets may span several calls, the
+ * SLIP decoder keeps its state in between. Lines of text (the MSB-A2's
+ * stdout, not starting with a 0 byte) are handed over as packets of
+ * their own, terminated with '\0'.
  */
-int readpacket(uint8_t *packet_buf, size_t size);
+int readpackets(void (*handle)(uint8_t *packet_buf, int len));
 
 /**
  * @brief   Writes a packet up to a length of <em>size</em> bytes from 
@@ -187,7 +193,11 @@ int readpacket(uint8_t *packet_buf, size_t size);
  * @param[in]   packet_buf  The buffer from which the packet should be 
  *                          written.
  * @param[in]   size        The maximum number of bytes to be written.
- * @return  The number of bytes written.
+ * @return  0 if the packet was written, -1 if not.
+ * 
+ * The packet is SLIP-encoded on the fly and written with writev()
+ * straight from <em>packet_buf</em>, which is left unchanged. Safe to
+ * call from several threads.
  */
 int writepacket(uint8_t *packet_buf, size_t size);
 
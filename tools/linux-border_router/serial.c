@@ -224,7 +224,9 @@ int read_serial_port(unsigned char *buf, int bufsize)
 {
 	int num;
 
-        num = read(port_fd, buf, bufsize);
+        do {
+                num = read(port_fd, buf, bufsize);
+        } while (num < 0 && errno == EINTR);
 
 	return num;
 }
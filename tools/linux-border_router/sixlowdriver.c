@@ -3,38 +3,42 @@
 #include <stdint.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <fcntl.h>
-#include <pthread.h>
 #include <signal.h>
 
 #include <arpa/inet.h>
 #include <net/if.h>
 #include <netinet/ip6.h>
 
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include <linux/if_tun.h>
 
 #include "sixlowdriver.h"
 #include "multiplex.h"
 #include "flowcontrol.h"
+#include "serial.h"
 #include "serialnumber.h"
 #include "control_2xxx.h"
 
 #define TUNDEV              "/dev/net/tun"
 #define MAXIMUM_CONTEXTS    16
+#define TUN_READ_BATCH      16  ///< Packets read from the TUN interface per event.
 
 char tun_if_name[IF_NAME_LEN];
 
-uint8_t tun_out_buf[BUFFER_SIZE];
 uint8_t tun_in_buf[BUFFER_SIZE];
 
 /* Cell i is defined as empty if context_cache[i].cid != i */
 border_context_t context_cache[MAXIMUM_CONTEXTS];
 
 int tun_fd;
-pthread_t serial_reader, tun_reader;
+int epoll_fd = -1;
+int tun_polled = 1;
 uint16_t abro_version = 0;
 
 uint16_t get_abro_version() {
@@ -50,64 +54,125 @@ int get_tun_fd(void) {
     return tun_fd;
 }
 
-void * serial_reader_f(void *arg) {
-    unsigned char buf[BUFFER_SIZE];
-    border_packet_t *packet_buf;
-    
-    while(1) {
-        int n = readpacket(buf, BUFFER_SIZE);
-        if (n > 0) {
-            if (buf[0] == 0) { 
-                packet_buf = (border_packet_t *)buf;
-                flowcontrol_deliver_from_tty(packet_buf, n);
-                continue;
-            }
-            printf("\033[00;33m[via serial interface] %s\033[00m\n",buf);
+void serial_packet_received(uint8_t *packet, int len) {
+    if (packet[0] == 0) {
+        flowcontrol_deliver_from_tty((border_packet_t *)packet, len);
+        return;
+    }
+    printf("\033[00;33m[via serial interface] %s\033[00m\n", packet);
+}
+
+/* reads straight behind the L3 header, the TUN header goes aside */
+void tun_read_packets(void) {
+    border_l3_header_t *l3_hdr = (border_l3_header_t *)tun_in_buf;
+    struct tun_pi tun_hdr;
+    struct iovec iov[2];
+    ssize_t bytes;
+    int i;
+    
+    iov[0].iov_base = &tun_hdr;
+    iov[0].iov_len = sizeof (struct tun_pi);
+    iov[1].iov_base = tun_in_buf + sizeof (border_l3_header_t);
+    iov[1].iov_len = BUFFER_SIZE - sizeof (border_l3_header_t);
+    
+    for (i = 0; i < TUN_READ_BATCH && flowcontrol_send_ready(); i++) {
+        bytes = readv(tun_fd, iov, 2);
+        
+        if (bytes <= (ssize_t)sizeof (struct tun_pi)) {
+            return;
         }
+        
+        l3_hdr->empty = 0;
+        l3_hdr->type = BORDER_PACKET_L3_TYPE;
+        l3_hdr->ethertype = ntohs(tun_hdr.proto);
+        flowcontrol_send_over_tty((border_packet_t *)l3_hdr, 
+                sizeof (border_l3_header_t) + bytes - sizeof (struct tun_pi));
     }
 }
 
-int tun_to_serial_packet(uint8_t *serial_packet, uint8_t *tun_packet, size_t packet_size) {
-    struct tun_pi *tun_hdr = (struct tun_pi *)tun_packet;
-    border_l3_header_t *l3_hdr = (border_l3_header_t *)serial_packet;
-    
-    l3_hdr->empty = 0;
-    l3_hdr->type = BORDER_PACKET_L3_TYPE;
-    l3_hdr->ethertype = ntohs(tun_hdr->proto);
-    
-    memcpy(
-            serial_packet + sizeof (border_l3_header_t), 
-            tun_packet + sizeof (struct tun_pi),
-            packet_size - sizeof (struct tun_pi)
-        );
-    return (sizeof (border_l3_header_t) + (packet_size - sizeof (struct tun_pi)));
+/* the TUN interface is only watched while its packets can be sent */
+void update_tun_polling(void) {
+    struct epoll_event ev;
+    int ready = flowcontrol_send_ready();
+    
+    if (ready == tun_polled) {
+        return;
+    }
+    
+    ev.events = ready ? EPOLLIN : 0;
+    ev.data.fd = tun_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, tun_fd, &ev);
+    tun_polled = ready;
 }
 
-void * tun_reader_f(void *args) {
-    unsigned char data[BUFFER_SIZE];
-    size_t bytes;
+int init_event_loop(void) {
+    struct epoll_event ev;
     
-    while (1) {
-        bytes = read(tun_fd,(void*)data, BUFFER_SIZE);
-        
-        if (bytes > 0) {
-            bytes = tun_to_serial_packet(tun_in_buf, (uint8_t *)data, bytes);
-            flowcontrol_send_over_tty((border_packet_t *)tun_in_buf, bytes);
+    if ((epoll_fd = epoll_create(2)) < 0) {
+        return -1;
+    }
+    
+    fcntl(tun_fd, F_SETFL, fcntl(tun_fd, F_GETFL) | O_NONBLOCK);
+    
+    ev.events = EPOLLIN;
+    ev.data.fd = serial_port_fd();
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, serial_port_fd(), &ev) < 0) {
+        return -1;
+    }
+    
+    ev.data.fd = tun_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, tun_fd, &ev) < 0) {
+        return -1;
+    }
+    tun_polled = 1;
+    
+    return 0;
+}
+
+int border_poll(int timeout) {
+    struct epoll_event events[3];
+    int i, n;
+    
+    update_tun_polling();
+    
+    n = epoll_wait(epoll_fd, events, 3, timeout);
+    if (n < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+    
+    for (i = 0; i < n; i++) {
+        if (events[i].data.fd == tun_fd) {
+            tun_read_packets();
+        }
+        else if (events[i].data.fd == flowcontrol_timer_fd()) {
+            flowcontrol_retransmit();
+        }
+        else if (readpackets(serial_packet_received) < 0) {
+            return -1;
         }
     }
+    
+    return n;
 }
 
-void border_send_ipv6_over_tun(int fd, const struct ip6_hdr *packet) {
-    uint8_t tun_packet[BUFFER_SIZE];
-    int packet_size = packet->ip6_plen + sizeof (struct ip6_hdr);
+int border_event_loop(void) {
+    while (border_poll(-1) >= 0);
     
-    struct tun_pi *tun_hdr = (struct tun_pi *)tun_packet;
+    return -1;
+}
+
+void border_send_ipv6_over_tun(int fd, const struct ip6_hdr *packet) {
+    struct tun_pi tun_hdr;
+    struct iovec iov[2];
     
-    tun_hdr->flags = 0;
-    tun_hdr->proto = htons(ETHERTYPE_IPV6);
+    tun_hdr.flags = 0;
+    tun_hdr.proto = htons(ETHERTYPE_IPV6);
     
-    memcpy(tun_packet+sizeof (struct tun_pi),(uint8_t *)packet, packet_size);
-    write(tun_fd,tun_packet,packet_size+sizeof (struct tun_pi));
+    iov[0].iov_base = &tun_hdr;
+    iov[0].iov_len = sizeof (struct tun_pi);
+    iov[1].iov_base = (void *)packet;
+    iov[1].iov_len = packet->ip6_plen + sizeof (struct ip6_hdr);
+    writev(fd, iov, 2);
 }
 
 int tun_set_owner(int fd, const uid_t *uid, const gid_t *gid) {
@@ -261,6 +326,7 @@ int border_add_addr(const char *ip_addr) {
 }
 
 int border_initialize(char *if_name, const char *ip_addr, const char *tty_dev) {
+    struct epoll_event ev;
     int res, i;
     char command[21 + IPV6_ADDR_LEN + IF_NAME_LEN];
     char ip_addr_cpy[IPV6_ADDR_LEN];
@@ -278,7 +344,9 @@ int border_initialize(char *if_name, const char *ip_addr, const char *tty_dev) {
         return res;
     }
     
-    tun_fd = open_tun(if_name, IFF_TUN);
+    if ((tun_fd = open_tun(if_name, IFF_TUN)) < 0) {
+        return tun_fd;
+    }
     
     printf("INFO: ip link set %s up\n", if_name);
     sprintf(command, "ip link set %s up", if_name);
@@ -298,11 +366,19 @@ int border_initialize(char *if_name, const char *ip_addr, const char *tty_dev) {
         context_cache[i].cid = 0xFF;
     }
     
-    pthread_create(&serial_reader, NULL, serial_reader_f, NULL);
+    if ((res = init_event_loop()) != 0) {
+        return res;
+    }
     
     hard_reset_to_user_code();
     flowcontrol_init(&parsed_addr);
-    pthread_create(&tun_reader, NULL, tun_reader_f, NULL);
+    
+    /* retransmissions only start with the first packet after the handshake */
+    ev.events = EPOLLIN;
+    ev.data.fd = flowcontrol_timer_fd();
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, flowcontrol_timer_fd(), &ev) < 0) {
+        return -1;
+    }
     
     return 0;
 }
@@ -90,9 +90,36 @@ int tun_add_addr(const char *ip_addr);
  *                          MSB-A2 is attached to.
  * @return  0 if successfull, 
  *          != 0 if an error occurs.
+ * 
+ * Returns after the handshake with the MSB-A2, the packets are then
+ * forwarded by border_event_loop().
  */
 int border_initialize(char *if_name, const char *ip_addr, const char *tty_dev);
 
+/**
+ * @brief   Runs one round of the border router's event loop.
+ * @param[in]   timeout How long to wait for the serial or the TUN
+ *                      interface to get readable, in milliseconds,
+ *                      -1 to wait forever.
+ * @return  The number of interfaces served, 0 on timeout, -1 if the
+ *          serial interface was closed or failed.
+ * 
+ * Packets from the serial interface are demultiplexed, packets from
+ * the TUN interface are sent via the serial interface as long as the
+ * sending window has room for them. All of this happens in the calling
+ * thread, so the callers of border_poll() must be serialized.
+ */
+int border_poll(int timeout);
+
+/**
+ * @brief   Runs the border router's event loop until the serial
+ *          interface is closed or fails.
+ * @return  -1
+ * 
+ * Has to be called after border_initialize().
+ */
+int border_event_loop(void);
+
 /**
  * @brief   Sends an IPv6 datagram via the TUN interface.
  * @param[in]   fd      The file descriptor of the TUN interface
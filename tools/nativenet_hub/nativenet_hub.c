@@ -0,0 +1,480 @@
+/**
+ * nativenet hub: shared radio medium for native nodes
+ *
+ * Every native node running the nativenet transceiver sends its frames as
+ * datagrams to this process, which delivers them to all nodes in radio
+ * range of the sender. Range, loss and latency come from a topology file
+ * or, without one, apply uniformly to a full mesh.
+ *
+ * Copyright (C) 2010 Freie Universität Berlin
+ *
+ * This file subject to the terms and conditions of the GNU General Public
+ * License. See the file LICENSE in the top level directory for more details.
+ *
+ * @author Freie Universität Berlin, Computer Systems & Telematics, FeuerWhere project
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nativenet_proto.h"
+
+#define MAX_NODES       (1024)
+#define ADDRESS_SPACE   (65536)
+
+typedef struct node_t {
+    struct sockaddr_un sa;
+    uint16_t address;
+    uint8_t channel;
+    uint8_t active;
+} node_t;
+
+typedef struct link_t {
+    uint16_t dst;
+    double loss;            ///< probability in [0, 1]
+    uint32_t latency;       ///< microseconds
+    uint8_t rssi;
+    uint8_t lqi;
+    struct link_t *next;
+} link_t;
+
+typedef struct delivery_t {
+    uint64_t due;           ///< microseconds, CLOCK_MONOTONIC
+    int node;
+    size_t len;
+    nativenet_frame_t frame;
+} delivery_t;
+
+static node_t nodes[MAX_NODES];
+static int num_nodes;
+
+/* outgoing links by source address, NULL for every address without a
+ * topology entry; unused in full mesh mode */
+static link_t *links[ADDRESS_SPACE];
+static int use_topology;
+
+static double default_loss;
+static uint32_t default_latency;
+static int promiscuous;
+
+/* pending deliveries as binary min-heap on due */
+static delivery_t **heap;
+static size_t heap_len;
+static size_t heap_size;
+
+static int sock = -1;
+static const char *sock_path = NATIVENET_HUB_PATH;
+
+static struct {
+    unsigned long frames_in;
+    unsigned long delivered;
+    unsigned long lost;
+    unsigned long unreachable;
+    unsigned long send_failed;
+} stats;
+
+static volatile sig_atomic_t running = 1;
+static volatile sig_atomic_t dump_stats = 0;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*---------------------------------------------------------------------------*/
+static void heap_push(delivery_t *d) {
+    if (heap_len == heap_size) {
+        heap_size = heap_size ? 2 * heap_size : 256;
+        heap = realloc(heap, heap_size * sizeof(*heap));
+        if (heap == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    size_t i = heap_len++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (heap[parent]->due <= d->due) {
+            break;
+        }
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = d;
+}
+
+static delivery_t *heap_pop(void) {
+    delivery_t *top = heap[0];
+    delivery_t *last = heap[--heap_len];
+    size_t i = 0;
+
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= heap_len) {
+            break;
+        }
+        if ((child + 1 < heap_len) && (heap[child + 1]->due < heap[child]->due)) {
+            child++;
+        }
+        if (last->due <= heap[child]->due) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (heap_len) {
+        heap[i] = last;
+    }
+
+    return top;
+}
+
+/*---------------------------------------------------------------------------*/
+static int node_by_sockaddr(struct sockaddr_un *sa) {
+    for (int i = 0; i < num_nodes; i++) {
+        if (strcmp(nodes[i].sa.sun_path, sa->sun_path) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int node_add(struct sockaddr_un *sa) {
+    int n = node_by_sockaddr(sa);
+    if (n >= 0) {
+        return n;
+    }
+
+    /* reuse slots of nodes that said goodbye */
+    for (n = 0; n < num_nodes; n++) {
+        if (!nodes[n].active) {
+            break;
+        }
+    }
+    if (n == MAX_NODES) {
+        fprintf(stderr, "too many nodes, ignoring %s\n", sa->sun_path);
+        return -1;
+    }
+    if (n == num_nodes) {
+        num_nodes++;
+    }
+
+    memset(&nodes[n], 0, sizeof(nodes[n]));
+    nodes[n].sa = *sa;
+    return n;
+}
+
+static void send_to_node(int n, nativenet_frame_t *frame, size_t len) {
+    if (sendto(sock, frame, len, 0, (struct sockaddr *) &nodes[n].sa, sizeof(nodes[n].sa)) < 0) {
+        stats.send_failed++;
+        if ((errno == ECONNREFUSED) || (errno == ENOENT)) {
+            /* the node process is gone */
+            nodes[n].active = 0;
+        }
+        return;
+    }
+    stats.delivered++;
+}
+
+static void deliver(int n, nativenet_frame_t *frame, size_t len, double loss,
+                    uint32_t latency, uint8_t rssi, uint8_t lqi) {
+    if ((loss > 0) && (drand48() < loss)) {
+        stats.lost++;
+        return;
+    }
+
+    frame->rssi = rssi;
+    frame->lqi = lqi;
+
+    if (latency == 0) {
+        send_to_node(n, frame, len);
+        return;
+    }
+
+    delivery_t *d = malloc(sizeof(*d));
+    if (d == NULL) {
+        stats.lost++;
+        return;
+    }
+    d->due = now_us() + latency;
+    d->node = n;
+    d->len = len;
+    memcpy(&d->frame, frame, len);
+    heap_push(d);
+}
+
+static int wants_frame(node_t *rx, nativenet_frame_t *frame) {
+    if (!rx->active || (rx->channel != frame->channel)) {
+        return 0;
+    }
+    /* the nodes filter by address themselves, the hub only saves the
+     * copies nobody would accept unless asked for promiscuous delivery */
+    return promiscuous || (frame->dst == NATIVENET_BROADCAST_ADDRESS) ||
+           (frame->dst == rx->address);
+}
+
+static void handle_data(int sender, nativenet_frame_t *frame, size_t len) {
+    stats.frames_in++;
+
+    if (!use_topology) {
+        for (int i = 0; i < num_nodes; i++) {
+            if ((i != sender) && wants_frame(&nodes[i], frame)) {
+                deliver(i, frame, len, default_loss, default_latency, 0, 255);
+            }
+        }
+        return;
+    }
+
+    int reached = 0;
+    for (link_t *l = links[frame->src]; l != NULL; l = l->next) {
+        for (int i = 0; i < num_nodes; i++) {
+            if ((i != sender) && (nodes[i].address == l->dst) && wants_frame(&nodes[i], frame)) {
+                deliver(i, frame, len, l->loss, l->latency, l->rssi, l->lqi);
+                reached = 1;
+            }
+        }
+    }
+    if (!reached) {
+        stats.unreachable++;
+    }
+}
+
+static void handle_datagram(void) {
+    nativenet_frame_t frame;
+    struct sockaddr_un sa;
+    socklen_t salen = sizeof(sa);
+
+    memset(&sa, 0, sizeof(sa));
+    ssize_t n = recvfrom(sock, &frame, sizeof(frame), MSG_DONTWAIT, (struct sockaddr *) &sa, &salen);
+    if (n < (ssize_t) NATIVENET_FRAME_HEADER_LENGTH) {
+        return;
+    }
+    if (NATIVENET_FRAME_HEADER_LENGTH + frame.length != (size_t) n) {
+        fprintf(stderr, "malformed frame from %s\n", sa.sun_path);
+        return;
+    }
+
+    int sender = node_add(&sa);
+    if (sender < 0) {
+        return;
+    }
+
+    switch (frame.type) {
+        case NATIVENET_HELLO:
+            nodes[sender].address = frame.src;
+            nodes[sender].channel = frame.channel;
+            nodes[sender].active = 1;
+            break;
+        case NATIVENET_BYE:
+            nodes[sender].active = 0;
+            break;
+        case NATIVENET_DATA:
+            nodes[sender].address = frame.src;
+            nodes[sender].channel = frame.channel;
+            nodes[sender].active = 1;
+            handle_data(sender, &frame, n);
+            break;
+        default:
+            break;
+    }
+}
+
+static void run_due(void) {
+    uint64_t now = now_us();
+    while (heap_len && (heap[0]->due <= now)) {
+        delivery_t *d = heap_pop();
+        if (nodes[d->node].active) {
+            send_to_node(d->node, &d->frame, d->len);
+        }
+        free(d);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+static int load_topology(const char *file) {
+    FILE *f = fopen(file, "r");
+    char line[256];
+    int lineno = 0;
+
+    if (f == NULL) {
+        perror(file);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        unsigned src, dst, rssi = 0, lqi = 255;
+        double loss = default_loss * 100;
+        unsigned latency = default_latency;
+
+        lineno++;
+        char *p = line + strspn(line, " \t");
+        if ((*p == '#') || (*p == '\n') || (*p == '\0')) {
+            continue;
+        }
+        if (sscanf(p, "%u %u %lf %u %u %u", &src, &dst, &loss, &latency, &rssi, &lqi) < 2 ||
+            (src >= ADDRESS_SPACE) || (dst >= ADDRESS_SPACE)) {
+            fprintf(stderr, "%s:%i: syntax error\n", file, lineno);
+            fclose(f);
+            return -1;
+        }
+
+        link_t *l = malloc(sizeof(*l));
+        if (l == NULL) {
+            fclose(f);
+            return -1;
+        }
+        l->dst = dst;
+        l->loss = loss / 100;
+        l->latency = latency;
+        l->rssi = rssi;
+        l->lqi = lqi;
+        l->next = links[src];
+        links[src] = l;
+    }
+
+    fclose(f);
+    use_topology = 1;
+    return 0;
+}
+
+static void print_stats(void) {
+    int active = 0;
+    for (int i = 0; i < num_nodes; i++) {
+        active += nodes[i].active;
+    }
+    fprintf(stderr, "nodes: %i frames: %lu delivered: %lu lost: %lu unreachable: %lu "
+            "failed: %lu pending: %lu\n", active, stats.frames_in, stats.delivered,
+            stats.lost, stats.unreachable, stats.send_failed, (unsigned long) heap_len);
+}
+
+static void on_signal(int sig) {
+    if (sig == SIGUSR1) {
+        dump_stats = 1;
+    }
+    else {
+        running = 0;
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-s socket] [-t topology] [-l loss%%] [-d latency_us] "
+            "[-r seed] [-p] [-v interval_s]\n"
+            "  -s  hub socket (default %s, nodes use $NATIVENET_HUB)\n"
+            "  -t  topology file, see topology.example (default: full mesh)\n"
+            "  -l  default loss in percent\n"
+            "  -d  default latency in microseconds\n"
+            "  -r  random seed for loss\n"
+            "  -p  deliver unicast frames to all neighbours (monitor mode nodes)\n"
+            "  -v  print statistics every interval_s seconds (also on SIGUSR1)\n",
+            name, NATIVENET_HUB_PATH);
+}
+
+int main(int argc, char **argv) {
+    const char *topology = NULL;
+    long seed = time(NULL);
+    int interval = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:t:l:d:r:pv:h")) != -1) {
+        switch (opt) {
+            case 's':
+                sock_path = optarg;
+                break;
+            case 't':
+                topology = optarg;
+                break;
+            case 'l':
+                default_loss = atof(optarg) / 100;
+                break;
+            case 'd':
+                default_latency = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                seed = strtol(optarg, NULL, 0);
+                break;
+            case 'p':
+                promiscuous = 1;
+                break;
+            case 'v':
+                interval = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    srand48(seed);
+
+    if ((topology != NULL) && (load_topology(topology) < 0)) {
+        return EXIT_FAILURE;
+    }
+
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, sock_path, sizeof(sa.sun_path) - 1);
+
+    sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+    unlink(sock_path);
+    if ((sock < 0) || (bind(sock, (struct sockaddr *) &sa, sizeof(sa)) < 0)) {
+        perror(sock_path);
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGUSR1, on_signal);
+
+    fprintf(stderr, "nativenet hub listening on %s (%s)\n", sock_path,
+            use_topology ? topology : "full mesh");
+
+    uint64_t next_stats = now_us() + (uint64_t) interval * 1000000;
+    struct pollfd pfd = { sock, POLLIN, 0 };
+
+    while (running) {
+        int timeout = -1;
+        if (heap_len) {
+            uint64_t now = now_us();
+            timeout = (heap[0]->due > now) ? (int)((heap[0]->due - now + 999) / 1000) : 0;
+        }
+        if (interval && ((timeout < 0) || (timeout > interval * 1000))) {
+            timeout = interval * 1000;
+        }
+
+        if (poll(&pfd, 1, timeout) > 0) {
+            /* drain the socket before looking at the clock again */
+            for (int i = 0; (i < 64) && (pfd.revents & POLLIN); i++) {
+                struct pollfd again = { sock, POLLIN, 0 };
+                handle_datagram();
+                if (poll(&again, 1, 0) <= 0) {
+                    break;
+                }
+            }
+        }
+        run_due();
+
+        if (dump_stats || (interval && (now_us() >= next_stats))) {
+            print_stats();
+            dump_stats = 0;
+            next_stats = now_us() + (uint64_t) interval * 1000000;
+        }
+    }
+
+    print_stats();
+    close(sock);
+    unlink(sock_path);
+
+    return EXIT_SUCCESS;
+}